@@ -42,6 +42,8 @@
 
 #include "evproc.h"
 #include "uip.h"
+#include "bsp.h"
+#include "board_conf.h"
 
 #define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
@@ -52,6 +54,20 @@
 #define SLIP_ESC_END 0334
 #define SLIP_ESC_ESC 0335
 
+/* Encoded frames are collected and written in blocks of this size */
+#ifdef SLIP_CONF_TXBUF_SIZE
+#define SLIP_TXBUF_SIZE SLIP_CONF_TXBUF_SIZE
+#else
+#define SLIP_TXBUF_SIZE 32
+#endif
+
+/* Targets able to write a whole block at once define SLIP_CONF_WRITE */
+#ifdef SLIP_CONF_WRITE
+#define SLIP_WRITE(p_data, len) SLIP_CONF_WRITE(p_data, len)
+#else
+#define SLIP_WRITE(p_data, len) slip_putchars(p_data, len)
+#endif
+
 
 uint8_t slip_active;
 
@@ -88,9 +104,15 @@ static uint16_t begin, next_free;
 static uint8_t rxbuf[RX_BUFSIZE];
 static uint16_t pkt_end;        /* SLIP_END tracker. */
 
+static uint8_t txbuf[SLIP_TXBUF_SIZE];
+static uint16_t txbuf_len;
+
 static     void (* input_callback)(void) = NULL;
 static     void rxbuf_init(void);
 static     void slip_callback(c_event_t ev, p_data_t data);
+static     void tx_put(uint8_t c);
+static     void tx_encode(const uint8_t *ptr, uint16_t len);
+static     void tx_flush(void);
 
 void slip_init(void)
 {
@@ -105,35 +127,68 @@ slip_set_input_callback(void (*c)(void))
   input_callback = c;
 }
 /*---------------------------------------------------------------------------*/
-/* slip_send: forward (IPv4) packets with {UIP_FW_NETIF(..., slip_send)}
- * was used in slip-bridge.c
- */
-//#if WITH_UIP
-uint8_t
-slip_send(void)
+#ifndef SLIP_CONF_WRITE
+static void
+slip_putchars(const uint8_t *ptr, uint16_t len)
+{
+  while(len--) {
+    putchar(*ptr++);
+  }
+}
+#endif /* SLIP_CONF_WRITE */
+/*---------------------------------------------------------------------------*/
+static void
+tx_flush(void)
+{
+  if(txbuf_len > 0) {
+    SLIP_WRITE(txbuf, txbuf_len);
+    txbuf_len = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_put(uint8_t c)
+{
+  if(txbuf_len == SLIP_TXBUF_SIZE) {
+    tx_flush();
+  }
+  txbuf[txbuf_len++] = c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_encode(const uint8_t *ptr, uint16_t len)
 {
-  uint16_t i;
-  uint8_t *ptr;
   uint8_t c;
 
-  putchar(SLIP_END);
-
-  ptr = &uip_buf[UIP_LLH_LEN];
-  for(i = 0; i < uip_len; ++i) {
-    if(i == UIP_TCPIP_HLEN) {
-        ptr = (uint8_t *)uip_appdata;
-    }
+  while(len--) {
     c = *ptr++;
     if(c == SLIP_END) {
-        putchar(SLIP_ESC);
-        c = SLIP_ESC_END;
+      tx_put(SLIP_ESC);
+      c = SLIP_ESC_END;
     } else if(c == SLIP_ESC) {
-        putchar(SLIP_ESC);
-        c = SLIP_ESC_ESC;
+      tx_put(SLIP_ESC);
+      c = SLIP_ESC_ESC;
     }
-    putchar(c);
+    tx_put(c);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* slip_send: forward (IPv4) packets with {UIP_FW_NETIF(..., slip_send)}
+ * was used in slip-bridge.c
+ */
+//#if WITH_UIP
+uint8_t
+slip_send(void)
+{
+  tx_put(SLIP_END);
+  if(uip_len > UIP_TCPIP_HLEN) {
+    tx_encode(&uip_buf[UIP_LLH_LEN], UIP_TCPIP_HLEN);
+    tx_encode((uint8_t *)uip_appdata, uip_len - UIP_TCPIP_HLEN);
+  } else {
+    tx_encode(&uip_buf[UIP_LLH_LEN], uip_len);
   }
-  putchar(SLIP_END);
+  tx_put(SLIP_END);
+  tx_flush();
 
   //return UIP_FW_OK;
   return 0;
@@ -143,24 +198,10 @@ slip_send(void)
 uint8_t
 slip_write(const void *_ptr, int len)
 {
-  const uint8_t *ptr = _ptr;
-  uint16_t i;
-  uint8_t c;
-
-  putchar(SLIP_END);
-
-  for(i = 0; i < len; ++i) {
-    c = *ptr++;
-    if(c == SLIP_END) {
-        putchar(SLIP_ESC);
-        c = SLIP_ESC_END;
-    } else if(c == SLIP_ESC) {
-        putchar(SLIP_ESC);
-        c = SLIP_ESC_ESC;
-    }
-    putchar(c);
-  }
-  putchar(SLIP_END);
+  tx_put(SLIP_END);
+  tx_encode(_ptr, len);
+  tx_put(SLIP_END);
+  tx_flush();
 
   return len;
 }
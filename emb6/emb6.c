@@ -189,6 +189,11 @@ uint8_t loc_emb6NetstackInit(s_ns_t * ps_ns)
   uint8_t is_valid;
   e_nsErr_t err;
 
+  /* the MAC address is known by now, make sure nodes sharing a firmware
+   * and a poor entropy source still draw different numbers */
+  random_seed(mac_phy_config.mac_address, sizeof(mac_phy_config.mac_address));
+  random_crypto_seed(mac_phy_config.mac_address, sizeof(mac_phy_config.mac_address));
+
   /* Initialize stack protocols */
   queuebuf_init();
   ctimer_init();
@@ -305,9 +310,13 @@ void emb6_process(uint16_t us_delay)
     /* Attention: emb6 main process loop !! do not change !! */
     while(1)
     {
-        evproc_nextEvent();
         etimer_request_poll();
-        bsp_delay_us(us_delay);
+        if (evproc_nextEvent() == E_QUEUE_EMPTY) {
+            /* timers are polled and no event is left, wait for the next one */
+            bsp_idle(us_delay);
+        } else {
+            bsp_delay_us(us_delay);
+        }
     }
 }
 
@@ -293,6 +293,7 @@ typedef enum netstk_ioc_cmd
      * MAC command codes
      */
     NETSTK_CMD_MAC_RSVD = 200U,
+    NETSTK_CMD_MAC_TXQ_FREE_GET,    /*!< Get frames that can still be queued for the receiver in the packet buffer */
 
     /*
      * PHY command codes
@@ -583,6 +584,7 @@ extern const s_nsHeadComp_t     hc_driver_slipnet;
 */
 /*! Supported link layer security handlers */
 extern const s_nsdllsec_t       dllsec_driver_null;
+extern const s_nsdllsec_t       dllsec_driver_ccm;
 
 
 /*
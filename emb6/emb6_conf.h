@@ -108,7 +108,9 @@
 #endif
 
 /** Neighbor table size */
+#ifndef NBR_TABLE_CONF_MAX_NEIGHBORS
 #define NBR_TABLE_CONF_MAX_NEIGHBORS         10
+#endif
 
 /** Routing table */
 #define UIP_CONF_MAX_ROUTES                  10
@@ -131,6 +133,12 @@
 /** Do we compress the IP header or not */
 #define SICSLOWPAN_CONF_COMPRESSION          SICSLOWPAN_COMPRESSION_HC06
 
+/** Encode the RPL option and source routing header as 6LoRH (RFC 8138).
+   All nodes of the network must support it. */
+#ifndef SICSLOWPAN_CONF_6LORH
+#define SICSLOWPAN_CONF_6LORH                FALSE
+#endif /* SICSLOWPAN_CONF_6LORH */
+
 /** To avoid unnecessary complexity, we assume the common case of
    a constant LoWPAN-wide IEEE 802.15.4 security level, which
    can be specified by defining LLSEC802154_CONF_SECURITY_LEVEL. */
@@ -159,6 +167,16 @@
 #define UIP_ND6_SEND_NA UIP_CONF_ND6_SEND_NA
 #endif
 
+/** enable/disable 6LoWPAN-ND (RFC 6775): addresses are registered with the
+ *  default router instead of being checked by multicast DAD, link-layer
+ *  addresses are taken from the interface identifier instead of multicast
+ *  address resolution, and routers answer RS with unicast RAs */
+#ifndef UIP_CONF_ND6_6LOWPAN_ND
+#define UIP_ND6_6LOWPAN_ND                  FALSE
+#else
+#define UIP_ND6_6LOWPAN_ND UIP_CONF_ND6_6LOWPAN_ND
+#endif
+
 
 /*=============================================================================
                                   RPL SECTION
@@ -277,6 +295,17 @@
 #define RPL_MAX_DAG_PER_INSTANCE     2
 #endif /* RPL_CONF_MAX_DAG_PER_INSTANCE */
 
+/**
+ * Number of nodes the root of a non-storing DODAG (RPL_CONF_MOP set to
+ * RPL_MOP_NON_STORING) can keep in its link table. Each entry takes
+ * 28 bytes on a 32-bit target. Other nodes do not use the table.
+ */
+#ifdef RPL_CONF_NS_LINK_NUM
+#define RPL_NS_LINK_NUM                     RPL_CONF_NS_LINK_NUM
+#else
+#define RPL_NS_LINK_NUM                     32
+#endif /* RPL_CONF_NS_LINK_NUM */
+
 /**
  * Initial metric attributed to a link when the ETX is unknown
  */
@@ -285,6 +314,25 @@
 #else
 #define RPL_INIT_LINK_METRIC                RPL_CONF_INIT_LINK_METRIC
 #endif
+
+/**
+ * Probe parents whose link statistics went stale with unicast DIOs, so
+ * that a backup parent has an up to date ETX before we switch to it
+ */
+#ifdef RPL_CONF_WITH_PROBING
+#define RPL_WITH_PROBING                    RPL_CONF_WITH_PROBING
+#else
+#define RPL_WITH_PROBING                    1
+#endif
+
+/**
+ * Mean interval between two probes, in seconds
+ */
+#ifdef RPL_CONF_PROBING_INTERVAL
+#define RPL_PROBING_INTERVAL                RPL_CONF_PROBING_INTERVAL
+#else
+#define RPL_PROBING_INTERVAL                120
+#endif
 /**
  *
  */
@@ -961,6 +1009,69 @@ void uip_log(char *msg);
 #define NETSTK_CFG_CSMA_MAX_BACKOFF               (uint8_t )(   4u )
 #define NETSTK_CFG_CSMA_UNIT_BACKOFF_US           (uint32_t)( 400u )  /* @50kbps 2FSK */
 
+/*
+ * MAC transmission queue. The frame pool has to hold NETSTK_CFG_MAC_TXQ_DEPTH
+ * frames, and a burst can not be longer than NETSTK_CFG_MAC_TXQ_DEPTH, both
+ * is checked in mac_txq.c. sicslowpan refuses datagrams whose fragments do not
+ * all fit into the queue of their receiver, the defaults are small and allow
+ * a datagram of 4 fragments at most. Boards with RAM to spare raise the
+ * values, all fragments of a UIP_LINK_MTU datagram need 14 frames with long
+ * addresses. The values are compared by the preprocessor and are therefore
+ * given without a cast.
+ */
+
+/*!< Frames the MAC can queue in total. Every frame takes PACKETBUF_SIZE
+     bytes plus its packet attributes (about 230 bytes with the default
+     packet buffer) */
+#ifndef NETSTK_CFG_MAC_TXQ_FRAME_NUM
+#define NETSTK_CFG_MAC_TXQ_FRAME_NUM                        4
+#endif
+
+/*!< Number of neighbours the MAC can queue frames for at the same time */
+#ifndef NETSTK_CFG_MAC_TXQ_NBR_NUM
+#define NETSTK_CFG_MAC_TXQ_NBR_NUM                          4
+#endif
+
+/*!< Frames queued per neighbour, all queues share the frame pool */
+#ifndef NETSTK_CFG_MAC_TXQ_DEPTH
+#define NETSTK_CFG_MAC_TXQ_DEPTH                            4
+#endif
+
+/*!< Frames sent back-to-back to a neighbour before moving on to the next one */
+#ifndef NETSTK_CFG_MAC_TXQ_BURST_MAX
+#define NETSTK_CFG_MAC_TXQ_BURST_MAX                        4
+#endif
+
+/*!< Wake-up phase of a neighbour older than this (in ms) is not used any more
+     for predictions, strobing then covers the whole sleep interval again */
+#ifndef NETSTK_CFG_MAC_PHASE_MAX_AGE
+#define NETSTK_CFG_MAC_PHASE_MAX_AGE              (uint32_t)( 600000u )
+#endif
+
+/*!< Clock tolerance (in ppm) added to the guard time of a predicted wake-up,
+     on top of the drift that has been measured for the neighbour */
+#ifndef NETSTK_CFG_MAC_PHASE_CLOCK_PPM
+#define NETSTK_CFG_MAC_PHASE_CLOCK_PPM            (uint32_t)(    20u )
+#endif
+
+/*!< Largest drift (in ppm) accepted as a measurement, i.e. sum of the
+     tolerances of the crystals on both sides */
+#ifndef NETSTK_CFG_MAC_PHASE_DRIFT_MAX_PPM
+#define NETSTK_CFG_MAC_PHASE_DRIFT_MAX_PPM        (int32_t )(   100 )
+#endif
+
+/*!< Strobe trains without ACK after which the phase of a neighbour is no
+     longer trusted */
+#ifndef NETSTK_CFG_MAC_PHASE_MAX_MISSES
+#define NETSTK_CFG_MAC_PHASE_MAX_MISSES           (uint8_t )(     2u )
+#endif
+
+/*!< Number of MAC header templates kept by the DLLC, one per destination and
+     security level. 0 builds every header field by field */
+#ifndef NETSTK_CFG_DLLC_HDR_CACHE_NUM
+#define NETSTK_CFG_DLLC_HDR_CACHE_NUM                       4u
+#endif
+
 
 /*
 ********************************************************************************
@@ -982,7 +1093,6 @@ void uip_log(char *msg);
 #define MAC_ULE_CFG_STROBE_TX_INTERVAL_IN_MS           (MAC_ULE_CFG_POWERUP_INTERVAL_IN_MS * 2)
 
 #if (MAC_ULE_CFG_LOOSE_SYNC_EN == TRUE)
-#define MAC_ULE_CFG_PWRON_TBL_SIZE                     (uint8_t )(   3u  )
 #define MAC_ULE_CFG_QTY_STROBE_SENT_IN_ADVANCE         (uint8_t )(   3u  )      /*!< variable   */
 #endif
  /**
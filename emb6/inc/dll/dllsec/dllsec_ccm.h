@@ -0,0 +1,142 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*============================================================================*/
+/*============================================================================*/
+
+/**
+ * @file    dllsec_ccm.h
+ * @brief   IEEE 802.15.4 link layer security with AES-CCM*
+ */
+
+/**
+ * \addtogroup llsec
+ * @{
+ */
+
+/**
+ * \defgroup dllsec_ccm LLSEC driver with AES-CCM*
+ *
+ * Every data frame is secured with LLSEC802154_SECURITY_LEVEL. Keys are
+ * pre-shared, either network-wide or pairwise with single neighbours, and
+ * selected implicitly from the addresses of the frame. Replayed frames are
+ * filtered out with the frame counter of each neighbour, separately for
+ * unicast and broadcast frames as the MAC may reorder them.
+ *
+ * The frame counter of the node is part of the CCM* nonce, and a nonce must
+ * never be used twice with the same key. As the counter starts at 0 after a
+ * reboot, the driver does not transmit before one of the following:
+ *  - dllsec_ccm_setFrameCounter() restores a counter that has not been used
+ *    yet. DLLSEC_CCM_CONF_COUNTER_STORE(counter) lets the application keep
+ *    such a counter in persistent storage, it is called whenever the driver
+ *    reserves the next DLLSEC_CCM_COUNTER_WINDOW counter values, before the
+ *    first of them is used. Restoring the last stored value never repeats a
+ *    counter, at the cost of skipping the unused rest of a window. A boot
+ *    epoch kept by the application works as well, e.g. epoch << 24.
+ *  - dllsec_ccm_setKey() sets a network-wide key that has never been used
+ *    before, e.g. one handed out at commissioning. Pairwise keys are not kept
+ *    across reboots either and have to be fresh as well.
+ * Until then, frames are dropped with MAC_TX_ERR_FATAL. Neighbours still
+ * discard the frames of a rebooted node whose counter does not exceed the
+ * last one they have seen, until their replay entry for it is recycled.
+ *
+ * DLLSEC_CCM_CONF_KEY should be set for every deployment. The default key
+ * is publicly known, a build using it gets a warning.
+ *
+ * AES and CCM are borrowed from tinydtls, i.e. the 'dtls' module has to be
+ * built along with 'dllsec' once LLSEC802154_CONF_SECURITY_LEVEL is set.
+ *
+ * @{
+ */
+
+#ifndef DLLSEC_CCM_H_
+#define DLLSEC_CCM_H_
+
+#include "dllsec.h"
+#include "dllsec_802154.h"
+#include "linkaddr.h"
+
+#define DLLSEC_CCM_KEY_LEN              16
+
+/** Network-wide key, used unless a pairwise key is set for a neighbour */
+#ifdef DLLSEC_CCM_CONF_KEY
+#define DLLSEC_CCM_KEY                  DLLSEC_CCM_CONF_KEY
+#else /* DLLSEC_CCM_CONF_KEY */
+#define DLLSEC_CCM_KEY                  { 0x00, 0x01, 0x02, 0x03, \
+                                          0x04, 0x05, 0x06, 0x07, \
+                                          0x08, 0x09, 0x0A, 0x0B, \
+                                          0x0C, 0x0D, 0x0E, 0x0F }
+#endif /* DLLSEC_CCM_CONF_KEY */
+
+/** Counter values reserved at a time by DLLSEC_CCM_CONF_COUNTER_STORE() */
+#ifdef DLLSEC_CCM_CONF_COUNTER_WINDOW
+#define DLLSEC_CCM_COUNTER_WINDOW       DLLSEC_CCM_CONF_COUNTER_WINDOW
+#else /* DLLSEC_CCM_CONF_COUNTER_WINDOW */
+#define DLLSEC_CCM_COUNTER_WINDOW       1024
+#endif /* DLLSEC_CCM_CONF_COUNTER_WINDOW */
+
+/** Number of neighbours a pairwise key can be set for */
+#ifdef DLLSEC_CCM_CONF_PAIRWISE_KEYS
+#define DLLSEC_CCM_PAIRWISE_KEYS        DLLSEC_CCM_CONF_PAIRWISE_KEYS
+#else /* DLLSEC_CCM_CONF_PAIRWISE_KEYS */
+#define DLLSEC_CCM_PAIRWISE_KEYS        2
+#endif /* DLLSEC_CCM_CONF_PAIRWISE_KEYS */
+
+/**
+ * \brief Set a key
+ * \param p_addr  Neighbour of a pairwise key, NULL for the network-wide key
+ * \param p_key   DLLSEC_CCM_KEY_LEN bytes of key, NULL to remove a
+ *                pairwise key
+ * \return 1 on success, 0 if there is no room for another pairwise key
+ */
+int dllsec_ccm_setKey(const linkaddr_t *p_addr, const uint8_t *p_key);
+
+/**
+ * \brief Resume the frame counter after a reboot and allow transmission
+ * \param counter  Highest counter value that may have been used with any of
+ *                 the keys, the next frame uses the one after it. This is
+ *                 the last value given to DLLSEC_CCM_CONF_COUNTER_STORE()
+ * \return 1 on success, 0 if the counter would go backwards
+ */
+int dllsec_ccm_setFrameCounter(uint32_t counter);
+
+#endif /* DLLSEC_CCM_H_ */
+
+/** @} */
+/** @} */
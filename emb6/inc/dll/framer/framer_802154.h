@@ -171,7 +171,7 @@ typedef struct {
   frame802154_scf_t security_control;           /**< Security control bitfield */
   frame802154_frame_counter_t frame_counter;    /**< Frame counter, used for security */
   frame802154_key_source_t key_source;          /**< Key Source subfield */
-  uint8_t  key_index[9];                        /**< < Key Index subfield */
+  uint8_t  key_index;                           /**< Key Index subfield */
 } frame802154_aux_hdr_t;
 
 #if NETSTK_CFG_IEEE_802154G_EN
@@ -15,6 +15,7 @@ typedef struct s_frame_smartmac frame_smartmac_st;
 struct s_frame_smartmac {
   uint8_t type;
   uint8_t ack_required;
+  uint8_t pending;
   uint8_t counter;
   uint16_t pan_id;
   uint16_t dest_addr;
@@ -71,6 +71,10 @@ enum {
      fatal error. The upper layer does not need to try again, as the
      error will be fatal then as well. */
   MAC_TX_ERR_FATAL,
+
+  /**< The frame has been queued by the MAC, the result of its
+     transmission is not known yet. */
+  MAC_TX_QUEUED,
 };
 
 #endif /* MAC_H_ */
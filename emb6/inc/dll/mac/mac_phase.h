@@ -0,0 +1,82 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*============================================================================*/
+/*============================================================================*/
+
+/**
+ * @file    mac_phase.h
+ * @brief   Wake-up phase learning for strobe based low-power MACs
+ *
+ *          Every acknowledged strobe tells when its receiver was awake. The
+ *          time is recorded per neighbour in a table of the nbr-table. The
+ *          next strobe train to the neighbour can then start just before its
+ *          next wake-up instead of covering a whole sleep interval. The drift
+ *          between both clocks is measured over a long baseline and taken
+ *          into account. Strobing covers the whole sleep interval again if
+ *          the phase is unknown, too old or has repeatedly been wrong.
+ */
+
+#ifndef MAC_PHASE_PRESENT
+#define MAC_PHASE_PRESENT
+
+#include "emb6.h"
+#include "linkaddr.h"
+#include "rt_tmr.h"
+
+
+/**
+ * @brief   Strobe statistics of the unicast transmissions
+ */
+struct mac_phase_stats {
+  uint32_t frames;      /* frames delivered */
+  uint32_t strobes;     /* strobes sent for the delivered frames */
+  uint32_t predicted;   /* delivered frames for which the phase was known */
+};
+
+extern struct mac_phase_stats mac_phase_stats;
+
+
+void mac_phase_init(rt_tmr_tick_t period);
+void mac_phase_update(const linkaddr_t *p_addr, rt_tmr_tick_t time);
+rt_tmr_tick_t mac_phase_wait(const linkaddr_t *p_addr, rt_tmr_tick_t guard);
+void mac_phase_miss(const linkaddr_t *p_addr);
+void mac_phase_txDone(uint8_t strobes, uint8_t isPredicted, e_nsErr_t err);
+
+#endif /* MAC_PHASE_PRESENT */
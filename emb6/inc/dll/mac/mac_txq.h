@@ -0,0 +1,90 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*============================================================================*/
+/*============================================================================*/
+
+/**
+ * @file    mac_txq.h
+ * @brief   Per-neighbour MAC transmission queues
+ *
+ *          Frames are copied into a pool of NETSTK_CFG_MAC_TXQ_FRAME_NUM
+ *          entries together with their packet attributes and kept in one
+ *          FIFO. Every receiver (linkaddr_null for broadcast frames) can
+ *          have up to NETSTK_CFG_MAC_TXQ_DEPTH of them queued, and the
+ *          receivers are served round-robin, each one its oldest frame
+ *          first. A neighbour keeps the channel for up to
+ *          NETSTK_CFG_MAC_TXQ_BURST_MAX acknowledged frames in a row, every
+ *          frame of such a burst but the last one carries the frame pending
+ *          bit so that a duty-cycled receiver stays awake for the next one.
+ */
+
+#ifndef MAC_TXQ_PRESENT
+#define MAC_TXQ_PRESENT
+
+#include "emb6.h"
+#include "packetbuf.h"
+
+
+/**
+ * @brief   Frame waiting for transmission
+ */
+struct mac_txq_frame {
+  struct mac_txq_frame *next;
+  struct mac_txq_nbr   *p_nbr;      /* receiver of the frame */
+  nsTxCbFnct_t          cbTxFnct;   /* TX callback set for this frame */
+  void                 *p_cbTxArg;
+  uint16_t              len;
+  uint8_t               data[PACKETBUF_SIZE];
+  struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
+  struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+};
+
+
+void mac_txq_init(void);
+struct mac_txq_frame *mac_txq_put(nsTxCbFnct_t cbTxFnct, void *p_cbTxArg, e_nsErr_t *p_err);
+struct mac_txq_frame *mac_txq_head(void);
+packetbuf_attr_t mac_txq_attr(struct mac_txq_frame *p_frame, uint8_t type);
+uint8_t mac_txq_load(struct mac_txq_frame *p_frame);
+uint8_t mac_txq_isBurst(void);
+void mac_txq_done(e_nsErr_t err);
+uint8_t mac_txq_len(void);
+uint8_t mac_txq_free(const linkaddr_t *p_addr);
+
+#endif /* MAC_TXQ_PRESENT */
@@ -87,24 +87,6 @@ typedef uint8_t MAC_ULE_FRAME_TYPE;
  */
 
 
-#if MAC_ULE_CFG_LOOSE_SYNC_EN
-typedef struct mac_ule_pwron_tbl_entry     s_nsMacUlePwrOnTblEntry_t;
-
-/**
- * @brief   Power-On table structure declaration
- */
-struct mac_ule_pwron_tbl_entry
-{
-    uint32_t    LastWakeup;     /*!< Last wake-up record                            */
-
-    uint16_t    DestId;         /*!< Destination ID                                 */
-
-    uint16_t    StrobeSentQty;  /*!< Quantity of sent strobes as waking-up signal   */
-};
-
-extern s_nsMacUlePwrOnTblEntry_t mac_ule_pwrOnTable[MAC_ULE_CFG_PWRON_TBL_SIZE];
-#endif
-
 extern netstk_devid_t NetstkSrcId;
 extern netstk_devid_t NetstkDstId;
 extern s_nsMacUleFramerDrv_t SmartMACFramer;
@@ -35,6 +35,11 @@
 #define DTLS_CCM_MAX        16	/**< max number of bytes in digest */
 #define DTLS_CCM_NONCE_SIZE 12	/**< size of nonce */
 
+#ifndef DTLS_CCM_BATCH
+/** number of CTR keystream blocks generated per batch */
+#define DTLS_CCM_BATCH       4
+#endif
+
 /**
  * Authenticates and encrypts a message using AES in CCM mode. Please
  * see also RFC 3610 for the meaning of \p M, \p L, \p lm and \p la.
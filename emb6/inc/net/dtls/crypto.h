@@ -71,9 +71,18 @@ typedef struct {
   rijndael_ctx ctx;		       /**< AES-128 encryption context */
 } aes128_ccm_t;
 
+#ifndef DTLS_KEY_CACHE_SIZE
+/** Number of expanded AES key schedules kept across records. Two
+ * slots hold the read and the write key of one active session. */
+#define DTLS_KEY_CACHE_SIZE 2
+#endif
+
 typedef struct dtls_cipher_context_t {
   /** numeric identifier of this cipher suite in host byte order. */
-  aes128_ccm_t data;		/**< The crypto context */
+  aes128_ccm_t data[DTLS_KEY_CACHE_SIZE]; /**< The crypto contexts */
+  uint8 key[DTLS_KEY_CACHE_SIZE][DTLS_KEY_LENGTH]; /**< key of each slot */
+  uint8 valid;			/**< bitmap of initialized slots */
+  uint8 next;			/**< slot to replace on next miss */
 } dtls_cipher_context_t;
 
 typedef struct {
@@ -123,6 +132,9 @@ typedef struct {
   } tmp;
   LIST_STRUCT(reorder_queue);	/**< the packets to reorder */
   dtls_hs_state_t hs_state;  /**< handshake protocol status */
+#ifdef SHA2_WITH_STATS
+  unsigned long hash_compressions; /**< SHA-256 counter at handshake start */
+#endif
 
   dtls_compression_t compression;		/**< compression method */
   dtls_cipher_t cipher;		/**< cipher type */
@@ -308,6 +320,17 @@ int dtls_psk_pre_master_secret(unsigned char *key, size_t keylen,
 
 #define DTLS_EC_KEY_SIZE 32
 
+#ifdef DTLS_ECC
+#ifndef DTLS_ECDSA_KEY_CACHE_SIZE
+/** Number of peer public keys that are kept after they have been
+ * checked to be on the curve, together with the table precomputed for
+ * verifying their signatures. Every slot takes 1028 bytes of static
+ * RAM. A single slot is enough to keep the key of the gateway most
+ * nodes talk to. 0 disables the cache. */
+#define DTLS_ECDSA_KEY_CACHE_SIZE 0
+#endif
+#endif /* DTLS_ECC */
+
 int dtls_ecdh_pre_master_secret(unsigned char *priv_key,
 				unsigned char *pub_key_x,
                                 unsigned char *pub_key_y,
@@ -226,6 +226,7 @@ typedef struct {
 typedef struct dtls_context_t {
   unsigned char cookie_secret[DTLS_COOKIE_SECRET_LENGTH];
   clock_time_t cookie_secret_age; /**< the time the secret has been generated */
+  dtls_hmac_context_t cookie_hmac; /**< HMAC midstates for cookie_secret */
 
 #ifndef WITH_CONTIKI
   dtls_peer_t *peers;		/**< peer hash map */
@@ -329,6 +330,7 @@ void dtls_check_retransmit(dtls_context_t *context, clock_time_t *next);
 #define DTLS_CT_ALERT              21
 #define DTLS_CT_HANDSHAKE          22
 #define DTLS_CT_APPLICATION_DATA   23
+#define DTLS_CT_TLS12_CID          25 /* see RFC 9146 */
 
 /** Generic header structure of the DTLS record layer. */
 #ifdef IAR_COMPILER
@@ -50,6 +50,24 @@ static inline void ecc_ecdh(const uint32_t *px, const uint32_t *py, const uint32
 	ecc_ec_mult(px, py, secret, resultx, resulty);
 }
 int ecc_ecdsa_validate(const uint32_t *x, const uint32_t *y, const uint32_t *e, const uint32_t *r, const uint32_t *s);
+
+/* window width in bits of the precomputed tables used by ecc_ecdsa_validate_table() */
+#define ECC_TABLE_WINDOW 2
+#define ECC_TABLE_SIZE ((1 << (2 * ECC_TABLE_WINDOW)) - 1)
+
+/*
+ * Precomputed points i * G + j * Q of a public key Q for all
+ * 0 <= i, j < 2^ECC_TABLE_WINDOW except 0 * G + 0 * Q, stored at index
+ * i + j * 2^ECC_TABLE_WINDOW - 1.
+ */
+typedef struct {
+	uint32_t x[ECC_TABLE_SIZE][8];
+	uint32_t y[ECC_TABLE_SIZE][8];
+} ecc_table_t;
+
+void ecc_table_init(ecc_table_t *table, const uint32_t *x, const uint32_t *y);
+int ecc_ecdsa_validate_table(const ecc_table_t *table, const uint32_t *e, const uint32_t *r, const uint32_t *s);
+int ecc_is_valid_point(const uint32_t *x, const uint32_t *y);
 int ecc_ecdsa_sign(const uint32_t *d, const uint32_t *e, const uint32_t *k, uint32_t *r, uint32_t *s);
 
 int ecc_is_valid_key(const uint32_t * priv_key);
@@ -70,6 +70,31 @@ typedef unsigned char uint48[6];
 #define DTLS_DEFAULT_MAX_RETRANSMIT 7
 #endif
 
+#ifndef DTLS_RETRANSMIT_TIMEOUT
+/** Initial retransmission timeout of a flight in seconds. */
+#define DTLS_RETRANSMIT_TIMEOUT 2
+#endif
+
+#ifndef DTLS_RETRANSMIT_MAX_TIMEOUT
+/** Upper bound for the doubled retransmission timeout in seconds,
+ * see RFC 6347, section 4.2.4.1. */
+#define DTLS_RETRANSMIT_MAX_TIMEOUT 60
+#endif
+
+#if DTLS_CONNECTION_ID
+#ifndef DTLS_CID_LENGTH
+/** Length of the connection IDs we hand out to our peers. All our
+ * CIDs have the same length so that tls12_cid records can be parsed
+ * without knowing the peer in advance. Must not be 0. */
+#define DTLS_CID_LENGTH 4
+#endif
+
+#ifndef DTLS_CID_MAX_LENGTH
+/** Longest connection ID we accept from a peer. */
+#define DTLS_CID_MAX_LENGTH 8
+#endif
+#endif /* DTLS_CONNECTION_ID */
+
 /** Known cipher suites.*/
 typedef enum {
   TLS_NULL_WITH_NULL_NULL = 0x0000,   /**< NULL cipher  */
@@ -88,6 +113,7 @@ typedef enum {
 #define TLS_EXT_CLIENT_CERTIFICATE_TYPE	19 /* see RFC 7250 */
 #define TLS_EXT_SERVER_CERTIFICATE_TYPE	20 /* see RFC 7250 */
 #define TLS_EXT_ENCRYPT_THEN_MAC	22 /* see RFC 7366 */
+#define TLS_EXT_CONNECTION_ID		54 /* see RFC 9146 */
 
 #define TLS_CERT_TYPE_RAW_PUBLIC_KEY	2 /* see RFC 7250 */
 
@@ -27,6 +27,7 @@
 #define _DTLS_HMAC_H_
 
 //#include <sys/types.h>
+#include <string.h>
 
 #include "global.h"
 
@@ -54,6 +55,46 @@ dtls_hash_finalize(unsigned char *buf, dtls_hash_t ctx) {
   SHA256_Final(buf, (SHA256_CTX *)ctx);
   return SHA256_DIGEST_LENGTH;
 }
+
+/** Chaining value of the hash function after a whole number of blocks. */
+typedef uint32_t dtls_hash_state_t[SHA256_DIGEST_LENGTH / sizeof(uint32_t)];
+
+/**
+ * Saves the chaining value of \p ctx to \p state. This is only
+ * meaningful when exactly one block has been hashed, e.g. right after
+ * an HMAC pad block.
+ */
+static inline void
+dtls_hash_midstate(dtls_hash_state_t state, const dtls_hash_ctx *ctx) {
+  memcpy(state, ctx->state, sizeof(dtls_hash_state_t));
+}
+
+/**
+ * Resets \p ctx to the point right after the block that produced
+ * \p state. No compression function call is needed.
+ */
+static inline void
+dtls_hash_resume(dtls_hash_t ctx, const dtls_hash_state_t state) {
+  memcpy(ctx->state, state, sizeof(dtls_hash_state_t));
+  ctx->bitcount = SHA256_BLOCK_LENGTH << 3;
+}
+
+/**
+ * Writes the digest of all data hashed into \p ctx so far to \p buf
+ * while \p ctx remains usable for further updates. Only the chaining
+ * value, the length and the pending partial block are copied to the
+ * temporary context instead of cloning the whole context.
+ */
+static inline size_t
+dtls_hash_finalize_copy(unsigned char *buf, const dtls_hash_ctx *ctx) {
+  dtls_hash_ctx snapshot;
+
+  memcpy(snapshot.state, ctx->state, sizeof(snapshot.state));
+  snapshot.bitcount = ctx->bitcount;
+  memcpy(snapshot.buffer, ctx->buffer,
+	 (ctx->bitcount >> 3) % SHA256_BLOCK_LENGTH);
+  return dtls_hash_finalize(buf, &snapshot);
+}
 #endif /* WITH_SHA256 */
 
 #ifndef WITH_CONTIKI
@@ -88,12 +129,13 @@ typedef enum {
 /**
  * Context for HMAC generation. This object is initialized with
  * dtls_hmac_init() and must be passed to dtls_hmac_update() and
- * dtls_hmac_finalize(). Once, finalized, the component \c H is
- * invalid and must be initialized again with dtls_hmac_init() before
- * the structure can be used again.
+ * dtls_hmac_finalize(). Once finalized, the component \c data is
+ * invalid and must be reset with dtls_hmac_reset() before the
+ * structure can be used again with the same key.
  */
 typedef struct {
-  unsigned char pad[DTLS_HMAC_BLOCKSIZE]; /**< ipad and opad storage */
+  dtls_hash_state_t istate;	          /**< midstate after ipad */
+  dtls_hash_state_t ostate;	          /**< midstate after opad */
   dtls_hash_ctx data;		          /**< context for hash function */
 } dtls_hmac_context_t;
 
@@ -106,6 +148,15 @@ typedef struct {
  */
 void dtls_hmac_init(dtls_hmac_context_t *ctx, const unsigned char *key, size_t klen);
 
+/**
+ * Restarts the MAC computation of \p ctx with the key it has been
+ * initialized with. As the pad midstates are kept in \p ctx, this
+ * does not need any compression function call.
+ *
+ * @param ctx The HMAC context to reset.
+ */
+void dtls_hmac_reset(dtls_hmac_context_t *ctx);
+
 /**
  * Allocates a new HMAC context \p ctx with the given secret key.
  * This function returns \c 1 if \c ctx has been set correctly, or \c
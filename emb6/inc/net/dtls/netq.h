@@ -24,12 +24,22 @@
 
 #ifndef NETQ_MAXCNT
 #ifdef DTLS_ECC
-#define NETQ_MAXCNT 5 /**< maximum number of elements in netq structure */
+#define NETQ_MAXCNT 10 /**< maximum number of elements in netq structure */
 #elif defined(DTLS_PSK)
-#define NETQ_MAXCNT 3 /**< maximum number of elements in netq structure */
+#define NETQ_MAXCNT 6 /**< maximum number of elements in netq structure */
 #endif
 #endif
 
+#ifndef NETQ_ARENA_SIZE
+/**
+ * Number of bytes shared by the datagrams of all netq nodes. Nodes only
+ * take as much of the arena as their datagram needs, so the default
+ * holds twice as many typical handshake messages as NETQ_MAXCNT / 2
+ * fixed DTLS_MAX_BUF slots would in the same amount of memory.
+ */
+#define NETQ_ARENA_SIZE ((NETQ_MAXCNT / 2) * DTLS_MAX_BUF)
+#endif
+
 /**
  * Datagrams in the netq_t structure have a fixed maximum size of
  * DTLS_MAX_BUF to simplify memory management on constrained nodes. */
@@ -50,7 +60,13 @@ typedef struct netq_t {
 #ifndef WITH_CONTIKI
   unsigned char data[];		/**< the datagram to send */
 #else
-  netq_packet_t data;		/**< the datagram to send */
+  struct netq_t *arena_next;	/**< next node in arena order */
+  size_t size;			/**< bytes reserved in the arena */
+  unsigned char *data;		/**< the datagram to send, stored in the
+				 * netq arena. Note that the arena is
+				 * compacted whenever a node is freed,
+				 * so this pointer must not be kept
+				 * across netq_node_free(). */
 #endif
 } netq_t;
 
@@ -79,7 +95,9 @@ void netq_node_free(netq_t *node);
 /** Removes all items from given queue and frees the allocated storage */
 void netq_delete_all(list_t queue);
 
-/** Creates a new node suitable for adding to a netq_t queue. */
+/**
+ * Creates a new node suitable for adding to a netq_t queue, with room
+ * for a datagram of @p size bytes. */
 netq_t *netq_node_new(size_t size);
 
 /**
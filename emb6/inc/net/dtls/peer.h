@@ -63,6 +63,15 @@ typedef struct dtls_peer_t {
 
   dtls_security_parameters_t *security_params[2];
   dtls_handshake_parameters_t *handshake_params;
+
+#if DTLS_CONNECTION_ID
+  uint8 cid[DTLS_CID_LENGTH];           /**< our CID, sent by the peer in its records */
+  uint8 peer_cid[DTLS_CID_MAX_LENGTH];  /**< CID to put into records sent to the peer */
+  uint8 peer_cid_length;                /**< length of peer_cid, may be 0 */
+  uint8 cid_negotiated;                 /**< set when both sides agreed on using CIDs */
+  uint64_t cid_rseq;                    /**< epoch and sequence number of the newest
+                                             authenticated tls12_cid record */
+#endif /* DTLS_CONNECTION_ID */
 } dtls_peer_t;
 
 static inline dtls_security_parameters_t *dtls_security_params_epoch(dtls_peer_t *peer, uint16_t epoch)
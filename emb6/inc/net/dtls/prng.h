@@ -52,33 +52,19 @@ dtls_prng(unsigned char *buf, size_t len)
 }
 #else
 /**
- * Fills \p buf with \p len random bytes. This is the default
- * implementation for prng().  You might want to change prng() to use
- * a better PRNG on your specific platform.
+ * Fills \p buf with \p len random bytes taken from the cryptographic
+ * generator, keys and nonces must not come from random_rand().
  */
 static inline int
 dtls_prng(unsigned char *buf, size_t len) {
-  unsigned short v = random_rand();
-  while (len > sizeof(v)) {
-    memcpy(buf, &v, sizeof(v));
-    len -= sizeof(v);
-    buf += sizeof(v);
-    v = random_rand();
-  }
-
-  memcpy(buf, &v, len);
-  return 1;
+  return random_crypto(buf, len);
 }
 #endif /* HAVE_PRNG */
 
 static inline void
 dtls_prng_init(unsigned short seed) {
-  /* random_init() messes with the radio interface of the CC2538 and
-   * therefore must not be called after the radio has been
-   * initialized. */
-#ifndef CONTIKI_TARGET_CC2538DK
-	random_init(seed);
-#endif
+  /* the generator is seeded by the BSP already, this only adds to it */
+  random_crypto_seed((const uint8_t *)&seed, sizeof(seed));
 }
 #endif /* WITH_CONTIKI */
 
@@ -208,6 +208,11 @@ char* SHA512_Data();
 
 #endif /* NOPROTO */
 
+#ifdef SHA2_WITH_STATS
+/* Number of SHA-256 compression function calls since startup */
+extern unsigned long sha256_compressions;
+#endif /* SHA2_WITH_STATS */
+
 #ifdef	__cplusplus
 }
 #endif /* __cplusplus */
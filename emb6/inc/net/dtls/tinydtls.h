@@ -43,6 +43,12 @@
 #define DTLS_PSK 1
 #endif
 
+/** Defined to 1 if tinydtls is built with support for Connection IDs
+ * (RFC 9146) */
+#ifndef DTLS_CONNECTION_ID
+#define DTLS_CONNECTION_ID 0
+#endif
+
 /** Defined to 1 if tinydtls is built for Contiki OS */
 /* #undef WITH_CONTIKI */
 
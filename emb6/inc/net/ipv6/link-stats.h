@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *
+ * Authors: Simon Duquennoy <simonduq@sics.se>
+ */
+/**
+ * \file
+ *         Per-neighbour link statistics: ETX, RSSI, LQI and freshness
+ */
+
+#ifndef LINK_STATS_H_
+#define LINK_STATS_H_
+
+#include "emb6.h"
+#include "linkaddr.h"
+
+/* ETX fixed point divisor. 128 is the value used by RPL (RFC 6551) */
+#ifdef LINK_STATS_CONF_ETX_DIVISOR
+#define LINK_STATS_ETX_DIVISOR LINK_STATS_CONF_ETX_DIVISOR
+#else
+#define LINK_STATS_ETX_DIVISOR 128
+#endif
+
+/* ETX accounted for a transmission that was never acknowledged */
+#ifdef LINK_STATS_CONF_ETX_NOACK_PENALTY
+#define LINK_STATS_ETX_NOACK_PENALTY LINK_STATS_CONF_ETX_NOACK_PENALTY
+#else
+#define LINK_STATS_ETX_NOACK_PENALTY 10
+#endif
+
+/* Transmissions needed before a link counts as fresh */
+#ifdef LINK_STATS_CONF_FRESHNESS_TARGET
+#define LINK_STATS_FRESHNESS_TARGET LINK_STATS_CONF_FRESHNESS_TARGET
+#else
+#define LINK_STATS_FRESHNESS_TARGET 4
+#endif
+
+/* Seconds without a transmission after which a link is no longer fresh */
+#ifdef LINK_STATS_CONF_FRESHNESS_EXPIRATION
+#define LINK_STATS_FRESHNESS_EXPIRATION LINK_STATS_CONF_FRESHNESS_EXPIRATION
+#else
+#define LINK_STATS_FRESHNESS_EXPIRATION 600
+#endif
+
+/* Seconds after which the freshness counters are halved */
+#ifdef LINK_STATS_CONF_FRESHNESS_HALF_LIFE
+#define LINK_STATS_FRESHNESS_HALF_LIFE LINK_STATS_CONF_FRESHNESS_HALF_LIFE
+#else
+#define LINK_STATS_FRESHNESS_HALF_LIFE 1200
+#endif
+
+/** \brief Statistics kept for every neighbour we talk to */
+struct link_stats {
+  clock_time_t last_tx_time;  /* Last transmission to the neighbour */
+  uint16_t etx;               /* ETX, 0 until the first transmission */
+  int16_t rssi;               /* RSSI of the last frame received */
+  uint8_t lqi;                /* LQI of the last frame received */
+  uint8_t freshness;          /* Recent transmissions, halved periodically */
+};
+
+/* Returns the statistics of a neighbour, or NULL if there are none */
+const struct link_stats *link_stats_from_lladdr(const linkaddr_t *lladdr);
+/* Are the statistics recent enough to rely on them? */
+uint8_t link_stats_is_fresh(const struct link_stats *stats);
+
+/* Packet sent callback, fed from the MAC TX status */
+void link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx);
+/* Packet input callback, takes RSSI and LQI from the packetbuf */
+void link_stats_input_callback(const linkaddr_t *lladdr);
+
+void link_stats_init(void);
+
+#endif /* LINK_STATS_H_ */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup uip6-multicast
+ * @{
+ */
+/**
+ * \defgroup mpl-multicast Multicast Protocol for Low-Power and Lossy Networks
+ *
+ * IPv6 multicast forwarding according to RFC 7731 (MPL).
+ *
+ * Each MPL Seed gets an entry in the seed set. Entries are hashed on their
+ * seed-id and keep their buffered messages in sequence order. Every buffered
+ * message runs its own Trickle timer for proactive forwarding, and a single
+ * control Trickle timer advertises the buffered messages so that neighbours
+ * can ask for missing ones (reactive forwarding).
+ * @{
+ */
+/**
+ * \file
+ *    Header file for the MPL multicast engine
+ */
+
+#ifndef MPL_H_
+#define MPL_H_
+
+#include "emb6_conf.h"
+#include "emb6.h"
+#include "uip-mcast6-stats.h"
+
+/*---------------------------------------------------------------------------*/
+/* Protocol Constants */
+/*---------------------------------------------------------------------------*/
+#define MPL_ICMP_CODE                  0   /**< MPL control message code */
+#define MPL_IP_HOP_LIMIT            0xFF   /**< Hop limit for ICMP messages */
+#define MPL_DGRAM_OUT                  0
+#define MPL_DGRAM_IN                   1
+/*---------------------------------------------------------------------------*/
+/* Configuration */
+/*---------------------------------------------------------------------------*/
+/**
+ * Number of entries in the seed set, i.e. how many MPL Seeds can have
+ * messages in flight at the same time
+ */
+#ifdef MPL_CONF_SEED_SET_SIZE
+#define MPL_SEED_SET_SIZE MPL_CONF_SEED_SET_SIZE
+#else
+#define MPL_SEED_SET_SIZE 2
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Number of buffered messages, shared by all seeds. When it is exhausted,
+ * the oldest message of the seed that received the oldest buffered message
+ * is reclaimed
+ */
+#ifdef MPL_CONF_BUFFER_SIZE
+#define MPL_BUFFER_SIZE MPL_CONF_BUFFER_SIZE
+#else
+#define MPL_BUFFER_SIZE 6
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Lifetime of a seed set entry in seconds, refreshed on every new message
+ * from the seed (SEED_SET_ENTRY_LIFETIME, 30 minutes in RFC 7731)
+ */
+#ifdef MPL_CONF_SEED_SET_ENTRY_LIFETIME
+#define MPL_SEED_SET_ENTRY_LIFETIME MPL_CONF_SEED_SET_ENTRY_LIFETIME
+#else
+#define MPL_SEED_SET_ENTRY_LIFETIME 1800
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Forward new messages without waiting for a control message. Turning this
+ * off leaves only reactive forwarding, which costs latency but saves
+ * transmissions in dense networks
+ */
+#ifdef MPL_CONF_PROACTIVE_FORWARDING
+#define MPL_PROACTIVE_FORWARDING MPL_CONF_PROACTIVE_FORWARDING
+#else
+#define MPL_PROACTIVE_FORWARDING 1
+#endif
+/*---------------------------------------------------------------------------*/
+/*
+ * Trickle parameters. Imin is in clock ticks, Imax is a number of doublings
+ * of Imin. RFC 7731 suggests an Imin of 10 times the expected link latency,
+ * Imax = Imin for data messages and 5 minutes for control messages.
+ */
+#ifdef MPL_CONF_DATA_MESSAGE_IMIN
+#define MPL_DATA_MESSAGE_IMIN MPL_CONF_DATA_MESSAGE_IMIN
+#else
+#define MPL_DATA_MESSAGE_IMIN (bsp_get(E_BSP_GET_TRES) / 4)
+#endif
+
+#ifdef MPL_CONF_DATA_MESSAGE_IMAX
+#define MPL_DATA_MESSAGE_IMAX MPL_CONF_DATA_MESSAGE_IMAX
+#else
+#define MPL_DATA_MESSAGE_IMAX 0
+#endif
+
+#ifdef MPL_CONF_DATA_MESSAGE_K
+#define MPL_DATA_MESSAGE_K MPL_CONF_DATA_MESSAGE_K
+#else
+#define MPL_DATA_MESSAGE_K 1
+#endif
+
+#ifdef MPL_CONF_DATA_MESSAGE_TIMER_EXPIRATIONS
+#define MPL_DATA_MESSAGE_TIMER_EXPIRATIONS MPL_CONF_DATA_MESSAGE_TIMER_EXPIRATIONS
+#else
+#define MPL_DATA_MESSAGE_TIMER_EXPIRATIONS 3
+#endif
+
+#ifdef MPL_CONF_CONTROL_MESSAGE_IMIN
+#define MPL_CONTROL_MESSAGE_IMIN MPL_CONF_CONTROL_MESSAGE_IMIN
+#else
+#define MPL_CONTROL_MESSAGE_IMIN (bsp_get(E_BSP_GET_TRES) / 4)
+#endif
+
+#ifdef MPL_CONF_CONTROL_MESSAGE_IMAX
+#define MPL_CONTROL_MESSAGE_IMAX MPL_CONF_CONTROL_MESSAGE_IMAX
+#else
+#define MPL_CONTROL_MESSAGE_IMAX 10  /* 256 s with the default Imin */
+#endif
+
+#ifdef MPL_CONF_CONTROL_MESSAGE_K
+#define MPL_CONTROL_MESSAGE_K MPL_CONF_CONTROL_MESSAGE_K
+#else
+#define MPL_CONTROL_MESSAGE_K 1
+#endif
+
+#ifdef MPL_CONF_CONTROL_MESSAGE_TIMER_EXPIRATIONS
+#define MPL_CONTROL_MESSAGE_TIMER_EXPIRATIONS MPL_CONF_CONTROL_MESSAGE_TIMER_EXPIRATIONS
+#else
+#define MPL_CONTROL_MESSAGE_TIMER_EXPIRATIONS 10
+#endif
+/*---------------------------------------------------------------------------*/
+/* Stats datatype */
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Multicast stats extension for the MPL engine
+ */
+struct mpl_stats {
+  /** Number of received control messages */
+  UIP_MCAST6_STATS_DATATYPE icmp_in;
+
+  /** Number of control messages sent */
+  UIP_MCAST6_STATS_DATATYPE icmp_out;
+
+  /** Number of malformed control messages seen by us */
+  UIP_MCAST6_STATS_DATATYPE icmp_bad;
+};
+/*---------------------------------------------------------------------------*/
+#endif /* MPL_H_ */
+/*---------------------------------------------------------------------------*/
+/** @} */
+/** @} */
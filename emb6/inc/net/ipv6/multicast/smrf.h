@@ -52,6 +52,7 @@
 
 #include "emb6_conf.h"
 #include "emb6.h"
+#include "uip-mcast6-stats.h"
 
 /*---------------------------------------------------------------------------*/
 /* Configuration */
@@ -69,17 +70,35 @@
 #else
 #define SMRF_MAX_SPREAD 4
 #endif
+
+/* Datagrams that can wait for their forwarding delay at the same time */
+#ifdef SMRF_CONF_FWD_QUEUE_LEN
+#define SMRF_FWD_QUEUE_LEN SMRF_CONF_FWD_QUEUE_LEN
+#else
+#define SMRF_FWD_QUEUE_LEN 2
+#endif
+
+/* Digests of recently seen datagrams kept to drop duplicates */
+#ifdef SMRF_CONF_DUP_CACHE_LEN
+#define SMRF_DUP_CACHE_LEN SMRF_CONF_DUP_CACHE_LEN
+#else
+#define SMRF_DUP_CACHE_LEN 8
+#endif
+
+/* Seconds a digest suppresses copies of its datagram. Long enough for a
+ * copy coming in over a new parent, short enough not to drop a periodic
+ * multicast that carries the same payload every time. */
+#ifdef SMRF_CONF_DUP_LIFETIME
+#define SMRF_DUP_LIFETIME SMRF_CONF_DUP_LIFETIME
+#else
+#define SMRF_DUP_LIFETIME 2
+#endif
 /*---------------------------------------------------------------------------*/
 /* Stats datatype */
 /*---------------------------------------------------------------------------*/
 struct smrf_stats {
-  uint16_t mcast_in_unique;
-  uint16_t mcast_in_all;        /* At layer 3 */
-  uint16_t mcast_in_ours;       /* Unique and we are a group member */
-  uint16_t mcast_fwd;           /* Forwarded by us but we are not the seed */
-  uint16_t mcast_out;           /* We are the seed */
-  uint16_t mcast_bad;
-  uint16_t mcast_dropped;
+  UIP_MCAST6_STATS_DATATYPE fwd_suppressed;  /* Duplicates not forwarded */
+  UIP_MCAST6_STATS_DATATYPE fwd_queue_full;  /* No room to queue a forward */
 };
 /*---------------------------------------------------------------------------*/
 #endif /* SMRF_H_ */
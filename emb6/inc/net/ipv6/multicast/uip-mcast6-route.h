@@ -51,7 +51,7 @@
 typedef struct uip_mcast6_route {
   struct uip_mcast6_route *next; /**< Routes are arranged in a linked list */
   uip_ipaddr_t group; /**< The multicast group */
-  uint32_t lifetime; /**< Entry lifetime seconds */
+  uint32_t expiry; /**< Entry expiry time on the routing protocol's clock */
   void *dag; /**< Pointer to an rpl_dag_t struct */
 } uip_mcast6_route_t;
 /*---------------------------------------------------------------------------*/
@@ -36,13 +36,15 @@
 /**
  * \defgroup uip6-multicast IPv6 Multicast Forwarding
  *
- *   We currently support 2 engines:
+ *   We currently support 3 engines:
  *   - 'Stateless Multicast RPL Forwarding' (SMRF)
  *     RPL does group management as per the RPL docs, SMRF handles datagram
  *     forwarding
  *   - 'Multicast Forwarding with Trickle' according to the algorithm described
  *     in the internet draft:
  *     http://tools.ietf.org/html/draft-ietf-roll-trickle-mcast
+ *   - 'Multicast Protocol for Low-Power and Lossy Networks' (MPL) as per
+ *     RFC 7731, the standardised successor of the above
  *
  * @{
  */
@@ -65,6 +67,7 @@
 #include "uip-mcast6-route.h"
 #include "smrf.h"
 #include "roll-tm.h"
+#include "mpl.h"
 
 #include <string.h>
 /*---------------------------------------------------------------------------*/
@@ -159,6 +162,10 @@ struct uip_mcast6_driver {
 #define RPL_CONF_MULTICAST     1
 
 #define UIP_MCAST6             smrf_driver
+#elif UIP_MCAST6_ENGINE == UIP_MCAST6_ENGINE_MPL
+#define RPL_CONF_MULTICAST     0        /* Not used by MPL */
+
+#define UIP_MCAST6             mpl_driver
 #else
 #error "Multicast Enabled with an Unknown Engine."
 #error "Check the value of UIP_MCAST6_CONF_ENGINE in conf files."
@@ -63,6 +63,13 @@
 #define  NBR_DELAY 3
 #define  NBR_PROBE 4
 
+/** \brief Buckets of the IPv6 address index of the nbr cache */
+#ifdef UIP_DS6_NBR_CONF_HASH_SIZE
+#define UIP_DS6_NBR_HASH_SIZE UIP_DS6_NBR_CONF_HASH_SIZE
+#else
+#define UIP_DS6_NBR_HASH_SIZE NBR_TABLE_MAX_NEIGHBORS
+#endif
+
 NBR_TABLE_DECLARE(ds6_neighbors);
 
 /** \brief An entry in the nbr cache */
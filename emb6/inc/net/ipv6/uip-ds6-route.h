@@ -95,7 +95,8 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_STATE_TYPE rpl_route_entry_t
 /* Needed for the extended route entry state when using ContikiRPL */
 typedef struct rpl_route_entry {
-  uint32_t lifetime;
+  /* Absolute expiry time, see rpl_set_route_lifetime() */
+  uint32_t expiry;
   void *dag;
   uint8_t learned_from;
   uint8_t nopath_received;
@@ -49,6 +49,9 @@
 #include "uip-nd6.h"
 #include "uip-ds6-route.h"
 #include "uip-ds6-nbr.h"
+#if UIP_CONF_IPV6_MULTICAST
+#include "uip-mcast6-engines.h"
+#endif
 
 /*--------------------------------------------------*/
 /** Configuration. For all tables (Neighbor cache, Prefix List, Routing Table,
@@ -87,10 +90,16 @@
 #define UIP_DS6_ADDR_NB UIP_DS6_ADDR_NBS + UIP_DS6_ADDR_NBU
 
 /* Multicast address list */
+#if UIP_CONF_IPV6_MULTICAST && defined(UIP_MCAST6_CONF_ENGINE) && \
+    (UIP_MCAST6_CONF_ENGINE == UIP_MCAST6_ENGINE_MPL)
+#define UIP_DS6_MADDR_MPL 1   /* all MPL forwarders */
+#else
+#define UIP_DS6_MADDR_MPL 0
+#endif
 #if UIP_CONF_ROUTER
-#define UIP_DS6_MADDR_NBS 2 + UIP_DS6_ADDR_NB   /* all routers + all nodes + one solicited per unicast */
+#define UIP_DS6_MADDR_NBS 2 + UIP_DS6_ADDR_NB + UIP_DS6_MADDR_MPL  /* all routers + all nodes + one solicited per unicast */
 #else
-#define UIP_DS6_MADDR_NBS 1 + UIP_DS6_ADDR_NB   /* all nodes + one solicited per unicast */
+#define UIP_DS6_MADDR_NBS 1 + UIP_DS6_ADDR_NB + UIP_DS6_MADDR_MPL  /* all nodes + one solicited per unicast */
 #endif
 #ifndef UIP_CONF_DS6_MADDR_NBU
 #define UIP_DS6_MADDR_NBU 0
@@ -112,6 +121,13 @@
 #endif
 #define UIP_DS6_AADDR_NB UIP_DS6_AADDR_NBS + UIP_DS6_AADDR_NBU
 
+/* Address registration cache of 6LoWPAN-ND routers */
+#ifndef UIP_CONF_DS6_REG_NB
+#define UIP_DS6_REG_NB NBR_TABLE_MAX_NEIGHBORS
+#else
+#define UIP_DS6_REG_NB UIP_CONF_DS6_REG_NB
+#endif
+
 /*--------------------------------------------------*/
 /* Should we use LinkLayer acks in NUD ?*/
 #ifndef UIP_CONF_DS6_LL_NUD
@@ -139,6 +155,14 @@
 #define UIP_DS6_PERIOD UIP_DS6_CONF_PERIOD
 #endif
 
+/** Longest sleep, in seconds, of the periodic task when no deadline is
+ *  closer. Only bounds the tick count of very long lifetimes. */
+#ifndef UIP_DS6_CONF_MAX_INTERVAL
+#define UIP_DS6_MAX_INTERVAL 3600
+#else
+#define UIP_DS6_MAX_INTERVAL UIP_DS6_CONF_MAX_INTERVAL
+#endif
+
 #define FOUND 0
 #define FREESPACE 1
 #define NOSPACE 2
@@ -181,8 +205,23 @@ typedef struct uip_ds6_addr {
   struct timer dadtimer;
   uint8_t dadnscount;
 #endif /* UIP_ND6_DEF_MAXDADNS > 0 */
+#if UIP_ND6_6LOWPAN_ND
+  struct stimer regtimer;       /**< next registration NS */
+  uip_ipaddr_t registrar;       /**< router the address is registered with */
+  uint8_t regcount;             /**< unanswered registration NSs */
+#endif /* UIP_ND6_6LOWPAN_ND */
 } uip_ds6_addr_t;
 
+#if UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND
+/** \brief An address registered with us by a 6LoWPAN-ND host (RFC 6775) */
+typedef struct uip_ds6_reg {
+  uint8_t isused;
+  uip_ipaddr_t ipaddr;
+  uip_lladdr_t owner;
+  struct stimer lifetime;
+} uip_ds6_reg_t;
+#endif /* UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND */
+
 /** \brief Anycast address  */
 typedef struct uip_ds6_aaddr {
   uint8_t isused;
@@ -247,6 +286,18 @@ void uip_ds6_init(void);
 /** \brief Periodic processing of data structures */
 void uip_ds6_periodic(void);
 
+/**
+ * \brief Make uip_ds6_periodic() run within \p interval seconds
+ *
+ * The periodic task only wakes up for the earliest pending deadline. Code
+ * that creates a timed entry, or moves a deadline closer, must call this;
+ * deadlines that move further away are picked up by the next run.
+ */
+void uip_ds6_schedule_periodic(unsigned long interval);
+
+/** \brief Make uip_ds6_periodic() run when \p t expires */
+void uip_ds6_schedule_stimer(struct stimer *t);
+
 /** \brief Generic loop routine on an abstract data structure, which generalizes
  * all data structures used in DS6 */
 uint8_t uip_ds6_list_loop(uip_ds6_element_t *list, uint8_t size,
@@ -306,6 +357,39 @@ uip_ds6_aaddr_t *uip_ds6_aaddr_lookup(uip_ipaddr_t *ipaddr);
 /** \brief set the last 64 bits of an IP address based on the MAC address */
 void uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr);
 
+/**
+ * \brief Get the MAC address an IP address was built from
+ * \return 1 on success, 0 if the interface identifier was not derived
+ * from a MAC address
+ */
+int uip_ds6_set_lladdr_from_iid(uip_lladdr_t *lladdr, const uip_ipaddr_t *ipaddr);
+
+#if UIP_ND6_6LOWPAN_ND
+/** \name Address registration routines (RFC 6775) */
+/** @{ */
+#if UIP_CONF_ROUTER
+uip_ds6_reg_t *uip_ds6_reg_lookup(const uip_ipaddr_t *ipaddr);
+
+/**
+ * \brief Handle an address registration of a host
+ * \param lifetime in units of 60 seconds, 0 removes the registration
+ * \return an ARO status, UIP_ND6_ARO_STATUS_DUPLICATE if the address is
+ * registered by another owner
+ */
+uint8_t uip_ds6_reg_update(const uip_ipaddr_t *ipaddr,
+                           const uip_lladdr_t *owner, uint16_t lifetime);
+#endif /* UIP_CONF_ROUTER */
+
+/**
+ * \brief Find the link-layer address of an on-link neighbor without
+ * address resolution: from the registration cache, or else from the
+ * interface identifier
+ * \return 1 on success, 0 if the address cannot be resolved
+ */
+int uip_ds6_reg_resolve(const uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr);
+/** @} */
+#endif /* UIP_ND6_6LOWPAN_ND */
+
 /** \brief Get the number of matching bits of two addresses */
 uint8_t get_match_length(uip_ipaddr_t *src, uip_ipaddr_t *dst);
 
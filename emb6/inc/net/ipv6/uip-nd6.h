@@ -94,8 +94,9 @@
 /** @} */
 
 #ifndef UIP_CONF_ND6_DEF_MAXDADNS
-/** \brief Do not try DAD when using EUI-64 as allowed by draft-ietf-6lowpan-nd-15 section 8.2 */
-#if UIP_CONF_LL_802154
+/** \brief Do not try DAD when using EUI-64 as allowed by draft-ietf-6lowpan-nd-15 section 8.2,
+ * nor when duplicates are found by address registration (RFC 6775) */
+#if UIP_CONF_LL_802154 || UIP_ND6_6LOWPAN_ND
 #define UIP_ND6_DEF_MAXDADNS 0
 #else /* UIP_CONF_LL_802154 */
 #define UIP_ND6_DEF_MAXDADNS UIP_ND6_SEND_NA
@@ -130,6 +131,22 @@
 #define UIP_ND6_MAX_RANDOM_FACTOR(x)   ((x) + (x) / 2)
 /** @} */
 
+/** \name RFC 6775 (6LoWPAN-ND) constants */
+/** @{ */
+/** \brief Registration lifetime requested by hosts, in units of 60 seconds */
+#ifdef UIP_CONF_ND6_REGISTRATION_LIFETIME
+#define UIP_ND6_REGISTRATION_LIFETIME   UIP_CONF_ND6_REGISTRATION_LIFETIME
+#else
+#define UIP_ND6_REGISTRATION_LIFETIME   60
+#endif
+/** \brief Seconds to wait before retrying a registration nobody answered */
+#define UIP_ND6_REGISTRATION_RETRY      60
+/** \brief Seconds before the default router expires at which hosts start
+ * refreshing it with unicast RSs, as routers send no periodic RAs */
+#define UIP_ND6_RS_REFRESH_TIME         (UIP_ND6_RTR_SOLICITATION_INTERVAL * \
+                                         UIP_ND6_MAX_RTR_SOLICITATIONS)
+/** @} */
+
 /** \name RFC 6106 RA DNS Options Constants  */
 /** @{ */
 #ifndef UIP_CONF_ND6_RA_RDNSS
@@ -156,6 +173,7 @@
 #define UIP_ND6_OPT_MTU                 5
 #define UIP_ND6_OPT_RDNSS               25
 #define UIP_ND6_OPT_DNSSL               31
+#define UIP_ND6_OPT_ARO                 33
 /** @} */
 
 /** \name ND6 option types */
@@ -180,6 +198,7 @@
 #define UIP_ND6_OPT_MTU_LEN            8
 #define UIP_ND6_OPT_RDNSS_LEN          1
 #define UIP_ND6_OPT_DNSSL_LEN          1
+#define UIP_ND6_OPT_ARO_LEN            16
 
 
 /* Length of TLLAO and SLLAO options, it is L2 dependant */
@@ -211,6 +230,13 @@
 #define UIP_ND6_RA_FLAG_AUTONOMOUS      0x40
 /** @} */
 
+/** \name Address Registration Option status values (RFC 6775) */
+/** @{ */
+#define UIP_ND6_ARO_STATUS_SUCCESS      0
+#define UIP_ND6_ARO_STATUS_DUPLICATE    1
+#define UIP_ND6_ARO_STATUS_CACHE_FULL   2
+/** @} */
+
 /**
  * \name ND message structures
  * @{
@@ -311,6 +337,22 @@ typedef struct uip_nd6_opt_dns {
   uip_ipaddr_t ip;
 } uip_nd6_opt_dns;
 
+/**
+ * \brief ND option address registration (RFC 6775)
+ *
+ * The EUI-64 field carries the link-layer address of the owner of the
+ * registered address, zero-padded if it is shorter than 8 bytes.
+ */
+typedef struct uip_nd6_opt_aro {
+  uint8_t type;
+  uint8_t len;
+  uint8_t status;
+  uint8_t reserved1;
+  uint16_t reserved2;
+  uint16_t lifetime;
+  uint8_t eui64[8];
+} uip_nd6_opt_aro;
+
 /** \struct Redirected header option */
 typedef struct uip_nd6_opt_redirected_hdr {
   uint8_t type;
@@ -370,6 +412,21 @@ uip_nd6_ns_input(void);
 void
 uip_nd6_ns_output(uip_ipaddr_t *src, uip_ipaddr_t *dest, uip_ipaddr_t *tgt);
 
+#if UIP_ND6_6LOWPAN_ND
+/**
+ * \brief Register one of our addresses with a router (RFC 6775)
+ * \param dest unicast address of the router
+ * \param tgt the address to register, also used as source address
+ * \param lifetime registration lifetime in units of 60 seconds, 0 to
+ * remove the registration
+ *
+ * The NS carries a SLLAO and an Address Registration Option. The router
+ * answers with a NA carrying the registration status.
+ */
+void
+uip_nd6_ns_aro_output(uip_ipaddr_t *dest, uip_ipaddr_t *tgt, uint16_t lifetime);
+#endif /* UIP_ND6_6LOWPAN_ND */
+
 #if UIP_CONF_ROUTER
 #if UIP_ND6_SEND_RA
 /**
@@ -383,6 +440,8 @@ void uip_nd6_ra_output(uip_ipaddr_t *dest);
 
 /**
  * \brief Send a Router Solicitation
+ * \param dest unicast address of a known router, or NULL to send to the
+ * all-routers multicast address
  *
  * src is chosen through the uip_netif_select_src function. If src is
  * unspecified  (i.e. we do not have a preferred address yet), then we do not
@@ -392,7 +451,7 @@ void uip_nd6_ra_output(uip_ipaddr_t *dest);
  * possible option is SLLAO, MUST NOT be included if source = unspecified
  * SHOULD be included otherwise
  */
-void uip_nd6_rs_output(void);
+void uip_nd6_rs_output(uip_ipaddr_t *dest);
 
 /**
  *
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ * \file
+ *   Link table of the root of a non-storing mode RPL DODAG.
+ *
+ *   In non-storing mode (MOP 1) only the root keeps downward routing
+ *   state. Every DAO carries the global address of the sender's preferred
+ *   parent, and the root stores the resulting child -> parent links. A
+ *   path to any node is found by walking the parent links up to the root,
+ *   which is what the root needs to build an RFC 6554 Source Routing
+ *   Header.
+ */
+
+#ifndef RPL_NS_H
+#define RPL_NS_H
+
+#include "rpl-private.h"
+
+/** Lifetime value for nodes that never expire (the root itself). */
+#define RPL_NS_INFINITE_LIFETIME        0xffffffffUL
+
+/*
+ * One link in the DODAG. All nodes of a DODAG share the /64 prefix of the
+ * DODAG ID, so only the interface identifier is stored.
+ */
+typedef struct rpl_ns_node {
+  /* Next node in the same hash bucket */
+  struct rpl_ns_node *next;
+  /* Preferred parent of this node, NULL if unknown */
+  struct rpl_ns_node *parent;
+  rpl_dag_t *dag;
+  /* Remaining lifetime in seconds */
+  uint32_t lifetime;
+  uint8_t link_identifier[8];
+  uint8_t flags;
+} rpl_ns_node_t;
+
+void rpl_ns_init(void);
+int rpl_ns_num_nodes(void);
+rpl_ns_node_t *rpl_ns_node_head(void);
+rpl_ns_node_t *rpl_ns_node_next(rpl_ns_node_t *item);
+
+/**
+ * Record that child has parent as its preferred parent. Nodes are
+ * created on demand; the parent gets an infinite lifetime until it
+ * registers itself. An update that would detach child from the root
+ * (a loop) is ignored.
+ *
+ * \return The node of child, or NULL if the link table is full.
+ */
+rpl_ns_node_t *rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                                  const uip_ipaddr_t *parent, uint32_t lifetime);
+
+/** Handle a No-Path DAO: expire the link child -> parent if it exists. */
+void rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                          const uip_ipaddr_t *parent);
+
+rpl_ns_node_t *rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+
+/** Does the chain of parents of addr end at the root of dag? */
+int rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+
+void rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, const rpl_ns_node_t *node);
+
+/** Remove all links of a DODAG, e.g. when the root leaves it. */
+void rpl_ns_free_dag(rpl_dag_t *dag);
+
+/** Age all links by one second and remove expired, unused ones. */
+void rpl_ns_periodic(void);
+
+#endif /* RPL_NS_H */
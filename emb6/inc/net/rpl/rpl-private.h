@@ -103,6 +103,14 @@
 #define RPL_HDR_OPT_FWD_ERR        0x20
 #define RPL_HDR_OPT_FWD_ERR_SHIFT       5
 /*---------------------------------------------------------------------------*/
+/* RPL Source Routing Header (RFC 6554). */
+#define RPL_RH_TYPE_SRH             3
+#define RPL_RH_LEN                  4
+#define RPL_SRH_LEN                 4
+#define RPL_SRH_GET_CMPRI(rh)       (((uint8_t *)(rh))[RPL_RH_LEN] >> 4)
+#define RPL_SRH_GET_CMPRE(rh)       (((uint8_t *)(rh))[RPL_RH_LEN] & 0x0f)
+#define RPL_SRH_GET_PAD(rh)         (((uint8_t *)(rh))[RPL_RH_LEN + 1] >> 4)
+/*---------------------------------------------------------------------------*/
 /* Default values for RPL constants and variables. */
 
 /* The default value for the DAO timer. */
@@ -139,6 +147,25 @@
 
 /* Expire DAOs from neighbors that do not respond in this time. (seconds) */
 #define DAO_EXPIRATION_TIMEOUT          60
+
+/* Maximum DAO payload in bytes; further targets go in another DAO. A
+   storing mode target takes 26 bytes (Target + Transit Information) after
+   the 4 byte DAO header, so the default packs three targets (82 bytes)
+   into one IEEE 802.15.4 frame. With RPL_DAO_SPECIFY_DAG the DODAGID adds
+   16 bytes to the header and only two targets (72 bytes) fit. Non-storing
+   mode targets take 42 bytes, two of them fit without the D flag. */
+#ifdef RPL_CONF_DAO_MAX_LEN
+#define RPL_DAO_MAX_LEN                 RPL_CONF_DAO_MAX_LEN
+#else /* RPL_CONF_DAO_MAX_LEN */
+#define RPL_DAO_MAX_LEN                 90
+#endif /* RPL_CONF_DAO_MAX_LEN */
+
+/* Number of one-second slots of the route expiry wheel. */
+#ifdef RPL_CONF_ROUTE_WHEEL_SIZE
+#define RPL_ROUTE_WHEEL_SIZE            RPL_CONF_ROUTE_WHEEL_SIZE
+#else /* RPL_CONF_ROUTE_WHEEL_SIZE */
+#define RPL_ROUTE_WHEEL_SIZE            32
+#endif /* RPL_CONF_ROUTE_WHEEL_SIZE */
 /*---------------------------------------------------------------------------*/
 #define RPL_INSTANCE_LOCAL_FLAG         0x80
 #define RPL_INSTANCE_D_FLAG             0x40
@@ -165,6 +192,15 @@
 #endif /* UIP_IPV6_MULTICAST_RPL */
 #endif /* RPL_CONF_MOP */
 
+/* Non-storing mode support is only built when it is the configured MOP */
+#define RPL_WITH_NON_STORING            (RPL_MOP_DEFAULT == RPL_MOP_NON_STORING)
+
+#define RPL_IS_STORING(instance) \
+  ((instance) != NULL && (instance)->mop > RPL_MOP_NON_STORING)
+#define RPL_IS_NON_STORING(instance) \
+  (RPL_WITH_NON_STORING && (instance) != NULL && \
+   (instance)->mop == RPL_MOP_NON_STORING)
+
 /* Emit a pre-processor error if the user configured multicast with bad MOP */
 #if RPL_CONF_MULTICAST && (RPL_MOP_DEFAULT != RPL_MOP_STORING_MULTICAST)
 #error "RPL Multicast requires RPL_MOP_DEFAULT==3. Check contiki-conf.h"
@@ -271,6 +307,11 @@ void dis_output(uip_ipaddr_t *addr);
 void dio_output(rpl_instance_t *, uip_ipaddr_t *uc_addr);
 void dao_output(rpl_parent_t *, uint8_t lifetime);
 void dao_output_target(rpl_parent_t *, uip_ipaddr_t *, uint8_t lifetime);
+/* Pack several targets into as few DAOs as RPL_DAO_MAX_LEN allows. */
+void dao_output_begin(rpl_parent_t *);
+void dao_output_add_target(uip_ipaddr_t *, uint8_t lifetime);
+void dao_output_add_routes(uint8_t lifetime);
+void dao_output_end(void);
 void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t);
 void rpl_icmp6_register_handlers(void);
 
@@ -296,6 +337,11 @@ void rpl_remove_parent(rpl_parent_t *);
 void rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent);
 rpl_parent_t *rpl_select_parent(rpl_dag_t *dag);
 rpl_dag_t *rpl_select_dag(rpl_instance_t *instance,rpl_parent_t *parent);
+/* Are the link statistics of a parent recent enough to rely on them? */
+int rpl_parent_is_fresh(rpl_parent_t *p);
+#if RPL_WITH_PROBING
+rpl_parent_t *rpl_get_probing_target(rpl_dag_t *dag);
+#endif /* RPL_WITH_PROBING */
 void rpl_recalculate_ranks(void);
 
 /* RPL routing table functions. */
@@ -304,6 +350,11 @@ void rpl_remove_routes_by_nexthop(uip_ipaddr_t *nexthop, rpl_dag_t *dag);
 uip_ds6_route_t *rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix,
                                int prefix_len, uip_ipaddr_t *next_hop);
 void rpl_purge_routes(void);
+/* Set the remaining lifetime of a route, in seconds. */
+void rpl_set_route_lifetime(uip_ds6_route_t *r, uint32_t lifetime);
+#if RPL_CONF_MULTICAST
+void rpl_set_mcast_route_lifetime(uip_mcast6_route_t *mcast_route, uint32_t lifetime);
+#endif
 
 /* Lock a parent in the neighbor cache. */
 void rpl_lock_parent(rpl_parent_t *p);
@@ -321,6 +372,10 @@ void rpl_cancel_dao(rpl_instance_t *instance);
 
 void rpl_reset_dio_timer(rpl_instance_t *);
 void rpl_reset_periodic_timer(void);
+#if RPL_WITH_PROBING
+void rpl_schedule_probing(rpl_instance_t *instance);
+void rpl_schedule_probing_now(rpl_instance_t *instance);
+#endif /* RPL_WITH_PROBING */
 
 /* Route poisoning. */
 void rpl_poison_routes(rpl_dag_t *, rpl_parent_t *);
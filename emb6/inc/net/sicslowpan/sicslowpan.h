@@ -80,6 +80,7 @@
 #define SICSLOWPAN_DISPATCH_IPHC                    0x60UL /* 011xxxxx = ... */
 #define SICSLOWPAN_DISPATCH_FRAG1                   0xc0UL /* 11000xxx */
 #define SICSLOWPAN_DISPATCH_FRAGN                   0xe0UL /* 11100xxx */
+#define SICSLOWPAN_DISPATCH_PAGING_1                0xf1UL /* 11110001, RFC 8025 */
 /** @} */
 
 /** \name HC1 encoding
@@ -143,6 +144,27 @@
 #define SICSLOWPAN_NHC_MASK                         0xF0
 #define SICSLOWPAN_NHC_EXT_HDR                      0xE0
 
+/**
+ * \name 6LoWPAN Routing Header encoding (RFC 8138, dispatch page 1)
+ * @{
+ */
+#define SICSLOWPAN_6LORH_DISPATCH_MASK              0xC0
+#define SICSLOWPAN_6LORH_DISPATCH                   0x80 /* 10xxxxxx */
+#define SICSLOWPAN_6LORH_MASK                       0xE0
+#define SICSLOWPAN_6LORH_CRITICAL                   0x80 /* 100xxxxx */
+#define SICSLOWPAN_6LORH_ELECTIVE                   0xA0 /* 101xxxxx */
+#define SICSLOWPAN_6LORH_SIZE_MASK                  0x1F
+/* Types 0 to 4 are SRH-6LoRH with hops of 1, 2, 4, 8 and 16 bytes */
+#define SICSLOWPAN_6LORH_TYPE_SRH_MAX               4
+#define SICSLOWPAN_6LORH_TYPE_RPI                   5
+/* Flags of the RPI-6LoRH, in the first byte */
+#define SICSLOWPAN_6LORH_RPI_O                      0x10
+#define SICSLOWPAN_6LORH_RPI_R                      0x08
+#define SICSLOWPAN_6LORH_RPI_F                      0x04
+#define SICSLOWPAN_6LORH_RPI_I                      0x02
+#define SICSLOWPAN_6LORH_RPI_K                      0x01
+/** @} */
+
 /**
  * \name LOWPAN_UDP encoding (works together with IPHC)
  * @{
@@ -64,6 +64,47 @@
 #include "crc.h"
 #endif
 
+/*
+********************************************************************************
+*                               LOCAL DEFINES
+********************************************************************************
+*/
+/* Header templates are not used with explicit keys, as key identifiers may
+ * change from frame to frame */
+#if (NETSTK_CFG_DLLC_HDR_CACHE_NUM > 0) && !LLSEC802154_USES_EXPLICIT_KEYS
+#define DLLC_HDR_TMPL_EN                    TRUE
+#else
+#define DLLC_HDR_TMPL_EN                    FALSE
+#endif
+
+/* FCF, sequence number, both PAN IDs, extended addresses and auxiliary
+ * security header with implicit key */
+#define DLLC_HDR_LEN_MAX                    (uint8_t )( 2 + 1 + 2 + 8 + 2 + 8 + 5 )
+
+#define DLLC_FCF_FRAME_PENDING              (uint8_t )( 0x10u )
+#define DLLC_FCF_ACK_REQUIRED               (uint8_t )( 0x20u )
+
+/*
+********************************************************************************
+*                               LOCAL TYPEDEFS
+********************************************************************************
+*/
+#if (DLLC_HDR_TMPL_EN == TRUE)
+/**
+ * @brief   MAC header prepared for a destination, only the frame pending and
+ *          ACK request bits, the sequence number and the frame counter
+ *          differ from one frame to the next
+ */
+struct dllc_hdrTmpl {
+  linkaddr_t        dest;           /* linkaddr_null for broadcast */
+  packetbuf_attr_t  panId;
+  uint8_t           frameType;
+  uint8_t           secLevel;
+  uint8_t           len;            /* 0 while the template is unused */
+  uint8_t           hdr[DLLC_HDR_LEN_MAX];
+};
+#endif
+
 /*
 ********************************************************************************
 *                          LOCAL FUNCTION DECLARATIONS
@@ -77,6 +118,10 @@ static void dllc_recv(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err);
 static void dllc_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err);
 static void dllc_cbtx(void *p_arg, e_nsErr_t *p_err);
 static void dllc_verifyAddr(frame802154_t *p_frame, e_nsErr_t *p_err);
+static void dllc_setHdrParams(frame802154_t *p_params, int is_broadcast);
+#if (DLLC_HDR_TMPL_EN == TRUE)
+static struct dllc_hdrTmpl *dllc_getHdrTmpl(int is_broadcast);
+#endif
 
 
 /*
@@ -98,6 +143,12 @@ static s_ns_t          *pdllc_netstk;
 static uint8_t       dllc_isOn;
 #endif
 
+#if (DLLC_HDR_TMPL_EN == TRUE)
+static struct dllc_hdrTmpl dllc_hdrTmpls[NETSTK_CFG_DLLC_HDR_CACHE_NUM];
+static uint8_t dllc_hdrTmplNext;
+static linkaddr_t dllc_hdrTmplSrc;
+#endif
+
 /*
 ********************************************************************************
 *                               GLOBAL VARIABLES
@@ -145,6 +196,11 @@ static void dllc_init(void *p_netstk, e_nsErr_t *p_err)
   dllc_cbTxFnct = 0;
   pdllc_cbtxarg = NULL;
   dllc_dsn = random_rand() & 0xFF;
+#if (DLLC_HDR_TMPL_EN == TRUE)
+  memset(dllc_hdrTmpls, 0, sizeof(dllc_hdrTmpls));
+  dllc_hdrTmplNext = 0;
+  linkaddr_copy(&dllc_hdrTmplSrc, &linkaddr_node_addr);
+#endif
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_PAN_ID, mac_phy_config.pan_id);
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_FCS_LEN, mac_phy_config.fcs_len);
 
@@ -208,8 +264,17 @@ static void dllc_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 {
   int alloc;
   int is_broadcast;
+#if LLSEC802154_SECURITY_LEVEL
+  uint8_t is_secured;
+#endif
+  uint8_t ack_required;
   uint8_t hdr_len;
+#if (DLLC_HDR_TMPL_EN == TRUE)
+  struct dllc_hdrTmpl *p_tmpl;
+  uint8_t *p_hdr;
+#else
   frame802154_t params;
+#endif
 
 #if NETSTK_CFG_ARG_CHK_EN
   if (p_err == NULL) {
@@ -228,74 +293,55 @@ static void dllc_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
   }
 #endif
 
-  /* init to zeros */
-  memset(&params, 0, sizeof(params));
-
-  /* build the FCF. */
-  params.fcf.frame_type = packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE);
-  params.fcf.frame_pending = packetbuf_attr(PACKETBUF_ATTR_PENDING);
-
   /* ACK-required bit */
   is_broadcast = packetbuf_holds_broadcast();
   if (is_broadcast == 1) {
-    params.fcf.ack_required = 0;
+    ack_required = 0;
   } else {
-    params.fcf.ack_required = packetbuf_attr(PACKETBUF_ATTR_RELIABLE);
+    ack_required = packetbuf_attr(PACKETBUF_ATTR_RELIABLE);
   }
 
   /* set MAC ACK required attribute accordingly */
-  packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, params.fcf.ack_required);
-
-  /* PAN ID compression */
-  params.fcf.panid_compression = 0;
-
-  /* Insert IEEE 802.15.4 (2006) version bits. */
-  params.fcf.frame_version = FRAME802154_IEEE802154_2006;
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, ack_required);
 
   /* sequence number */
-  params.seq = (uint8_t) packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
-  if (params.seq == 0) {
-    params.seq = dllc_dsn++;
-    packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, params.seq);
+  if (packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO) == 0) {
+    packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, dllc_dsn++);
   }
 
-  /* addressing fields */
-  params.dest_pid = packetbuf_attr(PACKETBUF_ATTR_MAC_PAN_ID);
-  if (is_broadcast == 1) {
-    /* Broadcast requires short address mode. */
-    params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
-    params.dest_addr[0] = 0xFF;
-    params.dest_addr[1] = 0xFF;
-  } else {
-    linkaddr_copy((linkaddr_t *)&params.dest_addr, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
-    params.fcf.dest_addr_mode = FRAME802154_LONGADDRMODE;
+#if (DLLC_HDR_TMPL_EN == TRUE)
+  /* copy the header prepared for this destination */
+  p_tmpl = dllc_getHdrTmpl(is_broadcast);
+  hdr_len = p_tmpl->len;
+  alloc = packetbuf_hdralloc(hdr_len);
+  if (alloc == 0) {
+    *p_err = NETSTK_ERR_BUF_OVERFLOW;
+    return;
   }
+  p_hdr = packetbuf_hdrptr();
+  memcpy(p_hdr, p_tmpl->hdr, hdr_len);
 
-  params.src_pid = packetbuf_attr(PACKETBUF_ATTR_MAC_PAN_ID);
-  if (LINKADDR_SIZE == 2UL) {
-    params.fcf.src_addr_mode = FRAME802154_SHORTADDRMODE;
-  } else {
-    params.fcf.src_addr_mode = FRAME802154_LONGADDRMODE;
+  /* then fill in the fields which change from frame to frame */
+  if (packetbuf_attr(PACKETBUF_ATTR_PENDING)) {
+    p_hdr[0] |= DLLC_FCF_FRAME_PENDING;
   }
-  linkaddr_copy((linkaddr_t *)&params.src_addr, &linkaddr_node_addr);
-
-  /* auxiliary security */
+  if (ack_required) {
+    p_hdr[0] |= DLLC_FCF_ACK_REQUIRED;
+  }
+  p_hdr[2] = (uint8_t) packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
 #if LLSEC802154_SECURITY_LEVEL
-  if(packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL)) {
-    params.fcf.security_enabled = 1;
+  is_secured = (p_tmpl->secLevel != 0);
+  if (is_secured) {
+    /* the frame counter closes the auxiliary security header */
+    p_hdr[hdr_len - 4] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1) & 0xFF;
+    p_hdr[hdr_len - 3] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1) >> 8;
+    p_hdr[hdr_len - 2] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3) & 0xFF;
+    p_hdr[hdr_len - 1] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3) >> 8;
   }
-  /* Setting security-related attributes */
-  params.aux_hdr.security_control.security_level = packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL);
-  params.aux_hdr.frame_counter.u16[0] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1);
-  params.aux_hdr.frame_counter.u16[1] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3);
-#if LLSEC802154_USES_EXPLICIT_KEYS
-  params.aux_hdr.security_control.key_id_mode = packetbuf_attr(PACKETBUF_ATTR_KEY_ID_MODE);
-  params.aux_hdr.key_index = packetbuf_attr(PACKETBUF_ATTR_KEY_INDEX);
-  params.aux_hdr.key_source.u16[0] = packetbuf_attr(PACKETBUF_ATTR_KEY_SOURCE_BYTES_0_1);
-#endif /* LLSEC802154_USES_EXPLICIT_KEYS */
 #endif /* LLSEC802154_SECURITY_LEVEL */
-
-  /* configure packet payload */
+#else
+  /* build the header field by field */
+  dllc_setHdrParams(&params, is_broadcast);
   params.payload = packetbuf_dataptr();
   params.payload_len = packetbuf_datalen();
 
@@ -309,6 +355,19 @@ static void dllc_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 
   /* write the header */
   frame802154_create(&params, packetbuf_hdrptr());
+#if LLSEC802154_SECURITY_LEVEL
+  is_secured = params.fcf.security_enabled;
+#endif
+#endif /* DLLC_HDR_TMPL_EN */
+
+#if LLSEC802154_SECURITY_LEVEL
+  /* the header is known now, the security driver can protect the frame */
+  if ((is_secured == 1) &&
+      (pdllc_netstk->dllsec->on_frame_created() == 0)) {
+    *p_err = NETSTK_ERR_FATAL;
+    return;
+  }
+#endif /* LLSEC802154_SECURITY_LEVEL */
 
 #if (NETSTK_CFG_RF_CRC_EN == FALSE)
   uint16_t checksum_data_len;
@@ -363,16 +422,11 @@ static void dllc_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
    * set TX callback function and argument
    */
   pdllc_netstk->mac->ioctrl(NETSTK_CMD_TX_CBFNCT_SET, (void *) dllc_cbtx, p_err);
-  pdllc_netstk->mac->ioctrl(NETSTK_CMD_TX_CBARG_SET, NULL, p_err);
+  /* the MAC may still hold earlier frames, each one keeps its argument */
+  pdllc_netstk->mac->ioctrl(NETSTK_CMD_TX_CBARG_SET, pdllc_cbtxarg, p_err);
 
   /* Issue next lower layer to transmit the prepared frame */
   pdllc_netstk->mac->send(packetbuf_hdrptr(), packetbuf_totlen(), p_err);
-
-#if (NETSTK_CFG_AUTO_ONOFF_EN == TRUE)
-  if (dllc_isOn == FALSE) {
-    pdllc_netstk->mac->off(p_err);
-  }
-#endif
 }
 
 
@@ -426,6 +480,20 @@ static void dllc_recv(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
     return;
   }
 
+#if LLSEC802154_SECURITY_LEVEL
+  /* auxiliary security, checked by the security driver */
+  if (frame.fcf.security_enabled) {
+    packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, frame.aux_hdr.security_control.security_level);
+    packetbuf_set_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1, frame.aux_hdr.frame_counter.u16[0]);
+    packetbuf_set_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3, frame.aux_hdr.frame_counter.u16[1]);
+#if LLSEC802154_USES_EXPLICIT_KEYS
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_ID_MODE, frame.aux_hdr.security_control.key_id_mode);
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_INDEX, frame.aux_hdr.key_index);
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_SOURCE_BYTES_0_1, frame.aux_hdr.key_source.u16[0]);
+#endif /* LLSEC802154_USES_EXPLICIT_KEYS */
+  }
+#endif /* LLSEC802154_SECURITY_LEVEL */
+
   /* set packet buffer miscellaneous attributes */
   pdllc_netstk->mac->ioctrl(NETSTK_CMD_RF_RSSI_GET, &rssi, p_err);
   packetbuf_set_attr(PACKETBUF_ATTR_RSSI, rssi);
@@ -507,8 +575,16 @@ static void dllc_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err)
  */
 static void dllc_cbtx(void *p_arg, e_nsErr_t *p_err)
 {
+#if (NETSTK_CFG_AUTO_ONOFF_EN == TRUE)
+  /* the MAC is done with the frame, the radio may be turned off again */
+  if (dllc_isOn == FALSE) {
+    e_nsErr_t err;
+    pdllc_netstk->mac->off(&err);
+  }
+#endif
+
   if (dllc_cbTxFnct) {
-    dllc_cbTxFnct(pdllc_cbtxarg, p_err);
+    dllc_cbTxFnct(p_arg, p_err);
   }
 }
 
@@ -562,6 +638,145 @@ static void dllc_verifyAddr(frame802154_t *p_frame, e_nsErr_t *p_err)
 }
 
 
+/**
+ * @brief   Fill the header parameters of the frame held in the packetbuf
+ *
+ * @param   p_params        Pointer to the parameters to fill
+ * @param   is_broadcast    1 if the frame is sent to the broadcast address
+ */
+static void dllc_setHdrParams(frame802154_t *p_params, int is_broadcast)
+{
+  /* init to zeros */
+  memset(p_params, 0, sizeof(*p_params));
+
+  /* build the FCF. */
+  p_params->fcf.frame_type = packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE);
+  p_params->fcf.frame_pending = packetbuf_attr(PACKETBUF_ATTR_PENDING);
+  p_params->fcf.ack_required = packetbuf_attr(PACKETBUF_ATTR_MAC_ACK);
+
+  /* PAN ID compression */
+  p_params->fcf.panid_compression = 0;
+
+  /* Insert IEEE 802.15.4 (2006) version bits. */
+  p_params->fcf.frame_version = FRAME802154_IEEE802154_2006;
+
+  /* sequence number */
+  p_params->seq = (uint8_t) packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
+
+  /* addressing fields */
+  p_params->dest_pid = packetbuf_attr(PACKETBUF_ATTR_MAC_PAN_ID);
+  if (is_broadcast == 1) {
+    /* Broadcast requires short address mode. */
+    p_params->fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
+    p_params->dest_addr[0] = 0xFF;
+    p_params->dest_addr[1] = 0xFF;
+  } else {
+    linkaddr_copy((linkaddr_t *)&p_params->dest_addr, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+    p_params->fcf.dest_addr_mode = FRAME802154_LONGADDRMODE;
+  }
+
+  p_params->src_pid = packetbuf_attr(PACKETBUF_ATTR_MAC_PAN_ID);
+  if (LINKADDR_SIZE == 2UL) {
+    p_params->fcf.src_addr_mode = FRAME802154_SHORTADDRMODE;
+  } else {
+    p_params->fcf.src_addr_mode = FRAME802154_LONGADDRMODE;
+  }
+  linkaddr_copy((linkaddr_t *)&p_params->src_addr, &linkaddr_node_addr);
+
+  /* auxiliary security */
+#if LLSEC802154_SECURITY_LEVEL
+  if(packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL)) {
+    p_params->fcf.security_enabled = 1;
+  }
+  /* Setting security-related attributes */
+  p_params->aux_hdr.security_control.security_level = packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL);
+  p_params->aux_hdr.frame_counter.u16[0] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1);
+  p_params->aux_hdr.frame_counter.u16[1] = packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3);
+#if LLSEC802154_USES_EXPLICIT_KEYS
+  p_params->aux_hdr.security_control.key_id_mode = packetbuf_attr(PACKETBUF_ATTR_KEY_ID_MODE);
+  p_params->aux_hdr.key_index = packetbuf_attr(PACKETBUF_ATTR_KEY_INDEX);
+  p_params->aux_hdr.key_source.u16[0] = packetbuf_attr(PACKETBUF_ATTR_KEY_SOURCE_BYTES_0_1);
+#endif /* LLSEC802154_USES_EXPLICIT_KEYS */
+#endif /* LLSEC802154_SECURITY_LEVEL */
+
+  /* configure packet payload */
+  p_params->payload = packetbuf_dataptr();
+  p_params->payload_len = packetbuf_datalen();
+}
+
+
+#if (DLLC_HDR_TMPL_EN == TRUE)
+/**
+ * @brief   Get the header template matching the frame held in the packetbuf,
+ *          building it when there is none yet
+ *
+ * @param   is_broadcast    1 if the frame is sent to the broadcast address
+ *
+ * @return  Pointer to the template
+ */
+static struct dllc_hdrTmpl *dllc_getHdrTmpl(int is_broadcast)
+{
+  uint8_t i;
+  const linkaddr_t *p_dest;
+  packetbuf_attr_t pan_id;
+  uint8_t frame_type;
+  uint8_t sec_level;
+  struct dllc_hdrTmpl *p_tmpl;
+  frame802154_t params;
+
+
+  /* templates carry the source address, drop them once it changed */
+  if (linkaddr_cmp(&dllc_hdrTmplSrc, &linkaddr_node_addr) == 0) {
+    memset(dllc_hdrTmpls, 0, sizeof(dllc_hdrTmpls));
+    linkaddr_copy(&dllc_hdrTmplSrc, &linkaddr_node_addr);
+  }
+
+  p_dest = (is_broadcast == 1) ? &linkaddr_null : packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  pan_id = packetbuf_attr(PACKETBUF_ATTR_MAC_PAN_ID);
+  frame_type = (uint8_t) packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE);
+#if LLSEC802154_SECURITY_LEVEL
+  sec_level = (uint8_t) packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL);
+#else
+  sec_level = 0;
+#endif
+
+  for (i = 0; i < NETSTK_CFG_DLLC_HDR_CACHE_NUM; i++) {
+    p_tmpl = &dllc_hdrTmpls[i];
+    if ((p_tmpl->len != 0) &&
+        (p_tmpl->panId == pan_id) &&
+        (p_tmpl->frameType == frame_type) &&
+        (p_tmpl->secLevel == sec_level) &&
+        linkaddr_cmp(&p_tmpl->dest, p_dest)) {
+      return p_tmpl;
+    }
+  }
+
+  /* not found, replace the templates in turn */
+  p_tmpl = &dllc_hdrTmpls[dllc_hdrTmplNext];
+  if (++dllc_hdrTmplNext >= NETSTK_CFG_DLLC_HDR_CACHE_NUM) {
+    dllc_hdrTmplNext = 0;
+  }
+
+  /* per-frame fields are left zero and filled in on every transmission */
+  dllc_setHdrParams(&params, is_broadcast);
+  params.fcf.frame_pending = 0;
+  params.fcf.ack_required = 0;
+  params.seq = 0;
+#if LLSEC802154_SECURITY_LEVEL
+  params.aux_hdr.frame_counter.u32 = 0;
+#endif
+
+  linkaddr_copy(&p_tmpl->dest, p_dest);
+  p_tmpl->panId = pan_id;
+  p_tmpl->frameType = frame_type;
+  p_tmpl->secLevel = sec_level;
+  p_tmpl->len = frame802154_hdrlen(&params);
+  frame802154_create(&params, p_tmpl->hdr);
+  return p_tmpl;
+}
+#endif /* DLLC_HDR_TMPL_EN */
+
+
 /*
 ********************************************************************************
 *                               END OF FILE
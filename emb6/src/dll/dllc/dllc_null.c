@@ -122,8 +122,16 @@ const s_nsDLLC_t dllc_driver_null =
  */
 static void dllc_cbTx(void *p_arg, e_nsErr_t *p_err)
 {
+#if (NETSTK_CFG_AUTO_ONOFF_EN == TRUE)
+  /* the MAC is done with the frame, the radio may be turned off again */
+  if (dllc_isOn == FALSE) {
+    e_nsErr_t err;
+    pdllc_netstk->mac->off(&err);
+  }
+#endif
+
   if (dllc_cbTxFnct) {
-    dllc_cbTxFnct(pdllc_cbTxArg, p_err);
+    dllc_cbTxFnct(p_arg, p_err);
   }
 }
 
@@ -186,16 +194,24 @@ static void dllc_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, is_ack_required);
 
   pdllc_netstk->mac->ioctrl(NETSTK_CMD_TX_CBFNCT_SET, (void *)dllc_cbTx, p_err);
-  pdllc_netstk->mac->ioctrl(NETSTK_CMD_TX_CBARG_SET, NULL, p_err);
+  /* the MAC may still hold earlier frames, each one keeps its argument */
+  pdllc_netstk->mac->ioctrl(NETSTK_CMD_TX_CBARG_SET, pdllc_cbTxArg, p_err);
 
 #if (NETSTK_CFG_RF_CRC_EN == FALSE)
   uint8_t *p_mfr;
   uint32_t fcs;
   packetbuf_attr_t fcs_len;
 
+  /* allocate buffer for MAC footer (checksum), the MAC queues the frame
+   * from the packet buffer */
+  fcs_len = packetbuf_attr(PACKETBUF_ATTR_MAC_FCS_LEN);
+  if (packetbuf_ftralloc(fcs_len) == 0) {
+    *p_err = NETSTK_ERR_BUF_OVERFLOW;
+    return;
+  }
+
   /* write footer */
   p_mfr = p_data + len;
-  fcs_len = packetbuf_attr(PACKETBUF_ATTR_MAC_FCS_LEN);
   if (fcs_len == 4) {
     /* 32-bit CRC */
     fcs = crc_32_calc(p_data, len);
@@ -214,12 +230,6 @@ static void dllc_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 
   /* issue transmission request */
   pdllc_netstk->mac->send(p_data, len, p_err);
-
-#if (NETSTK_CFG_AUTO_ONOFF_EN == TRUE)
-  if (dllc_isOn == FALSE) {
-    pdllc_netstk->mac->off(p_err);
-  }
-#endif
 }
 
 
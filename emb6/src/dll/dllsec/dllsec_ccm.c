@@ -0,0 +1,486 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*============================================================================*/
+/*============================================================================*/
+
+/**
+ * @file    dllsec_ccm.c
+ * @brief   IEEE 802.15.4 link layer security with AES-CCM*
+ */
+
+/**
+ * \addtogroup dllsec_ccm
+ * @{
+ */
+
+#include "emb6.h"
+#include "dllsec_ccm.h"
+
+#if LLSEC802154_SECURITY_LEVEL
+
+#include "framer_802154.h"
+#include "packetbuf.h"
+#include "nbr-table.h"
+#include "ccm.h"
+
+#define     LOGGER_ENABLE        LOGGER_LLC
+#include    "logger.h"
+
+#if (LLSEC802154_MIC_LENGTH == 0)
+#error "dllsec_ccm: CCM* without MIC (security level 4) is not supported"
+#endif
+
+#if LLSEC802154_USES_EXPLICIT_KEYS
+#error "dllsec_ccm: keys are selected implicitly, explicit key IDs are not supported"
+#endif
+
+#ifndef DLLSEC_CCM_CONF_KEY
+#warning "dllsec_ccm: DLLSEC_CCM_CONF_KEY is not set, the publicly known default key is used"
+#endif
+
+/* Length of the auxiliary security header with implicit keys */
+#define DLLSEC_CCM_AUX_HDR_LEN          5
+/* Length of the length field of CCM*, 15 - nonce length */
+#define DLLSEC_CCM_L                    2
+
+/**
+ * Pairwise key
+ */
+struct dllsec_ccm_key {
+  linkaddr_t    addr;
+  rijndael_ctx  ctx;            /* expanded once, when the key is set */
+  uint8_t       isUsed;
+};
+
+/**
+ * Last frame counters seen from a neighbour, 0 until a first frame
+ */
+struct dllsec_ccm_replay {
+  uint32_t      unicast;
+  uint32_t      broadcast;
+};
+
+NBR_TABLE(struct dllsec_ccm_replay, dllsec_ccm_replay);
+
+static s_ns_t *pdllsec_netstk;
+static mac_callback_t dllsec_txCbFnct;
+/* counter of the last secured frame */
+static uint32_t dllsec_frameCounter;
+/* last counter covered by DLLSEC_CCM_CONF_COUNTER_STORE() */
+static uint32_t dllsec_frameCounterStored;
+/* has the counter been restored or a new key been set since the boot? */
+static uint8_t dllsec_isTxEn;
+static rijndael_ctx dllsec_networkKey;
+static struct dllsec_ccm_key dllsec_pairwiseKeys[DLLSEC_CCM_PAIRWISE_KEYS];
+
+/*---------------------------------------------------------------------------*/
+static struct dllsec_ccm_key *dllsec_findPairwiseKey(const linkaddr_t *p_addr)
+{
+  uint8_t ix;
+
+  for (ix = 0; ix < DLLSEC_CCM_PAIRWISE_KEYS; ix++) {
+    if (dllsec_pairwiseKeys[ix].isUsed &&
+        linkaddr_cmp(&dllsec_pairwiseKeys[ix].addr, p_addr)) {
+      return &dllsec_pairwiseKeys[ix];
+    }
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/**
+ * @brief   Key protecting the frames exchanged with a neighbour
+ *
+ * @param   p_addr  Unicast neighbour, NULL for broadcast frames
+ */
+static rijndael_ctx *dllsec_getKey(const linkaddr_t *p_addr)
+{
+  struct dllsec_ccm_key *p_key;
+
+  if (p_addr != NULL) {
+    p_key = dllsec_findPairwiseKey(p_addr);
+    if (p_key != NULL) {
+      return &p_key->ctx;
+    }
+  }
+  return &dllsec_networkKey;
+}
+
+/*---------------------------------------------------------------------------*/
+/**
+ * @brief   Write the CCM* nonce: extended source address, frame counter and
+ *          security level
+ */
+static void dllsec_setNonce(uint8_t *p_nonce, const linkaddr_t *p_src, uint32_t counter)
+{
+  memset(p_nonce, 0, DTLS_CCM_BLOCKSIZE);
+  memcpy(p_nonce, p_src->u8, LINKADDR_SIZE);
+  p_nonce[8] = (uint8_t)(counter >> 24);
+  p_nonce[9] = (uint8_t)(counter >> 16);
+  p_nonce[10] = (uint8_t)(counter >> 8);
+  p_nonce[11] = (uint8_t)(counter);
+  p_nonce[12] = LLSEC802154_SECURITY_LEVEL;
+}
+
+/*---------------------------------------------------------------------------*/
+static uint32_t dllsec_getFrameCounter(void)
+{
+  return (uint32_t)packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1) |
+         ((uint32_t)packetbuf_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3) << 16);
+}
+
+/*---------------------------------------------------------------------------*/
+/**
+ * @brief   Transmission callback function handler
+ *
+ * @param   p_arg
+ * @param   p_err
+ */
+static void dllsec_cbTx(void *p_arg, e_nsErr_t *p_err)
+{
+  int status;
+  int retx = 0;
+
+  switch (*p_err) {
+    case NETSTK_ERR_NONE:
+      status = MAC_TX_OK;
+      retx = 1;
+      break;
+
+    case NETSTK_ERR_CHANNEL_ACESS_FAILURE:
+      status = MAC_TX_COLLISION;
+      retx = 0;
+      break;
+
+    case NETSTK_ERR_TX_NOACK:
+      status = MAC_TX_NOACK;
+      retx = 1;
+      break;
+
+    case NETSTK_ERR_BUSY:
+      status = MAC_TX_DEFERRED;
+      retx = 0;
+      break;
+
+    default:
+      status = MAC_TX_ERR_FATAL;
+      retx = 0;
+      break;
+  }
+
+  dllsec_txCbFnct(p_arg, status, retx);
+}
+
+/*---------------------------------------------------------------------------*/
+static void dllsec_send(mac_callback_t sent, void *p_arg)
+{
+  e_nsErr_t err = NETSTK_ERR_NONE;
+
+  dllsec_txCbFnct = sent;
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+
+  /* a nonce must never be used twice with the same key */
+  if (dllsec_isTxEn == FALSE) {
+    LOG_ERR("dllsec_ccm: frame counter not restored and no new key set");
+    sent(p_arg, MAC_TX_ERR_FATAL, 0);
+    return;
+  }
+  if (dllsec_frameCounter == 0xFFFFFFFFUL) {
+    LOG_ERR("dllsec_ccm: frame counter exhausted");
+    sent(p_arg, MAC_TX_ERR_FATAL, 0);
+    return;
+  }
+#ifdef DLLSEC_CCM_CONF_COUNTER_STORE
+  /* the next window has to be stored before its first counter is used */
+  if (dllsec_frameCounter == dllsec_frameCounterStored) {
+    if ((0xFFFFFFFFUL - dllsec_frameCounter) > DLLSEC_CCM_COUNTER_WINDOW) {
+      dllsec_frameCounterStored = dllsec_frameCounter + DLLSEC_CCM_COUNTER_WINDOW;
+    } else {
+      dllsec_frameCounterStored = 0xFFFFFFFFUL;
+    }
+    DLLSEC_CCM_CONF_COUNTER_STORE(dllsec_frameCounterStored);
+  }
+#endif /* DLLSEC_CCM_CONF_COUNTER_STORE */
+  dllsec_frameCounter++;
+
+  packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, LLSEC802154_SECURITY_LEVEL);
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1, dllsec_frameCounter & 0xFFFF);
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3, dllsec_frameCounter >> 16);
+
+  /*
+   * set TX callback function and argument
+   */
+  pdllsec_netstk->dllc->ioctrl(NETSTK_CMD_TX_CBFNCT_SET, (void *) dllsec_cbTx, &err);
+  pdllsec_netstk->dllc->ioctrl(NETSTK_CMD_TX_CBARG_SET, p_arg, &err);
+
+  /*
+   * Issue next lower layer to transmit the prepared packet
+   */
+  pdllsec_netstk->dllc->send(packetbuf_hdrptr(), packetbuf_totlen(), &err);
+}
+
+/*---------------------------------------------------------------------------*/
+/**
+ * @brief   Encrypt the payload and append the MIC, once the DLLC has
+ *          written the header including the auxiliary security header
+ *
+ * @return  1 on success, 0 otherwise
+ */
+static int dllsec_onFrameCreated(void)
+{
+  uint8_t nonce[DTLS_CCM_BLOCKSIZE];
+  rijndael_ctx *p_key;
+  uint8_t *p_hdr;
+  uint8_t *p_data;
+  uint8_t hdrlen;
+  uint16_t datalen;
+
+  if (packetbuf_totlen() + LLSEC802154_MIC_LENGTH > PACKETBUF_SIZE) {
+    return 0;
+  }
+
+  if (packetbuf_holds_broadcast()) {
+    p_key = dllsec_getKey(NULL);
+  } else {
+    p_key = dllsec_getKey(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  }
+  dllsec_setNonce(nonce, &linkaddr_node_addr, dllsec_getFrameCounter());
+
+  p_hdr = packetbuf_hdrptr();
+  hdrlen = packetbuf_hdrlen();
+  p_data = packetbuf_dataptr();
+  datalen = packetbuf_datalen();
+
+#if LLSEC802154_USES_ENCRYPTION
+  /* header is authenticated, payload is encrypted */
+  dtls_ccm_encrypt_message(p_key, LLSEC802154_MIC_LENGTH, DLLSEC_CCM_L, nonce,
+                           p_data, datalen, p_hdr, hdrlen);
+#else
+  /* header and payload are authenticated only */
+  dtls_ccm_encrypt_message(p_key, LLSEC802154_MIC_LENGTH, DLLSEC_CCM_L, nonce,
+                           p_data + datalen, 0, p_hdr, hdrlen + datalen);
+#endif
+  packetbuf_set_datalen(datalen + LLSEC802154_MIC_LENGTH);
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/**
+ * @brief   Verify and decrypt a received frame, then pass it up if it is
+ *          neither forged nor replayed
+ */
+static void dllsec_input(void)
+{
+  uint8_t nonce[DTLS_CCM_BLOCKSIZE];
+  struct dllsec_ccm_replay *p_replay;
+  const linkaddr_t *p_sender;
+  uint8_t isBroadcast;
+  uint32_t counter;
+  uint32_t *p_last;
+  uint8_t *p_hdr;
+  uint8_t *p_data;
+  uint8_t hdrlen;
+  uint16_t datalen;
+  long int len;
+
+  /* unsecured frames and other levels are rejected */
+  if (packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL) != LLSEC802154_SECURITY_LEVEL) {
+    LOG_WARN("dllsec_ccm: frame with security level %u dropped",
+             (unsigned)packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL));
+    return;
+  }
+
+  datalen = packetbuf_datalen();
+  if (datalen < LLSEC802154_MIC_LENGTH) {
+    return;
+  }
+
+  p_sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  isBroadcast = packetbuf_holds_broadcast();
+  counter = dllsec_getFrameCounter();
+
+  /* cheap check first, a replayed frame is not worth a decryption */
+  p_replay = nbr_table_get_from_lladdr(dllsec_ccm_replay, p_sender);
+  if (p_replay != NULL) {
+    p_last = isBroadcast ? &p_replay->broadcast : &p_replay->unicast;
+    if ((*p_last != 0) && (counter <= *p_last)) {
+      LOG_WARN("dllsec_ccm: replayed frame dropped");
+      return;
+    }
+  }
+
+  dllsec_setNonce(nonce, p_sender, counter);
+  p_hdr = packetbuf_hdrptr();
+  hdrlen = packetbuf_hdrlen();
+  p_data = packetbuf_dataptr();
+
+#if LLSEC802154_USES_ENCRYPTION
+  len = dtls_ccm_decrypt_message(dllsec_getKey(isBroadcast ? NULL : p_sender),
+                                 LLSEC802154_MIC_LENGTH, DLLSEC_CCM_L, nonce,
+                                 p_data, datalen, p_hdr, hdrlen);
+#else
+  len = dtls_ccm_decrypt_message(dllsec_getKey(isBroadcast ? NULL : p_sender),
+                                 LLSEC802154_MIC_LENGTH, DLLSEC_CCM_L, nonce,
+                                 p_data + datalen - LLSEC802154_MIC_LENGTH, LLSEC802154_MIC_LENGTH,
+                                 p_hdr, hdrlen + datalen - LLSEC802154_MIC_LENGTH);
+#endif
+  if (len < 0) {
+    LOG_WARN("dllsec_ccm: invalid MIC");
+    return;
+  }
+
+  /* only authentic frames may take a slot, forged ones could evict others */
+  if (p_replay == NULL) {
+    p_replay = nbr_table_add_lladdr(dllsec_ccm_replay, p_sender);
+    if (p_replay == NULL) {
+      LOG_WARN("dllsec_ccm: no room for the frame counter of the sender");
+      return;
+    }
+    p_replay->unicast = 0;
+    p_replay->broadcast = 0;
+  }
+  if (isBroadcast) {
+    p_replay->broadcast = counter;
+  } else {
+    p_replay->unicast = counter;
+  }
+
+  packetbuf_set_datalen(datalen - LLSEC802154_MIC_LENGTH);
+  pdllsec_netstk->hc->input();
+}
+
+/*---------------------------------------------------------------------------*/
+static uint8_t dllsec_getOverhead(void)
+{
+  return DLLSEC_CCM_AUX_HDR_LEN + LLSEC802154_MIC_LENGTH;
+}
+
+/*---------------------------------------------------------------------------*/
+static void dllsec_init(s_ns_t *p_netstk)
+{
+  static const uint8_t key[DLLSEC_CCM_KEY_LEN] = DLLSEC_CCM_KEY;
+
+#if NETSTK_CFG_ARG_CHK_EN
+  if (p_netstk == NULL) {
+    return;
+  }
+#endif
+
+  e_nsErr_t err = NETSTK_ERR_NONE;
+
+  pdllsec_netstk = p_netstk;
+  memset(dllsec_pairwiseKeys, 0, sizeof(dllsec_pairwiseKeys));
+  dllsec_ccm_setKey(NULL, key);
+  nbr_table_register(dllsec_ccm_replay, NULL);
+
+  /* the counters used with the built-in key before the reboot are unknown */
+  dllsec_frameCounter = 0;
+  dllsec_frameCounterStored = 0;
+  dllsec_isTxEn = FALSE;
+
+  pdllsec_netstk->dllc->ioctrl(NETSTK_CMD_RX_CBFNT_SET, (void *) dllsec_input, &err);
+}
+
+/*---------------------------------------------------------------------------*/
+int dllsec_ccm_setKey(const linkaddr_t *p_addr, const uint8_t *p_key)
+{
+  struct dllsec_ccm_key *p_entry;
+  uint8_t ix;
+
+  if (p_addr == NULL) {
+    if (p_key == NULL) {
+      return 0;
+    }
+    rijndael_set_key_enc_only(&dllsec_networkKey, p_key, 8 * DLLSEC_CCM_KEY_LEN);
+    dllsec_isTxEn = TRUE;
+    return 1;
+  }
+
+  p_entry = dllsec_findPairwiseKey(p_addr);
+  if (p_key == NULL) {
+    /* remove the pairwise key, the network-wide key is used again */
+    if (p_entry != NULL) {
+      memset(p_entry, 0, sizeof(*p_entry));
+    }
+    return 1;
+  }
+
+  for (ix = 0; (p_entry == NULL) && (ix < DLLSEC_CCM_PAIRWISE_KEYS); ix++) {
+    if (!dllsec_pairwiseKeys[ix].isUsed) {
+      p_entry = &dllsec_pairwiseKeys[ix];
+    }
+  }
+  if (p_entry == NULL) {
+    return 0;
+  }
+
+  linkaddr_copy(&p_entry->addr, p_addr);
+  rijndael_set_key_enc_only(&p_entry->ctx, p_key, 8 * DLLSEC_CCM_KEY_LEN);
+  p_entry->isUsed = TRUE;
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+int dllsec_ccm_setFrameCounter(uint32_t counter)
+{
+  if (counter < dllsec_frameCounter) {
+    return 0;
+  }
+  dllsec_frameCounter = counter;
+  dllsec_frameCounterStored = counter;
+  dllsec_isTxEn = TRUE;
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+const s_nsdllsec_t dllsec_driver_ccm =
+{
+ "LLSEC CCM",
+  dllsec_init,
+  dllsec_send,
+  dllsec_onFrameCreated,
+  dllsec_input,
+  dllsec_getOverhead
+};
+/*---------------------------------------------------------------------------*/
+
+#endif /* LLSEC802154_SECURITY_LEVEL */
+
+/** @} */
@@ -70,6 +70,7 @@
 #include "cc.h"
 #include "framer.h"
 #include "framer_802154.h"
+#include "dllsec_802154.h"
 
 
 /**
@@ -252,9 +253,10 @@ field_len(frame802154_t *p, field_length_t *flen)
   /* Aux security header */
   if(p->fcf.security_enabled & 1) {
       flen->aux_sec_len = 5
-      #if LLSEC802154_USES_EXPLICIT_KEYS
-              get_key_id_len(p->aux_hdr.security_control.key_id_mode);
-      #endif /* LLSEC802154_USES_EXPLICIT_KEYS */
+#if LLSEC802154_USES_EXPLICIT_KEYS
+              + get_key_id_len(p->aux_hdr.security_control.key_id_mode)
+#endif /* LLSEC802154_USES_EXPLICIT_KEYS */
+              ;
   }
 #endif /* LLSEC802154_SECURITY_LEVEL */
 }
@@ -356,6 +358,7 @@ frame802154_create(frame802154_t *p, uint8_t *buf)
 #if LLSEC802154_USES_EXPLICIT_KEYS
         | (p->aux_hdr.security_control.key_id_mode << 3)
 #endif /* LLSEC802154_USES_EXPLICIT_KEYS */
+        ;
         memcpy(buf + pos, p->aux_hdr.frame_counter.u8, 4);
         pos += 4;
 
@@ -22,6 +22,7 @@ uint16_t frame_smartmac_create(frame_smartmac_st *p_frame, uint8_t *p_buf)
 
   /* write frame control fields */
   *p++ = ((p_frame->type & 7)) |
+         ((p_frame->pending & 1) << 4) |
          ((p_frame->ack_required & 1) << 5);
 
   *p++ = 0b10011000; /* frame version 2006, short address modes for both destination and source */
@@ -86,6 +87,7 @@ uint16_t frame_smartmac_parse(uint8_t *p_buf, uint16_t len, frame_smartmac_st *p
 
   /* read frame control fields */
   p_frame->type = p[0] & 7;
+  p_frame->pending = (p[0] >> 4) & 1;
   p_frame->ack_required = (p[0] >> 5) & 1;
   p += 2;
 
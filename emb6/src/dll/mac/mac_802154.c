@@ -56,6 +56,7 @@
 #include "evproc.h"
 #include "framer_802154.h"
 #include "packetbuf.h"
+#include "mac_txq.h"
 #include "random.h"
 #include "rt_tmr.h"
 
@@ -77,6 +78,17 @@
   #endif
 #endif
 
+/*
+********************************************************************************
+*                               LOCAL TYPEDEF
+********************************************************************************
+*/
+typedef enum {
+  E_MAC_TX_STATE_IDLE,          /* no transmission in progress */
+  E_MAC_TX_STATE_BACKOFF,       /* CSMA-CA random backoff before the CCA */
+  E_MAC_TX_STATE_WFA,           /* frame sent, waiting for its ACK */
+} e_mac_txState_t;
+
 /*
 ********************************************************************************
 *                          LOCAL FUNCTION DECLARATIONS
@@ -91,10 +103,17 @@ static void mac_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err);
 
 #if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE)
 static void mac_txAck(uint8_t seq, e_nsErr_t *p_err);
-static void mac_rxBufTimeout(s_rt_tmr_t *p_tmr, e_nsErr_t *p_err);
+static void mac_txWfaTimeout(void);
 #endif /* NETSTK_CFG_MAC_SW_AUTOACK_EN */
 
-static void mac_csma(e_nsErr_t *p_err);
+static void mac_txStart(void);
+static void mac_txCsma(void);
+static void mac_txBackoff(void);
+static void mac_txCca(void);
+static void mac_txTransmit(void);
+static void mac_txDone(e_nsErr_t err);
+static void mac_tmrCb(void *p_arg);
+static void mac_eventHandler(c_event_t c_event, p_data_t p_data);
 
 
 /*
@@ -110,11 +129,23 @@ static uint8_t          mac_isAckReq;
 static s_ns_t          *pmac_netstk;
 static void            *pmac_cbTxArg;
 static nsTxCbFnct_t     mac_cbTxFnct;
-static e_nsErr_t        mac_txErr;
-static uint8_t          mac_hasData;
+
+/* transmission of the frame at the head of the queue */
+static e_mac_txState_t  mac_txState;
+static uint8_t          mac_txSeq;
+static uint8_t          mac_txNb;
+static uint8_t          mac_txBe;
+static uint8_t          mac_txRetries;
+static uint8_t          mac_txRetriesMax;
+static uint32_t         mac_txBackoffUs;
+static s_rt_tmr_t       mac_tmrBackoff;
 
 #if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE)
 static s_rt_tmr_t       mac_tmrWfa;
+#if (NETSTK_CFG_RF_RETX_EN == TRUE)
+/* does the radio still hold the frame for a retransmission? */
+static uint8_t          mac_txIsBuffered;
+#endif
 #endif
 
 /*
@@ -166,10 +197,14 @@ void mac_init(void *p_netstk, e_nsErr_t *p_err)
   mac_cbTxFnct = 0;
   pmac_cbTxArg = NULL;
   mac_isAckReq = 0;
-  mac_txErr = NETSTK_ERR_NONE;
+
+  /* initialize transmission queue */
+  mac_txState = E_MAC_TX_STATE_IDLE;
+  mac_txq_init();
+  evproc_regCallback(NETSTK_MAC_EVENT, mac_eventHandler);
 
 #if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE)
-  rt_tmr_create(&mac_tmrWfa, E_RT_TMR_TYPE_ONE_SHOT, MAC_CFG_TMR_WFA_IN_MS, 0, NULL);
+  rt_tmr_create(&mac_tmrWfa, E_RT_TMR_TYPE_ONE_SHOT, MAC_CFG_TMR_WFA_IN_MS, mac_tmrCb, NULL);
 #endif
 
   /*
@@ -241,6 +276,10 @@ void mac_off(e_nsErr_t *p_err)
 /**
  * @brief   Frame transmission handler
  *
+ *          The frame, which DLLC hands down in the packet buffer, is queued
+ *          and transmitted in the background. The result is signaled through
+ *          the TX callback function once the transmission has completed.
+ *
  * @param   p_data      Pointer to buffer holding frame to send
  * @param   len         Length of frame to send
  * @param   p_err       Pointer to a variable storing returned error code
@@ -294,148 +333,30 @@ void mac_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 
   LOG_INFO("MAC_TX: Transmit %d bytes.", len);
 
-  uint8_t is_tx_done;
-  uint8_t tx_retries;
-  uint8_t tx_retriesMax;
-
-  /* find out if ACK is required */
-  mac_isAckReq = packetbuf_attr(PACKETBUF_ATTR_MAC_ACK);
-
-  /*
-   * Transmission handling
-   */
-  tx_retriesMax = packetbuf_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS);
-  tx_retries = 0;
-  is_tx_done = FALSE;
-
-  /* set result of TX process to default */
-  mac_txErr = NETSTK_ERR_TX_NOACK;
-
-  /* perform CSMA-CA */
-  mac_csma(p_err);
-
-  /* was channel free? */
-  if (*p_err == NETSTK_ERR_NONE) {
-    /* then attempt to transmit the packet */
-    pmac_netstk->phy->send(p_data, len, p_err);
+  /* the frame is not expected anywhere else than in the packet buffer */
+  if ((p_data != packetbuf_hdrptr()) || (len != packetbuf_totlen())) {
+    *p_err = NETSTK_ERR_INVALID_ARGUMENT;
+    return;
   }
 
-  /* is ACK required? */
-  if (mac_isAckReq == TRUE) {
-
-  /* is software Auto-ACK feature of MAC disabled? */
-#if (NETSTK_CFG_MAC_SW_AUTOACK_EN == FALSE)
-    {
-      /* has the frame not been acknowledged? */
-      if (*p_err == NETSTK_ERR_TX_NOACK) {
-        /* then perform retransmission */
-        tx_retries++;
-
-        /* iterates retransmission as long as number of retries does not exceed
-        * the maximum retries and ACK was not arrived
-        */
-        while ((tx_retries < tx_retriesMax) && (is_tx_done == FALSE)) {
-          TRACE_LOG_ERR("+ MAC_TX: seq=%02x; retry=%d; err=-%d", p_data[2], tx_retries, *p_err);
-
-          /* perform unslotted CSMA-CA */
-          mac_csma(p_err);
-
-          /* is channel free? */
-          if (*p_err == NETSTK_ERR_NONE) {
-            /* then retransmit the frame */
-            pmac_netstk->phy->send(p_data, len, p_err);
-            /* was ACK not arrived? */
-            if (*p_err == NETSTK_ERR_TX_NOACK) {
-              /* then increase number of retries */
-              tx_retries++;
-            } else {
-              /* otherwise terminate the transmission */
-              is_tx_done = TRUE;
-              TRACE_LOG_ERR("+ MAC_TX: TX done, r=%d, e=-%d", tx_retries, *p_err);
-            }
-          }
-          /* was channel free or was the radio busy */
-          else {
-            /* then terminate transmission process */
-            is_tx_done = TRUE;
-            TRACE_LOG_ERR("+ MAC_TX: CCA failed, r=%d, e=%d", tx_retries, *p_err);
-          }
-        }
-      }
+  /* store the frame together with its attributes in the queue of its
+   * receiver */
+  if (mac_txq_put(mac_cbTxFnct, pmac_cbTxArg, p_err) == NULL) {
+    /* queue was full, the upper layer has to try again later */
+    /* was transmission callback function set? */
+    if (mac_cbTxFnct) {
+      /* then signal the upper layer of the result of transmission process */
+      mac_cbTxFnct(pmac_cbTxArg, p_err);
     }
-#else
-    {
-      /* was the packet successfully transmitted? */
-      if (*p_err == NETSTK_ERR_NONE) {
-        /* then waits for ACK */
-        is_tx_done = FALSE;
-        do {
-          tx_retries++;
-          /* polling for ACK until timeout is expired */
-          mac_rxBufTimeout(&mac_tmrWfa, p_err);
-          /* was no packet arrived during AckWaitDuration? */
-          if (*p_err == NETSTK_ERR_FATAL) {
-            TRACE_LOG_ERR("MAC_TX: WFA timeout seq=%02x, r=%d", p_data[2], tx_retries);
-            /* was number of retries smaller than maximum retry? */
-            if (tx_retries < tx_retriesMax) {
-              /* then check if channel is free */
-              mac_csma(p_err);
-              /* was the channel free? */
-              if (*p_err == NETSTK_ERR_NONE) {
-                /* then retransmit the frame */
-                #if (NETSTK_CFG_RF_RETX_EN == TRUE)
-                pmac_netstk->phy->ioctrl(NETSTK_CMD_RF_RETX, NULL, p_err);
-                #else
-                pmac_netstk->phy->send(p_data, len, p_err);
-                #endif
-                /* has frame failed to transmit? */
-                if (*p_err != NETSTK_ERR_NONE) {
-                  /* then terminate the transmission */
-                  is_tx_done = TRUE;
-                  TRACE_LOG_ERR("MAC_TX: TX failed, r=%d", tx_retries);
-                }
-              }
-              /* was channel free or was the radio busy */
-              else {
-                is_tx_done = TRUE;
-                TRACE_LOG_ERR("MAC_TX: CCA failed, r=%d, e=%d", tx_retries, *p_err);
-              }
-            }
-            /* was number of retries equal or greater than the maximum retry? */
-            else {
-              /* then terminate the transmission process */
-              is_tx_done = TRUE;
-              *p_err = NETSTK_ERR_TX_NOACK;
-              TRACE_LOG_ERR("MAC_TX: NO_ACK, r=%d", tx_retries);
-            }
-          }
-          /* was a packet arrived during ACK-wait duration? */
-          else {
-            /* then TX result is set in mac_recv() and terminate the TX process */
-            *p_err = mac_txErr;
-            is_tx_done = TRUE;
-          }
-        } while (is_tx_done == FALSE);
-      }
-    }
-    #endif
-  }
-  /* is ACK not required? */
-  else {
-    /* then terminate transmission process */
+    return;
   }
 
-
-  /* reset local variables */
-  mac_isAckReq = 0;
-  mac_txErr = NETSTK_ERR_NONE;
-  TRACE_LOG_MAIN("MAC_TX: finished e=-%d", *p_err);
-  LOG_INFO("MAC_TX: --> Done - TX Status %d (%d/%d retries).", *p_err, tx_retries, tx_retriesMax);
-
-  /* was transmission callback function set? */
-  if (mac_cbTxFnct) {
-    /* then signal the upper layer of the result of transmission process */
-    mac_cbTxFnct(pmac_cbTxArg, p_err);
+  /* is this the only frame in the queue? */
+  if ((mac_txState == E_MAC_TX_STATE_IDLE) && (mac_txq_len() == 1)) {
+    /* then start right away. Otherwise the event posted when the previous
+     * frame completed starts the next one, so that a callback invoked from
+     * here always belongs to the frame that has just been handed down */
+    mac_txStart();
   }
 }
 
@@ -461,7 +382,6 @@ void mac_recv(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 #endif
 
   int hdrlen;
-  uint8_t exp_seq;
   uint8_t is_acked;
   frame802154_t frame;
 
@@ -486,25 +406,22 @@ void mac_recv(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
     return;
   }
 
-  /* a valid frame has arrived */
-  mac_hasData = 1;
-
   /* was MAC waiting for ACK? */
-  if (mac_isAckReq) {
+  if (mac_txState == E_MAC_TX_STATE_WFA) {
 #if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE)
     /* then frames other than ACK shall be discarded silently */
+    rt_tmr_stop(&mac_tmrWfa);
 
     /* check if this is expected ACK */
-    exp_seq = (uint8_t) packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
-    is_acked = ((frame.seq == exp_seq) &&
+    is_acked = ((frame.seq == mac_txSeq) &&
                 (frame.fcf.frame_type == FRAME802154_ACKFRAME));
     if (is_acked) {
       /* valid ACK has arrived */
-      mac_txErr = NETSTK_ERR_NONE;
+      mac_txDone(NETSTK_ERR_NONE);
     } else {
       /* unexpected packet arrives while waiting for ACK */
-      mac_txErr = NETSTK_ERR_TX_COLLISION;
       TRACE_LOG_ERR("MAC_TX: collided");
+      mac_txDone(NETSTK_ERR_TX_COLLISION);
     }
 #endif
   }
@@ -569,6 +486,10 @@ void mac_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err)
       pmac_cbTxArg = p_val;
       break;
 
+    case NETSTK_CMD_MAC_TXQ_FREE_GET:
+      *((uint8_t *)p_val) = mac_txq_free(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+      break;
+
     default:
       pmac_netstk->phy->ioctrl(cmd, p_val, p_err);
       break;
@@ -619,104 +540,283 @@ static void mac_txAck(uint8_t seq, e_nsErr_t *p_err)
   /* Issue next lower layer to transmit ACK */
   pmac_netstk->phy->send(p_ack, ack_len, p_err);
   LOG_INFO("MAC_TX: ACK %d.", frame.seq);
+
+#if (NETSTK_CFG_RF_RETX_EN == TRUE)
+  /* the ACK has replaced a frame waiting for retransmission */
+  mac_txIsBuffered = FALSE;
+#endif
 }
 #endif /* NETSTK_CFG_MAC_SW_AUTOACK_EN */
 
 
 /**
- * @brief   This function performs CSMA-CA mechanism.
+ * @brief   Start transmission of the frame at the head of the queue
+ */
+static void mac_txStart(void)
+{
+  struct mac_txq_frame *p_frame;
+
+  p_frame = mac_txq_head();
+  if (p_frame == NULL) {
+    mac_txState = E_MAC_TX_STATE_IDLE;
+    return;
+  }
+
+#if (NETSTK_CFG_AUTO_ONOFF_EN == TRUE)
+  e_nsErr_t err;
+
+  /* DLLC turns the radio off after every frame it has sent */
+  pmac_netstk->phy->on(&err);
+#endif
+
+  /* find out if ACK is required */
+  mac_isAckReq = mac_txq_attr(p_frame, PACKETBUF_ATTR_MAC_ACK);
+  mac_txSeq = mac_txq_attr(p_frame, PACKETBUF_ATTR_MAC_SEQNO);
+  mac_txRetriesMax = mac_txq_attr(p_frame, PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS);
+  mac_txRetries = 0;
+#if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE) && (NETSTK_CFG_RF_RETX_EN == TRUE)
+  mac_txIsBuffered = FALSE;
+#endif
+
+  /* perform CSMA-CA */
+  mac_txCsma();
+}
+
+
+/**
+ * @brief   Start a round of unslotted CSMA-CA
+ */
+static void mac_txCsma(void)
+{
+  /* initialize CSMA variables */
+  mac_txNb = 0;
+  mac_txBe = NETSTK_CFG_CSMA_MIN_BE;
+  mac_txBackoff();
+}
+
+
+/**
+ * @brief   Delay for random (2^BE - 1) unit backoff periods before the CCA
  *
- * @param   p_err   Pointer to a variable storing returned error code
+ *          Whole milliseconds are left to the backoff timer so that the
+ *          event loop keeps running, only the sub-millisecond remainder is
+ *          busy-waited before the CCA.
  */
-static void mac_csma(e_nsErr_t *p_err)
+static void mac_txBackoff(void)
 {
-  uint32_t delay = 0;
+  uint32_t delay;
   uint32_t max_random;
-  uint8_t nb;
-  uint8_t be;
 
-  /* initialize CSMA variables */
-  nb = 0;
-  be = NETSTK_CFG_CSMA_MIN_BE;
-  *p_err = NETSTK_ERR_NONE;
+  max_random = (1 << mac_txBe) - 1;
+  delay  = bsp_getrand(max_random);
+  delay *= NETSTK_CFG_CSMA_UNIT_BACKOFF_US;
 
-  /* perform CCA maximum MaxBackoff time */
-  while (nb <= NETSTK_CFG_CSMA_MAX_BACKOFF) {
-    /* delay for random (2^BE - 1) unit backoff periods */
-    max_random = (1 << be) - 1;
-    delay  = bsp_getrand(max_random);
-    delay *= NETSTK_CFG_CSMA_UNIT_BACKOFF_US;
-    bsp_delay_us(delay);
-
-    /* perform CCA */
-    pmac_netstk->phy->ioctrl(NETSTK_CMD_RF_CCA_GET, 0, p_err);
-    /* was channel free or was the radio busy? */
-    if (*p_err == NETSTK_ERR_NONE) {
-      /* channel free */
-      break;
-    }
-    else if (*p_err == NETSTK_ERR_BUSY) {
-      /* radio is likely busy receiving a packet and therefore should let it handle the received packet now */
-      *p_err = NETSTK_ERR_CHANNEL_ACESS_FAILURE;
-      break;
-    }
-    /* was channel busy? */
-    else {
-      /* then increase number of backoff by one */
-      nb++;
+  mac_txState = E_MAC_TX_STATE_BACKOFF;
+  mac_txBackoffUs = delay % 1000;
+  if (delay < 1000) {
+    bsp_delay_us(mac_txBackoffUs);
+    mac_txCca();
+  } else {
+    rt_tmr_create(&mac_tmrBackoff, E_RT_TMR_TYPE_ONE_SHOT, delay / 1000, mac_tmrCb, NULL);
+    rt_tmr_start(&mac_tmrBackoff);
+  }
+}
+
+
+/**
+ * @brief   Perform CCA once the backoff period has elapsed
+ */
+static void mac_txCca(void)
+{
+  e_nsErr_t err;
+
+  pmac_netstk->phy->ioctrl(NETSTK_CMD_RF_CCA_GET, 0, &err);
+  /* was channel free or was the radio busy? */
+  if (err == NETSTK_ERR_NONE) {
+    /* channel free */
+    LOG_INFO("MAC_TX: NB %d.", mac_txNb);
+    mac_txTransmit();
+  }
+  else if (err == NETSTK_ERR_BUSY) {
+    /* radio is likely busy receiving a packet and therefore should let it handle the received packet now */
+    TRACE_LOG_ERR("MAC_TX: CCA failed, r=%d, e=%d", mac_txRetries, err);
+    mac_txDone(NETSTK_ERR_CHANNEL_ACESS_FAILURE);
+  }
+  /* was channel busy? */
+  else {
+    /* then increase number of backoff by one */
+    mac_txNb++;
+    if (mac_txNb > NETSTK_CFG_CSMA_MAX_BACKOFF) {
+      TRACE_LOG_ERR("MAC_TX: CCA failed, r=%d, e=%d", mac_txRetries, err);
+      mac_txDone(err);
+    } else {
       /* be = MIN((be + 1), MaxBE) */
-      be = ((be + 1) < NETSTK_CFG_CSMA_MAX_BE) ? (be + 1) : (NETSTK_CFG_CSMA_MAX_BE);
+      mac_txBe = ((mac_txBe + 1) < NETSTK_CFG_CSMA_MAX_BE) ? (mac_txBe + 1) : (NETSTK_CFG_CSMA_MAX_BE);
+      mac_txBackoff();
     }
   }
-  LOG_INFO("MAC_TX: NB %d.", nb);
 }
 
-#if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE)
+
 /**
- * @brief Polling for data until either the data is available or timeout is over
- * @param p_tmr
- * @param p_err NETSTK_ERR_NONE when data is available, otherwise NETSTK_ERR_MAC_ULE_NO_DATA
- *
+ * @brief   Transmit the frame on a free channel
  */
-static void mac_rxBufTimeout(s_rt_tmr_t *p_tmr, e_nsErr_t *p_err)
+static void mac_txTransmit(void)
 {
-  e_rt_tmr_state_t tmr_state;
-
-  /* start polling timer */
-  rt_tmr_stop(p_tmr);
-  rt_tmr_start(p_tmr);
-  mac_hasData = 0;
-  do {
-    /* check if RF is in reception process */
-    pmac_netstk->phy->ioctrl(NETSTK_CMD_RF_IS_RX_BUSY, NULL, p_err);
-    if (*p_err == NETSTK_ERR_BUSY) {
-      /* wait until RF has completed reception process i.e., the radio is not
-      * busy anymore
-      */
-      do {
-        pmac_netstk->phy->ioctrl(NETSTK_CMD_RX_BUF_READ, NULL, p_err);
-        pmac_netstk->phy->ioctrl(NETSTK_CMD_RF_IS_RX_BUSY, NULL, p_err);
-      } while (*p_err == NETSTK_ERR_BUSY);
-      break;
+  e_nsErr_t err;
+  struct mac_txq_frame *p_frame;
+
+  p_frame = mac_txq_head();
+  mac_txRetries++;
+
+#if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE) && (NETSTK_CFG_RF_RETX_EN == TRUE)
+  if (mac_txIsBuffered == TRUE) {
+    /* then retransmit the frame */
+    pmac_netstk->phy->ioctrl(NETSTK_CMD_RF_RETX, NULL, &err);
+  } else {
+    mac_txq_load(p_frame);
+    pmac_netstk->phy->send(packetbuf_hdrptr(), packetbuf_totlen(), &err);
+    mac_txIsBuffered = TRUE;
+  }
+#else
+  mac_txq_load(p_frame);
+  pmac_netstk->phy->send(packetbuf_hdrptr(), packetbuf_totlen(), &err);
+#endif
+
+  /* is software Auto-ACK feature of MAC disabled? */
+#if (NETSTK_CFG_MAC_SW_AUTOACK_EN == FALSE)
+  /* has the frame not been acknowledged and may it be retransmitted? */
+  if ((mac_isAckReq == TRUE) &&
+      (err == NETSTK_ERR_TX_NOACK) &&
+      (mac_txRetries < mac_txRetriesMax)) {
+    /* then perform retransmission */
+    TRACE_LOG_ERR("+ MAC_TX: seq=%02x; retry=%d; err=-%d", mac_txSeq, mac_txRetries, err);
+    mac_txCsma();
+  } else {
+    /* otherwise terminate the transmission */
+    mac_txDone(err);
+  }
+#else
+  /* was the frame successfully transmitted and is ACK required? */
+  if ((mac_isAckReq == TRUE) && (err == NETSTK_ERR_NONE)) {
+    /* then waits for ACK */
+    mac_txState = E_MAC_TX_STATE_WFA;
+    rt_tmr_create(&mac_tmrWfa, E_RT_TMR_TYPE_ONE_SHOT, MAC_CFG_TMR_WFA_IN_MS, mac_tmrCb, NULL);
+    rt_tmr_start(&mac_tmrWfa);
+  } else {
+    if (err != NETSTK_ERR_NONE) {
+      TRACE_LOG_ERR("MAC_TX: TX failed, r=%d", mac_txRetries);
     }
+    mac_txDone(err);
+  }
+#endif
+}
 
-    /* get state of the timeout timer */
-    tmr_state = rt_tmr_getState(p_tmr);
-  } while (tmr_state == E_RT_TMR_STATE_RUNNING);
 
-  /* stop polling timer */
-  rt_tmr_stop(p_tmr);
+#if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE)
+/**
+ * @brief   No ACK has arrived within the ACK-wait duration
+ */
+static void mac_txWfaTimeout(void)
+{
+  e_nsErr_t err;
+
+  /* check if RF is in reception process */
+  pmac_netstk->phy->ioctrl(NETSTK_CMD_RF_IS_RX_BUSY, NULL, &err);
+  if (err == NETSTK_ERR_BUSY) {
+    /* the frame being received may be the ACK, wait for one more tick */
+    rt_tmr_create(&mac_tmrWfa, E_RT_TMR_TYPE_ONE_SHOT, 1, mac_tmrCb, NULL);
+    rt_tmr_start(&mac_tmrWfa);
+    return;
+  }
 
-  /* set return error code */
-  if (mac_hasData == 0) {
-    *p_err = NETSTK_ERR_FATAL;
+  TRACE_LOG_ERR("MAC_TX: WFA timeout seq=%02x, r=%d", mac_txSeq, mac_txRetries);
+  /* was number of retries smaller than maximum retry? */
+  if (mac_txRetries < mac_txRetriesMax) {
+    /* then retransmit after another round of CSMA-CA */
+    mac_txCsma();
   } else {
-    *p_err = NETSTK_ERR_NONE;
+    /* then terminate the transmission process */
+    TRACE_LOG_ERR("MAC_TX: NO_ACK, r=%d", mac_txRetries);
+    mac_txDone(NETSTK_ERR_TX_NOACK);
   }
 }
 #endif /* NETSTK_CFG_MAC_SW_AUTOACK_EN */
 
 
+/**
+ * @brief   Terminate transmission of the frame at the head of the queue
+ *          and signal the upper layer of the result
+ *
+ * @param   err     Result of the transmission
+ */
+static void mac_txDone(e_nsErr_t err)
+{
+  /* reset local variables */
+  mac_isAckReq = 0;
+  mac_txState = E_MAC_TX_STATE_IDLE;
+  TRACE_LOG_MAIN("MAC_TX: finished e=-%d", err);
+  LOG_INFO("MAC_TX: --> Done - TX Status %d (%d/%d retries).", err, mac_txRetries, mac_txRetriesMax);
+
+  /* the next frame is started from the event loop */
+  if (mac_txq_len() > 1) {
+    evproc_putEvent(E_EVPROC_HEAD, NETSTK_MAC_EVENT, NULL);
+  }
+
+  /* dequeue the frame and signal the upper layer */
+  mac_txq_done(err);
+}
+
+
+/**
+ * @brief   Backoff and ACK-wait timer callback
+ *
+ * @param   p_arg   Not used
+ */
+static void mac_tmrCb(void *p_arg)
+{
+  /* timers expire in interrupt context, the transmission goes on from the
+   * event loop */
+  evproc_putEvent(E_EVPROC_HEAD, NETSTK_MAC_EVENT, p_arg);
+}
+
+
+/**
+ * @brief   MAC event handler, drives the transmission state machine
+ */
+static void mac_eventHandler(c_event_t c_event, p_data_t p_data)
+{
+  if (c_event != NETSTK_MAC_EVENT) {
+    return;
+  }
+
+  /* events of timers that have been restarted meanwhile are ignored */
+  switch (mac_txState) {
+    case E_MAC_TX_STATE_IDLE:
+      mac_txStart();
+      break;
+
+    case E_MAC_TX_STATE_BACKOFF:
+      if (rt_tmr_getState(&mac_tmrBackoff) != E_RT_TMR_STATE_RUNNING) {
+        bsp_delay_us(mac_txBackoffUs);
+        mac_txCca();
+      }
+      break;
+
+#if (NETSTK_CFG_MAC_SW_AUTOACK_EN == TRUE)
+    case E_MAC_TX_STATE_WFA:
+      if (rt_tmr_getState(&mac_tmrWfa) != E_RT_TMR_STATE_RUNNING) {
+        mac_txWfaTimeout();
+      }
+      break;
+#endif
+
+    default:
+      break;
+  }
+}
+
+
 /*
 ********************************************************************************
 *                               END OF FILE
@@ -61,6 +61,7 @@
 #include "mac_ule.h"
 #include "framer_802154.h"
 #include "framer_smartmac.h"
+#include "mac_phase.h"
 
 
 /*
@@ -138,8 +139,7 @@ static void mac_ule_txStrobe(uint8_t counter, e_nsErr_t *p_err);
 static void mac_ule_txStrobeAck(uint8_t counter, uint16_t dest_addr, e_nsErr_t *p_err);
 
 #if (MAC_ULE_CFG_LOOSE_SYNC_EN == TRUE)
-static void mac_ule_updatePowerOnTable(void);
-static void mac_ule_calcStrobeDelay(e_nsErr_t *p_err);
+static uint8_t mac_ule_calcStrobeDelay(const linkaddr_t *p_dstaddr, e_nsErr_t *p_err);
 static void mac_ule_calcDataDelay(uint8_t counter, e_nsErr_t *p_err);
 #endif
 
@@ -186,10 +186,6 @@ netstk_devid_t      NetstkSrcId;
 netstk_devid_t      NetstkDstId;
 
 
-#if MAC_ULE_CFG_LOOSE_SYNC_EN
-s_nsMacUlePwrOnTblEntry_t mac_ule_pwrOnTable[MAC_ULE_CFG_PWRON_TBL_SIZE];
-#endif
-
 const s_nsMAC_t mac_driver_ule =
 {
    "MAC IEEE802.15.4 Ultra-Low Energy",
@@ -267,6 +263,11 @@ static void mac_ule_init (void *p_netstk, e_nsErr_t *p_err)
   rt_tmr_create(&mac_ule_tmr1WFSA, E_RT_TMR_TYPE_ONE_SHOT, MAC_ULE_PORT_STROBE_TX_GAP_TIME_IN_MS, 0, NULL);
   rt_tmr_create(&mac_ule_tmr1WFA, E_RT_TMR_TYPE_ONE_SHOT, MAC_ULE_PORT_WFA_TIMEOUT_IN_MS, 0, NULL);
 
+#if (MAC_ULE_CFG_LOOSE_SYNC_EN == TRUE)
+  /* learn wake-up phases of the destination nodes */
+  mac_phase_init(MAC_ULE_CFG_POWERUP_INTERVAL_IN_MS);
+#endif
+
 
 #if (MAC_ULE_CFG_STAT_EN == TRUE)
   /* initialize local statistical variables */
@@ -761,6 +762,9 @@ static void mac_ule_txBroadcast(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 static void mac_ule_txUnicast(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 {
   uint8_t counter;
+  uint8_t strobes;
+  uint8_t isPredicted;
+  uint8_t isStrobeAcked;
   frame_smartmac_st frame;
   const linkaddr_t *p_dstaddr;
 
@@ -772,8 +776,9 @@ static void mac_ule_txUnicast(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
     return;
   }
 
+  isPredicted = FALSE;
 #if (MAC_ULE_CFG_LOOSE_SYNC_EN == TRUE)
-  mac_ule_calcStrobeDelay(p_err);
+  isPredicted = mac_ule_calcStrobeDelay(p_dstaddr, p_err);
 #endif
 
   /* perform CSMA */
@@ -782,9 +787,12 @@ static void mac_ule_txUnicast(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
 
     /* reset counter to default maximum value */
     counter = MAC_ULE_CFG_STROBE_TX_MAX;
+    strobes = 0;
+    isStrobeAcked = FALSE;
 
     /* transmit strobe frame until either counter reaches 0 or a valid strobe ACK is received */
     while (counter--) {
+      strobes++;
       mac_ule_txStrobe(counter, p_err);
       if (*p_err == NETSTK_ERR_NONE) {
         /* wait for strobe ACK */
@@ -797,14 +805,14 @@ static void mac_ule_txUnicast(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
               (frame.counter == counter) &&
               (frame.src_addr == NetstkDstId) &&
               (frame.dest_addr == NetstkSrcId)) {
-            /* transmit the actual data packet */
-            mac_ule_txPayload(p_data, len, p_err);
-
+            isStrobeAcked = TRUE;
             #if (MAC_ULE_CFG_LOOSE_SYNC_EN == TRUE)
             /* record power-on schedule of destination node */
-            mac_ule_updatePowerOnTable();
+            mac_phase_update(p_dstaddr, rt_tmr_getCurrenTick());
             #endif
 
+            /* transmit the actual data packet */
+            mac_ule_txPayload(p_data, len, p_err);
             break;
           }
         } else {
@@ -817,10 +825,15 @@ static void mac_ule_txUnicast(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
       }
     }
 
-#if (MAC_ULE_CFG_STAT_EN == TRUE)
-    uint8_t attempts;
-    attempts = MAC_ULE_CFG_STROBE_TX_MAX - counter;
+#if (MAC_ULE_CFG_LOOSE_SYNC_EN == TRUE)
+    /* was the destination node not found awake? */
+    if (isStrobeAcked == FALSE) {
+      mac_phase_miss(p_dstaddr);
+    }
+    mac_phase_txDone(strobes, isPredicted, *p_err);
+#endif
 
+#if (MAC_ULE_CFG_STAT_EN == TRUE)
     /* update local statistical variables */
     mac_ule_nUnicastTx++;
     if (*p_err == NETSTK_ERR_NONE) {
@@ -828,7 +841,7 @@ static void mac_ule_txUnicast(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
     } else {
       /* output statistics */
       TRACE_LOG_MAIN("MAC_TX_Unicast: %5lu / %5lu / -%5d\n", mac_ule_nUnicastTxOk, mac_ule_nUnicastTx, *p_err);
-      TRACE_LOG_MAIN("MAC_TX_Unicast: attempts = %d", attempts);
+      TRACE_LOG_MAIN("MAC_TX_Unicast: attempts = %d", strobes);
     }
 #endif
   }
@@ -978,92 +991,39 @@ static void mac_ule_rxBufTimeout(s_rt_tmr_t *p_tmr, e_nsErr_t *p_err)
 
 
 #if (MAC_ULE_CFG_LOOSE_SYNC_EN == TRUE)
-static void mac_ule_updatePowerOnTable(void)
-{
-  uint8_t ix;
-
-  for (ix = 0; ix < MAC_ULE_CFG_PWRON_TBL_SIZE ; ix++) {
-    if (mac_ule_pwrOnTable[ix].DestId == NetstkDstId) {
-      mac_ule_pwrOnTable[ix].LastWakeup = rt_tmr_getCurrenTick();
-      break;
-    }
-  }
-}
-
-
-static void mac_ule_calcStrobeDelay(e_nsErr_t *p_err)
+/**
+ * @brief   Sleep until the destination node is about to wake up
+ * @param   p_dstaddr   link-layer address of the destination node
+ * @param   p_err       point to variable holding returned error code
+ * @return  TRUE if the strobe train starts at a predicted wake-up
+ */
+static uint8_t mac_ule_calcStrobeDelay(const linkaddr_t *p_dstaddr, e_nsErr_t *p_err)
 {
-  uint8_t on_qty;
-  uint8_t ix;
-  uint32_t on_next;
-  uint32_t tx_delay;
-  uint32_t tx_advance;
-  uint32_t min_delay;
-  uint32_t last_seen;
-  rt_tmr_tick_t curr_time;
+  rt_tmr_tick_t tx_delay;
+  rt_tmr_tick_t tx_advance;
+  rt_tmr_tick_t min_delay;
 
   /*
-   * look for records with regard to the destination node
+   * Note(s):
+   *
+   * (1)  Minimum possible delay shall be calculated as following:
+   *      min_delay = T_off_to_on + T_on_to_off + T_scan + T_tx_smartpreamble
    */
-  tx_delay = 0;
-  last_seen = 0;
-  for (ix = 0; ix < MAC_ULE_CFG_PWRON_TBL_SIZE ; ix++) {
-    if (mac_ule_pwrOnTable[ix].DestId == NetstkDstId) {
-      last_seen = mac_ule_pwrOnTable[ix].LastWakeup;
-      break;
-    }
+  tx_advance = MAC_ULE_CFG_QTY_STROBE_SENT_IN_ADVANCE * MAC_ULE_PORT_STROBE_TX_INTERVAL_IN_MS;
+  min_delay = MAC_ULE_PORT_OFF_TO_ON_TIME_IN_MS +
+              MAC_ULE_PORT_ON_TO_OFF_TIME_IN_MS +
+              MAC_ULE_PORT_SCAN_DURATION_IN_MS;
+
+  /* unknown or stale phases return no delay, the full strobe train is sent */
+  tx_delay = mac_phase_wait(p_dstaddr, tx_advance + min_delay);
+  if (tx_delay == 0) {
+    return FALSE;
   }
 
-  if (last_seen == 0) {
-    /* the record has not found then allocate an entry for the destination node */
-    for (ix = 0; ix < MAC_ULE_CFG_PWRON_TBL_SIZE ; ix++) {
-      if (mac_ule_pwrOnTable[ix].LastWakeup == 0) {
-        mac_ule_pwrOnTable[ix].DestId = NetstkDstId;
-        break;
-      }
-    }
-  } else {
-    /*
-     * Perform prediction on next waking-up interval of the intended receiver
-     */
-    ix = 0;
-    curr_time = rt_tmr_getCurrenTick();
-    while (tx_delay == 0) {
-      /* go to next power-on schedule */
-      ix++;
-
-      /* estimation */
-      on_qty = (curr_time - last_seen) / MAC_ULE_CFG_POWERUP_INTERVAL_IN_MS;       /* Number of power-on interval in between   */
-      on_next = last_seen + (on_qty + ix) * MAC_ULE_CFG_POWERUP_INTERVAL_IN_MS;  /* Predicted next power-on time interval    */
-      tx_delay = (on_next - curr_time);
-
-      /*
-       * Note(s):
-       *
-       * (1)  Minimum possible delay shall be calculated as following:
-       *      min_delay = T_off_to_on + T_on_to_off + T_scan + T_tx_smartpreamble
-       */
-      tx_advance = MAC_ULE_CFG_QTY_STROBE_SENT_IN_ADVANCE * MAC_ULE_PORT_STROBE_TX_INTERVAL_IN_MS;
-      min_delay = MAC_ULE_PORT_OFF_TO_ON_TIME_IN_MS +
-                  MAC_ULE_PORT_ON_TO_OFF_TIME_IN_MS +
-                  MAC_ULE_PORT_SCAN_DURATION_IN_MS;
-
-      if (tx_delay > min_delay) {
-        tx_delay -= min_delay;
-        if (tx_delay > tx_advance) {
-          tx_delay -= tx_advance;
-        }
-      } else {
-        tx_delay = 0;
-      }
-    }
-
-    if (tx_delay > 0) {
-      mac_ule_off(p_err);
-      rt_tmr_delay(tx_delay);
-      mac_ule_on(p_err);
-    }
-  }
+  mac_ule_off(p_err);
+  rt_tmr_delay(tx_delay);
+  mac_ule_on(p_err);
+  return TRUE;
 }
 
 
@@ -0,0 +1,285 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*============================================================================*/
+/*============================================================================*/
+
+/**
+ * @file    mac_phase.c
+ * @brief   Wake-up phase learning for strobe based low-power MACs
+ */
+
+/*
+********************************************************************************
+*                                   INCLUDES
+********************************************************************************
+*/
+#include "emb6.h"
+
+#include "mac_phase.h"
+#include "nbr-table.h"
+#include "rt_tmr.h"
+#include "logger.h"
+
+
+/*
+********************************************************************************
+*                               LOCAL TYPEDEF
+********************************************************************************
+*/
+
+/** Wake-up schedule of a neighbour */
+struct mac_phase {
+  rt_tmr_tick_t anchor;     /* first wake-up seen on the current schedule */
+  rt_tmr_tick_t time;       /* last wake-up seen */
+  int32_t       drift;      /* drift of the neighbour clock in ppm */
+  uint8_t       misses;     /* strobe trains without ACK since then */
+};
+
+
+/*
+********************************************************************************
+*                               LOCAL VARIABLES
+********************************************************************************
+*/
+NBR_TABLE(struct mac_phase, mac_phase);
+
+/* wake-up interval of the neighbours */
+static rt_tmr_tick_t    mac_phase_period;
+
+
+/*
+********************************************************************************
+*                               GLOBAL VARIABLES
+********************************************************************************
+*/
+struct mac_phase_stats  mac_phase_stats;
+
+
+/*
+********************************************************************************
+*                           LOCAL FUNCTION DEFINITIONS
+********************************************************************************
+*/
+
+/**
+ * @brief   Predict a wake-up of a neighbour
+ *
+ * @param   p_phase     Wake-up schedule of the neighbour
+ * @param   periods     Wake-up intervals after the last one seen
+ * @return  Time of the wake-up
+ */
+static rt_tmr_tick_t mac_phase_predict(const struct mac_phase *p_phase, uint32_t periods)
+{
+  uint32_t span;
+
+  span = periods * mac_phase_period;
+  return p_phase->time + span + ((int32_t)span * p_phase->drift) / 1000000;
+}
+
+
+/*
+********************************************************************************
+*                           GLOBAL FUNCTION DEFINITIONS
+********************************************************************************
+*/
+
+/**
+ * @brief   Initialize phase learning
+ *
+ * @param   period  Wake-up interval of the neighbours in ticks, 0 if they do
+ *                  not duty-cycle
+ */
+void mac_phase_init(rt_tmr_tick_t period)
+{
+  mac_phase_period = period;
+  memset(&mac_phase_stats, 0, sizeof(mac_phase_stats));
+  nbr_table_register(mac_phase, NULL);
+}
+
+
+/**
+ * @brief   Record that a neighbour was awake, i.e. it has acknowledged a
+ *          strobe
+ *
+ *          The drift is only measured once the schedule has been followed
+ *          for NETSTK_CFG_MAC_PHASE_MAX_AGE. As such the error of the
+ *          measurement, which comes from the time a strobe takes, never
+ *          grows beyond one strobe over a prediction.
+ *
+ * @param   p_addr  Link-layer address of the neighbour
+ * @param   time    Tick at which the neighbour was awake
+ */
+void mac_phase_update(const linkaddr_t *p_addr, rt_tmr_tick_t time)
+{
+  struct mac_phase *p_phase;
+  uint32_t elapsed;
+  uint32_t periods;
+  int32_t offset;
+
+  if (mac_phase_period == 0) {
+    return;
+  }
+
+  p_phase = nbr_table_get_from_lladdr(mac_phase, p_addr);
+  if (p_phase == NULL) {
+    p_phase = nbr_table_add_lladdr(mac_phase, p_addr);
+    if (p_phase == NULL) {
+      return;
+    }
+    p_phase->anchor = time;
+    p_phase->time = time;
+    return;
+  }
+
+  /* does the wake-up fit the schedule learnt so far? */
+  elapsed = time - p_phase->time;
+  periods = (elapsed + mac_phase_period / 2) / mac_phase_period;
+  offset = (int32_t)(time - mac_phase_predict(p_phase, periods));
+  if ((elapsed > NETSTK_CFG_MAC_PHASE_MAX_AGE) ||
+      (offset > (int32_t)(mac_phase_period / 4)) ||
+      (offset < -(int32_t)(mac_phase_period / 4))) {
+    /* no, the neighbour has restarted or drifted away, start over */
+    p_phase->anchor = time;
+    p_phase->drift = 0;
+  }
+  else {
+    /* yes, then measure the drift over the whole schedule */
+    elapsed = time - p_phase->anchor;
+    if (elapsed >= NETSTK_CFG_MAC_PHASE_MAX_AGE) {
+      periods = (elapsed + mac_phase_period / 2) / mac_phase_period;
+      offset = (int32_t)(elapsed - periods * mac_phase_period);
+      p_phase->drift = (offset * 1000) / (int32_t)(elapsed / 1000);
+      if (p_phase->drift > NETSTK_CFG_MAC_PHASE_DRIFT_MAX_PPM) {
+        p_phase->drift = NETSTK_CFG_MAC_PHASE_DRIFT_MAX_PPM;
+      }
+      else if (p_phase->drift < -NETSTK_CFG_MAC_PHASE_DRIFT_MAX_PPM) {
+        p_phase->drift = -NETSTK_CFG_MAC_PHASE_DRIFT_MAX_PPM;
+      }
+    }
+  }
+  p_phase->time = time;
+  p_phase->misses = 0;
+}
+
+
+/**
+ * @brief   Compute how long to wait before strobing a neighbour
+ *
+ * @param   p_addr  Link-layer address of the neighbour
+ * @param   guard   Ticks strobing shall start before the expected wake-up
+ * @return  Ticks to wait, 0 if strobing shall start right away and cover a
+ *          whole wake-up interval
+ */
+rt_tmr_tick_t mac_phase_wait(const linkaddr_t *p_addr, rt_tmr_tick_t guard)
+{
+  struct mac_phase *p_phase;
+  rt_tmr_tick_t now;
+  rt_tmr_tick_t expected;
+  uint32_t elapsed;
+  uint32_t periods;
+
+  if (mac_phase_period == 0) {
+    return 0;
+  }
+
+  /* is the phase of the neighbour known and trustworthy? */
+  p_phase = nbr_table_get_from_lladdr(mac_phase, p_addr);
+  if ((p_phase == NULL) || (p_phase->misses >= NETSTK_CFG_MAC_PHASE_MAX_MISSES)) {
+    return 0;
+  }
+
+  now = rt_tmr_getCurrenTick();
+  elapsed = now - p_phase->time;
+  if (elapsed > NETSTK_CFG_MAC_PHASE_MAX_AGE) {
+    return 0;
+  }
+
+  /* the remaining clock error widens the guard time */
+  guard += (elapsed / 1000) * NETSTK_CFG_MAC_PHASE_CLOCK_PPM / 1000;
+
+  /* first wake-up that leaves enough time to start strobing */
+  periods = elapsed / mac_phase_period;
+  do {
+    periods++;
+    expected = mac_phase_predict(p_phase, periods);
+  } while ((int32_t)(expected - now) < (int32_t)guard);
+
+  return expected - now - guard;
+}
+
+
+/**
+ * @brief   Record that a strobe train to a neighbour has not been
+ *          acknowledged
+ *
+ * @param   p_addr  Link-layer address of the neighbour
+ */
+void mac_phase_miss(const linkaddr_t *p_addr)
+{
+  struct mac_phase *p_phase;
+
+  p_phase = nbr_table_get_from_lladdr(mac_phase, p_addr);
+  if ((p_phase != NULL) && (p_phase->misses < NETSTK_CFG_MAC_PHASE_MAX_MISSES)) {
+    p_phase->misses++;
+  }
+}
+
+
+/**
+ * @brief   Account the strobes of a unicast transmission
+ *
+ * @param   strobes     Strobes sent
+ * @param   isPredicted Was strobing started at a predicted wake-up?
+ * @param   err         Result of the transmission
+ */
+void mac_phase_txDone(uint8_t strobes, uint8_t isPredicted, e_nsErr_t err)
+{
+  if (err != NETSTK_ERR_NONE) {
+    return;
+  }
+
+  mac_phase_stats.frames++;
+  mac_phase_stats.strobes += strobes;
+  if (isPredicted == TRUE) {
+    mac_phase_stats.predicted++;
+  }
+  TRACE_LOG_MAIN("MAC_PHASE: %lu strobes / %lu frames (%lu predicted)",
+                 mac_phase_stats.strobes, mac_phase_stats.frames, mac_phase_stats.predicted);
+}
@@ -0,0 +1,472 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*============================================================================*/
+/*============================================================================*/
+
+/**
+ * @file    mac_txq.c
+ * @brief   Per-neighbour MAC transmission queues
+ *
+ *          All frames are kept in one FIFO in the order they have been
+ *          handed down. A neighbour entry only counts the frames of its
+ *          receiver and takes part in the round-robin, the frames of a
+ *          neighbour are found by walking the FIFO. With the few frames the
+ *          pool holds, this is cheaper than a list per neighbour.
+ */
+
+/*
+********************************************************************************
+*                                   INCLUDES
+********************************************************************************
+*/
+#include "emb6.h"
+
+#include "mac_txq.h"
+#include "packetbuf.h"
+#include "clist.h"
+#include "memb.h"
+
+#if (NETSTK_CFG_RF_CRC_EN == FALSE)
+#include "crc.h"
+#endif
+
+#define     LOGGER_ENABLE        LOGGER_MAC
+#include    "logger.h"
+
+
+/*
+********************************************************************************
+*                               LOCAL MACROS
+********************************************************************************
+*/
+#define MAC_TXQ_FCF_SECURITY_ENABLED            (uint8_t )( 0x08u )
+#define MAC_TXQ_FCF_FRAME_PENDING               (uint8_t )( 0x10u )
+
+#if (NETSTK_CFG_MAC_TXQ_FRAME_NUM < NETSTK_CFG_MAC_TXQ_DEPTH)
+#error "NETSTK_CFG_MAC_TXQ_FRAME_NUM is smaller than NETSTK_CFG_MAC_TXQ_DEPTH"
+#endif
+
+#if (NETSTK_CFG_MAC_TXQ_BURST_MAX > NETSTK_CFG_MAC_TXQ_DEPTH)
+#error "NETSTK_CFG_MAC_TXQ_BURST_MAX is larger than NETSTK_CFG_MAC_TXQ_DEPTH"
+#endif
+
+
+/*
+********************************************************************************
+*                               LOCAL TYPEDEF
+********************************************************************************
+*/
+
+/** Receiver with queued frames */
+struct mac_txq_nbr {
+  struct mac_txq_nbr *next;
+  linkaddr_t          addr;         /* receiver, linkaddr_null for broadcast */
+  uint8_t             len;          /* frames queued for the receiver */
+};
+
+
+/*
+********************************************************************************
+*                               LOCAL VARIABLES
+********************************************************************************
+*/
+/* all queued frames, oldest first */
+LIST(mac_txq_fifo);
+/* neighbours with queued frames, the head one owns the channel */
+LIST(mac_txq_nbrList);
+MEMB(mac_txq_nbrMem, struct mac_txq_nbr, NETSTK_CFG_MAC_TXQ_NBR_NUM);
+MEMB(mac_txq_frameMem, struct mac_txq_frame, NETSTK_CFG_MAC_TXQ_FRAME_NUM);
+
+/* frames acknowledged so far in the burst to the head neighbour */
+static uint8_t          mac_txq_burst;
+/* does the frame being transmitted carry the frame pending bit? */
+static uint8_t          mac_txq_isPending;
+
+
+/*
+********************************************************************************
+*                           LOCAL FUNCTION DEFINITIONS
+********************************************************************************
+*/
+
+/**
+ * @brief   Look up the queue of a receiver
+ *
+ * @param   p_addr  Link-layer address of the receiver
+ * @return  Queue of the receiver, NULL if it has no frames queued
+ */
+static struct mac_txq_nbr *mac_txq_nbrFind(const linkaddr_t *p_addr)
+{
+  struct mac_txq_nbr *p_nbr;
+
+  for (p_nbr = list_head(mac_txq_nbrList); p_nbr != NULL; p_nbr = list_item_next(p_nbr)) {
+    if (linkaddr_cmp(&p_nbr->addr, p_addr)) {
+      return p_nbr;
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * @brief   Look up the queue of a receiver, create it if there is none
+ *
+ * @param   p_addr  Link-layer address of the receiver
+ * @return  Queue of the receiver, NULL if no entry is left
+ */
+static struct mac_txq_nbr *mac_txq_nbrGet(const linkaddr_t *p_addr)
+{
+  struct mac_txq_nbr *p_nbr;
+
+  p_nbr = mac_txq_nbrFind(p_addr);
+  if (p_nbr != NULL) {
+    return p_nbr;
+  }
+
+  p_nbr = memb_alloc(&mac_txq_nbrMem);
+  if (p_nbr != NULL) {
+    linkaddr_copy(&p_nbr->addr, p_addr);
+    p_nbr->len = 0;
+    list_add(mac_txq_nbrList, p_nbr);
+  }
+  return p_nbr;
+}
+
+
+/**
+ * @brief   Get the next frame of a receiver
+ *
+ * @param   p_frame     Frame to start after, NULL to start at the oldest one
+ * @param   p_nbr       Receiver
+ * @return  Oldest frame of the receiver queued after p_frame, NULL if there
+ *          is none
+ */
+static struct mac_txq_frame *mac_txq_nbrNext(struct mac_txq_frame *p_frame, struct mac_txq_nbr *p_nbr)
+{
+  p_frame = (p_frame == NULL) ? list_head(mac_txq_fifo) : list_item_next(p_frame);
+  while ((p_frame != NULL) && (p_frame->p_nbr != p_nbr)) {
+    p_frame = list_item_next(p_frame);
+  }
+  return p_frame;
+}
+
+
+#if (NETSTK_CFG_RF_CRC_EN == FALSE)
+/**
+ * @brief   Recompute the software FCS of the frame in the packet buffer
+ *          after its header has been modified
+ */
+static void mac_txq_updateFcs(void)
+{
+  uint8_t *p_mhr;
+  uint8_t *p_mfr;
+  uint16_t checksum_data_len;
+  uint32_t fcs;
+  packetbuf_attr_t fcs_len;
+
+  fcs_len = packetbuf_attr(PACKETBUF_ATTR_MAC_FCS_LEN);
+  p_mhr = (uint8_t *)packetbuf_hdrptr();
+  checksum_data_len = packetbuf_totlen() - fcs_len;
+  p_mfr = p_mhr + checksum_data_len;
+
+  if (fcs_len == 4) {
+    /* 32-bit CRC */
+    fcs = crc_32_calc(p_mhr, checksum_data_len);
+    p_mfr[0] = (fcs & 0xFF000000u) >> 24;
+    p_mfr[1] = (fcs & 0x00FF0000u) >> 16;
+    p_mfr[2] = (fcs & 0x0000FF00u) >> 8;
+    p_mfr[3] = (fcs & 0x000000FFu);
+  } else {
+    /* 16-bit CRC */
+    fcs = crc_16_calc(p_mhr, checksum_data_len);
+    p_mfr[0] = (fcs & 0xFF00u) >> 8;
+    p_mfr[1] = (fcs & 0x00FFu);
+  }
+}
+#endif /* NETSTK_CFG_RF_CRC_EN */
+
+
+/*
+********************************************************************************
+*                           GLOBAL FUNCTION DEFINITIONS
+********************************************************************************
+*/
+
+/**
+ * @brief   Initialize the transmission queues
+ */
+void mac_txq_init(void)
+{
+  list_init(mac_txq_fifo);
+  list_init(mac_txq_nbrList);
+  memb_init(&mac_txq_nbrMem);
+  memb_init(&mac_txq_frameMem);
+  mac_txq_burst = 0;
+  mac_txq_isPending = FALSE;
+}
+
+
+/**
+ * @brief   Queue the frame in the packet buffer behind all queued frames
+ *
+ * @param   cbTxFnct    TX callback of the frame
+ * @param   p_cbTxArg   Argument of the TX callback
+ * @param   p_err       Pointer to a variable storing returned error code,
+ *                      NETSTK_ERR_BUSY if the frame could not be queued
+ * @return  Queued frame, NULL on error
+ */
+struct mac_txq_frame *mac_txq_put(nsTxCbFnct_t cbTxFnct, void *p_cbTxArg, e_nsErr_t *p_err)
+{
+  struct mac_txq_nbr *p_nbr;
+  struct mac_txq_frame *p_frame;
+
+  p_nbr = mac_txq_nbrGet(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  if (p_nbr == NULL) {
+    TRACE_LOG_ERR("MAC_TXQ: no queue left");
+    *p_err = NETSTK_ERR_BUSY;
+    return NULL;
+  }
+
+  p_frame = NULL;
+  if (p_nbr->len < NETSTK_CFG_MAC_TXQ_DEPTH) {
+    p_frame = memb_alloc(&mac_txq_frameMem);
+  }
+
+  if (p_frame == NULL) {
+    TRACE_LOG_ERR("MAC_TXQ: queue full");
+    /* do not keep a queue that has just been created for nothing */
+    if (p_nbr->len == 0) {
+      list_remove(mac_txq_nbrList, p_nbr);
+      memb_free(&mac_txq_nbrMem, p_nbr);
+    }
+    *p_err = NETSTK_ERR_BUSY;
+    return NULL;
+  }
+
+  p_frame->len = packetbuf_copyto(p_frame->data);
+  packetbuf_attr_copyto(p_frame->attrs, p_frame->addrs);
+  p_frame->cbTxFnct = cbTxFnct;
+  p_frame->p_cbTxArg = p_cbTxArg;
+  p_frame->p_nbr = p_nbr;
+  list_add(mac_txq_fifo, p_frame);
+  p_nbr->len++;
+  *p_err = NETSTK_ERR_NONE;
+  return p_frame;
+}
+
+
+/**
+ * @brief   Get the frame to transmit next
+ *
+ * @return  First frame of the neighbour owning the channel, NULL if all
+ *          queues are empty
+ */
+struct mac_txq_frame *mac_txq_head(void)
+{
+  struct mac_txq_nbr *p_nbr;
+
+  p_nbr = list_head(mac_txq_nbrList);
+  if (p_nbr == NULL) {
+    return NULL;
+  }
+  return mac_txq_nbrNext(NULL, p_nbr);
+}
+
+
+/**
+ * @brief   Get a packet attribute of a queued frame
+ *
+ * @param   p_frame     Queued frame
+ * @param   type        Attribute to get
+ * @return  Value of the attribute
+ */
+packetbuf_attr_t mac_txq_attr(struct mac_txq_frame *p_frame, uint8_t type)
+{
+  return p_frame->attrs[type].val;
+}
+
+
+/**
+ * @brief   Copy a frame returned by mac_txq_head() into the packet buffer
+ *          for transmission
+ *
+ *          The frame pending bit is set if another frame for the same
+ *          receiver is going to follow right after this one. Both frames
+ *          have to request an ACK, so every frame of a burst is confirmed
+ *          by the receiver and the burst ends at the first frame that is
+ *          not.
+ *
+ * @param   p_frame     Frame to transmit
+ * @return  TRUE if the frame pending bit has been set, FALSE otherwise
+ */
+uint8_t mac_txq_load(struct mac_txq_frame *p_frame)
+{
+  struct mac_txq_nbr *p_nbr;
+  struct mac_txq_frame *p_next;
+  uint8_t *p_fcf;
+
+  p_nbr = p_frame->p_nbr;
+  p_next = mac_txq_nbrNext(p_frame, p_nbr);
+  packetbuf_copyfrom(p_frame->data, p_frame->len);
+  packetbuf_attr_copyfrom(p_frame->attrs, p_frame->addrs);
+
+  /* the MIC of a secured frame covers the FCF, it can't be touched anymore */
+  p_fcf = packetbuf_hdrptr();
+  mac_txq_isPending = ((p_fcf[0] & MAC_TXQ_FCF_SECURITY_ENABLED) == 0) &&
+                      (!linkaddr_cmp(&p_nbr->addr, &linkaddr_null)) &&
+                      (packetbuf_attr(PACKETBUF_ATTR_MAC_ACK) == TRUE) &&
+                      (p_next != NULL) &&
+                      (mac_txq_attr(p_next, PACKETBUF_ATTR_MAC_ACK) == TRUE) &&
+                      ((mac_txq_burst + 1) < NETSTK_CFG_MAC_TXQ_BURST_MAX);
+  if (mac_txq_isPending) {
+    p_fcf[0] |= MAC_TXQ_FCF_FRAME_PENDING;
+#if (NETSTK_CFG_RF_CRC_EN == FALSE)
+    mac_txq_updateFcs();
+#endif
+  }
+  return mac_txq_isPending;
+}
+
+
+/**
+ * @brief   Does the frame at the head follow a frame that announced it
+ *          with the frame pending bit?
+ *
+ *          The receiver is then expected to be awake already.
+ *
+ * @return  TRUE if the burst to the head neighbour goes on, FALSE otherwise
+ */
+uint8_t mac_txq_isBurst(void)
+{
+  return (mac_txq_burst > 0);
+}
+
+
+/**
+ * @brief   Remove the frame at the head once its transmission is over and
+ *          signal the upper layer of the result
+ *
+ *          The packet buffer holds the frame and its attributes again when
+ *          the TX callback is invoked.
+ *
+ * @param   err     Result of the transmission
+ */
+void mac_txq_done(e_nsErr_t err)
+{
+  struct mac_txq_nbr *p_nbr;
+  struct mac_txq_frame *p_frame;
+  nsTxCbFnct_t cbTxFnct;
+  void *p_cbTxArg;
+
+  p_frame = mac_txq_head();
+  p_nbr = p_frame->p_nbr;
+  list_remove(mac_txq_fifo, p_frame);
+  cbTxFnct = p_frame->cbTxFnct;
+  p_cbTxArg = p_frame->p_cbTxArg;
+  p_nbr->len--;
+
+  /* has the next frame been announced to the receiver? */
+  if ((err == NETSTK_ERR_NONE) && (mac_txq_isPending == TRUE)) {
+    /* then the neighbour keeps the channel */
+    mac_txq_burst++;
+  } else {
+    /* otherwise it is the turn of the next neighbour */
+    mac_txq_burst = 0;
+    list_remove(mac_txq_nbrList, p_nbr);
+    if (p_nbr->len > 0) {
+      list_add(mac_txq_nbrList, p_nbr);
+    } else {
+      memb_free(&mac_txq_nbrMem, p_nbr);
+    }
+  }
+  mac_txq_isPending = FALSE;
+
+  /* upper layers look up the attributes of the frame, e.g. its receiver */
+  packetbuf_copyfrom(p_frame->data, p_frame->len);
+  packetbuf_attr_copyfrom(p_frame->attrs, p_frame->addrs);
+  memb_free(&mac_txq_frameMem, p_frame);
+
+  /* was transmission callback function set? */
+  if (cbTxFnct) {
+    /* then signal the upper layer of the result of transmission process */
+    cbTxFnct(p_cbTxArg, &err);
+  }
+}
+
+
+/**
+ * @brief   Get the number of queued frames
+ *
+ * @return  Number of frames in all queues
+ */
+uint8_t mac_txq_len(void)
+{
+  return list_length(mac_txq_fifo);
+}
+
+
+/**
+ * @brief   Get the number of frames that can still be queued for a receiver
+ *
+ *          Lets an upper layer find out whether all fragments of a datagram
+ *          are going to fit before it hands down the first one.
+ *
+ * @param   p_addr  Link-layer address of the receiver
+ * @return  Number of frames
+ */
+uint8_t mac_txq_free(const linkaddr_t *p_addr)
+{
+  struct mac_txq_nbr *p_nbr;
+  uint8_t num;
+
+  p_nbr = mac_txq_nbrFind(p_addr);
+  if (p_nbr != NULL) {
+    num = NETSTK_CFG_MAC_TXQ_DEPTH - p_nbr->len;
+  } else if (memb_numfree(&mac_txq_nbrMem) > 0) {
+    num = NETSTK_CFG_MAC_TXQ_DEPTH;
+  } else {
+    num = 0;
+  }
+
+  if (num > memb_numfree(&mac_txq_frameMem)) {
+    num = memb_numfree(&mac_txq_frameMem);
+  }
+  return num;
+}
@@ -21,6 +21,8 @@
 #include "phy_framer_802154.h"
 #include "framer_802154.h"
 #include "framer_smartmac.h"
+#include "mac_txq.h"
+#include "mac_phase.h"
 
 
 /*
@@ -31,6 +33,7 @@
 #define SMARTMAC_CFG_RXPENDING_TIMEOUT_MAX      1u
 #define SMARTMAC_CFG_CHANSCAN_TIMEOUT_MAX       2u
 #define SMARTMAC_CFG_SELF_TEST_EN             FALSE
+#define SMARTMAC_CFG_PHASE_LEARNING_EN        TRUE
 
 
 #if 0
@@ -86,6 +89,8 @@ struct s_smartMAC {
   uint8_t           rxPendingTimeoutCount;
   uint8_t           maxUnicastCounter;
   uint8_t           maxBroadcastCounter;
+  uint8_t           isTxPredicted;
+  packetbuf_attr_t  ackWaitDuration;
 
   s_rt_tmr_t        tmrPowerUp;
   s_rt_tmr_t        tmr1Scan;
@@ -111,8 +116,12 @@ static void mac_txStrobe(struct s_smartMAC *p_ctx, uint8_t counter, uint16_t dst
 static void mac_txBroadcast(struct s_smartMAC *p_ctx, uint8_t *p_data, uint16_t len, e_nsErr_t *p_err);
 static void mac_txUnicast(struct s_smartMAC *p_ctx, uint8_t *p_data, uint16_t len, e_nsErr_t *p_err);
 static void mac_lbt(struct s_smartMAC *p_ctx, e_nsErr_t *p_err);
+#if (SMARTMAC_CFG_PHASE_LEARNING_EN == TRUE)
+static void mac_txPhaseWait(struct s_smartMAC *p_ctx);
+#endif
 
 static void mac_eventHandler(c_event_t c_event, p_data_t p_data);
+static void mac_txEventHandler(c_event_t c_event, p_data_t p_data);
 
 /* unit-test */
 #if (SMARTMAC_CFG_SELF_TEST_EN == TRUE)
@@ -219,6 +228,7 @@ static void smartMAC_init (void *p_netstk, e_nsErr_t *p_err) {
   macAckWaitDuration = macUnitBackoffPeriod + phyTurnaroundTime +
       phySHRDuration + 6 * phySymbolsPerOctet * phySymbolPeriod;
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK_WAIT_DURATION, macAckWaitDuration);
+  p_ctx->ackWaitDuration = macAckWaitDuration;
 
   // FIXME compute smartMAC timing parameters based on settings of underlying layers
   uint8_t strobeLen = 12; /* PHR(1) + FCF(2) + SEQ(1) + PANID(2) + DST.ADDR(2) + SRC.ADDR(2) + CHKSUM(2) */
@@ -233,14 +243,22 @@ static void smartMAC_init (void *p_netstk, e_nsErr_t *p_err) {
   p_ctx->rxDelayMin = 2 * p_ctx->strobeTxInterval;
   p_ctx->maxBroadcastCounter = p_ctx->sleepTimeout / p_ctx->strobeTxInterval + 1;
   p_ctx->maxUnicastCounter = 2 * p_ctx->maxBroadcastCounter;
+  p_ctx->isTxPredicted = FALSE;
+#if (SMARTMAC_CFG_PHASE_LEARNING_EN == TRUE)
+  mac_phase_init(p_ctx->sleepTimeout);
+#endif
 
   /* initialize local attributes */
   rt_tmr_create(&p_ctx->tmrPowerUp, E_RT_TMR_TYPE_PERIODIC, p_ctx->sleepTimeout, mac_tmrSleepCb, p_ctx);
   rt_tmr_create(&p_ctx->tmr1Scan, E_RT_TMR_TYPE_ONE_SHOT, p_ctx->scanTimeout, mac_tmrScanCb, p_ctx);
   rt_tmr_create(&p_ctx->tmr1RxPending, E_RT_TMR_TYPE_ONE_SHOT, p_ctx->rxTimeout, mac_tmrRxPendingCb, p_ctx);
 
-  /* register MAC event */
+  /* initialize transmission queues */
+  mac_txq_init();
+
+  /* register MAC events */
   evproc_regCallback(NETSTK_MAC_ULE_EVENT, mac_eventHandler);
+  evproc_regCallback(NETSTK_MAC_EVENT, mac_txEventHandler);
 
   /* initial transition */
   mac_off_entry(p_ctx);
@@ -268,26 +286,21 @@ static void smartMAC_stop(e_nsErr_t *p_err) {
 
 static void smartMAC_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err) {
   struct s_smartMAC *p_ctx = &smartMAC;
-  int isBroadcastTx;
 
 #if (SMARTMAC_CFG_CONTINUOUS_RX_EN == TRUE)
   *p_err = NETSTK_ERR_BUSY;
   return;
 #endif
 
-  /* is MAC performing channel scan? */
-  if (p_ctx->state == E_SMARTMAC_STATE_SCAN) {
-    /* then terminate the channel scan and start TX process */
-    mac_scan_exit(p_ctx);
-  }
-  else if (p_ctx->state == E_SMARTMAC_STATE_OFF) {
-    /* state transition: OFF -> ON */
-    mac_off_exit(p_ctx);
-    mac_on_entry(p_ctx);
+  /* the frame is not expected anywhere else than in the packet buffer */
+  if ((p_data != packetbuf_hdrptr()) || (len != packetbuf_totlen())) {
+    *p_err = NETSTK_ERR_INVALID_ARGUMENT;
+    return;
   }
-  else {
-    /* MAC is busy performing other tasks which cannot be overtaken */
-    *p_err = NETSTK_ERR_BUSY;
+
+  /* store the frame in the queue of its receiver */
+  if (mac_txq_put(p_ctx->cbTxFnct, p_ctx->p_cbTxArg, p_err) == NULL) {
+    /* queue is full, the upper layer has to try again later */
     TRACE_LOG_ERR("smartMAC busy, %02x", p_ctx->state);
 
     /* was transmission callback function set? */
@@ -298,66 +311,9 @@ static void smartMAC_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err) {
     return;
   }
 
-  /* handle transmission */
-  isBroadcastTx = packetbuf_holds_broadcast();
-
-#if (SMARTMAC_CFG_CONTINUOUS_TX_BROADCAST_EN == TRUE)
-  isBroadcastTx = TRUE;
-#elif (SMARTMAC_CFG_CONTINUOUS_TX_UNICAST_EN == TRUE)
-  linkaddr_t dstAddr;
-
-  /* unicast, ACK required, destination address 0x1120 */
-  isBroadcastTx = FALSE;
-  packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, TRUE);
-  memset(&dstAddr, 0, sizeof(dstAddr));
-  dstAddr.u8[7] = 0x21;
-  dstAddr.u8[6] = 0x11;
-  linkaddr_copy((linkaddr_t *)packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &dstAddr);
-#else
-
-#endif
-
-#if ((SMARTMAC_CFG_CONTINUOUS_TX_BROADCAST_EN == TRUE) || (SMARTMAC_CFG_CONTINUOUS_TX_UNICAST_EN == TRUE))
-  uint32_t txDelayMilli = 100;
-
-  for (;;) {
-    txDelayMilli += 100;
-    if (txDelayMilli > 2000) {
-      txDelayMilli = 100;
-    }
-    bsp_delay_us(txDelayMilli * 1000);
-
-    if (isBroadcastTx == TRUE) {
-      mac_txBroadcast(p_ctx, p_data, len, p_err);
-    } else {
-      mac_txUnicast(p_ctx, p_data, len, p_err);
-    }
-  }
-#endif
-
-  /* Listen Before Talk */
-  mac_lbt(p_ctx, p_err);
-  if (*p_err == NETSTK_ERR_NONE) {
-    if (isBroadcastTx) {
-      mac_txBroadcast(p_ctx, p_data, len, p_err);
-    }
-    else {
-      mac_txUnicast(p_ctx, p_data, len, p_err);
-    }
-
-    /* state transition: ON -> OFF */
-    mac_on_exit(p_ctx);
-    mac_off_entry(p_ctx);
-  }
-  else {
-    mac_scan_entry(p_ctx);
-  }
-
-  /* was transmission callback function set? */
-  if (p_ctx->cbTxFnct) {
-    /* then signal the upper layer of the result of transmission process */
-    p_ctx->cbTxFnct(p_ctx->p_cbTxArg, p_err);
-  }
+  /* transmission is started from the event loop. As such the upper layer
+   * queues all fragments of a packet first, and they are sent in one burst */
+  evproc_putEvent(E_EVPROC_TAIL, NETSTK_MAC_EVENT, p_ctx);
 }
 
 
@@ -417,16 +373,28 @@ static void smartMAC_recv(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err) {
     }
     else {
       /* otherwise the received frame is not a strobe, then simply forwards to
-       * upper layer before going back to OFF state */
+       * upper layer before going back to OFF state, unless the sender has
+       * announced another frame */
       mac_scan_exit(p_ctx);
-      mac_off_entry(p_ctx);
+      if (frame.pending == TRUE) {
+        mac_rxPending_entry(p_ctx);
+      }
+      else {
+        mac_off_entry(p_ctx);
+      }
       p_ctx->p_netstk->dllc->recv(p_data, len, p_err);
     }
   }
   else if (p_ctx->state == E_SMARTMAC_STATE_RX_PENDING) {
-    /* a frame has arrived, then go to Off state */
+    /* a frame has arrived, then go to Off state unless the frame pending
+     * bit tells that another data frame follows */
     mac_rxPending_exit(p_ctx);
-    mac_off_entry(p_ctx);
+    if ((frame.type != SMARTMAC_FRAME_STROBE) && (frame.pending == TRUE)) {
+      mac_rxPending_entry(p_ctx);
+    }
+    else {
+      mac_off_entry(p_ctx);
+    }
     if (frame.type != SMARTMAC_FRAME_STROBE) {
       p_ctx->p_netstk->dllc->recv(p_data, len, p_err);
     }
@@ -465,6 +433,10 @@ static void smartMAC_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err) {
       p_ctx->p_cbTxArg = p_val;
       break;
 
+    case NETSTK_CMD_MAC_TXQ_FREE_GET:
+      *((uint8_t *)p_val) = mac_txq_free(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+      break;
+
     default:
       p_ctx->p_netstk->phy->ioctrl(cmd, p_val, p_err);
       break;
@@ -555,6 +527,7 @@ static void mac_txBroadcast(struct s_smartMAC *p_ctx, uint8_t *p_data, uint16_t
 
 static void mac_txUnicast(struct s_smartMAC *p_ctx, uint8_t *p_data, uint16_t len, e_nsErr_t *p_err) {
   uint8_t isTxDone;
+  uint8_t isStrobeAcked;
   uint8_t counter;
   uint8_t dataSeqNo;
   uint8_t dataAckReq;
@@ -567,6 +540,7 @@ static void mac_txUnicast(struct s_smartMAC *p_ctx, uint8_t *p_data, uint16_t le
   /* transmit broadcast strobes */
   counter = p_ctx->maxUnicastCounter;
   isTxDone = FALSE;
+  isStrobeAcked = FALSE;
 
   /* store sequence number of the actual data packet to send */
   dataSeqNo = packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
@@ -591,6 +565,11 @@ static void mac_txUnicast(struct s_smartMAC *p_ctx, uint8_t *p_data, uint16_t le
         /* the strobe was acknowledged. The MAC then commence transmission of
          * the actual data frame before declaring completion of transmission
          * process */
+        isStrobeAcked = TRUE;
+#if (SMARTMAC_CFG_PHASE_LEARNING_EN == TRUE)
+        /* the receiver is awake, remember when */
+        mac_phase_update(&dstAddr, rt_tmr_getCurrenTick());
+#endif
 
         /* restore data sequence number and acknowledgment requirement fields */
         packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, dataSeqNo);
@@ -635,17 +614,164 @@ static void mac_txUnicast(struct s_smartMAC *p_ctx, uint8_t *p_data, uint16_t le
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, dataSeqNo);
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, dataAckReq);
 
+#if (SMARTMAC_CFG_PHASE_LEARNING_EN == TRUE)
+  /* was the receiver not found awake? */
+  if (isStrobeAcked == FALSE) {
+    mac_phase_miss(&dstAddr);
+  }
+  mac_phase_txDone(p_ctx->maxUnicastCounter - counter, p_ctx->isTxPredicted, *p_err);
+#endif
+  p_ctx->isTxPredicted = FALSE;
+
   /* transition to OFF state */
   mac_txUnicast_exit(p_ctx);
 }
 
 
+/* Transmit the queued frames of the neighbour whose turn it is. The first
+ * frame is announced by strobes, the following frames of a burst are sent
+ * right away as the frame pending bit has kept the receiver awake */
+static void mac_txEventHandler(c_event_t c_event, p_data_t p_data) {
+  struct s_smartMAC *p_ctx = &smartMAC;
+  struct mac_txq_frame *p_frame;
+  uint8_t isBurst;
+  uint8_t isLbtFailed;
+  int isBroadcastTx;
+  e_nsErr_t err;
+
+  /* is MAC busy receiving? */
+  if ((p_ctx->state != E_SMARTMAC_STATE_SCAN) &&
+      (p_ctx->state != E_SMARTMAC_STATE_OFF)) {
+    /* then the queue is served again once MAC is back to OFF state */
+    return;
+  }
+
+  p_frame = mac_txq_head();
+  if (p_frame == NULL) {
+    return;
+  }
+
+  /* is MAC performing channel scan? */
+  if (p_ctx->state == E_SMARTMAC_STATE_SCAN) {
+    /* then terminate the channel scan and start TX process */
+    mac_scan_exit(p_ctx);
+  }
+  else {
+    /* state transition: OFF -> ON */
+    mac_off_exit(p_ctx);
+    mac_on_entry(p_ctx);
+  }
+
+  isLbtFailed = FALSE;
+  while (p_frame != NULL) {
+    isBurst = mac_txq_isBurst();
+    mac_txq_load(p_frame);
+
+    /* the attributes queued with the frame have been cleared by the upper
+     * layers, the radio needs to know how long to wait for the ACK */
+    packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK_WAIT_DURATION, p_ctx->ackWaitDuration);
+
+    /* handle transmission */
+    isBroadcastTx = packetbuf_holds_broadcast();
+
+#if (SMARTMAC_CFG_CONTINUOUS_TX_BROADCAST_EN == TRUE)
+    isBroadcastTx = TRUE;
+#elif (SMARTMAC_CFG_CONTINUOUS_TX_UNICAST_EN == TRUE)
+    linkaddr_t dstAddr;
+
+    /* unicast, ACK required, destination address 0x1120 */
+    isBroadcastTx = FALSE;
+    packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, TRUE);
+    memset(&dstAddr, 0, sizeof(dstAddr));
+    dstAddr.u8[7] = 0x21;
+    dstAddr.u8[6] = 0x11;
+    linkaddr_copy((linkaddr_t *)packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &dstAddr);
+#else
+
+#endif
+
+#if ((SMARTMAC_CFG_CONTINUOUS_TX_BROADCAST_EN == TRUE) || (SMARTMAC_CFG_CONTINUOUS_TX_UNICAST_EN == TRUE))
+    uint32_t txDelayMilli = 100;
+
+    for (;;) {
+      txDelayMilli += 100;
+      if (txDelayMilli > 2000) {
+        txDelayMilli = 100;
+      }
+      bsp_delay_us(txDelayMilli * 1000);
+
+      if (isBroadcastTx == TRUE) {
+        mac_txBroadcast(p_ctx, packetbuf_hdrptr(), packetbuf_totlen(), &err);
+      } else {
+        mac_txUnicast(p_ctx, packetbuf_hdrptr(), packetbuf_totlen(), &err);
+      }
+    }
+#endif
+
+    /* was the frame announced by the previous one? */
+    if (isBurst == TRUE) {
+      /* then the receiver is awake already. Every frame of a burst requests
+       * an ACK, the radio waits for it and reports NETSTK_ERR_TX_NOACK if it
+       * does not arrive, which ends the burst */
+      p_ctx->p_netstk->phy->send(packetbuf_hdrptr(), packetbuf_totlen(), &err);
+      if (err != NETSTK_ERR_NONE) {
+        TRACE_LOG_ERR("burst TX err=-%d", err);
+      }
+    }
+    else {
+#if (SMARTMAC_CFG_PHASE_LEARNING_EN == TRUE)
+      /* sleep until the receiver is about to wake up */
+      if (!isBroadcastTx) {
+        mac_txPhaseWait(p_ctx);
+      }
+#endif
+      /* Listen Before Talk */
+      mac_lbt(p_ctx, &err);
+      if (err == NETSTK_ERR_NONE) {
+        if (isBroadcastTx) {
+          mac_txBroadcast(p_ctx, packetbuf_hdrptr(), packetbuf_totlen(), &err);
+        }
+        else {
+          mac_txUnicast(p_ctx, packetbuf_hdrptr(), packetbuf_totlen(), &err);
+        }
+      }
+      else {
+        isLbtFailed = TRUE;
+      }
+    }
+
+    /* dequeue the frame and signal the upper layer */
+    mac_txq_done(err);
+
+    /* does the burst go on? */
+    p_frame = NULL;
+    if (mac_txq_isBurst() == TRUE) {
+      p_frame = mac_txq_head();
+    }
+  }
+
+  if (isLbtFailed == FALSE) {
+    /* state transition: ON -> OFF */
+    mac_on_exit(p_ctx);
+    mac_off_entry(p_ctx);
+  }
+  else {
+    mac_scan_entry(p_ctx);
+  }
+}
+
+
 static void mac_off_entry(struct s_smartMAC *p_ctx) {
   e_nsErr_t err = NETSTK_ERR_NONE;
 
   p_ctx->p_netstk->phy->off(&err);
   if (err == NETSTK_ERR_NONE) {
     p_ctx->state = E_SMARTMAC_STATE_OFF;
+
+    /* are there frames waiting for transmission? */
+    if (mac_txq_len() > 0) {
+      evproc_putEvent(E_EVPROC_TAIL, NETSTK_MAC_EVENT, p_ctx);
+    }
   }
   else {
     mac_on_entry(p_ctx);
@@ -852,6 +978,25 @@ static void mac_lbt(struct s_smartMAC *p_ctx, e_nsErr_t *p_err) {
   }
 }
 
+#if (SMARTMAC_CFG_PHASE_LEARNING_EN == TRUE)
+static void mac_txPhaseWait(struct s_smartMAC *p_ctx) {
+  e_nsErr_t err;
+  rt_tmr_tick_t guard;
+  rt_tmr_tick_t wait;
+
+  /* strobing starts once LBT is over, one strobe interval before the
+   * receiver was seen awake, plus one strobe interval of margin */
+  guard = (p_ctx->strobeTxInterval + 1) + 2 * p_ctx->strobeTxInterval;
+  wait = mac_phase_wait(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), guard);
+  if (wait > 0) {
+    p_ctx->isTxPredicted = TRUE;
+    p_ctx->p_netstk->phy->off(&err);
+    rt_tmr_delay(wait);
+    p_ctx->p_netstk->phy->on(&err);
+  }
+}
+#endif
+
 
 static void mac_eventHandler(c_event_t c_event, p_data_t p_data) {
   struct s_smartMAC *p_ctx = &smartMAC;
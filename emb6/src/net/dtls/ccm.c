@@ -36,16 +36,6 @@
 
 #define CCM_FLAGS(A,M,L) (((A > 0) << 6) | (((M - 2)/2) << 3) | (L - 1))
 
-#define MASK_L(_L) ((1 << 8 * _L) - 1)
-
-#define SET_COUNTER(A,L,cnt,C) {					\
-    int i;								\
-    memset((A) + DTLS_CCM_BLOCKSIZE - (L), 0, (L));			\
-    (C) = (cnt) & MASK_L(L);						\
-    for (i = DTLS_CCM_BLOCKSIZE - 1; (C) && (i > (L)); --i, (C) >>= 8)	\
-      (A)[i] |= (C) & 0xFF;						\
-  }
-
 static inline void
 block0(size_t M,       /* number of auth bytes */
        size_t L,       /* number of bytes to encode message length */
@@ -145,22 +135,38 @@ add_auth_data(rijndael_ctx *ctx, const unsigned char *msg, size_t la,
   }
 }
 
+/**
+ * Increments the \p L octets wide counter field at the end of the
+ * counter block \p A in place.
+ */
 static inline void
-encrypt(rijndael_ctx *ctx, size_t L, unsigned long counter,
-	unsigned char *msg, size_t len,
-	unsigned char A[DTLS_CCM_BLOCKSIZE],
-	unsigned char S[DTLS_CCM_BLOCKSIZE]) {
+ctr_inc(unsigned char A[DTLS_CCM_BLOCKSIZE], size_t L) {
+  unsigned char *p = A + DTLS_CCM_BLOCKSIZE;
 
-  static unsigned long counter_tmp;
+  while (L-- && ++*--p == 0)
+    ;
+}
 
-  SET_COUNTER(A, L, counter, counter_tmp);
-  rijndael_encrypt(ctx, A, S);
-  memxor(msg, S, len);
+/**
+ * Generates \p n consecutive keystream blocks S_i = E(K, A_i) into
+ * \p S and advances the counter in \p A accordingly. Producing the
+ * keystream in batches keeps the expanded key schedule hot and avoids
+ * rebuilding the counter block for every 16 bytes of payload.
+ */
+static inline void
+keystream(rijndael_ctx *ctx, size_t L, size_t n,
+	  unsigned char A[DTLS_CCM_BLOCKSIZE],
+	  unsigned char S[DTLS_CCM_BATCH * DTLS_CCM_BLOCKSIZE]) {
+  while (n--) {
+    rijndaelEncrypt(ctx->ek, ctx->Nr, A, S);
+    ctr_inc(A, L);
+    S += DTLS_CCM_BLOCKSIZE;
+  }
 }
 
 static inline void
 mac(rijndael_ctx *ctx,
-    unsigned char *msg, size_t len,
+    const unsigned char *msg, size_t len,
     unsigned char B[DTLS_CCM_BLOCKSIZE],
     unsigned char X[DTLS_CCM_BLOCKSIZE]) {
   size_t i;
@@ -168,8 +174,27 @@ mac(rijndael_ctx *ctx,
   for (i = 0; i < len; ++i)
     B[i] = X[i] ^ msg[i];
 
-  rijndael_encrypt(ctx, B, X);
+  rijndaelEncrypt(ctx->ek, ctx->Nr, B, X);
+}
+
+/**
+ * Initializes the counter block template \p A from \p nonce, stores
+ * the encrypted A_0 (used to mask the MAC) in \p S0 and leaves \p A
+ * set to A_1, the first counter block for payload encryption.
+ */
+static inline void
+ctr_init(rijndael_ctx *ctx, size_t L,
+	 unsigned char nonce[DTLS_CCM_BLOCKSIZE],
+	 unsigned char A[DTLS_CCM_BLOCKSIZE],
+	 unsigned char S0[DTLS_CCM_BLOCKSIZE]) {
+  A[0] = L-1;
 
+  /* copy the nonce */
+  memcpy(A + 1, nonce, DTLS_CCM_BLOCKSIZE - L);
+  memset(A + DTLS_CCM_BLOCKSIZE - L, 0, L);
+
+  rijndaelEncrypt(ctx->ek, ctx->Nr, A, S0);
+  A[DTLS_CCM_BLOCKSIZE - 1] = 1;
 }
 
 long int
@@ -177,61 +202,53 @@ dtls_ccm_encrypt_message(rijndael_ctx *ctx, size_t M, size_t L,
 			 unsigned char nonce[DTLS_CCM_BLOCKSIZE],
 			 unsigned char *msg, size_t lm,
 			 const unsigned char *aad, size_t la) {
-  size_t i, len;
-  unsigned long counter_tmp;
-  unsigned long counter = 1; /* \bug does not work correctly on ia32 when
-			             lm >= 2^16 */
+  size_t i, n, len;
   unsigned char A[DTLS_CCM_BLOCKSIZE]; /* A_i blocks for encryption input */
   unsigned char B[DTLS_CCM_BLOCKSIZE]; /* B_i blocks for CBC-MAC input */
-  unsigned char S[DTLS_CCM_BLOCKSIZE]; /* S_i = encrypted A_i blocks */
+  unsigned char S[DTLS_CCM_BATCH * DTLS_CCM_BLOCKSIZE]; /* S_i = encrypted A_i blocks */
   unsigned char X[DTLS_CCM_BLOCKSIZE]; /* X_i = encrypted B_i blocks */
+  unsigned char S0[DTLS_CCM_BLOCKSIZE]; /* S_0 masks the MAC */
 
   len = lm;			/* save original length */
   /* create the initial authentication block B0 */
   block0(M, L, la, lm, nonce, B);
   add_auth_data(ctx, aad, la, B, X);
 
-  /* initialize block template */
-  A[0] = L-1;
+  ctr_init(ctx, L, nonce, A, S0);
 
-  /* copy the nonce */
-  memcpy(A + 1, nonce, DTLS_CCM_BLOCKSIZE - L);
-
-  while (lm >= DTLS_CCM_BLOCKSIZE) {
-    /* calculate MAC */
-    mac(ctx, msg, DTLS_CCM_BLOCKSIZE, B, X);
-
-    /* encrypt */
-    encrypt(ctx, L, counter, msg, DTLS_CCM_BLOCKSIZE, A, S);
-
-    /* update local pointers */
-    lm -= DTLS_CCM_BLOCKSIZE;
-    msg += DTLS_CCM_BLOCKSIZE;
-    counter++;
-  }
+  while (lm) {
+    /* number of keystream blocks needed for this batch */
+    n = min(DTLS_CCM_BATCH, (lm + DTLS_CCM_BLOCKSIZE - 1) / DTLS_CCM_BLOCKSIZE);
+    keystream(ctx, L, n, A, S);
 
-  if (lm) {
-    /* Calculate MAC. The remainder of B must be padded with zeroes, so
-     * B is constructed to contain X ^ msg for the first lm bytes (done in
-     * mac() and X ^ 0 for the remaining DTLS_CCM_BLOCKSIZE - lm bytes
-     * (i.e., we can use memcpy() here).
-     */
-    memcpy(B + lm, X + lm, DTLS_CCM_BLOCKSIZE - lm);
-    mac(ctx, msg, lm, B, X);
+    for (i = 0; lm >= DTLS_CCM_BLOCKSIZE && i < n; ++i) {
+      /* calculate MAC over plaintext, then encrypt */
+      mac(ctx, msg, DTLS_CCM_BLOCKSIZE, B, X);
+      memxor(msg, S + i * DTLS_CCM_BLOCKSIZE, DTLS_CCM_BLOCKSIZE);
 
-    /* encrypt */
-    encrypt(ctx, L, counter, msg, lm, A, S);
+      /* update local pointers */
+      lm -= DTLS_CCM_BLOCKSIZE;
+      msg += DTLS_CCM_BLOCKSIZE;
+    }
 
-    /* update local pointers */
-    msg += lm;
+    if (lm && i < n) {
+      /* Calculate MAC. The remainder of B must be padded with zeroes, so
+       * B is constructed to contain X ^ msg for the first lm bytes (done in
+       * mac() and X ^ 0 for the remaining DTLS_CCM_BLOCKSIZE - lm bytes
+       * (i.e., we can use memcpy() here).
+       */
+      memcpy(B + lm, X + lm, DTLS_CCM_BLOCKSIZE - lm);
+      mac(ctx, msg, lm, B, X);
+      memxor(msg, S + i * DTLS_CCM_BLOCKSIZE, lm);
+
+      /* update local pointers */
+      msg += lm;
+      lm = 0;
+    }
   }
 
-  /* calculate S_0 */
-  SET_COUNTER(A, L, 0, counter_tmp);
-  rijndael_encrypt(ctx, A, S);
-
   for (i = 0; i < M; ++i)
-    *msg++ = X[i] ^ S[i];
+    *msg++ = X[i] ^ S0[i];
 
   return len + M;
 }
@@ -242,14 +259,12 @@ dtls_ccm_decrypt_message(rijndael_ctx *ctx, size_t M, size_t L,
 			 unsigned char *msg, size_t lm,
 			 const unsigned char *aad, size_t la) {
 
-  size_t len;
-  unsigned long counter_tmp;
-  unsigned long counter = 1; /* \bug does not work correctly on ia32 when
-			             lm >= 2^16 */
+  size_t i, n, len;
   unsigned char A[DTLS_CCM_BLOCKSIZE]; /* A_i blocks for encryption input */
   unsigned char B[DTLS_CCM_BLOCKSIZE]; /* B_i blocks for CBC-MAC input */
-  unsigned char S[DTLS_CCM_BLOCKSIZE]; /* S_i = encrypted A_i blocks */
+  unsigned char S[DTLS_CCM_BATCH * DTLS_CCM_BLOCKSIZE]; /* S_i = encrypted A_i blocks */
   unsigned char X[DTLS_CCM_BLOCKSIZE]; /* X_i = encrypted B_i blocks */
+  unsigned char S0[DTLS_CCM_BLOCKSIZE]; /* S_0 masks the MAC */
 
   if (lm < M)
     goto error;
@@ -261,46 +276,42 @@ dtls_ccm_decrypt_message(rijndael_ctx *ctx, size_t M, size_t L,
   block0(M, L, la, lm, nonce, B);
   add_auth_data(ctx, aad, la, B, X);
 
-  /* initialize block template */
-  A[0] = L-1;
+  ctr_init(ctx, L, nonce, A, S0);
 
-  /* copy the nonce */
-  memcpy(A + 1, nonce, DTLS_CCM_BLOCKSIZE - L);
-
-  while (lm >= DTLS_CCM_BLOCKSIZE) {
-    /* decrypt */
-    encrypt(ctx, L, counter, msg, DTLS_CCM_BLOCKSIZE, A, S);
+  while (lm) {
+    /* number of keystream blocks needed for this batch */
+    n = min(DTLS_CCM_BATCH, (lm + DTLS_CCM_BLOCKSIZE - 1) / DTLS_CCM_BLOCKSIZE);
+    keystream(ctx, L, n, A, S);
 
-    /* calculate MAC */
-    mac(ctx, msg, DTLS_CCM_BLOCKSIZE, B, X);
-
-    /* update local pointers */
-    lm -= DTLS_CCM_BLOCKSIZE;
-    msg += DTLS_CCM_BLOCKSIZE;
-    counter++;
-  }
+    for (i = 0; lm >= DTLS_CCM_BLOCKSIZE && i < n; ++i) {
+      /* decrypt, then calculate MAC over plaintext */
+      memxor(msg, S + i * DTLS_CCM_BLOCKSIZE, DTLS_CCM_BLOCKSIZE);
+      mac(ctx, msg, DTLS_CCM_BLOCKSIZE, B, X);
 
-  if (lm) {
-    /* decrypt */
-    encrypt(ctx, L, counter, msg, lm, A, S);
-
-    /* Calculate MAC. Note that msg ends in the MAC so we must
-     * construct B to contain X ^ msg for the first lm bytes (done in
-     * mac() and X ^ 0 for the remaining DTLS_CCM_BLOCKSIZE - lm bytes
-     * (i.e., we can use memcpy() here).
-     */
-    memcpy(B + lm, X + lm, DTLS_CCM_BLOCKSIZE - lm);
-    mac(ctx, msg, lm, B, X);
+      /* update local pointers */
+      lm -= DTLS_CCM_BLOCKSIZE;
+      msg += DTLS_CCM_BLOCKSIZE;
+    }
 
-    /* update local pointers */
-    msg += lm;
+    if (lm && i < n) {
+      /* decrypt */
+      memxor(msg, S + i * DTLS_CCM_BLOCKSIZE, lm);
+
+      /* Calculate MAC. Note that msg ends in the MAC so we must
+       * construct B to contain X ^ msg for the first lm bytes (done in
+       * mac() and X ^ 0 for the remaining DTLS_CCM_BLOCKSIZE - lm bytes
+       * (i.e., we can use memcpy() here).
+       */
+      memcpy(B + lm, X + lm, DTLS_CCM_BLOCKSIZE - lm);
+      mac(ctx, msg, lm, B, X);
+
+      /* update local pointers */
+      msg += lm;
+      lm = 0;
+    }
   }
 
-  /* calculate S_0 */
-  SET_COUNTER(A, L, 0, counter_tmp);
-  rijndael_encrypt(ctx, A, S);
-
-  memxor(msg, S, M);
+  memxor(msg, S0, M);
 
   /* return length if MAC is valid, otherwise continue with error handling */
   if (equals(X, msg, M))
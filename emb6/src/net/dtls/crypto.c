@@ -72,6 +72,39 @@ static void dtls_cipher_context_release(void)
 #endif
 }
 
+/**
+ * Returns the expanded key schedule for \p key from the cipher
+ * context's key cache. On a miss, the least recently inserted slot is
+ * replaced and the key schedule is computed once. Records of the same
+ * epoch thus reuse the expanded key instead of running the rijndael
+ * key setup per record.
+ */
+static aes128_ccm_t *
+dtls_cipher_key_get(struct dtls_cipher_context_t *ctx,
+		    const unsigned char *key, size_t keylen)
+{
+  int i;
+
+  if (keylen == DTLS_KEY_LENGTH) {
+    for (i = 0; i < DTLS_KEY_CACHE_SIZE; i++) {
+      if ((ctx->valid & (1 << i)) && !memcmp(ctx->key[i], key, keylen))
+        return &ctx->data[i];
+    }
+  }
+
+  i = ctx->next;
+  ctx->valid &= ~(1 << i);
+  if (rijndael_set_key_enc_only(&ctx->data[i].ctx, key, 8 * keylen) < 0)
+    return NULL;
+
+  if (keylen == DTLS_KEY_LENGTH) {
+    memcpy(ctx->key[i], key, keylen);
+    ctx->valid |= 1 << i;
+    ctx->next = (i + 1) % DTLS_KEY_CACHE_SIZE;
+  }
+  return &ctx->data[i];
+}
+
 #ifndef WITH_CONTIKI
 void crypto_init()
 {
@@ -139,6 +172,9 @@ dtls_handshake_parameters_t *dtls_handshake_new()
     /* FIXME: we use the default SHA256 here, might need to support other
               hash functions as well */
     dtls_hash_init(&handshake->hs_state.hs_hash);
+#ifdef SHA2_WITH_STATS
+    handshake->hash_compressions = sha256_compressions;
+#endif
   }
   return handshake;
 }
@@ -148,6 +184,10 @@ void dtls_handshake_free(dtls_handshake_parameters_t *handshake)
   if (!handshake)
     return;
 
+#ifdef SHA2_WITH_STATS
+  dtls_info("handshake used %lu SHA-256 compressions\n",
+	    sha256_compressions - handshake->hash_compressions);
+#endif
   netq_delete_all(handshake->reorder_queue);
   dtls_handshake_dealloc(handshake);
 }
@@ -186,61 +226,56 @@ dtls_p_hash(dtls_hashfunc_t h,
 	    const unsigned char *random1, size_t random1len,
 	    const unsigned char *random2, size_t random2len,
 	    unsigned char *buf, size_t buflen) {
-  dtls_hmac_context_t *hmac_a, *hmac_p;
+  dtls_hmac_context_t *hmac;
 
   unsigned char A[DTLS_HMAC_DIGEST_SIZE];
   unsigned char tmp[DTLS_HMAC_DIGEST_SIZE];
   size_t dlen;			/* digest length */
   size_t len = 0;			/* result length */
 
-  hmac_a = dtls_hmac_new(key, keylen);
-  if (!hmac_a)
+  /* The key setup is done only once. All further HMAC computations
+   * with this secret restart from the cached ipad/opad midstates. */
+  hmac = dtls_hmac_new(key, keylen);
+  if (!hmac)
     return 0;
 
   /* calculate A(1) from A(0) == seed */
-  HMAC_UPDATE_SEED(hmac_a, label, labellen);
-  HMAC_UPDATE_SEED(hmac_a, random1, random1len);
-  HMAC_UPDATE_SEED(hmac_a, random2, random2len);
+  HMAC_UPDATE_SEED(hmac, label, labellen);
+  HMAC_UPDATE_SEED(hmac, random1, random1len);
+  HMAC_UPDATE_SEED(hmac, random2, random2len);
 
-  dlen = dtls_hmac_finalize(hmac_a, A);
-
-  hmac_p = dtls_hmac_new(key, keylen);
-  if (!hmac_p)
-    goto error;
+  dlen = dtls_hmac_finalize(hmac, A);
 
   while (len + dlen < buflen) {
 
-    /* FIXME: rewrite loop to avoid superflous call to dtls_hmac_init() */
-    dtls_hmac_init(hmac_p, key, keylen);
-    dtls_hmac_update(hmac_p, A, dlen);
+    dtls_hmac_reset(hmac);
+    dtls_hmac_update(hmac, A, dlen);
 
-    HMAC_UPDATE_SEED(hmac_p, label, labellen);
-    HMAC_UPDATE_SEED(hmac_p, random1, random1len);
-    HMAC_UPDATE_SEED(hmac_p, random2, random2len);
+    HMAC_UPDATE_SEED(hmac, label, labellen);
+    HMAC_UPDATE_SEED(hmac, random1, random1len);
+    HMAC_UPDATE_SEED(hmac, random2, random2len);
 
-    len += dtls_hmac_finalize(hmac_p, tmp);
+    len += dtls_hmac_finalize(hmac, tmp);
     memcpy(buf, tmp, dlen);
     buf += dlen;
 
     /* calculate A(i+1) */
-    dtls_hmac_init(hmac_a, key, keylen);
-    dtls_hmac_update(hmac_a, A, dlen);
-    dtls_hmac_finalize(hmac_a, A);
+    dtls_hmac_reset(hmac);
+    dtls_hmac_update(hmac, A, dlen);
+    dtls_hmac_finalize(hmac, A);
   }
 
-  dtls_hmac_init(hmac_p, key, keylen);
-  dtls_hmac_update(hmac_p, A, dlen);
+  dtls_hmac_reset(hmac);
+  dtls_hmac_update(hmac, A, dlen);
 
-  HMAC_UPDATE_SEED(hmac_p, label, labellen);
-  HMAC_UPDATE_SEED(hmac_p, random1, random1len);
-  HMAC_UPDATE_SEED(hmac_p, random2, random2len);
+  HMAC_UPDATE_SEED(hmac, label, labellen);
+  HMAC_UPDATE_SEED(hmac, random1, random1len);
+  HMAC_UPDATE_SEED(hmac, random2, random2len);
 
-  dtls_hmac_finalize(hmac_p, tmp);
+  dtls_hmac_finalize(hmac, tmp);
   memcpy(buf, tmp, buflen - len);
 
- error:
-  dtls_hmac_free(hmac_a);
-  dtls_hmac_free(hmac_p);
+  dtls_hmac_free(hmac);
 
   return buflen;
 }
@@ -349,6 +384,67 @@ static void dtls_ec_key_to_uint32(const unsigned char *key, size_t key_size,
   }
 }
 
+#if DTLS_ECDSA_KEY_CACHE_SIZE > 0
+typedef struct {
+  uint32_t x[8];		/**< x coordinate of the public key */
+  uint32_t y[8];		/**< y coordinate of the public key */
+  uint8 valid;			/**< set if this slot holds a key */
+  uint8 hits;			/**< saturating use counter, aged on misses */
+  ecc_table_t table;		/**< precomputed points for verification */
+} dtls_ecdsa_key_cache_t;
+
+static dtls_ecdsa_key_cache_t ecdsa_key_cache[DTLS_ECDSA_KEY_CACHE_SIZE];
+#ifndef WITH_CONTIKI
+static pthread_mutex_t ecdsa_key_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * Returns the verification table of the public key (\p x, \p y) from
+ * the key cache. On a miss, the key is checked to be on the curve and
+ * replaces the least used slot, while the other slots age so that keys
+ * which are no longer seen drop out. Returns NULL if the key is not
+ * on the curve. The caller must hold ecdsa_key_cache_mutex.
+ */
+static const ecc_table_t *
+dtls_ecdsa_key_get(const uint32_t *x, const uint32_t *y) {
+  dtls_ecdsa_key_cache_t *entry;
+  dtls_ecdsa_key_cache_t *victim = ecdsa_key_cache;
+  int i;
+
+  for (i = 0; i < DTLS_ECDSA_KEY_CACHE_SIZE; i++) {
+    entry = &ecdsa_key_cache[i];
+    if (!entry->valid) {
+      if (victim->valid)
+        victim = entry;
+      continue;
+    }
+    if (memcmp(entry->x, x, sizeof(entry->x)) == 0 &&
+        memcmp(entry->y, y, sizeof(entry->y)) == 0) {
+      if (entry->hits < 0xff)
+        entry->hits++;
+      return &entry->table;
+    }
+    if (victim->valid && entry->hits < victim->hits)
+      victim = entry;
+  }
+
+  if (!ecc_is_valid_point(x, y))
+    return NULL;
+
+  for (i = 0; i < DTLS_ECDSA_KEY_CACHE_SIZE; i++) {
+    if (ecdsa_key_cache[i].hits)
+      ecdsa_key_cache[i].hits--;
+  }
+
+  memcpy(victim->x, x, sizeof(victim->x));
+  memcpy(victim->y, y, sizeof(victim->y));
+  victim->valid = 1;
+  victim->hits = 1;
+  ecc_table_init(&victim->table, x, y);
+  return &victim->table;
+}
+#endif /* DTLS_ECDSA_KEY_CACHE_SIZE > 0 */
+
 static void dtls_ec_key_from_uint32(const uint32_t *key, size_t key_size,
 				    unsigned char *result) {
   int i;
@@ -489,6 +585,10 @@ dtls_ecdsa_verify_sig_hash(const unsigned char *pub_key_x,
   uint32_t hash[8];
   uint32_t point_r[8];
   uint32_t point_s[8];
+  int ret = -1;
+#if DTLS_ECDSA_KEY_CACHE_SIZE > 0
+  const ecc_table_t *table;
+#endif
 
   dtls_ec_key_to_uint32(pub_key_x, key_size, pub_x);
   dtls_ec_key_to_uint32(pub_key_y, key_size, pub_y);
@@ -496,7 +596,26 @@ dtls_ecdsa_verify_sig_hash(const unsigned char *pub_key_x,
   dtls_ec_key_to_uint32(result_s, key_size, point_s);
   dtls_ec_key_to_uint32(sign_hash, sign_hash_size, hash);
 
-  return ecc_ecdsa_validate(pub_x, pub_y, hash, point_r, point_s);
+#if DTLS_ECDSA_KEY_CACHE_SIZE > 0
+#ifndef WITH_CONTIKI
+  pthread_mutex_lock(&ecdsa_key_cache_mutex);
+#endif
+  table = dtls_ecdsa_key_get(pub_x, pub_y);
+  if (table)
+    ret = ecc_ecdsa_validate_table(table, hash, point_r, point_s);
+  else
+    dtls_warn("public key is not on the curve\n");
+#ifndef WITH_CONTIKI
+  pthread_mutex_unlock(&ecdsa_key_cache_mutex);
+#endif
+#else /* DTLS_ECDSA_KEY_CACHE_SIZE > 0 */
+  if (ecc_is_valid_point(pub_x, pub_y))
+    ret = ecc_ecdsa_validate(pub_x, pub_y, hash, point_r, point_s);
+  else
+    dtls_warn("public key is not on the curve\n");
+#endif /* DTLS_ECDSA_KEY_CACHE_SIZE > 0 */
+
+  return ret;
 }
 
 int
@@ -527,11 +646,12 @@ dtls_encrypt(const unsigned char *src, size_t length,
 	     unsigned char *key, size_t keylen,
 	     const unsigned char *aad, size_t la)
 {
-  int ret;
+  int ret = -1;
   struct dtls_cipher_context_t *ctx = dtls_cipher_context_get();
+  aes128_ccm_t *ccm_ctx;
 
-  ret = rijndael_set_key_enc_only(&ctx->data.ctx, key, 8 * keylen);
-  if (ret < 0) {
+  ccm_ctx = dtls_cipher_key_get(ctx, key, keylen);
+  if (!ccm_ctx) {
     /* cleanup everything in case the key has the wrong size */
     dtls_warn("cannot set rijndael key\n");
     goto error;
@@ -539,7 +659,7 @@ dtls_encrypt(const unsigned char *src, size_t length,
 
   if (src != buf)
     memmove(buf, src, length);
-  ret = dtls_ccm_encrypt(&ctx->data, src, length, buf, nounce, aad, la);
+  ret = dtls_ccm_encrypt(ccm_ctx, src, length, buf, nounce, aad, la);
 
 error:
   dtls_cipher_context_release();
@@ -553,11 +673,12 @@ dtls_decrypt(const unsigned char *src, size_t length,
 	     unsigned char *key, size_t keylen,
 	     const unsigned char *aad, size_t la)
 {
-  int ret;
+  int ret = -1;
   struct dtls_cipher_context_t *ctx = dtls_cipher_context_get();
+  aes128_ccm_t *ccm_ctx;
 
-  ret = rijndael_set_key_enc_only(&ctx->data.ctx, key, 8 * keylen);
-  if (ret < 0) {
+  ccm_ctx = dtls_cipher_key_get(ctx, key, keylen);
+  if (!ccm_ctx) {
     /* cleanup everything in case the key has the wrong size */
     dtls_warn("cannot set rijndael key\n");
     goto error;
@@ -565,7 +686,7 @@ dtls_decrypt(const unsigned char *src, size_t length,
 
   if (src != buf)
     memmove(buf, src, length);
-  ret = dtls_ccm_decrypt(&ctx->data, src, length, buf, nounce, aad, la);
+  ret = dtls_ccm_decrypt(ccm_ctx, src, length, buf, nounce, aad, la);
 
 error:
   dtls_cipher_context_release();
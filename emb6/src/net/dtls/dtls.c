@@ -80,7 +80,7 @@
 #define DTLS_HS_LENGTH sizeof(dtls_handshake_header_t)
 #define DTLS_CH_LENGTH sizeof(dtls_client_hello_t) /* no variable length fields! */
 #define DTLS_COOKIE_LENGTH_MAX 32
-#define DTLS_CH_LENGTH_MAX sizeof(dtls_client_hello_t) + DTLS_COOKIE_LENGTH_MAX + 12 + 26
+#define DTLS_CH_LENGTH_MAX sizeof(dtls_client_hello_t) + DTLS_COOKIE_LENGTH_MAX + 12 + 26 + DTLS_CID_EXT_LENGTH
 #define DTLS_HV_LENGTH sizeof(dtls_hello_verify_t)
 #define DTLS_SH_LENGTH (2 + DTLS_RANDOM_LENGTH + 1 + 2 + 1)
 #define DTLS_CE_LENGTH (3 + 3 + 27 + DTLS_EC_KEY_SIZE + DTLS_EC_KEY_SIZE)
@@ -92,6 +92,17 @@
 #define DTLS_CV_LENGTH (1 + 1 + 2 + 1 + 1 + 1 + 1 + DTLS_EC_KEY_SIZE + 1 + 1 + DTLS_EC_KEY_SIZE)
 #define DTLS_FIN_LENGTH 12
 
+#if DTLS_CONNECTION_ID
+/* connection_id extension: type(2) + length(2) + cid length(1) + cid */
+#define DTLS_CID_EXT_LENGTH (2 + 2 + 1 + DTLS_CID_LENGTH)
+/* the CID of a tls12_cid record follows the sequence number */
+#define DTLS_CID_OFFSET (DTLS_RH_LENGTH - sizeof(uint16))
+/* additional_data of tls12_cid records, see RFC 9146, section 5 */
+#define DTLS_CID_A_DATA_LEN(L) (8 + 1 + 1 + 1 + 2 + 2 + 6 + (L) + 2)
+#else /* DTLS_CONNECTION_ID */
+#define DTLS_CID_EXT_LENGTH 0
+#endif /* DTLS_CONNECTION_ID */
+
 #define HS_HDR_LENGTH  DTLS_RH_LENGTH + DTLS_HS_LENGTH
 #define HV_HDR_LENGTH  HS_HDR_LENGTH + DTLS_HV_LENGTH
 
@@ -150,6 +161,7 @@ free_context(dtls_context_t *context) {
 }
 
 void dtls_retransmit_process(c_event_t c_event, p_data_t p_data);
+static void dtls_retransmit_schedule(dtls_context_t *context);
 #else /* WITH_CONTIKI */
 
 static inline dtls_context_t *
@@ -209,6 +221,12 @@ static int dtls_send(dtls_context_t *ctx, dtls_peer_t *peer, unsigned char type,
  */
 static void dtls_stop_retransmission(dtls_context_t *context, dtls_peer_t *peer);
 
+/**
+ * Returns the first queued record of the flight that is currently
+ * being sent to @p peer, or NULL if nothing is queued for @p peer.
+ */
+static netq_t *dtls_flight_head(dtls_context_t *context, dtls_peer_t *peer);
+
 dtls_peer_t *
 dtls_get_peer(const dtls_context_t *ctx, const session_t *session) {
 	dtls_peer_t *p = NULL;
@@ -224,7 +242,61 @@ dtls_get_peer(const dtls_context_t *ctx, const session_t *session) {
 	return p;
 }
 
+#if DTLS_CONNECTION_ID
+/**
+ * Returns the peer that we have handed out the connection ID @p cid
+ * to, or NULL if there is none. @p cid must hold DTLS_CID_LENGTH
+ * bytes.
+ */
+static dtls_peer_t *
+dtls_get_peer_by_cid(const dtls_context_t *ctx, const uint8 *cid) {
+	dtls_peer_t *p;
+#ifndef WITH_CONTIKI
+	dtls_peer_t *tmp;
+
+	HASH_ITER(hh, ctx->peers, p, tmp) {
+		if (memcmp(p->cid, cid, DTLS_CID_LENGTH) == 0)
+			return p;
+	}
+#else /* WITH_CONTIKI */
+	for (p = list_head(ctx->peers); p; p = list_item_next(p))
+		if (memcmp(p->cid, cid, DTLS_CID_LENGTH) == 0)
+			return p;
+#endif /* WITH_CONTIKI */
+
+	return NULL;
+}
+
+/**
+ * Moves @p peer to the transport address @p session from where it
+ * has sent an authenticated tls12_cid record.
+ */
+static void dtls_update_peer_session(dtls_context_t *ctx, dtls_peer_t *peer,
+		const session_t *session) {
+	if (dtls_get_peer(ctx, session)) {
+		dtls_warn("address is used by another peer, not migrating\n");
+		return;
+	}
+
+	dtls_dsrv_log_addr(DTLS_LOG_INFO, "peer moved to", session);
+#ifndef WITH_CONTIKI
+	HASH_DEL_PEER(ctx->peers, peer);
+	memcpy(&peer->session, session, sizeof(session_t));
+	HASH_ADD_PEER(ctx->peers, session, peer);
+#else /* WITH_CONTIKI */
+	memcpy(&peer->session, session, sizeof(session_t));
+#endif /* WITH_CONTIKI */
+}
+#endif /* DTLS_CONNECTION_ID */
+
 static void dtls_add_peer(dtls_context_t *ctx, dtls_peer_t *peer) {
+#if DTLS_CONNECTION_ID
+	/* records are demultiplexed by our CID, so it has to be unique */
+	do {
+		dtls_prng(peer->cid, DTLS_CID_LENGTH);
+	} while (dtls_get_peer_by_cid(ctx, peer->cid));
+#endif /* DTLS_CONNECTION_ID */
+
 #ifndef WITH_CONTIKI
 	HASH_ADD_PEER(ctx->peers, session, peer);
 #else /* WITH_CONTIKI */
@@ -301,8 +373,8 @@ static int dtls_create_cookie(dtls_context_t *ctx, session_t *session,
 	 * implementation of dtls_hmac_context_new()). */
 
 	dtls_hmac_context_t hmac_context;
-	dtls_hmac_init(&hmac_context, ctx->cookie_secret,
-			DTLS_COOKIE_SECRET_LENGTH);
+	hmac_context = ctx->cookie_hmac;
+	dtls_hmac_reset(&hmac_context);
 
 	dtls_hmac_update(&hmac_context, (unsigned char *) &session->addr,
 			session->size);
@@ -343,24 +415,43 @@ static char const content_types[] = {
 	DTLS_CT_ALERT,
 	DTLS_CT_HANDSHAKE,
 	DTLS_CT_APPLICATION_DATA,
+#if DTLS_CONNECTION_ID
+	DTLS_CT_TLS12_CID,
+#endif /* DTLS_CONNECTION_ID */
 	0 /* end marker */
 };
 #endif
 
+/**
+ * Returns the length of the record header at \p msg. tls12_cid
+ * records carry one of our own CIDs, which all have the same length.
+ */
+static inline unsigned int dtls_record_header_length(const uint8 *msg) {
+#if DTLS_CONNECTION_ID
+	if (msg[0] == DTLS_CT_TLS12_CID)
+		return DTLS_RH_LENGTH + DTLS_CID_LENGTH;
+#endif /* DTLS_CONNECTION_ID */
+	return DTLS_RH_LENGTH;
+}
+
 /**
  * Checks if \p msg points to a valid DTLS record. If
  *
  */
 static unsigned int is_record(uint8 *msg, size_t msglen) {
 	unsigned int rlen = 0;
+	unsigned int hlen;
+
+	if (msglen < DTLS_RH_LENGTH)
+		return 0;
 
-	if (msglen >= DTLS_RH_LENGTH /* FIXME allow empty records? */
+	hlen = dtls_record_header_length(msg);
+	if (msglen >= hlen /* FIXME allow empty records? */
 #ifdef DTLS_CHECK_CONTENTTYPE
 			&& strchr(content_types, msg[0])
 #endif
 			&& msg[1] == HIGH(DTLS_VERSION) && msg[2] == LOW(DTLS_VERSION)) {
-		rlen = DTLS_RH_LENGTH
-				+ dtls_uint16_to_int(DTLS_RECORD_HEADER(msg)->length);
+		rlen = hlen + dtls_uint16_to_int(msg + hlen - sizeof(uint16));
 
 		/* we do not accept wrong length field in record header */
 		if (rlen > msglen)
@@ -829,6 +920,23 @@ static int dtls_check_tls_extension(dtls_peer_t *peer, uint8 *data,
 			 */
 			dtls_info("skipped encrypt-then-mac extension\n");
 			break;
+#if DTLS_CONNECTION_ID
+		case TLS_EXT_CONNECTION_ID:
+			if (j < sizeof(uint8) || dtls_uint8_to_int(data) != j - sizeof(uint8))
+				goto error;
+			if (j - sizeof(uint8) > DTLS_CID_MAX_LENGTH) {
+				/* a server may simply not echo the extension, but a client
+				 * has to use what the server has chosen */
+				dtls_warn("connection id of %i bytes is too long\n", j - 1);
+				if (!client_hello)
+					goto error;
+				break;
+			}
+			peer->peer_cid_length = j - sizeof(uint8);
+			memcpy(peer->peer_cid, data + sizeof(uint8), peer->peer_cid_length);
+			peer->cid_negotiated = 1;
+			break;
+#endif /* DTLS_CONNECTION_ID */
 		default:
 			dtls_warn("unsupported tls extension: %i\n", i);
 			break;
@@ -1045,13 +1153,13 @@ static inline void update_hs_hash(dtls_peer_t *peer, uint8 *data, size_t length)
 	dtls_hash_update(&peer->handshake_params->hs_state.hs_hash, data, length);
 }
 
-static void copy_hs_hash(dtls_peer_t *peer, dtls_hash_ctx *hs_hash) {
-	memcpy(hs_hash, &peer->handshake_params->hs_state.hs_hash,
-			sizeof(peer->handshake_params->hs_state.hs_hash));
-}
-
-static inline size_t finalize_hs_hash(dtls_peer_t *peer, uint8 *buf) {
-	return dtls_hash_finalize(buf, &peer->handshake_params->hs_state.hs_hash);
+/**
+ * Computes the digest over all handshake messages seen so far without
+ * disturbing the running handshake hash.
+ */
+static inline size_t snapshot_hs_hash(dtls_peer_t *peer, uint8 *buf) {
+	return dtls_hash_finalize_copy(buf,
+			&peer->handshake_params->hs_state.hs_hash);
 }
 
 static inline void clear_hs_hash(dtls_peer_t *peer) {
@@ -1075,29 +1183,12 @@ static int check_finished(dtls_context_t *ctx, dtls_peer_t *peer, uint8 *data,
 	size_t digest_length, label_size;
 	const unsigned char *label;
 	unsigned char buf[DTLS_HMAC_MAX];
+	unsigned char verify_data[DTLS_FIN_LENGTH];
 
 	if (data_length < DTLS_HS_LENGTH + DTLS_FIN_LENGTH)
 		return dtls_alert_fatal_create(DTLS_ALERT_HANDSHAKE_FAILURE);
 
-	/* Use a union here to ensure that sufficient stack space is
-	 * reserved. As statebuf and verify_data are not used at the same
-	 * time, we can re-use the storage safely.
-	 */
-	union {
-		unsigned char statebuf[DTLS_HASH_CTX_SIZE];
-		unsigned char verify_data[DTLS_FIN_LENGTH];
-	} b;
-
-	/* temporarily store hash status for roll-back after finalize */
-	memcpy(b.statebuf, &peer->handshake_params->hs_state.hs_hash,
-			DTLS_HASH_CTX_SIZE);
-
-	digest_length = finalize_hs_hash(peer, buf);
-	/* clear_hash(); */
-
-	/* restore hash status */
-	memcpy(&peer->handshake_params->hs_state.hs_hash, b.statebuf,
-			DTLS_HASH_CTX_SIZE);
+	digest_length = snapshot_hs_hash(peer, buf);
 
 	if (peer->role == DTLS_CLIENT) {
 		label = PRF_LABEL(server);
@@ -1109,19 +1200,80 @@ static int check_finished(dtls_context_t *ctx, dtls_peer_t *peer, uint8 *data,
 
 	dtls_prf(peer->handshake_params->tmp.master_secret,
 	DTLS_MASTER_SECRET_LENGTH, label, label_size, PRF_LABEL(finished),
-			PRF_LABEL_SIZE(finished), buf, digest_length, b.verify_data,
-			sizeof(b.verify_data));
+			PRF_LABEL_SIZE(finished), buf, digest_length, verify_data,
+			sizeof(verify_data));
 
-	dtls_debug_dump("d:", data + DTLS_HS_LENGTH, sizeof(b.verify_data));
-	dtls_debug_dump("v:", b.verify_data, sizeof(b.verify_data));
+	dtls_debug_dump("d:", data + DTLS_HS_LENGTH, sizeof(verify_data));
+	dtls_debug_dump("v:", verify_data, sizeof(verify_data));
 
 	/* compare verify data and create DTLS alert code when they differ */
-	return equals(data + DTLS_HS_LENGTH, b.verify_data, sizeof(b.verify_data)) ?
+	return equals(data + DTLS_HS_LENGTH, verify_data, sizeof(verify_data)) ?
 			0 :
 			dtls_alert_create(DTLS_ALERT_LEVEL_FATAL,
 					DTLS_ALERT_HANDSHAKE_FAILURE);
 }
 
+#if DTLS_CONNECTION_ID
+/**
+ * Creates the additional_data of a tls12_cid record according to
+ * RFC 9146, section 5:
+ *
+ * additional_data = seq_num_placeholder + tls12_cid + cid_length +
+ *                   tls12_cid + DTLSCiphertext.version + epoch +
+ *                   sequence_number + cid +
+ *                   length_of_DTLSInnerPlaintext;
+ *
+ * \param A_DATA     Output buffer of DTLS_CID_A_DATA_LEN(cid_length) bytes.
+ * \param header     The record header including the CID.
+ * \param cid_length The length of the CID in \p header.
+ * \param length     The length of the DTLSInnerPlaintext.
+ * \return The number of bytes written to \p A_DATA.
+ */
+static size_t dtls_cid_additional_data(uint8 *A_DATA, const uint8 *header,
+		size_t cid_length, size_t length) {
+	uint8 *p = A_DATA;
+
+	memset(p, 0xff, 8);
+	p += 8;
+	dtls_int_to_uint8(p++, DTLS_CT_TLS12_CID);
+	dtls_int_to_uint8(p++, cid_length);
+	dtls_int_to_uint8(p++, DTLS_CT_TLS12_CID);
+	/* version, epoch and sequence_number */
+	memcpy(p, header + sizeof(uint8), DTLS_CID_OFFSET - sizeof(uint8));
+	p += DTLS_CID_OFFSET - sizeof(uint8);
+	memcpy(p, header + DTLS_CID_OFFSET, cid_length);
+	p += cid_length;
+	dtls_int_to_uint16(p, length);
+	p += sizeof(uint16);
+
+	return p - A_DATA;
+}
+
+/**
+ * Strips the padding from the DTLSInnerPlaintext of the tls12_cid
+ * record \p packet and writes the real content type back into its
+ * record header.
+ *
+ * \param packet The record, its header is updated.
+ * \param data   The decrypted DTLSInnerPlaintext.
+ * \param length The length of \p data.
+ * \return The length of the content or \c -1 if \p data holds no
+ *         content type.
+ */
+static int dtls_cid_inner_plaintext(uint8 *packet, const uint8 *data,
+		int length) {
+	while (length > 0 && data[length - 1] == 0)
+		length--;
+
+	if (length == 0)
+		return -1;
+
+	length--;
+	dtls_int_to_uint8(packet, data[length]);
+	return length;
+}
+#endif /* DTLS_CONNECTION_ID */
+
 /**
  * Prepares the payload given in \p data for sending with
  * dtls_send(). The \p data is encrypted and compressed according to
@@ -1153,13 +1305,35 @@ static int dtls_prepare_record(dtls_peer_t *peer,
 	uint8 *p, *start;
 	int res;
 	unsigned int i;
-
-	if (*rlen < DTLS_RH_LENGTH) {
+	size_t hlen = DTLS_RH_LENGTH;
+#if DTLS_CONNECTION_ID
+	/* once both sides have agreed on CIDs, all protected records are sent
+	 * as tls12_cid records if the peer wants to see its CID */
+	int cid = peer && peer->cid_negotiated && peer->peer_cid_length && security
+			&& security->cipher != TLS_NULL_WITH_NULL_NULL;
+
+	if (cid)
+		hlen += peer->peer_cid_length;
+#endif /* DTLS_CONNECTION_ID */
+
+	if (*rlen < hlen) {
 		dtls_alert("The sendbuf (%zu bytes) is too small\n", *rlen);
 		return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
 	}
 
 	p = dtls_set_record_header(type, security, sendbuf);
+#if DTLS_CONNECTION_ID
+	if (cid) {
+		/* RFC 9146: the real content type moves into the encrypted
+		 * DTLSInnerPlaintext, the CID goes in front of the length */
+		dtls_int_to_uint8(sendbuf, DTLS_CT_TLS12_CID);
+		p -= sizeof(uint16);
+		memcpy(p, peer->peer_cid, peer->peer_cid_length);
+		p += peer->peer_cid_length;
+		memset(p, 0, sizeof(uint16));
+		p += sizeof(uint16);
+	}
+#endif /* DTLS_CONNECTION_ID */
 	start = p;
 
 	if (!security || security->cipher == TLS_NULL_WITH_NULL_NULL) {
@@ -1168,7 +1342,7 @@ static int dtls_prepare_record(dtls_peer_t *peer,
 		res = 0;
 		for (i = 0; i < data_array_len; i++) {
 			/* check the minimum that we need for packets that are not encrypted */
-			if (*rlen < res + DTLS_RH_LENGTH + data_len_array[i]) {
+			if (*rlen < res + hlen + data_len_array[i]) {
 				dtls_debug("dtls_prepare_record: send buffer too small\n");
 				return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
 			}
@@ -1184,7 +1358,12 @@ static int dtls_prepare_record(dtls_peer_t *peer,
 		 */
 #define A_DATA_LEN 13
 		unsigned char nonce[DTLS_CCM_BLOCKSIZE];
+#if DTLS_CONNECTION_ID
+		unsigned char A_DATA[DTLS_CID_A_DATA_LEN(DTLS_CID_MAX_LENGTH)];
+#else /* DTLS_CONNECTION_ID */
 		unsigned char A_DATA[A_DATA_LEN];
+#endif /* DTLS_CONNECTION_ID */
+		size_t a_data_len = A_DATA_LEN;
 
 		if (is_tls_psk_with_aes_128_ccm_8(security->cipher)) {
 			dtls_debug(
@@ -1242,7 +1421,7 @@ static int dtls_prepare_record(dtls_peer_t *peer,
 
 		for (i = 0; i < data_array_len; i++) {
 			/* check the minimum that we need for packets that are not encrypted */
-			if (*rlen < res + DTLS_RH_LENGTH + data_len_array[i]) {
+			if (*rlen < res + hlen + data_len_array[i]) {
 				dtls_debug("dtls_prepare_record: send buffer too small\n");
 				return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
 			}
@@ -1252,6 +1431,19 @@ static int dtls_prepare_record(dtls_peer_t *peer,
 			res += data_len_array[i];
 		}
 
+#if DTLS_CONNECTION_ID
+		if (cid) {
+			/* DTLSInnerPlaintext: content || real type, no padding */
+			if (*rlen < res + hlen + sizeof(uint8)) {
+				dtls_debug("dtls_prepare_record: send buffer too small\n");
+				return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
+			}
+			dtls_int_to_uint8(p, type);
+			p += sizeof(uint8);
+			res += sizeof(uint8);
+		}
+#endif /* DTLS_CONNECTION_ID */
+
 		memset(nonce, 0, DTLS_CCM_BLOCKSIZE);
 		memcpy(nonce, dtls_kb_local_iv(security, peer->role),
 				dtls_kb_iv_size(security, peer->role));
@@ -1269,10 +1461,15 @@ static int dtls_prepare_record(dtls_peer_t *peer,
 		memcpy(A_DATA, &DTLS_RECORD_HEADER(sendbuf)->epoch, 8); /* epoch and seq_num */
 		memcpy(A_DATA + 8, &DTLS_RECORD_HEADER(sendbuf)->content_type, 3); /* type and version */
 		dtls_int_to_uint16(A_DATA + 11, res - 8); /* length */
+#if DTLS_CONNECTION_ID
+		if (cid)
+			a_data_len = dtls_cid_additional_data(A_DATA, sendbuf,
+					peer->peer_cid_length, res - 8);
+#endif /* DTLS_CONNECTION_ID */
 
 		res = dtls_encrypt(start + 8, res - 8, start + 8, nonce,
 				dtls_kb_local_write_key(security, peer->role),
-				dtls_kb_key_size(security, peer->role), A_DATA, A_DATA_LEN);
+				dtls_kb_key_size(security, peer->role), A_DATA, a_data_len);
 
 		if (res < 0)
 			return res;
@@ -1282,9 +1479,9 @@ static int dtls_prepare_record(dtls_peer_t *peer,
 	}
 
 	/* fix length of fragment in sendbuf */
-	dtls_int_to_uint16(sendbuf + 11, res);
+	dtls_int_to_uint16(start - sizeof(uint16), res);
 
-	*rlen = DTLS_RH_LENGTH + res;
+	*rlen = hlen + res;
 	return 0;
 }
 
@@ -1401,11 +1598,21 @@ static int dtls_send_multi(dtls_context_t *ctx, dtls_peer_t *peer,
 		/* copy handshake messages other than HelloVerify into retransmit buffer */
 		netq_t *n = netq_node_new(overall_len);
 		if (n) {
-			dtls_tick_t now;
-			dtls_ticks(&now);
-			n->t = now + 2 * bsp_get(E_BSP_GET_TRES);
-			n->retransmit_cnt = 0;
-			n->timeout = 2 * bsp_get(E_BSP_GET_TRES);
+			netq_t *flight = dtls_flight_head(ctx, peer);
+
+			if (flight) {
+				/* join the flight that is currently being sent so that all
+				 * its records are retransmitted together */
+				n->t = flight->t;
+				n->retransmit_cnt = flight->retransmit_cnt;
+				n->timeout = flight->timeout;
+			} else {
+				dtls_tick_t now;
+				dtls_ticks(&now);
+				n->timeout = DTLS_RETRANSMIT_TIMEOUT * bsp_get(E_BSP_GET_TRES);
+				n->t = now + n->timeout;
+				n->retransmit_cnt = 0;
+			}
 			n->peer = peer;
 			n->epoch = (security) ? security->epoch : 0;
 			n->type = type;
@@ -1421,9 +1628,7 @@ static int dtls_send_multi(dtls_context_t *ctx, dtls_peer_t *peer,
 
 #ifdef WITH_CONTIKI
 			} else {
-				/* must set timer within the context of the retransmit process */
-				/*should be inside the #ifdef with_contiki on the next line*/
-				etimer_set(&ctx->retransmit_timer, n->timeout, dtls_retransmit_process);
+				dtls_retransmit_schedule(ctx);
 
 #else /* WITH_CONTIKI */
 				dtls_debug("copied to sendqueue\n");
@@ -1646,7 +1851,6 @@ static int check_client_certificate_verify(dtls_context_t *ctx,
 	int ret;
 	unsigned char *result_r;
 	unsigned char *result_s;
-	dtls_hash_ctx hs_hash;
 	unsigned char sha256hash[DTLS_HMAC_DIGEST_SIZE];
 
 	assert(is_tls_ecdhe_ecdsa_with_aes_128_ccm_8(config->cipher));
@@ -1666,9 +1870,7 @@ static int check_client_certificate_verify(dtls_context_t *ctx,
 	data += ret;
 	data_length -= ret;
 
-	copy_hs_hash(peer, &hs_hash);
-
-	dtls_hash_finalize(sha256hash, &hs_hash);
+	snapshot_hs_hash(peer, sha256hash);
 
 	ret = dtls_ecdsa_verify_sig_hash(config->keyx.ecdsa.other_pub_x,
 			config->keyx.ecdsa.other_pub_y,
@@ -1683,11 +1885,33 @@ static int check_client_certificate_verify(dtls_context_t *ctx,
 }
 #endif /* DTLS_ECC */
 
+#if DTLS_CONNECTION_ID
+/**
+ * Writes the connection_id extension carrying the CID that @p peer
+ * shall use in records sent to us to @p p.
+ * \return pointer to the next byte after the extension.
+ */
+static uint8 *dtls_add_cid_extension(dtls_peer_t *peer, uint8 *p) {
+	dtls_int_to_uint16(p, TLS_EXT_CONNECTION_ID);
+	p += sizeof(uint16);
+
+	/* length of this extension type */
+	dtls_int_to_uint16(p, sizeof(uint8) + DTLS_CID_LENGTH);
+	p += sizeof(uint16);
+
+	dtls_int_to_uint8(p, DTLS_CID_LENGTH);
+	p += sizeof(uint8);
+
+	memcpy(p, peer->cid, DTLS_CID_LENGTH);
+	return p + DTLS_CID_LENGTH;
+}
+#endif /* DTLS_CONNECTION_ID */
+
 static int dtls_send_server_hello(dtls_context_t *ctx, dtls_peer_t *peer) {
 	/* Ensure that the largest message to create fits in our source
 	 * buffer. (The size of the destination buffer is checked by the
 	 * encoding function, so we do not need to guess.) */
-	uint8 buf[DTLS_SH_LENGTH + 2 + 5 + 5 + 8 + 6];
+	uint8 buf[DTLS_SH_LENGTH + 2 + 5 + 5 + 8 + 6 + DTLS_CID_EXT_LENGTH];
 	uint8 *p;
 	int ecdsa;
 	uint8 extension_size;
@@ -1696,7 +1920,14 @@ static int dtls_send_server_hello(dtls_context_t *ctx, dtls_peer_t *peer) {
 
 	ecdsa = is_tls_ecdhe_ecdsa_with_aes_128_ccm_8(handshake->cipher);
 
-	extension_size = (ecdsa) ? 2 + 5 + 5 + 6 : 0;
+	extension_size = (ecdsa) ? 5 + 5 + 6 : 0;
+#if DTLS_CONNECTION_ID
+	/* only answer with our CID if the client has offered one */
+	if (peer->cid_negotiated)
+		extension_size += DTLS_CID_EXT_LENGTH;
+#endif /* DTLS_CONNECTION_ID */
+	if (extension_size)
+		extension_size += 2; /* length of the extension list */
 
 	/* Handshake header */
 	p = buf;
@@ -1771,6 +2002,11 @@ static int dtls_send_server_hello(dtls_context_t *ctx, dtls_peer_t *peer) {
 		p += sizeof(uint8);
 	}
 
+#if DTLS_CONNECTION_ID
+	if (peer->cid_negotiated)
+		p = dtls_add_cid_extension(peer, p);
+#endif /* DTLS_CONNECTION_ID */
+
 	assert(p - buf <= sizeof(buf));
 
 	/* TODO use the same record sequence number as in the ClientHello,
@@ -2187,7 +2423,6 @@ static int dtls_send_certificate_verify_ecdh(dtls_context_t *ctx,
 	uint8 *p;
 	uint32_t point_r[9];
 	uint32_t point_s[9];
-	dtls_hash_ctx hs_hash;
 	unsigned char sha256hash[DTLS_HMAC_DIGEST_SIZE];
 
 	/* ServerKeyExchange
@@ -2195,9 +2430,7 @@ static int dtls_send_certificate_verify_ecdh(dtls_context_t *ctx,
 	 * Start message construction at beginning of buffer. */
 	p = buf;
 
-	copy_hs_hash(peer, &hs_hash);
-
-	dtls_hash_finalize(sha256hash, &hs_hash);
+	snapshot_hs_hash(peer, sha256hash);
 
 	/* sign the ephemeral and its paramaters */
 	dtls_ecdsa_create_sig_hash(key->priv_key, DTLS_EC_KEY_SIZE, sha256hash,
@@ -2217,12 +2450,9 @@ static int dtls_send_finished(dtls_context_t *ctx, dtls_peer_t *peer,
 	int length;
 	uint8 hash[DTLS_HMAC_MAX];
 	uint8 buf[DTLS_FIN_LENGTH];
-	dtls_hash_ctx hs_hash;
 	uint8 *p = buf;
 
-	copy_hs_hash(peer, &hs_hash);
-
-	length = dtls_hash_finalize(hash, &hs_hash);
+	length = snapshot_hs_hash(peer, hash);
 
 	dtls_prf(peer->handshake_params->tmp.master_secret,
 	DTLS_MASTER_SECRET_LENGTH, label, labellen, PRF_LABEL(finished),
@@ -2252,7 +2482,9 @@ static int dtls_send_client_hello(dtls_context_t *ctx, dtls_peer_t *peer,
 	ecdsa = is_ecdsa_supported(ctx, 1);
 
 	cipher_size = 2 + ((ecdsa) ? 2 : 0) + ((psk) ? 2 : 0);
-	extension_size = (ecdsa) ? 2 + 6 + 6 + 8 + 6 : 0;
+	extension_size = ((ecdsa) ? 6 + 6 + 8 + 6 : 0) + DTLS_CID_EXT_LENGTH;
+	if (extension_size)
+		extension_size += 2; /* length of the extension list */
 
 	if (cipher_size == 0) {
 		dtls_crit("no cipher callbacks implemented\n");
@@ -2379,6 +2611,11 @@ static int dtls_send_client_hello(dtls_context_t *ctx, dtls_peer_t *peer,
 		p += sizeof(uint8);
 	}
 
+#if DTLS_CONNECTION_ID
+	/* offer our CID, it is used once the server answers with its own */
+	p = dtls_add_cid_extension(peer, p);
+#endif /* DTLS_CONNECTION_ID */
+
 	assert(p - buf <= sizeof(buf));
 
 	if (cookie_length != 0)
@@ -2794,10 +3031,14 @@ static int decrypt_verify(dtls_peer_t *peer, uint8 *packet, size_t length,
 	dtls_record_header_t *header = DTLS_RECORD_HEADER(packet);
 	dtls_security_parameters_t *security = dtls_security_params_epoch(peer,
 			dtls_get_epoch(header));
+	unsigned int hlen = dtls_record_header_length(packet);
 	int clen;
+#if DTLS_CONNECTION_ID
+	int cid = packet[0] == DTLS_CT_TLS12_CID;
+#endif /* DTLS_CONNECTION_ID */
 
-	*cleartext = (uint8 *) packet + sizeof(dtls_record_header_t);
-	clen = length - sizeof(dtls_record_header_t);
+	*cleartext = (uint8 *) packet + hlen;
+	clen = length - hlen;
 
 	if (!security) {
 		dtls_alert("No security context for epoch: %i\n",
@@ -2807,6 +3048,10 @@ static int decrypt_verify(dtls_peer_t *peer, uint8 *packet, size_t length,
 
 	if (security->cipher == TLS_NULL_WITH_NULL_NULL) {
 		/* no cipher suite selected */
+#if DTLS_CONNECTION_ID
+		if (cid) /* tls12_cid records are always protected */
+			return -1;
+#endif /* DTLS_CONNECTION_ID */
 		return clen;
 	} else { /* TLS_PSK_WITH_AES_128_CCM_8 or TLS_ECDHE_ECDSA_WITH_AES_128_CCM_8 */
 		/**
@@ -2815,7 +3060,12 @@ static int decrypt_verify(dtls_peer_t *peer, uint8 *packet, size_t length,
 		 */
 #define A_DATA_LEN 13
 		unsigned char nonce[DTLS_CCM_BLOCKSIZE];
+#if DTLS_CONNECTION_ID
+		unsigned char A_DATA[DTLS_CID_A_DATA_LEN(DTLS_CID_LENGTH)];
+#else /* DTLS_CONNECTION_ID */
 		unsigned char A_DATA[A_DATA_LEN];
+#endif /* DTLS_CONNECTION_ID */
+		size_t a_data_len = A_DATA_LEN;
 
 		if (clen < 16) /* need at least IV and MAC */
 			return -1;
@@ -2842,13 +3092,25 @@ static int decrypt_verify(dtls_peer_t *peer, uint8 *packet, size_t length,
 		memcpy(A_DATA, &DTLS_RECORD_HEADER(packet)->epoch, 8); /* epoch and seq_num */
 		memcpy(A_DATA + 8, &DTLS_RECORD_HEADER(packet)->content_type, 3); /* type and version */
 		dtls_int_to_uint16(A_DATA + 11, clen - 8); /* length without nonce_explicit */
+#if DTLS_CONNECTION_ID
+		if (cid)
+			a_data_len = dtls_cid_additional_data(A_DATA, packet,
+					DTLS_CID_LENGTH, clen - 8);
+#endif /* DTLS_CONNECTION_ID */
 
 		clen = dtls_decrypt(*cleartext, clen, *cleartext, nonce,
 				dtls_kb_remote_write_key(security, peer->role),
-				dtls_kb_key_size(security, peer->role), A_DATA, A_DATA_LEN);
+				dtls_kb_key_size(security, peer->role), A_DATA, a_data_len);
 		if (clen < 0)
 			dtls_warn("decryption failed\n");
 		else {
+#if DTLS_CONNECTION_ID
+			if (cid && (clen = dtls_cid_inner_plaintext(packet, *cleartext,
+					clen)) < 0) {
+				dtls_warn("no content type in tls12_cid record\n");
+				return clen;
+			}
+#endif /* DTLS_CONNECTION_ID */
 #ifndef NDEBUG
 			printf("decrypt_verify(): found %i bytes cleartext\n", clen);
 #endif
@@ -3364,10 +3626,16 @@ static int handle_handshake(dtls_context_t *ctx, dtls_peer_t *peer,
 
 				if (dtls_uint16_to_int(node_header->message_seq)
 						== peer->handshake_params->hs_state.mseq_r) {
+					size_t length = node->length;
+
+					/* The netq arena is compacted when other nodes are freed
+					 * while the message is handled, so work on a copy. */
+					memcpy(ctx->readbuf, node->data, length);
 					netq_remove(peer->handshake_params->reorder_queue, node);
+					netq_node_free(node);
 					next = 1;
 					res = handle_handshake_msg(ctx, peer, session, role,
-							peer->state, node->data, node->length);
+							peer->state, ctx->readbuf, length);
 					if (res < 0) {
 						return res;
 					}
@@ -3541,10 +3809,51 @@ int dtls_handle_message(dtls_context_t *ctx, session_t *session, uint8 *msg,
 	while ((rlen = is_record(msg, msglen))) {
 		dtls_peer_type role;
 		dtls_state_t state;
+#if DTLS_CONNECTION_ID
+		int cid_record = msg[0] == DTLS_CT_TLS12_CID;
+#endif /* DTLS_CONNECTION_ID */
 
 		dtls_debug("got packet %d (%d bytes)\n", msg[0], rlen);
+#if DTLS_CONNECTION_ID
+		if (cid_record) {
+			/* The CID identifies the session, the transport address may
+			 * have changed since the handshake. */
+			dtls_peer_t *cid_peer = dtls_get_peer_by_cid(ctx,
+					msg + DTLS_CID_OFFSET);
+
+			if (!cid_peer || !cid_peer->cid_negotiated) {
+				dtls_info("dropped record with unknown connection id\n");
+				msg += rlen;
+				msglen -= rlen;
+				continue;
+			}
+			peer = cid_peer;
+		}
+#endif /* DTLS_CONNECTION_ID */
 		if (peer) {
 			data_length = decrypt_verify(peer, msg, rlen, &data);
+#if DTLS_CONNECTION_ID
+			if (cid_record) {
+				uint64_t rseq = dtls_uint64_to_int(DTLS_RECORD_HEADER(msg)->epoch);
+
+				if (data_length < 0) {
+					/* anyone can send us a CID, so a forged record must not
+					 * tear down the session */
+					dtls_info("dropped tls12_cid record that failed to verify\n");
+					msg += rlen;
+					msglen -= rlen;
+					continue;
+				}
+
+				/* only the newest record may move the session, see RFC 9146,
+				 * section 6 */
+				if (rseq > peer->cid_rseq) {
+					peer->cid_rseq = rseq;
+					if (!dtls_session_equals(&peer->session, session))
+						dtls_update_peer_session(ctx, peer, session);
+				}
+			}
+#endif /* DTLS_CONNECTION_ID */
 			if (data_length < 0) {
 				int err = dtls_alert_fatal_create(DTLS_ALERT_DECRYPT_ERROR);
 				dtls_info("decrypt_verify() failed\n");
@@ -3720,6 +4029,9 @@ dtls_new_context(void *app_data) {
 	else
 		goto error;
 
+	/* the cookie secret does not change, so the HMAC key setup is done once */
+	dtls_hmac_init(&c->cookie_hmac, c->cookie_secret, DTLS_COOKIE_SECRET_LENGTH);
+
 	return c;
 
 	error:
@@ -3815,56 +4127,100 @@ int dtls_connect(dtls_context_t *ctx, const session_t *dst) {
 	return res;
 }
 
-static void dtls_retransmit(dtls_context_t *context, netq_t *node) {
-	if (!context || !node)
+static netq_t *dtls_flight_head(dtls_context_t *context, dtls_peer_t *peer) {
+	netq_t *node;
+
+	for (node = netq_head(context->sendqueue); node; node = netq_next(node)) {
+		if (node->peer == peer)
+			return node;
+	}
+	return NULL;
+}
+
+static void dtls_retransmit_node(dtls_context_t *context, netq_t *node) {
+	unsigned char sendbuf[DTLS_MAX_BUF];
+	size_t len = sizeof(sendbuf);
+	int err;
+	unsigned char *data = node->data;
+	size_t length = node->length;
+	dtls_security_parameters_t *security = dtls_security_params_epoch(
+			node->peer, node->epoch);
+
+	if (node->type == DTLS_CT_HANDSHAKE) {
+		dtls_handshake_header_t *hs_header = DTLS_HANDSHAKE_HEADER(data);
+
+		dtls_debug("** retransmit handshake packet of type: %s (%i)\n",
+				dtls_handshake_type_to_name(hs_header->msg_type),
+				hs_header->msg_type);
+	} else {
+		dtls_debug("** retransmit packet\n");
+	}
+
+	err = dtls_prepare_record(node->peer, security, node->type, &data,
+			&length, 1, sendbuf, &len);
+	if (err < 0) {
+		dtls_warn("can not retransmit packet, err: %i\n", err);
 		return;
+	}
+	dtls_debug_hexdump("retransmit header", sendbuf,
+			sizeof(dtls_record_header_t));
+	dtls_debug_hexdump("retransmit unencrypted", node->data, node->length);
 
-	/* re-initialize timeout when maximum number of retransmissions are not reached yet */
-	if (node->retransmit_cnt < DTLS_DEFAULT_MAX_RETRANSMIT) {
-		unsigned char sendbuf[DTLS_MAX_BUF];
-		size_t len = sizeof(sendbuf);
-		int err;
-		unsigned char *data = node->data;
-		size_t length = node->length;
-		dtls_tick_t now;
-		dtls_security_parameters_t *security = dtls_security_params_epoch(
-				node->peer, node->epoch);
+	(void) CALL(context, write, &node->peer->session, sendbuf, len);
+}
 
-		dtls_ticks(&now);
-		node->retransmit_cnt++;
-		node->t = now + (node->timeout << node->retransmit_cnt);
-		netq_insert_node(context->sendqueue, node);
+/**
+ * Retransmits the whole flight queued for \p peer. RFC 6347 treats a
+ * flight as the unit of retransmission: all of its records are resent
+ * in their original order and share one deadline, which is doubled on
+ * each attempt up to DTLS_RETRANSMIT_MAX_TIMEOUT. Once the maximum
+ * number of retransmissions is reached, the flight is dropped.
+ */
+static void dtls_retransmit(dtls_context_t *context, dtls_peer_t *peer) {
+	netq_t *flight = NULL, **tail = &flight;
+	netq_t *node, *next;
+	clock_time_t timeout;
+	dtls_tick_t now;
 
-		if (node->type == DTLS_CT_HANDSHAKE) {
-			dtls_handshake_header_t *hs_header = DTLS_HANDSHAKE_HEADER(data);
+	if (!context || !peer)
+		return;
 
-			dtls_debug("** retransmit handshake packet of type: %s (%i)\n",
-					dtls_handshake_type_to_name(hs_header->msg_type),
-					hs_header->msg_type);
-		} else {
-			dtls_debug("** retransmit packet\n");
+	/* take the flight out of the queue, keeping the send order */
+	for (node = netq_head(context->sendqueue); node; node = next) {
+		next = netq_next(node);
+		if (node->peer == peer) {
+			netq_remove(context->sendqueue, node);
+			node->next = NULL;
+			*tail = node;
+			tail = &node->next;
 		}
+	}
 
-		err = dtls_prepare_record(node->peer, security, node->type, &data,
-				&length, 1, sendbuf, &len);
-		if (err < 0) {
-			dtls_warn("can not retransmit packet, err: %i\n", err);
-			return;
-		}
-		dtls_debug_hexdump("retransmit header", sendbuf,
-				sizeof(dtls_record_header_t));
-		dtls_debug_hexdump("retransmit unencrypted", node->data, node->length);
+	if (!flight)
+		return;
 
-		(void) CALL(context, write, &node->peer->session, sendbuf, len);
+	if (flight->retransmit_cnt >= DTLS_DEFAULT_MAX_RETRANSMIT) {
+		/* no more retransmissions, remove flight from system */
+		dtls_debug("** removed transaction\n");
+		for (node = flight; node; node = next) {
+			next = node->next;
+			netq_node_free(node);
+		}
 		return;
 	}
 
-	/* no more retransmissions, remove node from system */
+	timeout = flight->timeout << (flight->retransmit_cnt + 1);
+	if (timeout > DTLS_RETRANSMIT_MAX_TIMEOUT * bsp_get(E_BSP_GET_TRES))
+		timeout = DTLS_RETRANSMIT_MAX_TIMEOUT * bsp_get(E_BSP_GET_TRES);
 
-	dtls_debug("** removed transaction\n");
-
-	/* And finally delete the node */
-	netq_node_free(node);
+	dtls_ticks(&now);
+	for (node = flight; node; node = next) {
+		next = node->next;
+		node->retransmit_cnt++;
+		node->t = now + timeout;
+		netq_insert_node(context->sendqueue, node);
+		dtls_retransmit_node(context, node);
+	}
 }
 
 static void dtls_stop_retransmission(dtls_context_t *context, dtls_peer_t *peer) {
@@ -3880,6 +4236,9 @@ static void dtls_stop_retransmission(dtls_context_t *context, dtls_peer_t *peer)
 		} else
 			node = list_item_next(node);
 	}
+#ifdef WITH_CONTIKI
+	dtls_retransmit_schedule(context);
+#endif /* WITH_CONTIKI */
 }
 
 void dtls_check_retransmit(dtls_context_t *context, clock_time_t *next) {
@@ -3888,8 +4247,7 @@ void dtls_check_retransmit(dtls_context_t *context, clock_time_t *next) {
 
 	dtls_ticks(&now);
 	while (node && node->t <= now) {
-		netq_pop_first(context->sendqueue);
-		dtls_retransmit(context, node);
+		dtls_retransmit(context, node->peer);
 		node = netq_head(context->sendqueue);
 	}
 
@@ -3901,29 +4259,38 @@ void dtls_check_retransmit(dtls_context_t *context, clock_time_t *next) {
 /*---------------------------------------------------------------------------*/
 /* message retransmission */
 /*---------------------------------------------------------------------------*/
-void dtls_retransmit_process(c_event_t c_event, p_data_t p_data)
+/**
+ * Arms the retransmission timer for the earliest flight deadline in
+ * the send queue, or stops it when nothing is queued. All records of a
+ * flight share one deadline, so the timer fires once per flight.
+ */
+static void dtls_retransmit_schedule(dtls_context_t *context)
 {
+	netq_t *node = netq_head(context->sendqueue);
 	clock_time_t now;
-	netq_t *node;
 
-	if(c_event == EVENT_TYPE_TIMER_EXP) {
-		if (etimer_expired(&the_dtls_context.retransmit_timer)) {
-			node = list_head(the_dtls_context.sendqueue);
-			now = bsp_getTick();
+	if (!node) {
+		etimer_stop(&context->retransmit_timer);
+		return;
+	}
 
-			if (node && node->t <= now) {
-				dtls_debug("Started DTLS retransmit process\r\n");
-				dtls_retransmit(&the_dtls_context, list_pop(the_dtls_context.sendqueue));
-				node = list_head(the_dtls_context.sendqueue);
-			}
-			/* need to set timer to some value even if no nextpdu is available */
-			if (node) {
-				timer_set(&the_dtls_context.retransmit_timer.timer,
-						node->t <= now ? 1 : node->t - now);
-			} else {
-				etimer_stop(&the_dtls_context.retransmit_timer);
-			}
-		}
+	/* keep the timer if it is already armed for this deadline */
+	if (!etimer_expired(&context->retransmit_timer)
+			&& etimer_expiration_time(&context->retransmit_timer) == node->t)
+		return;
+
+	now = bsp_getTick();
+	etimer_set(&context->retransmit_timer,
+			node->t <= now ? 1 : node->t - now, dtls_retransmit_process);
+}
+
+void dtls_retransmit_process(c_event_t c_event, p_data_t p_data)
+{
+	if (c_event == EVENT_TYPE_TIMER_EXP
+			&& p_data == (p_data_t) &the_dtls_context.retransmit_timer) {
+		dtls_debug("Started DTLS retransmit process\r\n");
+		dtls_check_retransmit(&the_dtls_context, NULL);
+		dtls_retransmit_schedule(&the_dtls_context);
 	}
 }
 #endif /* WITH_CONTIKI */
@@ -104,6 +104,10 @@ const uint32_t ecc_g_point_x[8] = { 0xD898C296, 0xF4A13945, 0x2DEB33A0, 0x77037D
 const uint32_t ecc_g_point_y[8] = { 0x37BF51F5, 0xCBB64068, 0x6B315ECE, 0x2BCE3357,
 				    0x7C0F9E16, 0x8EE7EB4A, 0xFE1A7F9B, 0x4FE342E2};
 
+// 5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b
+static const uint32_t ecc_b[8] = { 0x27D2604B, 0x3BCE3C3E, 0xCC53B0F6, 0x651D06B0,
+				   0x769886BC, 0xB3EBBD55, 0xAA3A93E7, 0x5AC635D8};
+
 
 static void setZero(uint32_t *A, const int length){
 	memset(A, 0x0, length * sizeof(uint32_t));
@@ -516,6 +520,77 @@ void ecc_ec_mult(const uint32_t *px, const uint32_t *py, const uint32_t *secret,
 	copy(Qy, resulty,arrayLength);
 }
 
+/*
+ * Fills a table with the sums i * G + j * Q for 0 <= i, j < 2^window,
+ * see ecc_table_t for the layout. Each entry costs one point addition.
+ */
+static void ec_table_fill(uint32_t (*tx)[8], uint32_t (*ty)[8], uint8_t window, const uint32_t *qx, const uint32_t *qy){
+	uint8_t n = 1 << window;
+	uint8_t i, j, idx;
+
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < n; i++) {
+			idx = i + (j << window);
+			if (idx == 0)
+				continue;
+			if (j == 0) {
+				if (i == 1) {
+					copy(ecc_g_point_x, tx[0], arrayLength);
+					copy(ecc_g_point_y, ty[0], arrayLength);
+				} else { // i * G = (i - 1) * G + G
+					ec_add(tx[i - 2], ty[i - 2], ecc_g_point_x, ecc_g_point_y, tx[idx - 1], ty[idx - 1]);
+				}
+			} else if (i == 0) {
+				if (j == 1) {
+					copy(qx, tx[idx - 1], arrayLength);
+					copy(qy, ty[idx - 1], arrayLength);
+				} else { // j * Q = (j - 1) * Q + Q
+					ec_add(tx[((j - 1) << window) - 1], ty[((j - 1) << window) - 1], qx, qy, tx[idx - 1], ty[idx - 1]);
+				}
+			} else { // i * G + j * Q
+				ec_add(tx[i - 1], ty[i - 1], tx[(j << window) - 1], ty[(j << window) - 1], tx[idx - 1], ty[idx - 1]);
+			}
+		}
+	}
+}
+
+/*
+ * Calculates u1 * G + u2 * Q with Straus's algorithm (Shamir's trick):
+ * both scalars are scanned window by window and share a single chain
+ * of doublings, each window adds at most one point from the table
+ * filled by ec_table_fill(). This roughly halves the work of two
+ * independent scalar multiplications.
+ */
+static void ec_mult_table(const uint32_t (*tx)[8], const uint32_t (*ty)[8], uint8_t window, const uint32_t *u1, const uint32_t *u2, uint32_t *resultx, uint32_t *resulty){
+	uint32_t Qx[8];
+	uint32_t Qy[8];
+	uint32_t tempx[8];
+	uint32_t tempy[8];
+	uint32_t mask = (1 << window) - 1;
+	uint32_t idx;
+	int i, d;
+
+	setZero(Qx, 8);
+	setZero(Qy, 8);
+
+	for (i = 256; i;){
+		i -= window;
+		for (d = 0; d < window; d++) {
+			ec_double(Qx, Qy, tempx, tempy);
+			copy(tempx, Qx,arrayLength);
+			copy(tempy, Qy,arrayLength);
+		}
+		idx = ((u1[i / 32] >> (i % 32)) & mask) | (((u2[i / 32] >> (i % 32)) & mask) << window);
+		if (idx) {
+			ec_add(Qx, Qy, tx[idx - 1], ty[idx - 1], tempx, tempy);
+			copy(tempx, Qx,arrayLength);
+			copy(tempy, Qy,arrayLength);
+		}
+	}
+	copy(Qx, resultx,arrayLength);
+	copy(Qy, resulty,arrayLength);
+}
+
 /**
  * Calculate the ecdsa signature.
  *
@@ -577,6 +652,36 @@ int ecc_ecdsa_sign(const uint32_t *d, const uint32_t *e, const uint32_t *k, uint
 	return 0;
 }
 
+/*
+ * Steps 1 to 4 of the ecdsa signature verification: checks that r and
+ * s are in [1, n-1] and calculates u_1 = zw and u_2 = rw with
+ * w = s^{-1} (mod n).
+ */
+static int ecdsa_scalars(const uint32_t *e, const uint32_t *r, const uint32_t *s, uint32_t *u1, uint32_t *u2)
+{
+	uint32_t w[8];
+	uint32_t tmp[16];
+
+	// 1. Verify that r and s are integers in [1, n-1].
+	if (isZero(r) || isZero(s) ||
+	    isGreater(ecc_order_m, r, arrayLength) <= 0 ||
+	    isGreater(ecc_order_m, s, arrayLength) <= 0)
+		return -1;
+
+	// 3. Calculate w = s^{-1} \pmod{n}
+	fieldInv(s, ecc_order_m, ecc_order_r, w);
+
+	// 4. Calculate u_1 = zw \pmod{n}
+	fieldMult(e, w, tmp, arrayLength);
+	fieldModO(tmp, u1, 16);
+
+	// 4. Calculate u_2 = rw \pmod{n}
+	fieldMult(r, w, tmp, arrayLength);
+	fieldModO(tmp, u2, 16);
+
+	return 0;
+}
+
 /**
  * Verifies a ecdsa signature.
  *
@@ -596,40 +701,91 @@ int ecc_ecdsa_sign(const uint32_t *d, const uint32_t *e, const uint32_t *k, uint
  */
 int ecc_ecdsa_validate(const uint32_t *x, const uint32_t *y, const uint32_t *e, const uint32_t *r, const uint32_t *s)
 {
-	uint32_t w[8];
-	uint32_t tmp[16];
 	uint32_t u1[9];
 	uint32_t u2[9];
-	uint32_t tmp1_x[8];
-	uint32_t tmp1_y[8];
-	uint32_t tmp2_x[8];
-	uint32_t tmp2_y[8];
-	uint32_t tmp3_x[8];
-	uint32_t tmp3_y[8];
+	uint32_t tx[3][8];
+	uint32_t ty[3][8];
+	uint32_t tmp_x[8];
+	uint32_t tmp_y[8];
 
-	// 3. Calculate w = s^{-1} \pmod{n}
-	fieldInv(s, ecc_order_m, ecc_order_r, w);
+	if (ecdsa_scalars(e, r, s, u1, u2))
+		return -1;
 
-	// 4. Calculate u_1 = zw \pmod{n}
-	fieldMult(e, w, tmp, arrayLength);
-	fieldModO(tmp, u1, 16);
+	// 5. Calculate the curve point (x_1, y_1) = u_1 * G + u_2 * Q_A.
+	// tx, ty = G, Q_A, G + Q_A
+	ec_table_fill(tx, ty, 1, x, y);
+	ec_mult_table((const uint32_t (*)[8])tx, (const uint32_t (*)[8])ty, 1, u1, u2, tmp_x, tmp_y);
 
-	// 4. Calculate u_2 = rw \pmod{n}
-	fieldMult(r, w, tmp, arrayLength);
-	fieldModO(tmp, u2, 16);
+	return isSame(tmp_x, r, arrayLength) ? 0 : -1;
+}
 
-	// 5. Calculate the curve point (x_1, y_1) = u_1 * G + u_2 * Q_A.
-	// tmp1 = u_1 * G
-	ecc_ec_mult(ecc_g_point_x, ecc_g_point_y, u1, tmp1_x, tmp1_y);
+/**
+ * Precomputes the table of the public key (x, y) used by
+ * ecc_ecdsa_validate_table(). This costs ECC_TABLE_SIZE - 2 point
+ * additions and pays off from the first verification on.
+ */
+void ecc_table_init(ecc_table_t *table, const uint32_t *x, const uint32_t *y)
+{
+	ec_table_fill(table->x, table->y, ECC_TABLE_WINDOW, x, y);
+}
+
+/**
+ * Verifies a ecdsa signature like ecc_ecdsa_validate() with a table
+ * precomputed by ecc_table_init() for the public key.
+ */
+int ecc_ecdsa_validate_table(const ecc_table_t *table, const uint32_t *e, const uint32_t *r, const uint32_t *s)
+{
+	uint32_t u1[9];
+	uint32_t u2[9];
+	uint32_t tmp_x[8];
+	uint32_t tmp_y[8];
+
+	if (ecdsa_scalars(e, r, s, u1, u2))
+		return -1;
 
-	// tmp2 = u_2 * Q_A
-	ecc_ec_mult(x, y, u2, tmp2_x, tmp2_y);
+	ec_mult_table(table->x, table->y, ECC_TABLE_WINDOW, u1, u2, tmp_x, tmp_y);
 
-	// tmp3 = tmp1 + tmp2
-	ec_add(tmp1_x, tmp1_y, tmp2_x, tmp2_y, tmp3_x, tmp3_y);
-	// TODO: this u_1 * G + u_2 * Q_A  could be optimiced with Straus's algorithm.
+	return isSame(tmp_x, r, arrayLength) ? 0 : -1;
+}
+
+/**
+ * Checks that (x, y) is a point on the curve secp256r1, i.e.
+ * y^2 = x^3 - 3x + b (mod p) with both coordinates below p.
+ *
+ * return:
+ *  1: the point is on the curve
+ *  0: the point is not on the curve
+ */
+int ecc_is_valid_point(const uint32_t *x, const uint32_t *y)
+{
+	uint32_t tmp[16];
+	uint32_t lhs[8];
+	uint32_t rhs[8];
+	uint32_t t[8];
+	uint32_t three[8];
+
+	if (isGreater(x, ecc_prime_m, arrayLength) >= 0 || isGreater(y, ecc_prime_m, arrayLength) >= 0)
+		return 0;
 
-	return isSame(tmp3_x, r, arrayLength) ? 0 : -1;
+	fieldMult(y, y, tmp, arrayLength);
+	fieldModP(lhs, tmp); // lhs = y^2
+
+	setZero(three, 8);
+	three[0] = 0x00000003;
+	fieldMult(x, x, tmp, arrayLength);
+	fieldModP(t, tmp); // t = x^2
+	fieldSub(t, three, ecc_prime_m, rhs); // rhs = x^2 - 3
+	fieldMult(rhs, x, tmp, arrayLength);
+	fieldModP(t, tmp); // t = x^3 - 3x
+	fieldAdd(t, ecc_b, ecc_prime_r, rhs); // rhs = x^3 - 3x + b
+
+	// the field functions do not always reduce completely
+	while (isGreater(lhs, ecc_prime_m, arrayLength) >= 0)
+		sub(lhs, ecc_prime_m, lhs, arrayLength);
+	while (isGreater(rhs, ecc_prime_m, arrayLength) >= 0)
+		sub(rhs, ecc_prime_m, rhs, arrayLength);
+
+	return isSame(lhs, rhs, arrayLength);
 }
 
 int ecc_is_valid_key(const uint32_t * priv_key)
@@ -92,29 +92,44 @@ dtls_hmac_new(const unsigned char *key, size_t klen) {
 
 void
 dtls_hmac_init(dtls_hmac_context_t *ctx, const unsigned char *key, size_t klen) {
+  unsigned char pad[DTLS_HMAC_BLOCKSIZE];
   int i;
 
   assert(ctx);
 
   memset(ctx, 0, sizeof(dtls_hmac_context_t));
+  memset(pad, 0, sizeof(pad));
 
   if (klen > DTLS_HMAC_BLOCKSIZE) {
     dtls_hash_init(&ctx->data);
     dtls_hash_update(&ctx->data, key, klen);
-    dtls_hash_finalize(ctx->pad, &ctx->data);
+    dtls_hash_finalize(pad, &ctx->data);
   } else
-    memcpy(ctx->pad, key, klen);
+    memcpy(pad, key, klen);
 
-  /* create ipad: */
+  /* create opad and keep the midstate after hashing it: */
   for (i=0; i < DTLS_HMAC_BLOCKSIZE; ++i)
-    ctx->pad[i] ^= 0x36;
+    pad[i] ^= 0x5C;
 
   dtls_hash_init(&ctx->data);
-  dtls_hmac_update(ctx, ctx->pad, DTLS_HMAC_BLOCKSIZE);
+  dtls_hash_update(&ctx->data, pad, DTLS_HMAC_BLOCKSIZE);
+  dtls_hash_midstate(ctx->ostate, &ctx->data);
 
-  /* create opad by xor-ing pad[i] with 0x36 ^ 0x5C: */
+  /* create ipad by xor-ing pad[i] with 0x5C ^ 0x36: */
   for (i=0; i < DTLS_HMAC_BLOCKSIZE; ++i)
-    ctx->pad[i] ^= 0x6A;
+    pad[i] ^= 0x6A;
+
+  dtls_hash_init(&ctx->data);
+  dtls_hash_update(&ctx->data, pad, DTLS_HMAC_BLOCKSIZE);
+  dtls_hash_midstate(ctx->istate, &ctx->data);
+
+  memset(pad, 0, sizeof(pad));
+}
+
+void
+dtls_hmac_reset(dtls_hmac_context_t *ctx) {
+  assert(ctx);
+  dtls_hash_resume(&ctx->data, ctx->istate);
 }
 
 void
@@ -133,8 +148,7 @@ dtls_hmac_finalize(dtls_hmac_context_t *ctx, unsigned char *result) {
 
   len = dtls_hash_finalize(buf, &ctx->data);
 
-  dtls_hash_init(&ctx->data);
-  dtls_hash_update(&ctx->data, ctx->pad, DTLS_HMAC_BLOCKSIZE);
+  dtls_hash_resume(&ctx->data, ctx->ostate);
   dtls_hash_update(&ctx->data, buf, len);
 
   len = dtls_hash_finalize(result, &ctx->data);
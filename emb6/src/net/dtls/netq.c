@@ -21,6 +21,9 @@
 
 #include "t_list.h"
 
+#include <stddef.h>
+#include <string.h>
+
 #ifndef WITH_CONTIKI
 #include <stdlib.h>
 
@@ -41,37 +44,84 @@ netq_free_node(netq_t *node) {
 
 MEMB(netq_storage, netq_t, NETQ_MAXCNT);
 
+/* Datagram storage for all nodes. Allocations are appended at the end
+ * and the arena is compacted on free (see mmem.c), so no space is
+ * lost to fragmentation. netq_arena_head lists the nodes in the order
+ * of their data in the arena. */
+static unsigned char netq_arena[NETQ_ARENA_SIZE];
+static size_t netq_arena_used;
+static netq_t *netq_arena_head;
+
 static inline netq_t *
 netq_malloc_node(size_t size) {
-  return (netq_t *)memb_alloc(&netq_storage);
+  netq_t *node, *p;
+
+  if (size > NETQ_ARENA_SIZE - netq_arena_used)
+    return NULL;
+
+  node = (netq_t *)memb_alloc(&netq_storage);
+  if (!node)
+    return NULL;
+
+  node->arena_next = NULL;
+  node->size = size;
+  node->data = netq_arena + netq_arena_used;
+  netq_arena_used += size;
+
+  if (!netq_arena_head) {
+    netq_arena_head = node;
+  } else {
+    for (p = netq_arena_head; p->arena_next; p = p->arena_next)
+      ;
+    p->arena_next = node;
+  }
+
+  return node;
 }
 
 static inline void
 netq_free_node(netq_t *node) {
+  netq_t **pp, *p;
+  unsigned char *end;
+
+  for (pp = &netq_arena_head; *pp && *pp != node; pp = &(*pp)->arena_next)
+    ;
+  if (!*pp)
+    return;
+  *pp = node->arena_next;
+
+  /* move all datagrams behind node downwards */
+  end = node->data + node->size;
+  memmove(node->data, end, netq_arena + netq_arena_used - end);
+  for (p = node->arena_next; p; p = p->arena_next)
+    p->data -= node->size;
+  netq_arena_used -= node->size;
+
   memb_free(&netq_storage, node);
 }
 
 void
 netq_init() {
   memb_init(&netq_storage);
+  netq_arena_used = 0;
+  netq_arena_head = NULL;
 }
 #endif /* WITH_CONTIKI */
 
 int
 netq_insert_node(list_t queue, netq_t *node) {
-  netq_t *p;
+  netq_t *p, *prev = NULL;
 
   assert(queue);
   assert(node);
 
-  p = (netq_t *)list_head(queue);
-  while(p && p->t <= node->t && list_item_next(p))
-    p = list_item_next(p);
+  /* insert behind all nodes that are due at the same time to keep
+   * the send order of a flight */
+  for (p = (netq_t *)list_head(queue); p && p->t <= node->t;
+       p = list_item_next(p))
+    prev = p;
 
-  if (p)
-    list_insert(queue, p, node);
-  else
-    list_push(queue, node);
+  list_insert(queue, prev, node);
 
   return 1;
 }
@@ -117,8 +167,13 @@ netq_node_new(size_t size) {
     dtls_warn("netq_node_new: malloc\n");
 #endif
 
-  if (node)
+  if (node) {
+#ifndef WITH_CONTIKI
     memset(node, 0, sizeof(netq_t));
+#else
+    memset(node, 0, offsetof(netq_t, arena_next));
+#endif
+  }
 
   return node;
 }
@@ -252,6 +252,10 @@ void SHA512_Last(SHA512_CTX*);
 void SHA256_Transform(SHA256_CTX*, const sha2_word32*);
 void SHA512_Transform(SHA512_CTX*, const sha2_word64*);
 
+#ifdef SHA2_WITH_STATS
+unsigned long sha256_compressions;
+#endif
+
 #ifdef WITH_SHA256
 /*** SHA-XYZ INITIAL HASH VALUES AND CONSTANTS ************************/
 /* Hash constant words K for SHA-256: */
@@ -421,6 +425,10 @@ void SHA256_Transform(SHA256_CTX* context, const sha2_word32* data) {
 	sha2_word32	T1, *W256;
 	int		j;
 
+#ifdef SHA2_WITH_STATS
+	sha256_compressions++;
+#endif
+
 	W256 = (sha2_word32*)context->buffer;
 
 	/* Initialize registers with the prev. intermediate value */
@@ -479,6 +487,10 @@ void SHA256_Transform(SHA256_CTX* context, const sha2_word32* data) {
 	sha2_word32	T1, T2, *W256;
 	int		j;
 
+#ifdef SHA2_WITH_STATS
+	sha256_compressions++;
+#endif
+
 	W256 = (sha2_word32*)context->buffer;
 
 	/* Initialize registers with the prev. intermediate value */
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *
+ * Authors: Simon Duquennoy <simonduq@sics.se>
+ */
+/**
+ * \file
+ *         Per-neighbour link statistics: ETX, RSSI, LQI and freshness
+ */
+
+#include "emb6.h"
+#include "bsp.h"
+#include "ctimer.h"
+#include "packetbuf.h"
+#include "nbr-table.h"
+#include "uip-ds6-nbr.h"
+#include "link-stats.h"
+
+#define DEBUG DEBUG_NONE
+#include "uip-debug.h"
+
+/* EWMA weights of a new sample, in percent. A link that is not fresh
+   converges faster so that a few probes are enough to correct it. */
+#define EWMA_SCALE            100
+#define EWMA_ALPHA             10
+#define EWMA_BOOTSTRAP_ALPHA   30
+
+/* Saturation value of the freshness counter */
+#define FRESHNESS_MAX          16
+
+NBR_TABLE(struct link_stats, link_stats);
+
+static struct ctimer periodic_timer;
+
+/*---------------------------------------------------------------------------*/
+const struct link_stats *
+link_stats_from_lladdr(const linkaddr_t *lladdr)
+{
+  return nbr_table_get_from_lladdr(link_stats, lladdr);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+link_stats_is_fresh(const struct link_stats *stats)
+{
+  return stats != NULL &&
+         stats->freshness >= LINK_STATS_FRESHNESS_TARGET &&
+         (bsp_getTick() - stats->last_tx_time) <
+         (clock_time_t)LINK_STATS_FRESHNESS_EXPIRATION * bsp_get(E_BSP_GET_TRES);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx)
+{
+  struct link_stats *stats;
+  uint16_t packet_etx;
+  uint8_t ewma_alpha;
+
+  /* Collisions and other local errors say nothing about the link */
+  if(status != MAC_TX_OK && status != MAC_TX_NOACK) {
+    return;
+  }
+
+  stats = nbr_table_get_from_lladdr(link_stats, lladdr);
+  if(stats == NULL) {
+    stats = nbr_table_add_lladdr(link_stats, lladdr);
+    if(stats == NULL) {
+      return;
+    }
+  }
+
+  stats->last_tx_time = bsp_getTick();
+  if(stats->freshness < FRESHNESS_MAX) {
+    stats->freshness++;
+  }
+
+  if(status == MAC_TX_NOACK) {
+    packet_etx = LINK_STATS_ETX_NOACK_PENALTY * LINK_STATS_ETX_DIVISOR;
+  } else {
+    packet_etx = numtx * LINK_STATS_ETX_DIVISOR;
+  }
+
+  if(stats->etx == 0) {
+    /* First sample for this link */
+    stats->etx = packet_etx;
+  } else {
+    ewma_alpha = link_stats_is_fresh(stats) ? EWMA_ALPHA : EWMA_BOOTSTRAP_ALPHA;
+    stats->etx = ((uint32_t)stats->etx * (EWMA_SCALE - ewma_alpha) +
+                  (uint32_t)packet_etx * ewma_alpha) / EWMA_SCALE;
+  }
+
+  PRINTF("link-stats: ETX %u (packet ETX %u, freshness %u)\n\r",
+         (unsigned)stats->etx, (unsigned)packet_etx,
+         (unsigned)stats->freshness);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_input_callback(const linkaddr_t *lladdr)
+{
+  struct link_stats *stats;
+
+  stats = nbr_table_get_from_lladdr(link_stats, lladdr);
+  if(stats == NULL) {
+    /* Only take a slot for neighbours the stack already knows, a frame
+       overheard from a stranger must not evict a neighbour cache entry */
+    if(nbr_table_get_from_lladdr(ds6_neighbors, lladdr) == NULL) {
+      return;
+    }
+    stats = nbr_table_add_lladdr(link_stats, lladdr);
+    if(stats == NULL) {
+      return;
+    }
+  }
+
+  stats->rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  stats->lqi = (uint8_t)packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY);
+}
+/*---------------------------------------------------------------------------*/
+static void
+periodic(void *ptr)
+{
+  struct link_stats *stats;
+
+  /* Age the freshness of every link */
+  for(stats = nbr_table_head(link_stats); stats != NULL;
+      stats = nbr_table_next(link_stats, stats)) {
+    stats->freshness >>= 1;
+  }
+  ctimer_reset(&periodic_timer);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_init(void)
+{
+  nbr_table_register(link_stats, NULL);
+  ctimer_set(&periodic_timer,
+             (clock_time_t)LINK_STATS_FRESHNESS_HALF_LIFE * bsp_get(E_BSP_GET_TRES),
+             periodic, NULL);
+}
@@ -0,0 +1,1163 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup mpl-multicast
+ * @{
+ */
+/**
+ * \file
+ *    Implementation of the MPL multicast engine (RFC 7731)
+ *
+ *    All buffered messages share one ctimer, armed for the earliest Trickle
+ *    event among them, and the control Trickle timer has a second one.
+ */
+
+#include "emb6.h"
+#include "uip-icmp6.h"
+#include "uip-mcast6.h"
+#include "uip-ds6.h"
+#include "mpl.h"
+#include "bsp.h"
+#include "ctimer.h"
+#include "memb.h"
+#include "random.h"
+
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "uip-debug.h"
+
+/*---------------------------------------------------------------------------*/
+/* Data Representation */
+/*---------------------------------------------------------------------------*/
+/* S field of the MPL Option and of MPL Seed Info */
+#define SEED_ID_S_SRC            0  /* Seed-id is the IPv6 source address */
+#define SEED_ID_S_16             1
+#define SEED_ID_S_64             2
+#define SEED_ID_S_128            3
+
+/*
+ * Seed-ids are stored with their length. A seed-id elided in favour of the
+ * IPv6 source address (S = 0) is stored as the equivalent 128-bit seed-id.
+ */
+typedef struct seed_id {
+  uint8_t len;
+  uint8_t id[16];
+} seed_id_t;
+
+#define PRINT_SEED(s) PRINTF("%u/..%02x%02x", (s)->len, \
+                             (s)->id[(s)->len - 2], (s)->id[(s)->len - 1])
+
+/* Sequence numbers are compared in 8-bit serial number arithmetic */
+#define SEQ_VAL_IS_LT(a, b) ((int8_t)((uint8_t)(a) - (uint8_t)(b)) < 0)
+
+/* Has the absolute tick count when been reached at now? */
+#define TIME_REACHED(now, when) ((int32_t)((now) - (when)) >= 0)
+
+/* Trickle Timers */
+struct trickle_param {
+  clock_time_t start;           /* Start of the interval (absolute) */
+  clock_time_t i;               /* Interval length */
+  clock_time_t t;               /* Transmission point, relative to start */
+  uint8_t c;                    /* Consistency counter */
+  uint8_t e;                    /* Intervals ended since the last reset */
+  uint8_t flags;
+};
+
+#define TRICKLE_RUNNING          0x01
+#define TRICKLE_FIRED            0x02   /* Point t of this interval passed */
+
+#define DATA_IMAX \
+  ((clock_time_t)MPL_DATA_MESSAGE_IMIN << MPL_DATA_MESSAGE_IMAX)
+#define CONTROL_IMAX \
+  ((clock_time_t)MPL_CONTROL_MESSAGE_IMIN << MPL_CONTROL_MESSAGE_IMAX)
+
+/* Buffered Messages */
+struct mpl_msg {
+  struct mpl_msg *next;         /* Next message of the seed, by sequence */
+  struct mpl_msg *older;        /* Neighbours in the buffer age list */
+  struct mpl_msg *newer;
+  struct mpl_seed *seed;
+  struct trickle_param tp;
+  uint16_t buff_len;
+  uint8_t seq;
+  uint8_t buff[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+
+/**
+ * \brief Get the hop limit of a buffered message
+ * m: pointer to a struct mpl_msg
+ */
+#define MPL_MSG_TTL(m) (((struct uip_ip_hdr *)(m)->buff)->ttl)
+
+/* Seed Set Entries */
+struct mpl_seed {
+  struct mpl_seed *next;        /* Next seed in the same hash bucket */
+  struct mpl_msg *head;         /* Lowest buffered sequence number */
+  struct mpl_msg *tail;         /* Highest buffered sequence number */
+  clock_time_t expires;
+  seed_id_t seed_id;
+  uint8_t min_seqno;
+  uint8_t count;
+  uint8_t flags;
+};
+
+#define SEED_LISTED              0x01   /* Listed in current control msg */
+
+#define SEED_HASH_SIZE           MPL_SEED_SET_SIZE
+
+/* MPL HBH Option, the seed-id (0, 2, 8 or 16 bytes) follows */
+struct hbho_mpl {
+  uint8_t type;
+  uint8_t len;
+  uint8_t flags;                /* S (2 bits), M, V, reserved */
+  uint8_t seq;
+};
+
+#define HBHO_MPL_GET_S(h)        ((h)->flags >> 6)
+#define HBHO_MPL_M_BIT           0x20
+#define HBHO_MPL_V_BIT           0x10
+#define HBHO_MPL_LEN_SRC_SEED    2
+#define HBHO_TOTAL_LEN           8
+
+/* MPL Seed Info in control messages: min-seqno, bm-len (6 bits) and S
+ * (2 bits), then the seed-id and bm-len bytes of buffered message bitmap */
+#define SEED_INFO_LEN            2
+#define SEED_INFO_BM_LEN(p)      ((p)[1] >> 2)
+#define SEED_INFO_S(p)           ((p)[1] & 0x03)
+
+/* Bit off of bitmap bm, most significant bit first */
+#define BITMAP_IS_SET(bm, off)   ((bm)[(off) >> 3] & (0x80 >> ((off) & 7)))
+#define BITMAP_SET(bm, off)      ((bm)[(off) >> 3] |= (0x80 >> ((off) & 7)))
+/*---------------------------------------------------------------------------*/
+/* Destination for our ICMPv6 datagrams: FF02::FC, all MPL forwarders */
+#define mpl_create_all_forwarders(a) \
+  uip_ip6addr(a, 0xff02, 0, 0, 0, 0, 0, 0, 0x00fc)
+#define mpl_is_all_forwarders(a) \
+  ((a)->u16[0] == UIP_HTONS(0xff02) && (a)->u16[1] == 0 && \
+   (a)->u16[2] == 0 && (a)->u16[3] == 0 && (a)->u16[4] == 0 && \
+   (a)->u16[5] == 0 && (a)->u16[6] == 0 && (a)->u16[7] == UIP_HTONS(0x00fc))
+/*---------------------------------------------------------------------------*/
+/* Maintain Stats */
+#if UIP_MCAST6_STATS
+static struct mpl_stats stats;
+
+#define MPL_STATS_ADD(x) stats.x++
+#define MPL_STATS_INIT() do { memset(&stats, 0, sizeof(stats)); } while(0)
+#else /* UIP_MCAST6_STATS */
+#define MPL_STATS_ADD(x)
+#define MPL_STATS_INIT()
+#endif
+/*---------------------------------------------------------------------------*/
+/* Internal Data Structures */
+/*---------------------------------------------------------------------------*/
+MEMB(seed_memb, struct mpl_seed, MPL_SEED_SET_SIZE);
+MEMB(msg_memb, struct mpl_msg, MPL_BUFFER_SIZE);
+static struct mpl_seed *seed_hash[SEED_HASH_SIZE];
+static struct mpl_msg *oldest;
+static struct mpl_msg *newest;
+static struct trickle_param control;
+static struct ctimer data_timer;
+static struct ctimer control_timer;
+static uint8_t last_seq;
+/*---------------------------------------------------------------------------*/
+/* uIPv6 Pointers */
+/*---------------------------------------------------------------------------*/
+#define UIP_EXT_BUF       ((struct uip_ext_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#define UIP_EXT_BUF_NEXT  ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + HBHO_TOTAL_LEN])
+#define UIP_EXT_OPT_FIRST ((struct hbho_mpl *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + 2])
+#define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_ICMP_BUF      ((struct uip_icmp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
+#define UIP_ICMP_PAYLOAD  ((unsigned char *)&uip_buf[uip_l2_l3_icmp_hdr_len])
+extern uint16_t uip_slen;
+/*---------------------------------------------------------------------------*/
+/* Local function prototypes */
+/*---------------------------------------------------------------------------*/
+static void icmp_input(void);
+static void handle_data_timer(void *);
+static void handle_control_timer(void *);
+/*---------------------------------------------------------------------------*/
+/* MPL ICMPv6 handler declaration */
+UIP_ICMP6_HANDLER(mpl_icmp_handler, ICMP6_MPL,
+                  UIP_ICMP6_HANDLER_CODE_ANY, icmp_input);
+/*---------------------------------------------------------------------------*/
+/* Trickle (RFC 6206) */
+/*---------------------------------------------------------------------------*/
+static void
+trickle_new_interval(struct trickle_param *tp, clock_time_t start)
+{
+  clock_time_t half;
+
+  tp->start = start;
+  tp->c = 0;
+  tp->flags &= ~TRICKLE_FIRED;
+
+  /* Pick t in [I/2, I) */
+  half = tp->i >> 1;
+  tp->t = half;
+  if(tp->i > half) {
+    tp->t += random_rand() % (tp->i - half);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Start a timer, or restart it at Imin on an inconsistency. A timer already
+ * running at Imin keeps its interval (RFC 6206, section 4.2, rule 6). */
+static void
+trickle_reset(struct trickle_param *tp, clock_time_t i_min)
+{
+  tp->e = 0;
+  if((tp->flags & TRICKLE_RUNNING) && tp->i == i_min) {
+    return;
+  }
+  tp->i = i_min;
+  tp->flags |= TRICKLE_RUNNING;
+  trickle_new_interval(tp, bsp_getTick());
+}
+/*---------------------------------------------------------------------------*/
+/* Absolute time of the next event of a running timer */
+static clock_time_t
+trickle_deadline(const struct trickle_param *tp)
+{
+  return tp->start + ((tp->flags & TRICKLE_FIRED) ? tp->i : tp->t);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Handle the event that is due for tp. At point t this returns 1 if the
+ * caller must transmit. At the end of the interval the interval doubles,
+ * and the timer stops after the given number of intervals.
+ */
+static uint8_t
+trickle_expired(struct trickle_param *tp, clock_time_t i_max, uint8_t k,
+                uint8_t expirations)
+{
+  clock_time_t end;
+
+  if(!(tp->flags & TRICKLE_FIRED)) {
+    tp->flags |= TRICKLE_FIRED;
+    return tp->c < k;
+  }
+
+  if(++tp->e >= expirations) {
+    tp->flags &= ~TRICKLE_RUNNING;
+    return 0;
+  }
+
+  end = tp->start + tp->i;
+  tp->i <<= 1;
+  if(tp->i > i_max) {
+    tp->i = i_max;
+  }
+  trickle_new_interval(tp, end);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Seed Set */
+/*---------------------------------------------------------------------------*/
+static unsigned
+seed_hash_index(const seed_id_t *s)
+{
+  unsigned h;
+  uint8_t i;
+
+  h = 0;
+  for(i = 0; i < s->len; i++) {
+    h = h * 31 + s->id[i];
+  }
+  return h % SEED_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static struct mpl_seed *
+seed_lookup(const seed_id_t *s)
+{
+  struct mpl_seed *seed;
+
+  for(seed = seed_hash[seed_hash_index(s)]; seed != NULL; seed = seed->next) {
+    if(seed->seed_id.len == s->len &&
+       memcmp(seed->seed_id.id, s->id, s->len) == 0) {
+      return seed;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove the lowest sequence number of a seed. Later messages below the
+ * removed one are too old to be accepted again. */
+static void
+seed_pop_head(struct mpl_seed *seed)
+{
+  struct mpl_msg *m;
+
+  m = seed->head;
+  seed->head = m->next;
+  if(seed->head == NULL) {
+    seed->tail = NULL;
+  }
+  seed->count--;
+  seed->min_seqno = m->seq + 1;
+
+  if(m->older != NULL) {
+    m->older->newer = m->newer;
+  } else {
+    oldest = m->newer;
+  }
+  if(m->newer != NULL) {
+    m->newer->older = m->older;
+  } else {
+    newest = m->older;
+  }
+  memb_free(&msg_memb, m);
+}
+/*---------------------------------------------------------------------------*/
+static void
+seed_remove(struct mpl_seed *seed)
+{
+  struct mpl_seed **sp;
+
+  PRINTF("MPL: Free seed ");
+  PRINT_SEED(&seed->seed_id);
+  PRINTF("\n");
+
+  while(seed->head != NULL) {
+    seed_pop_head(seed);
+  }
+  for(sp = &seed_hash[seed_hash_index(&seed->seed_id)]; *sp != NULL;
+      sp = &(*sp)->next) {
+    if(*sp == seed) {
+      *sp = seed->next;
+      break;
+    }
+  }
+  memb_free(&seed_memb, seed);
+}
+/*---------------------------------------------------------------------------*/
+static void
+seed_set_expire(clock_time_t now)
+{
+  struct mpl_seed *seed;
+  struct mpl_seed *next;
+  uint8_t i;
+
+  for(i = 0; i < SEED_HASH_SIZE; i++) {
+    for(seed = seed_hash[i]; seed != NULL; seed = next) {
+      next = seed->next;
+      if(TIME_REACHED(now, seed->expires)) {
+        seed_remove(seed);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct mpl_seed *
+seed_allocate(const seed_id_t *s, uint8_t seq, clock_time_t now)
+{
+  struct mpl_seed *seed;
+  unsigned h;
+
+  seed = memb_alloc(&seed_memb);
+  if(seed == NULL) {
+    seed_set_expire(now);
+    seed = memb_alloc(&seed_memb);
+    if(seed == NULL) {
+      return NULL;
+    }
+  }
+
+  memset(seed, 0, sizeof(struct mpl_seed));
+  memcpy(&seed->seed_id, s, sizeof(seed_id_t));
+  seed->min_seqno = seq;
+  h = seed_hash_index(s);
+  seed->next = seed_hash[h];
+  seed_hash[h] = seed;
+  return seed;
+}
+/*---------------------------------------------------------------------------*/
+/* Buffered Messages */
+/*---------------------------------------------------------------------------*/
+static struct mpl_msg *
+msg_lookup(const struct mpl_seed *seed, uint8_t seq)
+{
+  struct mpl_msg *m;
+
+  for(m = seed->head; m != NULL && !SEQ_VAL_IS_LT(seq, m->seq); m = m->next) {
+    if(m->seq == seq) {
+      return m;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Get a free message buffer. When all are in use, the seed that received
+ * the oldest buffered message gives up its lowest sequence number: both
+ * ends of the lists are at hand, so reclaiming costs the same as a free
+ * buffer.
+ */
+static struct mpl_msg *
+msg_allocate(void)
+{
+  struct mpl_msg *m;
+
+  m = memb_alloc(&msg_memb);
+  if(m == NULL && oldest != NULL) {
+    PRINTF("MPL: Reclaim seq %u from seed ", oldest->seed->head->seq);
+    PRINT_SEED(&oldest->seed->seed_id);
+    PRINTF("\n");
+    seed_pop_head(oldest->seed);
+    m = memb_alloc(&msg_memb);
+  }
+  return m;
+}
+/*---------------------------------------------------------------------------*/
+static void
+msg_insert(struct mpl_seed *seed, struct mpl_msg *m)
+{
+  struct mpl_msg **mp;
+
+  m->seed = seed;
+  if(seed->tail == NULL || SEQ_VAL_IS_LT(seed->tail->seq, m->seq)) {
+    /* In order arrival, the common case */
+    m->next = NULL;
+    if(seed->tail != NULL) {
+      seed->tail->next = m;
+    } else {
+      seed->head = m;
+    }
+    seed->tail = m;
+  } else {
+    for(mp = &seed->head; SEQ_VAL_IS_LT((*mp)->seq, m->seq); mp = &(*mp)->next);
+    m->next = *mp;
+    *mp = m;
+  }
+  seed->count++;
+
+  m->newer = NULL;
+  m->older = newest;
+  if(newest != NULL) {
+    newest->newer = m;
+  } else {
+    oldest = m;
+  }
+  newest = m;
+}
+/*---------------------------------------------------------------------------*/
+/* (Re)start the Trickle timer of a message that may still be forwarded */
+static uint8_t
+msg_trickle_reset(struct mpl_msg *m)
+{
+  if(MPL_MSG_TTL(m) == 0) {
+    return 0;
+  }
+  trickle_reset(&m->tp, MPL_DATA_MESSAGE_IMIN);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+msg_send(struct mpl_msg *m)
+{
+  PRINTF("MPL: Sending seq %u from seed ", m->seq);
+  PRINT_SEED(&m->seed->seed_id);
+  PRINTF("\n");
+
+  uip_len = m->buff_len;
+  memcpy(UIP_IP_BUF, m->buff, uip_len);
+  uip_ext_len = 0;
+
+  UIP_MCAST6_STATS_ADD(mcast_fwd);
+  tcpip_output(NULL);
+  uip_len = 0;
+  bsp_wdt(E_BSP_WDT_PERIODIC);
+}
+/*---------------------------------------------------------------------------*/
+/* Timers */
+/*---------------------------------------------------------------------------*/
+static void
+data_timer_schedule(void)
+{
+  struct mpl_msg *m;
+  clock_time_t now;
+  clock_time_t next;
+  clock_time_t deadline;
+  uint8_t found;
+
+  found = 0;
+  next = 0;
+  for(m = oldest; m != NULL; m = m->newer) {
+    if(m->tp.flags & TRICKLE_RUNNING) {
+      deadline = trickle_deadline(&m->tp);
+      if(!found || !TIME_REACHED(deadline, next)) {
+        next = deadline;
+        found = 1;
+      }
+    }
+  }
+
+  if(!found) {
+    ctimer_stop(&data_timer);
+    return;
+  }
+  now = bsp_getTick();
+  ctimer_set(&data_timer, TIME_REACHED(now, next) ? 0 : next - now,
+             handle_data_timer, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+control_timer_schedule(void)
+{
+  clock_time_t now;
+  clock_time_t deadline;
+
+  if(!(control.flags & TRICKLE_RUNNING)) {
+    ctimer_stop(&control_timer);
+    return;
+  }
+  now = bsp_getTick();
+  deadline = trickle_deadline(&control);
+  ctimer_set(&control_timer, TIME_REACHED(now, deadline) ? 0 : deadline - now,
+             handle_control_timer, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_data_timer(void *ptr)
+{
+  struct mpl_msg *m;
+  clock_time_t now;
+
+  now = bsp_getTick();
+  for(m = oldest; m != NULL; m = m->newer) {
+    while((m->tp.flags & TRICKLE_RUNNING) &&
+          TIME_REACHED(now, trickle_deadline(&m->tp))) {
+      if(trickle_expired(&m->tp, DATA_IMAX, MPL_DATA_MESSAGE_K,
+                         MPL_DATA_MESSAGE_TIMER_EXPIRATIONS)) {
+        msg_send(m);
+      }
+    }
+  }
+  data_timer_schedule();
+}
+/*---------------------------------------------------------------------------*/
+static void
+icmp_output(void)
+{
+  struct mpl_seed *seed;
+  struct mpl_msg *m;
+  uint8_t *info;
+  uint8_t *bm;
+  uint8_t *end;
+  uint8_t bm_len;
+  uint8_t off;
+  uint8_t i;
+  uint16_t payload_len;
+
+  /* Bail out pronto if our uIPv6 stack is not ready to send messages */
+  if(uip_ds6_get_link_local(ADDR_PREFERRED) == NULL) {
+    PRINTF("MPL: Suppressing control message. Stack not ready\n");
+    return;
+  }
+
+  uip_ext_len = 0;
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = MPL_IP_HOP_LIMIT;
+
+  info = UIP_ICMP_PAYLOAD;
+  end = &uip_buf[UIP_BUFSIZE];
+
+  for(i = 0; i < SEED_HASH_SIZE; i++) {
+    for(seed = seed_hash[i]; seed != NULL; seed = seed->next) {
+      bm_len = 0;
+      if(seed->tail != NULL) {
+        bm_len = (uint8_t)(seed->tail->seq - seed->min_seqno) / 8 + 1;
+      }
+      if(info + SEED_INFO_LEN + seed->seed_id.len + bm_len > end) {
+        break;
+      }
+
+      info[0] = seed->min_seqno;
+      info[1] = bm_len << 2;
+      if(seed->seed_id.len == 2) {
+        info[1] |= SEED_ID_S_16;
+      } else if(seed->seed_id.len == 8) {
+        info[1] |= SEED_ID_S_64;
+      } else {
+        info[1] |= SEED_ID_S_128;
+      }
+      memcpy(&info[SEED_INFO_LEN], seed->seed_id.id, seed->seed_id.len);
+
+      bm = &info[SEED_INFO_LEN + seed->seed_id.len];
+      memset(bm, 0, bm_len);
+      for(m = seed->head; m != NULL; m = m->next) {
+        off = m->seq - seed->min_seqno;
+        BITMAP_SET(bm, off);
+      }
+
+      PRINTF("MPL: Control out, seed ");
+      PRINT_SEED(&seed->seed_id);
+      PRINTF(" min %u, %u buffered\n", seed->min_seqno, seed->count);
+
+      info = bm + bm_len;
+    }
+  }
+
+  /* Sent even when empty: a neighbour learns that we lack all its seeds */
+  payload_len = info - UIP_ICMP_PAYLOAD;
+
+  mpl_create_all_forwarders(&UIP_IP_BUF->destipaddr);
+  uip_ds6_select_src(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
+
+  UIP_IP_BUF->len[0] = (UIP_ICMPH_LEN + payload_len) >> 8;
+  UIP_IP_BUF->len[1] = (UIP_ICMPH_LEN + payload_len) & 0xff;
+
+  UIP_ICMP_BUF->type = ICMP6_MPL;
+  UIP_ICMP_BUF->icode = MPL_ICMP_CODE;
+
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + payload_len;
+
+  tcpip_ipv6_output();
+  MPL_STATS_ADD(icmp_out);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_control_timer(void *ptr)
+{
+  clock_time_t now;
+
+  now = bsp_getTick();
+  seed_set_expire(now);
+
+  while((control.flags & TRICKLE_RUNNING) &&
+        TIME_REACHED(now, trickle_deadline(&control))) {
+    if(trickle_expired(&control, CONTROL_IMAX, MPL_CONTROL_MESSAGE_K,
+                       MPL_CONTROL_MESSAGE_TIMER_EXPIRATIONS)) {
+      icmp_output();
+    }
+  }
+  control_timer_schedule();
+}
+/*---------------------------------------------------------------------------*/
+/* Control Messages */
+/*---------------------------------------------------------------------------*/
+/*
+ * Compare a neighbour's MPL Seed Info with our buffer. Messages of ours
+ * that the neighbour lacks get their Trickle timer reset, so they are
+ * forwarded again. Returns 1 on any inconsistency, including messages the
+ * neighbour has and we do not.
+ */
+static uint8_t
+seed_info_check(struct mpl_seed *seed, uint8_t min_seqno,
+                const uint8_t *bm, uint8_t bm_len)
+{
+  struct mpl_msg *m;
+  uint16_t off;
+  uint8_t seq;
+  uint8_t inconsistent;
+
+  inconsistent = 0;
+
+  /* "We have new" */
+  for(m = seed->head; m != NULL; m = m->next) {
+    if(SEQ_VAL_IS_LT(m->seq, min_seqno)) {
+      continue;
+    }
+    off = (uint8_t)(m->seq - min_seqno);
+    if(off >= bm_len * 8 || !BITMAP_IS_SET(bm, off)) {
+      PRINTF("MPL: Neighbour lacks seq %u\n", m->seq);
+      msg_trickle_reset(m);
+      inconsistent = 1;
+    }
+  }
+
+  /* "They have new". Both the bitmap and our list are in sequence order,
+   * so one walk over each is enough. */
+  m = seed->head;
+  for(off = 0; off < bm_len * 8; off++) {
+    if(!BITMAP_IS_SET(bm, off)) {
+      continue;
+    }
+    seq = min_seqno + off;
+    if(SEQ_VAL_IS_LT(seq, seed->min_seqno)) {
+      continue;
+    }
+    while(m != NULL && SEQ_VAL_IS_LT(m->seq, seq)) {
+      m = m->next;
+    }
+    if(m == NULL || m->seq != seq) {
+      PRINTF("MPL: Missing seq %u\n", seq);
+      inconsistent = 1;
+      break;
+    }
+  }
+  return inconsistent;
+}
+/*---------------------------------------------------------------------------*/
+/* MPL ICMPv6 Input Handler */
+static void
+icmp_input(void)
+{
+  struct mpl_seed *seed;
+  struct mpl_msg *m;
+  seed_id_t seed_id;
+  uint8_t *info;
+  uint8_t *end;
+  const uint8_t *bm;
+  uint8_t bm_len;
+  uint8_t inconsistent;
+  uint8_t i;
+
+#if UIP_CONF_IPV6_CHECKS
+  if(!uip_is_addr_link_local(&UIP_IP_BUF->srcipaddr)) {
+    PRINTF("MPL: Control in, bad source\n");
+    MPL_STATS_ADD(icmp_bad);
+    goto discard;
+  }
+
+  if(!mpl_is_all_forwarders(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("MPL: Control in, bad destination\n");
+    MPL_STATS_ADD(icmp_bad);
+    goto discard;
+  }
+
+  if(UIP_ICMP_BUF->icode != MPL_ICMP_CODE) {
+    PRINTF("MPL: Control in, bad ICMP code\n");
+    MPL_STATS_ADD(icmp_bad);
+    goto discard;
+  }
+
+  if(UIP_IP_BUF->ttl != MPL_IP_HOP_LIMIT) {
+    PRINTF("MPL: Control in, bad TTL\n");
+    MPL_STATS_ADD(icmp_bad);
+    goto discard;
+  }
+#endif
+
+  PRINTF("MPL: Control in from ");
+  PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
+  PRINTF(" len %u\n", uip_len);
+
+  MPL_STATS_ADD(icmp_in);
+
+  for(i = 0; i < SEED_HASH_SIZE; i++) {
+    for(seed = seed_hash[i]; seed != NULL; seed = seed->next) {
+      seed->flags &= ~SEED_LISTED;
+    }
+  }
+
+  inconsistent = 0;
+  info = UIP_ICMP_PAYLOAD;
+  end = UIP_ICMP_PAYLOAD + uip_len - uip_l2_l3_icmp_hdr_len;
+
+  while(info < end) {
+    if(info + SEED_INFO_LEN > end) {
+      goto bad;
+    }
+    switch(SEED_INFO_S(info)) {
+    case SEED_ID_S_16:
+      seed_id.len = 2;
+      break;
+    case SEED_ID_S_64:
+      seed_id.len = 8;
+      break;
+    default:
+      seed_id.len = 16;
+      break;
+    }
+    bm_len = SEED_INFO_BM_LEN(info);
+    if(info + SEED_INFO_LEN + seed_id.len + bm_len > end) {
+      goto bad;
+    }
+    memcpy(seed_id.id, &info[SEED_INFO_LEN], seed_id.len);
+    bm = &info[SEED_INFO_LEN + seed_id.len];
+
+    seed = seed_lookup(&seed_id);
+    if(seed != NULL) {
+      seed->flags |= SEED_LISTED;
+      inconsistent |= seed_info_check(seed, info[0], bm, bm_len);
+    } else {
+      /* Any buffered message of an unknown seed is new to us */
+      for(i = 0; i < bm_len; i++) {
+        if(bm[i] != 0) {
+          PRINTF("MPL: Neighbour knows an unknown seed\n");
+          inconsistent = 1;
+          break;
+        }
+      }
+    }
+    info += SEED_INFO_LEN + seed_id.len + bm_len;
+  }
+
+  /* Seeds the neighbour did not list: everything we have is new to it */
+  for(i = 0; i < SEED_HASH_SIZE; i++) {
+    for(seed = seed_hash[i]; seed != NULL; seed = seed->next) {
+      if(!(seed->flags & SEED_LISTED) && seed->head != NULL) {
+        PRINTF("MPL: Seed ");
+        PRINT_SEED(&seed->seed_id);
+        PRINTF(" was not listed\n");
+        for(m = seed->head; m != NULL; m = m->next) {
+          msg_trickle_reset(m);
+        }
+        inconsistent = 1;
+      }
+    }
+  }
+
+  if(inconsistent) {
+    trickle_reset(&control, MPL_CONTROL_MESSAGE_IMIN);
+    control_timer_schedule();
+    data_timer_schedule();
+  } else {
+    control.c++;
+  }
+  goto discard;
+
+bad:
+  PRINTF("MPL: Control in, malformed Seed Info\n");
+  MPL_STATS_ADD(icmp_bad);
+
+discard:
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Data Messages */
+/*---------------------------------------------------------------------------*/
+/* Find the MPL Option in the Hop-by-Hop Options header, if any */
+static struct hbho_mpl *
+hbho_mpl_lookup(void)
+{
+  uint8_t *opt;
+  uint8_t *end;
+
+  if(UIP_IP_BUF->proto != UIP_PROTO_HBHO ||
+     uip_len < UIP_IPH_LEN + (UIP_EXT_BUF->len << 3) + 8) {
+    return NULL;
+  }
+
+  opt = (uint8_t *)UIP_EXT_BUF + 2;
+  end = (uint8_t *)UIP_EXT_BUF + (UIP_EXT_BUF->len << 3) + 8;
+  while(opt < end) {
+    if(opt[0] == UIP_EXT_HDR_OPT_PAD1) {
+      opt++;
+      continue;
+    }
+    if(opt + 2 > end || opt + 2 + opt[1] > end) {
+      return NULL;
+    }
+    if(opt[0] == UIP_EXT_HDR_OPT_MPL && opt[1] >= HBHO_MPL_LEN_SRC_SEED) {
+      return (struct hbho_mpl *)opt;
+    }
+    opt += 2 + opt[1];
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Processes an incoming or outgoing multicast message and determines
+ * whether it should be dropped or accepted
+ *
+ * \param in 1: Incoming packet, 0: Outgoing (we are the seed)
+ *
+ * \return 0: Drop, 1: Accept
+ */
+static uint8_t
+accept(uint8_t in)
+{
+  struct hbho_mpl *opt;
+  struct mpl_seed *seed;
+  struct mpl_msg *m;
+  seed_id_t seed_id;
+  clock_time_t now;
+  uint8_t new_seed;
+
+#if UIP_CONF_IPV6_CHECKS
+  if(uip_is_addr_mcast_non_routable(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("MPL: Mcast I/O, bad destination\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+  /*
+   * Abort transmission if the v6 src is unspecified. This may happen if the
+   * seed tries to TX while it's still performing DAD or waiting for a prefix
+   */
+  if(uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)) {
+    PRINTF("MPL: Mcast I/O, bad source\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+#endif
+
+  opt = hbho_mpl_lookup();
+  if(opt == NULL) {
+    PRINTF("MPL: Mcast I/O, no MPL Option\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+
+  /* V set: the option is from an incompatible version of MPL */
+  if(opt->flags & HBHO_MPL_V_BIT) {
+    PRINTF("MPL: Mcast I/O, unsupported version\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+
+  switch(HBHO_MPL_GET_S(opt)) {
+  case SEED_ID_S_SRC:
+    seed_id.len = 0;
+    break;
+  case SEED_ID_S_16:
+    seed_id.len = 2;
+    break;
+  case SEED_ID_S_64:
+    seed_id.len = 8;
+    break;
+  default:
+    seed_id.len = 16;
+    break;
+  }
+  if(opt->len != HBHO_MPL_LEN_SRC_SEED + seed_id.len) {
+    PRINTF("MPL: Mcast I/O, bad length\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+  if(seed_id.len == 0) {
+    seed_id.len = 16;
+    memcpy(seed_id.id, &UIP_IP_BUF->srcipaddr, 16);
+  } else {
+    memcpy(seed_id.id, (uint8_t *)opt + sizeof(struct hbho_mpl), seed_id.len);
+  }
+
+#if UIP_MCAST6_STATS
+  if(in == MPL_DGRAM_IN) {
+    UIP_MCAST6_STATS_ADD(mcast_in_all);
+  }
+#endif
+
+  now = bsp_getTick();
+  new_seed = 0;
+  seed = seed_lookup(&seed_id);
+  if(seed != NULL) {
+    if(SEQ_VAL_IS_LT(opt->seq, seed->min_seqno)) {
+      PRINTF("MPL: Too old\n");
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
+    }
+    m = msg_lookup(seed, opt->seq);
+    if(m != NULL) {
+      PRINTF("MPL: Seen before\n");
+      m->tp.c++;
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
+    }
+  } else {
+    seed = seed_allocate(&seed_id, opt->seq, now);
+    if(seed == NULL) {
+      PRINTF("MPL: Failed to allocate seed\n");
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
+    }
+    new_seed = 1;
+  }
+
+  m = msg_allocate();
+  if(m != NULL && SEQ_VAL_IS_LT(opt->seq, seed->min_seqno)) {
+    /* The reclaimed message was a later one of the same seed */
+    memb_free(&msg_memb, m);
+    m = NULL;
+  }
+  if(m == NULL) {
+    PRINTF("MPL: Buffer allocation failed\n");
+    if(new_seed) {
+      seed_remove(seed);
+    }
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
+#if UIP_MCAST6_STATS
+  if(in == MPL_DGRAM_IN) {
+    UIP_MCAST6_STATS_ADD(mcast_in_unique);
+  }
+#endif
+
+  seed->expires = now + MPL_SEED_SET_ENTRY_LIFETIME * bsp_get(E_BSP_GET_TRES);
+
+  memset(&m->tp, 0, sizeof(m->tp));
+  memcpy(m->buff, UIP_IP_BUF, uip_len);
+  m->buff_len = uip_len;
+  m->seq = opt->seq;
+  msg_insert(seed, m);
+
+  PRINTF("MPL: Buffered seq %u for seed ", m->seq);
+  PRINT_SEED(&seed->seed_id);
+  PRINTF(", %u buffered\n", seed->count);
+
+  /*
+   * Forwarded copies carry a decremented hop limit. If we are the seed, the
+   * caller transmits the message right away and the Trickle timer only
+   * schedules the retransmissions.
+   */
+  if(in == MPL_DGRAM_IN) {
+    MPL_MSG_TTL(m)--;
+  }
+#if MPL_PROACTIVE_FORWARDING
+  if(msg_trickle_reset(m)) {
+    data_timer_schedule();
+  }
+#endif
+
+  /* A new message is an inconsistency for the control timer */
+  trickle_reset(&control, MPL_CONTROL_MESSAGE_IMIN);
+  control_timer_schedule();
+
+  return UIP_MCAST6_ACCEPT;
+}
+/*---------------------------------------------------------------------------*/
+static void
+out()
+{
+  struct hbho_mpl *opt;
+  uint8_t *padn;
+
+  if(uip_len + HBHO_TOTAL_LEN > UIP_BUFSIZE) {
+    PRINTF("MPL: Multicast Out can not add HBHO. Packet too long\n");
+    goto drop;
+  }
+
+  /* Slide 'right' by HBHO_TOTAL_LEN bytes */
+  memmove(UIP_EXT_BUF_NEXT, UIP_EXT_BUF, uip_len - UIP_IPH_LEN);
+  memset(UIP_EXT_BUF, 0, HBHO_TOTAL_LEN);
+
+  UIP_EXT_BUF->next = UIP_IP_BUF->proto;
+  UIP_EXT_BUF->len = 0;
+
+  /* The seed-id is our source address, so it is elided (S = 0) */
+  opt = UIP_EXT_OPT_FIRST;
+  opt->type = UIP_EXT_HDR_OPT_MPL;
+  opt->len = HBHO_MPL_LEN_SRC_SEED;
+  opt->flags = (SEED_ID_S_SRC << 6) | HBHO_MPL_M_BIT;
+  last_seq++;
+  opt->seq = last_seq;
+
+  /* PadN */
+  padn = (uint8_t *)opt + sizeof(struct hbho_mpl);
+  padn[0] = UIP_EXT_HDR_OPT_PADN;
+  padn[1] = 0;
+
+  uip_ext_len += HBHO_TOTAL_LEN;
+  uip_len += HBHO_TOTAL_LEN;
+
+  /* Update the proto and length field in the v6 header */
+  UIP_IP_BUF->proto = UIP_PROTO_HBHO;
+  UIP_IP_BUF->len[0] = ((uip_len - UIP_IPH_LEN) >> 8);
+  UIP_IP_BUF->len[1] = ((uip_len - UIP_IPH_LEN) & 0xff);
+
+  PRINTF("MPL: Multicast Out, seq %u\n", opt->seq);
+
+  /*
+   * Buffer the message so that we advertise it in our control messages,
+   * then send it right away and set uip_len = 0 to stop the core from
+   * sending it again.
+   */
+  if(accept(MPL_DGRAM_OUT)) {
+    tcpip_output(NULL);
+    UIP_MCAST6_STATS_ADD(mcast_out);
+  }
+
+drop:
+  uip_slen = 0;
+  uip_len = 0;
+  uip_ext_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+in()
+{
+  /*
+   * We call accept() which will sort out caching and forwarding. Depending
+   * on accept()'s return value, we then need to signal the core
+   * whether to deliver this to higher layers
+   */
+  if(accept(MPL_DGRAM_IN) == UIP_MCAST6_DROP) {
+    return UIP_MCAST6_DROP;
+  }
+
+  if(!uip_ds6_is_my_maddr(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("MPL: Not a group member. No further processing\n");
+    return UIP_MCAST6_DROP;
+  } else {
+    PRINTF("MPL: Ours. Deliver to upper layers\n");
+    UIP_MCAST6_STATS_ADD(mcast_in_ours);
+    return UIP_MCAST6_ACCEPT;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  uip_ipaddr_t all_forwarders;
+
+  PRINTF("MPL: Multicast Protocol for LLNs (RFC 7731)\n");
+
+  memb_init(&seed_memb);
+  memb_init(&msg_memb);
+  memset(seed_hash, 0, sizeof(seed_hash));
+  memset(&control, 0, sizeof(control));
+  oldest = NULL;
+  newest = NULL;
+
+  /* Start somewhere else after a reboot, so that neighbours still holding
+   * our earlier messages do not discard new ones as duplicates */
+  last_seq = random_rand();
+
+  MPL_STATS_INIT();
+  UIP_MCAST6_STATS_INIT(&stats);
+
+  /* Register the ICMPv6 input handler */
+  uip_icmp6_register_input_handler(&mpl_icmp_handler);
+
+  mpl_create_all_forwarders(&all_forwarders);
+  uip_ds6_maddr_add(&all_forwarders);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief The MPL engine driver
+ */
+const struct uip_mcast6_driver mpl_driver = {
+  "MPL",
+  init,
+  out,
+  in,
+};
+/*---------------------------------------------------------------------------*/
+/** @} */
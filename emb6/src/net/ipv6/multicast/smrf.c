@@ -51,6 +51,7 @@
 #include "smrf.h"
 #include "rpl.h"
 #include "packetbuf.h"
+#include "memb.h"
 #include "random.h"
 //#include "net/netstack.h"
 
@@ -64,28 +65,159 @@
 #define SMRF_FWD_DELAY()        0     //emb6_get()->lmac->channel_check_interval()  /* FIXME */
 /* Number of slots in the next 500ms */
 #define SMRF_INTERVAL_COUNT  ((bsp_get(E_BSP_GET_TRES) >> 2) / fwd_delay)
+
+/* Has the absolute tick count when been reached at now? */
+#define TIME_REACHED(now, when) ((int32_t)((now) - (when)) >= 0)
 /*---------------------------------------------------------------------------*/
 /* Internal Data */
 /*---------------------------------------------------------------------------*/
+/* A datagram waiting for its forwarding delay, kept in deadline order */
+struct mcast_fwd {
+  struct mcast_fwd *next;
+  clock_time_t deadline;
+  uint16_t len;
+  uint8_t buf[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+
+MEMB(fwd_memb, struct mcast_fwd, SMRF_FWD_QUEUE_LEN);
+static struct mcast_fwd *fwd_queue;
 static struct ctimer mcast_periodic;
-static uint8_t mcast_len;
-static uip_buf_t mcast_buf;
 static uint8_t fwd_delay;
 static uint8_t fwd_spread;
 
+/* Digests of recently accepted datagrams, overwritten round robin */
+struct dup_entry {
+  uint32_t digest;
+  clock_time_t seen;
+};
+
+static struct dup_entry dup_cache[SMRF_DUP_CACHE_LEN];
+static uint8_t dup_cache_next;
+static uint8_t dup_cache_used;
+/*---------------------------------------------------------------------------*/
+/* Maintain Stats */
+#if UIP_MCAST6_STATS
+static struct smrf_stats stats;
+
+#define SMRF_STATS_ADD(x) stats.x++
+#define SMRF_STATS_INIT() do { memset(&stats, 0, sizeof(stats)); } while(0)
+#else /* UIP_MCAST6_STATS */
+#define SMRF_STATS_ADD(x)
+#define SMRF_STATS_INIT()
+#endif
 /*---------------------------------------------------------------------------*/
 /* uIPv6 Pointers */
 /*---------------------------------------------------------------------------*/
 #define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 /*---------------------------------------------------------------------------*/
+/*
+ * FNV-1a over the source, the destination and the upper layer payload. The
+ * hop limit and the extension headers (the RPL option carries the sender's
+ * rank) change from hop to hop, so they are left out.
+ */
+static uint32_t
+dgram_digest(void)
+{
+  const uint8_t *p;
+  const uint8_t *end;
+  uint32_t h;
+
+  h = 2166136261UL;
+  for(p = (const uint8_t *)&UIP_IP_BUF->srcipaddr;
+      p < (const uint8_t *)&UIP_IP_BUF->destipaddr + sizeof(uip_ipaddr_t); p++) {
+    h = (h ^ *p) * 16777619UL;
+  }
+  end = &uip_buf[UIP_LLH_LEN + uip_len];
+  for(p = &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + uip_ext_len]; p < end; p++) {
+    h = (h ^ *p) * 16777619UL;
+  }
+  return h;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Returns 1 if the digest was seen within the last SMRF_DUP_LIFETIME
+ * seconds, otherwise remembers it
+ */
+static uint8_t
+dup_cache_check(uint32_t digest)
+{
+  clock_time_t now;
+  uint8_t i;
+
+  now = bsp_getTick();
+  for(i = 0; i < dup_cache_used; i++) {
+    if(dup_cache[i].digest == digest) {
+      if(!TIME_REACHED(now, dup_cache[i].seen +
+                       SMRF_DUP_LIFETIME * bsp_get(E_BSP_GET_TRES))) {
+        return 1;
+      }
+      /* the same payload again, e.g. a periodic report */
+      dup_cache[i].seen = now;
+      return 0;
+    }
+  }
+  dup_cache[dup_cache_next].digest = digest;
+  dup_cache[dup_cache_next].seen = now;
+  dup_cache_next = (dup_cache_next + 1) % SMRF_DUP_CACHE_LEN;
+  if(dup_cache_used < SMRF_DUP_CACHE_LEN) {
+    dup_cache_used++;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 mcast_fwd(void *p)
 {
-  memcpy(uip_buf, &mcast_buf, mcast_len);
-  uip_len = mcast_len;
-  UIP_IP_BUF->ttl--;
-  tcpip_output(NULL);
-  uip_len = 0;
+  struct mcast_fwd *f;
+  clock_time_t now;
+
+  now = bsp_getTick();
+  while(fwd_queue != NULL && TIME_REACHED(now, fwd_queue->deadline)) {
+    f = fwd_queue;
+    fwd_queue = f->next;
+
+    memcpy(uip_buf, f->buf, f->len);
+    uip_len = f->len;
+    memb_free(&fwd_memb, f);
+
+    UIP_IP_BUF->ttl--;
+    UIP_MCAST6_STATS_ADD(mcast_fwd);
+    tcpip_output(NULL);
+    uip_len = 0;
+  }
+
+  if(fwd_queue != NULL) {
+    ctimer_set(&mcast_periodic, fwd_queue->deadline - now, mcast_fwd, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Queue the datagram in uip_buf for forwarding in delay ticks */
+static void
+fwd_enqueue(clock_time_t delay)
+{
+  struct mcast_fwd *f;
+  struct mcast_fwd **fp;
+
+  f = memb_alloc(&fwd_memb);
+  if(f == NULL) {
+    PRINTF("SMRF: Forwarding queue full\n");
+    SMRF_STATS_ADD(fwd_queue_full);
+    return;
+  }
+
+  memcpy(f->buf, uip_buf, uip_len);
+  f->len = uip_len;
+  f->deadline = bsp_getTick() + delay;
+
+  for(fp = &fwd_queue;
+      *fp != NULL && TIME_REACHED(f->deadline, (*fp)->deadline);
+      fp = &(*fp)->next);
+  f->next = *fp;
+  *fp = f;
+
+  if(fwd_queue == f) {
+    ctimer_set(&mcast_periodic, delay, mcast_fwd, NULL);
+  }
 }
 /*---------------------------------------------------------------------------*/
 static uint8_t
@@ -135,14 +267,23 @@ in()
   }
 
   UIP_MCAST6_STATS_ADD(mcast_in_all);
+
+  /*
+   * A parent switch can bring the same datagram in twice. It has been
+   * forwarded and delivered already, so drop the copy.
+   */
+  if(dup_cache_check(dgram_digest())) {
+    PRINTF("SMRF: Duplicate, not forwarded\n");
+    SMRF_STATS_ADD(fwd_suppressed);
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
   UIP_MCAST6_STATS_ADD(mcast_in_unique);
 
   /* If we have an entry in the mcast routing table, something with
    * a higher RPL rank (somewhere down the tree) is a group member */
   if(uip_mcast6_route_lookup(&UIP_IP_BUF->destipaddr)) {
-    /* If we enter here, we will definitely forward */
-    UIP_MCAST6_STATS_ADD(mcast_fwd);
-
     /*
      * Add a delay (D) of at least SMRF_FWD_DELAY() to compensate for how
      * contikimac handles broadcasts. We can't start our TX before the sender
@@ -160,6 +301,7 @@ in()
     if(fwd_delay == 0) {
       /* No delay required, send it, do it now, why wait? */
       UIP_IP_BUF->ttl--;
+      UIP_MCAST6_STATS_ADD(mcast_fwd);
       tcpip_output(NULL);
       UIP_IP_BUF->ttl++;        /* Restore before potential upstack delivery */
     } else {
@@ -172,9 +314,7 @@ in()
         fwd_delay = fwd_delay * (1 + ((random_rand() >> 11) % fwd_spread));
       }
 
-      memcpy(&mcast_buf, uip_buf, uip_len);
-      mcast_len = uip_len;
-      ctimer_set(&mcast_periodic, fwd_delay, mcast_fwd, NULL);
+      fwd_enqueue(fwd_delay);
     }
     PRINTF("SMRF: %u bytes: fwd in %u [%u]\n",
            uip_len, fwd_delay, fwd_spread);
@@ -194,7 +334,13 @@ in()
 static void
 init(void)
 {
-  UIP_MCAST6_STATS_INIT(NULL);
+  SMRF_STATS_INIT();
+  UIP_MCAST6_STATS_INIT(&stats);
+
+  memb_init(&fwd_memb);
+  fwd_queue = NULL;
+  dup_cache_next = 0;
+  dup_cache_used = 0;
 
   uip_mcast6_route_init();
 }
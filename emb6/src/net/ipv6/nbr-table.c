@@ -320,6 +320,14 @@ nbr_table_get_from_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
   return nbr_get_bit(used_map, table, item) ? item : NULL;
 }
 /*---------------------------------------------------------------------------*/
+/* Get the item of the same neighbor as an item of another table */
+void *
+nbr_table_get_from_item(nbr_table_t *table, nbr_table_t *from, const void *item)
+{
+  void *other = item_from_index(table, index_from_item(from, item));
+  return nbr_get_bit(used_map, table, other) ? other : NULL;
+}
+/*---------------------------------------------------------------------------*/
 /* Removes a neighbor from the current table (unset "used" bit) */
 int
 nbr_table_remove(nbr_table_t *table, void *item)
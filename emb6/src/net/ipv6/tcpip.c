@@ -512,6 +512,12 @@ tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
   uip_ipaddr_t *nexthop;
+#if UIP_CONF_IPV6_RPL
+  uip_ipaddr_t srh_nexthop;
+#endif /* UIP_CONF_IPV6_RPL */
+#if UIP_ND6_6LOWPAN_ND
+  uip_lladdr_t lladdr;
+#endif /* UIP_ND6_6LOWPAN_ND */
 
   if(uip_len == 0) {
     return;
@@ -536,7 +542,12 @@ tcpip_ipv6_output(void)
     /* We first check if the destination address is on our immediate
        link. If so, we simply use the destination address as our
        nexthop address. */
-    if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)){
+    if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)
+#if UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND
+       /* Hosts that registered with us are neighbors */
+       || uip_ds6_reg_lookup(&UIP_IP_BUF->destipaddr) != NULL
+#endif /* UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND */
+       ){
       nexthop = &UIP_IP_BUF->destipaddr;
     } else {
       uip_ds6_route_t *route;
@@ -545,8 +556,18 @@ tcpip_ipv6_output(void)
 
       /* No route was found - we send to the default route instead. */
       if(route == NULL) {
-        PRINTF("tcpip_ipv6_output: no route found, using default route\n\r");
-        nexthop = uip_ds6_defrt_choose();
+        nexthop = NULL;
+#if UIP_CONF_IPV6_RPL
+        /* Source routed packets of a non-storing DODAG go to the neighbor
+           named by the destination address. */
+        if(rpl_srh_get_next_hop(&srh_nexthop)) {
+          nexthop = &srh_nexthop;
+        }
+#endif /* UIP_CONF_IPV6_RPL */
+        if(nexthop == NULL) {
+          PRINTF("tcpip_ipv6_output: no route found, using default route\n\r");
+          nexthop = uip_ds6_defrt_choose();
+        }
         if(nexthop == NULL) {
 #ifdef UIP_FALLBACK_INTERFACE
       PRINTF("FALLBACK: removing ext hdrs & setting proto %d %d\n\r",
@@ -619,6 +640,26 @@ tcpip_ipv6_output(void)
     }
 #endif /* UIP_CONF_IPV6_RPL */
     nbr = uip_ds6_nbr_lookup(nexthop);
+#if UIP_ND6_6LOWPAN_ND
+    if(nbr == NULL) {
+      /* No multicast address resolution (RFC 6775, section 5.6). The
+         neighbor cache holds one IP address per link-layer address, so
+         reuse an entry of the same neighbor if there is one. */
+      if(!uip_ds6_reg_resolve(nexthop, &lladdr)) {
+        PRINTF("tcpip_ipv6_output: cannot resolve next hop\n\r");
+        uip_len = 0;
+        return;
+      }
+      nbr = uip_ds6_nbr_ll_lookup(&lladdr);
+      if(nbr == NULL) {
+        nbr = uip_ds6_nbr_add(nexthop, &lladdr, 0, NBR_STALE);
+      }
+      if(nbr == NULL) {
+        uip_len = 0;
+        return;
+      }
+    }
+#endif /* UIP_ND6_6LOWPAN_ND */
     if(nbr == NULL) {
 #if UIP_ND6_SEND_NA
       if((nbr = uip_ds6_nbr_add(nexthop, NULL, 0, NBR_INCOMPLETE)) == NULL) {
@@ -668,6 +709,7 @@ tcpip_ipv6_output(void)
       if(nbr->state == NBR_STALE) {
         nbr->state = NBR_DELAY;
         stimer_set(&nbr->reachable, UIP_ND6_DELAY_FIRST_PROBE_TIME);
+        uip_ds6_schedule_stimer(&nbr->reachable);
         nbr->nscount = 0;
         PRINTF("tcpip_ipv6_output: nbr cache entry stale moving to delay\n\r");
       }
@@ -50,6 +50,7 @@
 #include "linkaddr.h"
 #include "packetbuf.h"
 #include "uip-ds6-nbr.h"
+#include "link-stats.h"
 
 #define DEBUG DEBUG_NONE
 #include "uip-debug.h"
@@ -70,20 +71,86 @@ void LINK_NEIGHBOR_CALLBACK(const linkaddr_t *addr, int status, int numtx);
 
 NBR_TABLE_GLOBAL(uip_ds6_nbr_t, ds6_neighbors);
 
+/*
+ * Index of the neighbor cache on the IPv6 address, so that next-hop
+ * resolution does not walk the whole table. Buckets and chain links hold
+ * neighbor table indices plus one, 0 ends a chain.
+ */
+#if NBR_TABLE_MAX_NEIGHBORS < 255
+typedef uint8_t nbr_index_t;
+#else
+typedef uint16_t nbr_index_t;
+#endif
+
+static nbr_index_t ipaddr_buckets[UIP_DS6_NBR_HASH_SIZE];
+static nbr_index_t ipaddr_chain[NBR_TABLE_MAX_NEIGHBORS];
+
+#define NBR_INDEX(nbr)      ((nbr) - (uip_ds6_nbr_t *)ds6_neighbors->data)
+#define NBR_FROM_INDEX(i)   ((uip_ds6_nbr_t *)ds6_neighbors->data + (i))
+
+/*---------------------------------------------------------------------------*/
+static nbr_index_t *
+ipaddr_bucket(const uip_ipaddr_t *ipaddr)
+{
+  uint16_t h;
+  uint8_t i;
+
+  /* The interface identifier is what tells neighbors apart */
+  h = 0;
+  for(i = 8; i < 16; i++) {
+    h = h * 31 + ipaddr->u8[i];
+  }
+  return &ipaddr_buckets[h % UIP_DS6_NBR_HASH_SIZE];
+}
+/*---------------------------------------------------------------------------*/
+static void
+ipaddr_index_add(uip_ds6_nbr_t *nbr)
+{
+  nbr_index_t *bucket = ipaddr_bucket(&nbr->ipaddr);
+
+  ipaddr_chain[NBR_INDEX(nbr)] = *bucket;
+  *bucket = NBR_INDEX(nbr) + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ipaddr_index_remove(uip_ds6_nbr_t *nbr)
+{
+  nbr_index_t *link = ipaddr_bucket(&nbr->ipaddr);
+  nbr_index_t i = NBR_INDEX(nbr) + 1;
+
+  while(*link != 0) {
+    if(*link == i) {
+      *link = ipaddr_chain[i - 1];
+      return;
+    }
+    link = &ipaddr_chain[*link - 1];
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_neighbors_init(void)
 {
+  memset(ipaddr_buckets, 0, sizeof(ipaddr_buckets));
   nbr_table_register(ds6_neighbors, (nbr_table_callback *)uip_ds6_nbr_rm);
+  link_stats_init();
 }
 /*---------------------------------------------------------------------------*/
 uip_ds6_nbr_t *
 uip_ds6_nbr_add(const uip_ipaddr_t *ipaddr, const uip_lladdr_t *lladdr,
                 uint8_t isrouter, uint8_t state)
 {
-  uip_ds6_nbr_t *nbr = nbr_table_add_lladdr(ds6_neighbors, (linkaddr_t*)lladdr);
+  uip_ds6_nbr_t *nbr;
+
+  /* Re-adding a link-layer address overwrites its entry */
+  nbr = nbr_table_get_from_lladdr(ds6_neighbors, (linkaddr_t*)lladdr);
+  if(nbr != NULL) {
+    ipaddr_index_remove(nbr);
+  }
+
+  nbr = nbr_table_add_lladdr(ds6_neighbors, (linkaddr_t*)lladdr);
   if(nbr) {
     uip_ipaddr_copy(&nbr->ipaddr, ipaddr);
+    ipaddr_index_add(nbr);
     nbr->isrouter = isrouter;
     nbr->state = state;
   #if UIP_CONF_IPV6_QUEUE_PKT
@@ -93,6 +160,8 @@ uip_ds6_nbr_add(const uip_ipaddr_t *ipaddr, const uip_lladdr_t *lladdr,
     stimer_set(&nbr->reachable, 0);
     stimer_set(&nbr->sendns, 0);
     nbr->nscount = 0;
+    /* The next periodic run picks up the timers set by the caller */
+    uip_ds6_schedule_periodic(0);
     PRINTF("Adding neighbor with ip addr ");
     PRINT6ADDR(ipaddr);
     PRINTF(" link addr ");
@@ -119,6 +188,7 @@ uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr)
     uip_packetqueue_free(&nbr->packethandle);
 #endif /* UIP_CONF_IPV6_QUEUE_PKT */
     NEIGHBOR_STATE_CHANGED(nbr);
+    ipaddr_index_remove(nbr);
     nbr_table_remove(ds6_neighbors, nbr);
   }
   return;
@@ -156,13 +226,15 @@ uip_ds6_nbr_num(void)
 uip_ds6_nbr_t *
 uip_ds6_nbr_lookup(const uip_ipaddr_t *ipaddr)
 {
-  uip_ds6_nbr_t *nbr = nbr_table_head(ds6_neighbors);
+  uip_ds6_nbr_t *nbr;
+  nbr_index_t i;
+
   if(ipaddr != NULL) {
-    while(nbr != NULL) {
+    for(i = *ipaddr_bucket(ipaddr); i != 0; i = ipaddr_chain[i - 1]) {
+      nbr = NBR_FROM_INDEX(i - 1);
       if(uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
         return nbr;
       }
-      nbr = nbr_table_next(ds6_neighbors, nbr);
     }
   }
   return NULL;
@@ -198,6 +270,7 @@ uip_ds6_link_neighbor_callback(int status, int numtx)
     return;
   }
 
+  link_stats_packet_sent(dest, status, numtx);
   LINK_NEIGHBOR_CALLBACK(dest, status, numtx);
 
 #if UIP_DS6_LL_NUD
@@ -222,6 +295,7 @@ uip_ds6_link_neighbor_callback(int status, int numtx)
     if(nbr != NULL && nbr->state != NBR_INCOMPLETE) {
       nbr->state = NBR_REACHABLE;
       stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+      uip_ds6_schedule_stimer(&nbr->reachable);
       PRINTF("uip-ds6-neighbor : received a link layer ACK : ");
       PRINTLLADDR((uip_lladdr_t *)dest);
       PRINTF(" is reachable.\n");
@@ -267,6 +341,10 @@ uip_ds6_neighbor_periodic(void)
         nbr->state = NBR_STALE;
 #endif /* UIP_CONF_IPV6_RPL */
       }
+      /* STALE neighbors have no deadline */
+      if(nbr->state != NBR_STALE) {
+        uip_ds6_schedule_stimer(&nbr->reachable);
+      }
       break;
 #if UIP_ND6_SEND_NA
     case NBR_INCOMPLETE:
@@ -278,6 +356,9 @@ uip_ds6_neighbor_periodic(void)
         uip_nd6_ns_output(NULL, NULL, &nbr->ipaddr);
         stimer_set(&nbr->sendns, uip_ds6_if.retrans_timer / 1000);
       }
+      if(nbr->state == NBR_INCOMPLETE) {
+        uip_ds6_schedule_stimer(&nbr->sendns);
+      }
       break;
     case NBR_DELAY:
       if(stimer_expired(&nbr->reachable)) {
@@ -286,6 +367,8 @@ uip_ds6_neighbor_periodic(void)
         PRINTF("DELAY: moving to PROBE\n");
         stimer_set(&nbr->sendns, 0);
       }
+      uip_ds6_schedule_stimer(nbr->state == NBR_DELAY ?
+                              &nbr->reachable : &nbr->sendns);
       break;
     case NBR_PROBE:
       if(nbr->nscount >= UIP_ND6_MAX_UNICAST_SOLICIT) {
@@ -303,6 +386,9 @@ uip_ds6_neighbor_periodic(void)
         uip_nd6_ns_output(NULL, &nbr->ipaddr, &nbr->ipaddr);
         stimer_set(&nbr->sendns, uip_ds6_if.retrans_timer / 1000);
       }
+      if(nbr->state == NBR_PROBE) {
+        uip_ds6_schedule_stimer(&nbr->sendns);
+      }
       break;
 #endif /* UIP_ND6_SEND_NA */
     default:
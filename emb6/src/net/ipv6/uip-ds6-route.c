@@ -543,12 +543,17 @@ uip_ds6_defrt_add(uip_ipaddr_t *ipaddr, unsigned long interval)
     }
 
     list_push(defaultrouterlist, d);
+#if UIP_ND6_6LOWPAN_ND
+    /* Register our addresses with the new router */
+    uip_ds6_schedule_periodic(0);
+#endif /* UIP_ND6_6LOWPAN_ND */
   }
 
   uip_ipaddr_copy(&d->ipaddr, ipaddr);
   if(interval != 0) {
     stimer_set(&d->lifetime, interval);
     d->isinfinite = 0;
+    uip_ds6_schedule_periodic(interval);
   } else {
     d->isinfinite = 1;
   }
@@ -645,15 +650,18 @@ void
 uip_ds6_defrt_periodic(void)
 {
   uip_ds6_defrt_t *d;
-  d = list_head(defaultrouterlist);
-  while(d != NULL) {
-    if(!d->isinfinite &&
-       stimer_expired(&d->lifetime)) {
+  uip_ds6_defrt_t *next;
+
+  for(d = list_head(defaultrouterlist); d != NULL; d = next) {
+    next = list_item_next(d);
+    if(d->isinfinite) {
+      continue;
+    }
+    if(stimer_expired(&d->lifetime)) {
       PRINTF("uip_ds6_defrt_periodic: defrt lifetime expired\n\r");
       uip_ds6_defrt_rm(d);
-      d = list_head(defaultrouterlist);
     } else {
-      d = list_item_next(d);
+      uip_ds6_schedule_stimer(&d->lifetime);
     }
   }
 }
@@ -75,6 +75,9 @@ static uint8_t rscount;                                         /** \brief numbe
 /** @{ */
 uip_ds6_netif_t uip_ds6_if;                                       /** \brief The single interface */
 uip_ds6_prefix_t uip_ds6_prefix_list[UIP_DS6_PREFIX_NB];          /** \brief Prefix list */
+#if UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND
+static uip_ds6_reg_t uip_ds6_reg_list[UIP_DS6_REG_NB];            /** \brief Address registration cache */
+#endif /* UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND */
 
 /* Used by Cooja to enable extraction of addresses from memory.*/
 uint8_t uip_ds6_addr_size;
@@ -90,6 +93,19 @@ static uip_ds6_addr_t *locaddr;
 static uip_ds6_maddr_t *locmaddr;
 static uip_ds6_aaddr_t *locaaddr;
 static uip_ds6_prefix_t *locprefix;
+#if UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND
+static uip_ds6_reg_t *locreg;
+#endif /* UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND */
+
+/*
+ * uip_ds6_timer_periodic is not a fixed-rate tick: it is armed for the
+ * earliest deadline of any address, prefix, default router or neighbor.
+ * While uip_ds6_periodic() runs, deadlines are collected in
+ * periodic_next and the timer is set once at the end.
+ */
+#define PERIODIC_NONE ((clock_time_t)-1)
+static uint8_t periodic_running;
+static clock_time_t periodic_next;
 
 /*---------------------------------------------------------------------------*/
 void
@@ -104,6 +120,9 @@ uip_ds6_init(void)
      NBR_TABLE_MAX_NEIGHBORS, UIP_DS6_DEFRT_NB, UIP_DS6_PREFIX_NB, UIP_DS6_ROUTE_NB,
      UIP_DS6_ADDR_NB, UIP_DS6_MADDR_NB, UIP_DS6_AADDR_NB);
   memset(uip_ds6_prefix_list, 0, sizeof(uip_ds6_prefix_list));
+#if UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND
+  memset(uip_ds6_reg_list, 0, sizeof(uip_ds6_reg_list));
+#endif /* UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND */
   memset(&uip_ds6_if, 0, sizeof(uip_ds6_if));
   uip_ds6_addr_size = sizeof(struct uip_ds6_addr);
   uip_ds6_netif_addr_list_offset = offsetof(struct uip_ds6_netif, addr_list);
@@ -145,10 +164,88 @@ uip_ds6_init(void)
 }
 
 
+/*---------------------------------------------------------------------------*/
+static void
+schedule_ticks(clock_time_t ticks)
+{
+  if(ticks < UIP_DS6_PERIOD) {
+    ticks = UIP_DS6_PERIOD;
+  }
+
+  if(periodic_running) {
+    if(ticks < periodic_next) {
+      periodic_next = ticks;
+    }
+  } else if(etimer_expired(&uip_ds6_timer_periodic)) {
+    /* The expiry event may still be queued, and tcpip ignores it once the
+       timer is armed again. Run the pass that is due within one period, it
+       arms the timer for the real deadline. */
+    etimer_set(&uip_ds6_timer_periodic, UIP_DS6_PERIOD,
+               (pfn_callback_t) tcpip_gethandler());
+  } else if(etimer_expiration_time(&uip_ds6_timer_periodic) - bsp_getTick() > ticks) {
+    etimer_set(&uip_ds6_timer_periodic, ticks,
+               (pfn_callback_t) tcpip_gethandler());
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_schedule_periodic(unsigned long interval)
+{
+  if(interval > UIP_DS6_MAX_INTERVAL) {
+    interval = UIP_DS6_MAX_INTERVAL;
+  }
+  schedule_ticks(interval * bsp_get(E_BSP_GET_TRES));
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_schedule_stimer(struct stimer *t)
+{
+  uip_ds6_schedule_periodic(stimer_expired(t) ? 0 : stimer_remaining(t));
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_ND6_6LOWPAN_ND
+/*
+ * Keep a global address registered with the default router (RFC 6775,
+ * section 5.5). A new default router gets a new registration; NSs nobody
+ * answers are retransmitted before backing off for a while.
+ */
+static void
+register_periodic(uip_ds6_addr_t *addr)
+{
+  uip_ipaddr_t *router;
+
+  router = uip_ds6_defrt_choose();
+  if(router == NULL) {
+    return;
+  }
+
+  if(!uip_ipaddr_cmp(&addr->registrar, router)) {
+    uip_ipaddr_copy(&addr->registrar, router);
+    addr->regcount = 0;
+    stimer_set(&addr->regtimer, 0);
+  }
+
+  if(stimer_expired(&addr->regtimer) && (uip_len == 0)) {
+    if(addr->regcount < UIP_ND6_MAX_UNICAST_SOLICIT) {
+      uip_nd6_ns_aro_output(&addr->registrar, &addr->ipaddr,
+                            UIP_ND6_REGISTRATION_LIFETIME);
+      addr->regcount++;
+      stimer_set(&addr->regtimer, uip_ds6_if.retrans_timer / 1000);
+    } else {
+      PRINTF("Registration not answered, retrying later\n\r");
+      addr->regcount = 0;
+      stimer_set(&addr->regtimer, UIP_ND6_REGISTRATION_RETRY);
+    }
+  }
+  uip_ds6_schedule_stimer(&addr->regtimer);
+}
+#endif /* UIP_ND6_6LOWPAN_ND */
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_periodic(void)
 {
+  periodic_running = 1;
+  periodic_next = PERIODIC_NONE;
 
   /* Periodic processing on unicast addresses */
   for(locaddr = uip_ds6_if.addr_list;
@@ -159,13 +256,27 @@ uip_ds6_periodic(void)
         PRINT6ADDR(&(locaddr->ipaddr));
         PRINTF("\n\r");
         uip_ds6_addr_rm(locaddr);
+        continue;
+      }
 #if UIP_ND6_DEF_MAXDADNS > 0
-      } else if((locaddr->state == ADDR_TENTATIVE)
-                && (locaddr->dadnscount <= uip_ds6_if.maxdadns)
-                && (timer_expired(&locaddr->dadtimer))
-                && (uip_len == 0)) {
-        uip_ds6_dad(locaddr);
+      if((locaddr->state == ADDR_TENTATIVE)
+         && (locaddr->dadnscount <= uip_ds6_if.maxdadns)) {
+        if((timer_expired(&locaddr->dadtimer)) && (uip_len == 0)) {
+          uip_ds6_dad(locaddr);
+        }
+        if(locaddr->state == ADDR_TENTATIVE) {
+          schedule_ticks(timer_expired(&locaddr->dadtimer) ? 0 :
+                         timer_remaining(&locaddr->dadtimer));
+        }
+      }
 #endif /* UIP_ND6_DEF_MAXDADNS > 0 */
+#if UIP_ND6_6LOWPAN_ND
+      if(!uip_is_addr_link_local(&locaddr->ipaddr)) {
+        register_periodic(locaddr);
+      }
+#endif /* UIP_ND6_6LOWPAN_ND */
+      if(!locaddr->isinfinite) {
+        uip_ds6_schedule_stimer(&locaddr->vlifetime);
       }
     }
   }
@@ -185,22 +296,46 @@ uip_ds6_periodic(void)
   for(locprefix = uip_ds6_prefix_list;
       locprefix < uip_ds6_prefix_list + UIP_DS6_PREFIX_NB;
       locprefix++) {
-    if(locprefix->isused && !locprefix->isinfinite
-       && stimer_expired(&(locprefix->vlifetime))) {
-      uip_ds6_prefix_rm(locprefix);
+    if(locprefix->isused && !locprefix->isinfinite) {
+      if(stimer_expired(&(locprefix->vlifetime))) {
+        uip_ds6_prefix_rm(locprefix);
+      } else {
+        uip_ds6_schedule_stimer(&locprefix->vlifetime);
+      }
     }
   }
 #endif /* !UIP_CONF_ROUTER */
 
+#if UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND
+  /* Periodic processing on address registrations */
+  for(locreg = uip_ds6_reg_list;
+      locreg < uip_ds6_reg_list + UIP_DS6_REG_NB; locreg++) {
+    if(locreg->isused) {
+      if(stimer_expired(&locreg->lifetime)) {
+        locreg->isused = 0;
+      } else {
+        uip_ds6_schedule_stimer(&locreg->lifetime);
+      }
+    }
+  }
+#endif /* UIP_CONF_ROUTER && UIP_ND6_6LOWPAN_ND */
+
   uip_ds6_neighbor_periodic();
 
-#if UIP_CONF_ROUTER && UIP_ND6_SEND_RA
+  /* 6LoWPAN-ND routers only send RAs in response to RSs */
+#if UIP_CONF_ROUTER && UIP_ND6_SEND_RA && !UIP_ND6_6LOWPAN_ND
   /* Periodic RA sending */
   if(stimer_expired(&uip_ds6_timer_ra) && (uip_len == 0)) {
     uip_ds6_send_ra_periodic();
   }
-#endif /* UIP_CONF_ROUTER && UIP_ND6_SEND_RA */
-  etimer_reset(&uip_ds6_timer_periodic);
+  uip_ds6_schedule_stimer(&uip_ds6_timer_ra);
+#endif /* UIP_CONF_ROUTER && UIP_ND6_SEND_RA && !UIP_ND6_6LOWPAN_ND */
+
+  periodic_running = 0;
+  if(periodic_next != PERIODIC_NONE) {
+    etimer_set(&uip_ds6_timer_periodic, periodic_next,
+               (pfn_callback_t) tcpip_gethandler());
+  }
   return;
 }
 
@@ -277,6 +412,7 @@ uip_ds6_prefix_add(uip_ipaddr_t *ipaddr, uint8_t ipaddrlen,
     if(interval != 0) {
       stimer_set(&(locprefix->vlifetime), interval);
       locprefix->isinfinite = 0;
+      uip_ds6_schedule_periodic(interval);
     } else {
       locprefix->isinfinite = 1;
     }
@@ -340,6 +476,7 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
     } else {
       locaddr->isinfinite = 0;
       stimer_set(&(locaddr->vlifetime), vlifetime);
+      uip_ds6_schedule_periodic(vlifetime);
     }
 #if UIP_ND6_DEF_MAXDADNS > 0
     locaddr->state = ADDR_TENTATIVE;
@@ -347,9 +484,16 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
               random_rand() % (UIP_ND6_MAX_RTR_SOLICITATION_DELAY *
                       bsp_get(E_BSP_GET_TRES)));
     locaddr->dadnscount = 0;
+    schedule_ticks(timer_remaining(&locaddr->dadtimer));
 #else /* UIP_ND6_DEF_MAXDADNS > 0 */
     locaddr->state = ADDR_PREFERRED;
 #endif /* UIP_ND6_DEF_MAXDADNS > 0 */
+#if UIP_ND6_6LOWPAN_ND
+    /* Registered by the next periodic run */
+    uip_create_unspecified(&locaddr->registrar);
+    locaddr->regcount = 0;
+    uip_ds6_schedule_periodic(0);
+#endif /* UIP_ND6_6LOWPAN_ND */
     uip_create_solicited_node(ipaddr, &loc_fipaddr);
     uip_ds6_maddr_add(&loc_fipaddr);
     return locaddr;
@@ -556,6 +700,98 @@ uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
 #endif
 }
 
+/*---------------------------------------------------------------------------*/
+int
+uip_ds6_set_lladdr_from_iid(uip_lladdr_t *lladdr, const uip_ipaddr_t *ipaddr)
+{
+#if (UIP_LLADDR_LEN == 8)
+  memcpy(lladdr, ipaddr->u8 + 8, UIP_LLADDR_LEN);
+  lladdr->addr[0] ^= 0x02;
+  return 1;
+#elif (UIP_LLADDR_LEN == 6)
+  if(ipaddr->u8[11] != 0xff || ipaddr->u8[12] != 0xfe) {
+    return 0;
+  }
+  memcpy(lladdr, ipaddr->u8 + 8, 3);
+  memcpy((uint8_t *)lladdr + 3, ipaddr->u8 + 13, 3);
+  lladdr->addr[0] ^= 0x02;
+  return 1;
+#else
+#error uip-ds6.c cannot build interface address when UIP_LLADDR_LEN is not 6 or 8
+#endif
+}
+
+#if UIP_ND6_6LOWPAN_ND
+#if UIP_CONF_ROUTER
+/*---------------------------------------------------------------------------*/
+uip_ds6_reg_t *
+uip_ds6_reg_lookup(const uip_ipaddr_t *ipaddr)
+{
+  if(uip_ds6_list_loop((uip_ds6_element_t *)uip_ds6_reg_list,
+               UIP_DS6_REG_NB, sizeof(uip_ds6_reg_t), (uip_ipaddr_t *)ipaddr,
+               128, (uip_ds6_element_t **)&locreg) == FOUND) {
+    return locreg;
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t
+uip_ds6_reg_update(const uip_ipaddr_t *ipaddr, const uip_lladdr_t *owner,
+                   uint16_t lifetime)
+{
+  switch(uip_ds6_list_loop((uip_ds6_element_t *)uip_ds6_reg_list,
+                           UIP_DS6_REG_NB, sizeof(uip_ds6_reg_t),
+                           (uip_ipaddr_t *)ipaddr, 128,
+                           (uip_ds6_element_t **)&locreg)) {
+  case FOUND:
+    /* An expired entry the periodic task has not removed yet is free */
+    if(memcmp(&locreg->owner, owner, UIP_LLADDR_LEN) != 0 &&
+       !stimer_expired(&locreg->lifetime)) {
+      PRINTF("Duplicate registration of ");
+      PRINT6ADDR(ipaddr);
+      PRINTF("\n\r");
+      return UIP_ND6_ARO_STATUS_DUPLICATE;
+    }
+    break;
+  case FREESPACE:
+    break;
+  default:
+    return lifetime == 0 ? UIP_ND6_ARO_STATUS_SUCCESS :
+      UIP_ND6_ARO_STATUS_CACHE_FULL;
+  }
+
+  if(lifetime == 0) {
+    locreg->isused = 0;
+    return UIP_ND6_ARO_STATUS_SUCCESS;
+  }
+
+  locreg->isused = 1;
+  uip_ipaddr_copy(&locreg->ipaddr, ipaddr);
+  memcpy(&locreg->owner, owner, UIP_LLADDR_LEN);
+  stimer_set(&locreg->lifetime, (unsigned long)lifetime * 60);
+  uip_ds6_schedule_stimer(&locreg->lifetime);
+  PRINTF("Registered ");
+  PRINT6ADDR(ipaddr);
+  PRINTF(" for %u minutes\n\r", lifetime);
+  return UIP_ND6_ARO_STATUS_SUCCESS;
+}
+#endif /* UIP_CONF_ROUTER */
+
+/*---------------------------------------------------------------------------*/
+int
+uip_ds6_reg_resolve(const uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
+{
+#if UIP_CONF_ROUTER
+  if(uip_ds6_reg_lookup(ipaddr) != NULL) {
+    memcpy(lladdr, &locreg->owner, UIP_LLADDR_LEN);
+    return 1;
+  }
+#endif /* UIP_CONF_ROUTER */
+  return uip_ds6_set_lladdr_from_iid(lladdr, ipaddr);
+}
+#endif /* UIP_ND6_6LOWPAN_ND */
+
 /*---------------------------------------------------------------------------*/
 uint8_t
 get_match_length(uip_ipaddr_t *src, uip_ipaddr_t *dst)
@@ -647,6 +883,7 @@ uip_ds6_send_ra_sollicited(void)
                  stimer_elapsed(&uip_ds6_timer_ra));
   */ } else {
       stimer_set(&uip_ds6_timer_ra, rand_time);
+      uip_ds6_schedule_periodic(rand_time);
     }
   }
 }
@@ -682,14 +919,47 @@ uip_ds6_send_ra_periodic(void)
 void
 uip_ds6_send_rs(void)
 {
+#if UIP_ND6_6LOWPAN_ND
+  uip_ipaddr_t *router;
+  uip_ds6_defrt_t *locdefrt;
+  unsigned long remaining;
+#endif /* UIP_ND6_6LOWPAN_ND */
+
   if((uip_ds6_defrt_choose() == NULL)
      && (rscount < UIP_ND6_MAX_RTR_SOLICITATIONS)) {
     PRINTF("Sending RS %u\n\r", rscount);
-    uip_nd6_rs_output();
+    uip_nd6_rs_output(NULL);
     rscount++;
     etimer_set(&uip_ds6_timer_rs,
                UIP_ND6_RTR_SOLICITATION_INTERVAL * bsp_get(E_BSP_GET_TRES), tcpip_gethandler());
   } else {
+#if UIP_ND6_6LOWPAN_ND
+    /* There are no periodic RAs (RFC 6775, section 5.3): refresh the
+       default router with unicast RSs shortly before it expires. If it
+       expires anyway, solicitation starts over. */
+    router = uip_ds6_defrt_choose();
+    locdefrt = router != NULL ? uip_ds6_defrt_lookup(router) : NULL;
+    if(locdefrt != NULL && !locdefrt->isinfinite) {
+      rscount = 0;
+      remaining = stimer_expired(&locdefrt->lifetime) ? 0 :
+        stimer_remaining(&locdefrt->lifetime);
+      if(remaining > UIP_ND6_RS_REFRESH_TIME) {
+        remaining -= UIP_ND6_RS_REFRESH_TIME;
+        if(remaining > UIP_DS6_MAX_INTERVAL) {
+          remaining = UIP_DS6_MAX_INTERVAL;
+        }
+        etimer_set(&uip_ds6_timer_rs, remaining * bsp_get(E_BSP_GET_TRES),
+                   tcpip_gethandler());
+      } else {
+        PRINTF("Refreshing default router with a unicast RS\n\r");
+        uip_nd6_rs_output(&locdefrt->ipaddr);
+        etimer_set(&uip_ds6_timer_rs,
+                   UIP_ND6_RTR_SOLICITATION_INTERVAL * bsp_get(E_BSP_GET_TRES),
+                   tcpip_gethandler());
+      }
+      return;
+    }
+#endif /* UIP_ND6_6LOWPAN_ND */
     PRINTF("Router found ? (boolean): %u\n\r",
            (uip_ds6_defrt_choose() != NULL));
     etimer_stop(&uip_ds6_timer_rs);
@@ -123,6 +123,9 @@ void uip_log(char *msg);
 
 static uint8_t nd6_opt_offset;                     /** Offset from the end of the icmpv6 header to the option in uip_buf*/
 static uint8_t *nd6_opt_llao;   /**  Pointer to llao option in uip_buf */
+#if UIP_ND6_6LOWPAN_ND
+static uip_nd6_opt_aro *nd6_opt_aro; /**  Pointer to aro option in uip_buf */
+#endif /* UIP_ND6_6LOWPAN_ND */
 
 #if !UIP_CONF_ROUTER            // TBD see if we move it to ra_input
 static uip_nd6_opt_prefix_info *nd6_opt_prefix_info; /**  Pointer to prefix information option in uip_buf */
@@ -145,12 +148,80 @@ create_llao(uint8_t *llao, uint8_t type) {
 }
 
 /*------------------------------------------------------------------*/
+#if UIP_ND6_6LOWPAN_ND
+/* create an aro */
+static void
+create_aro(uint8_t *aro, uint8_t status, uint16_t lifetime,
+           const uip_lladdr_t *owner)
+{
+  uip_nd6_opt_aro *opt = (uip_nd6_opt_aro *)aro;
+
+  opt->type = UIP_ND6_OPT_ARO;
+  opt->len = UIP_ND6_OPT_ARO_LEN >> 3;
+  opt->status = status;
+  opt->reserved1 = 0;
+  opt->reserved2 = 0;
+  opt->lifetime = uip_htons(lifetime);
+  memset(opt->eui64, 0, sizeof(opt->eui64));
+  memcpy(opt->eui64, owner, UIP_LLADDR_LEN);
+}
+
+#if UIP_CONF_ROUTER
+/*------------------------------------------------------------------*/
+/*
+ * Answer an address registration. The target address of the NS is left
+ * in place, the NA has it at the same offset. The NA goes to the
+ * link-local address of the owner: on failure the registered address
+ * belongs to someone else (RFC 6775, section 6.5.2).
+ */
+static void
+na_aro_output(uint8_t status, uint16_t lifetime, const uip_lladdr_t *owner)
+{
+  uip_ext_len = 0;
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->len[0] = 0;       /* length will not be more than 255 */
+  UIP_IP_BUF->len[1] = UIP_ICMPH_LEN + UIP_ND6_NA_LEN + UIP_ND6_OPT_ARO_LEN;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = UIP_ND6_HOP_LIMIT;
+  uip_create_linklocal_prefix(&UIP_IP_BUF->destipaddr);
+  uip_ds6_set_addr_iid(&UIP_IP_BUF->destipaddr, (uip_lladdr_t *)owner);
+  uip_ds6_select_src(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
+
+  UIP_ICMP_BUF->type = ICMP6_NA;
+  UIP_ICMP_BUF->icode = 0;
+
+  UIP_ND6_NA_BUF->flagsreserved = UIP_ND6_NA_FLAG_ROUTER |
+    UIP_ND6_NA_FLAG_SOLICITED;
+  memset(UIP_ND6_NA_BUF->reserved, 0, sizeof(UIP_ND6_NA_BUF->reserved));
+
+  create_aro(&uip_buf[uip_l2_l3_icmp_hdr_len + UIP_ND6_NA_LEN],
+             status, lifetime, owner);
+
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + UIP_ND6_NA_LEN + UIP_ND6_OPT_ARO_LEN;
+
+  UIP_STAT(++uip_stat.nd6.sent);
+  PRINTF("Sending NA with registration status %u to ", status);
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF("\n");
+}
+#endif /* UIP_CONF_ROUTER */
+#endif /* UIP_ND6_6LOWPAN_ND */
+/*------------------------------------------------------------------*/
 
 
 static void
 ns_input(void)
 {
   uint8_t flags;
+#if UIP_ND6_6LOWPAN_ND && UIP_CONF_ROUTER
+  uip_lladdr_t owner;
+  uint16_t lifetime;
+#endif /* UIP_ND6_6LOWPAN_ND && UIP_CONF_ROUTER */
   PRINTF("Received NS from ");
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
   PRINTF(" to ");
@@ -171,6 +242,9 @@ ns_input(void)
 
   /* Options processing */
   nd6_opt_llao = NULL;
+#if UIP_ND6_6LOWPAN_ND
+  nd6_opt_aro = NULL;
+#endif /* UIP_ND6_6LOWPAN_ND */
   nd6_opt_offset = UIP_ND6_NS_LEN;
   while(uip_l3_icmp_hdr_len + nd6_opt_offset < uip_len) {
 #if UIP_CONF_IPV6_CHECKS
@@ -187,30 +261,14 @@ ns_input(void)
       if(uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)) {
         PRINTF("NS received is bad\n");
         goto discard;
-      } else {
-#endif /*UIP_CONF_IPV6_CHECKS */
-        nbr = uip_ds6_nbr_lookup(&UIP_IP_BUF->srcipaddr);
-        if(nbr == NULL) {
-          uip_ds6_nbr_add(&UIP_IP_BUF->srcipaddr,
-              (uip_lladdr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
-              0, NBR_STALE);
-        } else {
-          uip_lladdr_t *lladdr = (uip_lladdr_t *)uip_ds6_nbr_get_ll(nbr);
-          if(memcmp(&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
-            lladdr, UIP_LLADDR_LEN) != 0) {
-            memcpy(lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
-           UIP_LLADDR_LEN);
-            nbr->state = NBR_STALE;
-          } else {
-            if(nbr->state == NBR_INCOMPLETE) {
-              nbr->state = NBR_STALE;
-            }
-          }
-        }
-#if UIP_CONF_IPV6_CHECKS
       }
 #endif /*UIP_CONF_IPV6_CHECKS */
       break;
+#if UIP_ND6_6LOWPAN_ND
+    case UIP_ND6_OPT_ARO:
+      nd6_opt_aro = (uip_nd6_opt_aro *)UIP_ND6_OPT_HDR_BUF;
+      break;
+#endif /* UIP_ND6_6LOWPAN_ND */
     default:
       PRINTF("ND option not supported in NS");
       break;
@@ -218,6 +276,53 @@ ns_input(void)
     nd6_opt_offset += (UIP_ND6_OPT_HDR_BUF->len << 3);
   }
 
+#if UIP_ND6_6LOWPAN_ND
+  if(nd6_opt_aro != NULL) {
+#if UIP_CONF_ROUTER
+    /*
+     * Address registration (RFC 6775, section 6.5). The registration
+     * cache holds the address: the neighbor cache has a single address
+     * per link-layer address, usually the link-local one.
+     */
+    if(nd6_opt_llao == NULL ||
+       !uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &UIP_ND6_NS_BUF->tgtipaddr) ||
+       uip_is_addr_link_local(&UIP_IP_BUF->srcipaddr)) {
+      PRINTF("NS received is bad\n");
+      goto discard;
+    }
+    memcpy(&owner, nd6_opt_aro->eui64, UIP_LLADDR_LEN);
+    lifetime = uip_ntohs(nd6_opt_aro->lifetime);
+    na_aro_output(uip_ds6_reg_update(&UIP_IP_BUF->srcipaddr, &owner, lifetime),
+                  lifetime, &owner);
+    return;
+#else /* UIP_CONF_ROUTER */
+    /* Only routers accept registrations */
+    goto discard;
+#endif /* UIP_CONF_ROUTER */
+  }
+#endif /* UIP_ND6_6LOWPAN_ND */
+
+  if(nd6_opt_llao != NULL) {
+    nbr = uip_ds6_nbr_lookup(&UIP_IP_BUF->srcipaddr);
+    if(nbr == NULL) {
+      uip_ds6_nbr_add(&UIP_IP_BUF->srcipaddr,
+          (uip_lladdr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
+          0, NBR_STALE);
+    } else {
+      uip_lladdr_t *lladdr = (uip_lladdr_t *)uip_ds6_nbr_get_ll(nbr);
+      if(memcmp(&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
+        lladdr, UIP_LLADDR_LEN) != 0) {
+        memcpy(lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
+       UIP_LLADDR_LEN);
+        nbr->state = NBR_STALE;
+      } else {
+        if(nbr->state == NBR_INCOMPLETE) {
+          nbr->state = NBR_STALE;
+        }
+      }
+    }
+  }
+
   addr = uip_ds6_addr_lookup(&UIP_ND6_NS_BUF->tgtipaddr);
   if(addr != NULL) {
 #if UIP_ND6_DEF_MAXDADNS > 0
@@ -392,6 +497,49 @@ uip_nd6_ns_output(uip_ipaddr_t * src, uip_ipaddr_t * dest, uip_ipaddr_t * tgt)
   PRINTF("\n");
   return;
 }
+#if UIP_ND6_6LOWPAN_ND
+/*------------------------------------------------------------------*/
+void
+uip_nd6_ns_aro_output(uip_ipaddr_t *dest, uip_ipaddr_t *tgt, uint16_t lifetime)
+{
+  uip_ext_len = 0;
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = UIP_ND6_HOP_LIMIT;
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, dest);
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, tgt);
+
+  UIP_ICMP_BUF->type = ICMP6_NS;
+  UIP_ICMP_BUF->icode = 0;
+  UIP_ND6_NS_BUF->reserved = 0;
+  uip_ipaddr_copy((uip_ipaddr_t *) &UIP_ND6_NS_BUF->tgtipaddr, tgt);
+
+  UIP_IP_BUF->len[0] = 0;       /* length will not be more than 255 */
+  UIP_IP_BUF->len[1] =
+    UIP_ICMPH_LEN + UIP_ND6_NS_LEN + UIP_ND6_OPT_LLAO_LEN + UIP_ND6_OPT_ARO_LEN;
+
+  create_llao(&uip_buf[uip_l2_l3_icmp_hdr_len + UIP_ND6_NS_LEN],
+              UIP_ND6_OPT_SLLAO);
+  create_aro(&uip_buf[uip_l2_l3_icmp_hdr_len + UIP_ND6_NS_LEN +
+                      UIP_ND6_OPT_LLAO_LEN],
+             UIP_ND6_ARO_STATUS_SUCCESS, lifetime, &uip_lladdr);
+
+  uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + UIP_ND6_NS_LEN +
+    UIP_ND6_OPT_LLAO_LEN + UIP_ND6_OPT_ARO_LEN;
+
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  UIP_STAT(++uip_stat.nd6.sent);
+  PRINTF("Sending registration NS to ");
+  PRINT6ADDR(dest);
+  PRINTF(" for ");
+  PRINT6ADDR(tgt);
+  PRINTF("\n");
+}
+#endif /* UIP_ND6_6LOWPAN_ND */
 /*------------------------------------------------------------------*/
 /**
  * Neighbor Advertisement Processing
@@ -451,6 +599,9 @@ na_input(void)
   /* Options processing: we handle TLLAO, and must ignore others */
   nd6_opt_offset = UIP_ND6_NA_LEN;
   nd6_opt_llao = NULL;
+#if UIP_ND6_6LOWPAN_ND
+  nd6_opt_aro = NULL;
+#endif /* UIP_ND6_6LOWPAN_ND */
   while(uip_l3_icmp_hdr_len + nd6_opt_offset < uip_len) {
 #if UIP_CONF_IPV6_CHECKS
     if(UIP_ND6_OPT_HDR_BUF->len == 0) {
@@ -462,6 +613,11 @@ na_input(void)
     case UIP_ND6_OPT_TLLAO:
       nd6_opt_llao = (uint8_t *)UIP_ND6_OPT_HDR_BUF;
       break;
+#if UIP_ND6_6LOWPAN_ND
+    case UIP_ND6_OPT_ARO:
+      nd6_opt_aro = (uip_nd6_opt_aro *)UIP_ND6_OPT_HDR_BUF;
+      break;
+#endif /* UIP_ND6_6LOWPAN_ND */
     default:
       PRINTF("ND option not supported in NA\n");
       break;
@@ -469,6 +625,33 @@ na_input(void)
     nd6_opt_offset += (UIP_ND6_OPT_HDR_BUF->len << 3);
   }
   addr = uip_ds6_addr_lookup(&UIP_ND6_NA_BUF->tgtipaddr);
+#if UIP_ND6_6LOWPAN_ND
+  /* Answer to one of our registrations */
+  if(addr != NULL && nd6_opt_aro != NULL &&
+     uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &addr->registrar)) {
+    switch(nd6_opt_aro->status) {
+    case UIP_ND6_ARO_STATUS_SUCCESS:
+      /* Refresh after three quarters of the lifetime (units of 60 s) */
+      PRINTF("Address registered\n");
+      addr->regcount = 0;
+      stimer_set(&addr->regtimer,
+                 (unsigned long)uip_ntohs(nd6_opt_aro->lifetime) * 45);
+      break;
+    case UIP_ND6_ARO_STATUS_DUPLICATE:
+      PRINTF("Address registration failed, duplicate address\n");
+      uip_ds6_addr_rm(addr);
+      goto discard;
+    default:
+      PRINTF("Address registration failed, status %u\n",
+             nd6_opt_aro->status);
+      addr->regcount = 0;
+      stimer_set(&addr->regtimer, UIP_ND6_REGISTRATION_RETRY);
+      break;
+    }
+    uip_ds6_schedule_stimer(&addr->regtimer);
+    goto discard;
+  }
+#endif /* UIP_ND6_6LOWPAN_ND */
   /* Message processing, including TLLAO if any */
   if(addr != NULL) {
 #if UIP_ND6_DEF_MAXDADNS > 0
@@ -502,6 +685,7 @@ na_input(void)
 
         /* reachable time is stored in ms */
         stimer_set(&(nbr->reachable), uip_ds6_if.reachable_time / 1000);
+        uip_ds6_schedule_stimer(&nbr->reachable);
 
       } else {
         nbr->state = NBR_STALE;
@@ -524,6 +708,7 @@ na_input(void)
             nbr->state = NBR_REACHABLE;
             /* reachable time is stored in ms */
             stimer_set(&(nbr->reachable), uip_ds6_if.reachable_time / 1000);
+            uip_ds6_schedule_stimer(&nbr->reachable);
           } else {
             if(nd6_opt_llao != 0 && is_llchange) {
               nbr->state = NBR_STALE;
@@ -569,6 +754,9 @@ discard:
 static void
 rs_input(void)
 {
+#if UIP_ND6_6LOWPAN_ND
+  uip_ipaddr_t dest;
+#endif /* UIP_ND6_6LOWPAN_ND */
 
   PRINTF("Received RS from");
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
@@ -643,8 +831,20 @@ rs_input(void)
 #endif /*UIP_CONF_IPV6_CHECKS */
   }
 
+#if UIP_ND6_6LOWPAN_ND
+  /* There are no periodic RAs to wait for: answer right away, unicast if
+     the host has an address (RFC 6775, section 6.5.3) */
+  if(uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)) {
+    uip_nd6_ra_output(NULL);
+  } else {
+    uip_ipaddr_copy(&dest, &UIP_IP_BUF->srcipaddr);
+    uip_nd6_ra_output(&dest);
+  }
+  return;
+#else /* UIP_ND6_6LOWPAN_ND */
   /* Schedule a sollicited RA */
   uip_ds6_send_ra_sollicited();
+#endif /* UIP_ND6_6LOWPAN_ND */
 
 discard:
   uip_len = 0;
@@ -656,6 +856,7 @@ void
 uip_nd6_ra_output(uip_ipaddr_t * dest)
 {
 
+  uip_ext_len = 0;
   UIP_IP_BUF->vtc = 0x60;
   UIP_IP_BUF->tcflow = 0;
   UIP_IP_BUF->flow = 0;
@@ -766,14 +967,18 @@ uip_nd6_ra_output(uip_ipaddr_t * dest)
 #if !UIP_CONF_ROUTER
 /*---------------------------------------------------------------------------*/
 void
-uip_nd6_rs_output(void)
+uip_nd6_rs_output(uip_ipaddr_t *dest)
 {
   UIP_IP_BUF->vtc = 0x60;
   UIP_IP_BUF->tcflow = 0;
   UIP_IP_BUF->flow = 0;
   UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
   UIP_IP_BUF->ttl = UIP_ND6_HOP_LIMIT;
-  uip_create_linklocal_allrouters_mcast(&UIP_IP_BUF->destipaddr);
+  if(dest == NULL) {
+    uip_create_linklocal_allrouters_mcast(&UIP_IP_BUF->destipaddr);
+  } else {
+    uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, dest);
+  }
   uip_ds6_select_src(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
   UIP_ICMP_BUF->type = ICMP6_RS;
   UIP_ICMP_BUF->icode = 0;
@@ -920,6 +1125,7 @@ ra_input(void)
               stimer_set(&prefix->vlifetime,
                          uip_ntohl(nd6_opt_prefix_info->validlt));
               prefix->isinfinite = 0;
+              uip_ds6_schedule_stimer(&prefix->vlifetime);
               break;
             }
           }
@@ -952,6 +1158,7 @@ ra_input(void)
                 PRINTF("new value %lu\n", (unsigned long)(2 * 60 * 60));
               }
               addr->isinfinite = 0;
+              uip_ds6_schedule_stimer(&addr->vlifetime);
             } else {
               addr->isinfinite = 1;
             }
@@ -1004,6 +1211,7 @@ ra_input(void)
     } else {
       stimer_set(&(defrt->lifetime),
                  (unsigned long)(uip_ntohs(UIP_ND6_RA_BUF->router_lifetime)));
+      uip_ds6_schedule_stimer(&defrt->lifetime);
     }
   } else {
     if(defrt != NULL) {
@@ -901,6 +901,14 @@ ext_hdr_options_process(void)
 #endif /* UIP_CONF_IPV6_RPL */
         uip_ext_opt_offset += (UIP_EXT_HDR_OPT_BUF->len) + 2;
         return 0;
+#if UIP_CONF_IPV6_MULTICAST && (UIP_MCAST6_ENGINE == UIP_MCAST6_ENGINE_MPL)
+      case UIP_EXT_HDR_OPT_MPL:
+        /* Left to the MPL engine, which gets the packet once the headers
+         * have been processed */
+        PRINTF("Processing MPL option\n\r");
+        uip_ext_opt_offset += (UIP_EXT_HDR_OPT_BUF->len) + 2;
+        break;
+#endif /* UIP_MCAST6_ENGINE == UIP_MCAST6_ENGINE_MPL */
       default:
         /*
          * check the two highest order bits of the option
@@ -1368,6 +1376,20 @@ uip_process(uint8_t flag)
 
         PRINTF("Processing Routing header\n\r");
         if(UIP_ROUTING_BUF->seg_left > 0) {
+#if UIP_CONF_IPV6_RPL
+          /* An RPL source route: we are a hop on the way down */
+          if(rpl_process_srh_header()) {
+            if(UIP_IP_BUF->ttl <= 1) {
+              uip_icmp6_error_output(ICMP6_E_TIME_EXCEEDED,
+                                     ICMP6_E_TIME_EXCEED_TRANSIT, 0);
+              UIP_STAT(++uip_stat.ip.drop);
+              goto send;
+            }
+            UIP_IP_BUF->ttl = UIP_IP_BUF->ttl - 1;
+            UIP_STAT(++uip_stat.ip.forwarded);
+            goto send;
+          }
+#endif /* UIP_CONF_IPV6_RPL */
           uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, UIP_IPH_LEN + uip_ext_len + 2);
           UIP_STAT(++uip_stat.ip.drop);
           UIP_LOG("ip6: unrecognized routing type");
@@ -43,10 +43,12 @@
  */
 
 #include "rpl-private.h"
+#include "rpl-ns.h"
 #include "uip.h"
 #include "uip-nd6.h"
 #include "uip-ds6-nbr.h"
 #include "nbr-table.h"
+#include "link-stats.h"
 #if UIP_CONF_IPV6_MULTICAST
 #include "uip-mcast6.h"
 #endif
@@ -85,13 +87,7 @@ rpl_instance_t *default_instance;
 uip_ds6_nbr_t *
 rpl_get_nbr(rpl_parent_t *parent)
 {
-  linkaddr_t *lladdr = NULL;
-  lladdr = nbr_table_get_lladdr(rpl_parents, parent);
-  if(lladdr != NULL) {
-    return nbr_table_get_from_lladdr(ds6_neighbors, lladdr);
-  } else {
-    return NULL;
-  }
+  return nbr_table_get_from_item(ds6_neighbors, rpl_parents, parent);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -137,11 +133,18 @@ rpl_get_parent_link_metric(const uip_lladdr_t *addr)
   }
 }
 /*---------------------------------------------------------------------------*/
+int
+rpl_parent_is_fresh(rpl_parent_t *p)
+{
+  const linkaddr_t *lladdr = nbr_table_get_lladdr(rpl_parents, p);
+  return lladdr != NULL && link_stats_is_fresh(link_stats_from_lladdr(lladdr));
+}
+/*---------------------------------------------------------------------------*/
 uip_ipaddr_t *
 rpl_get_parent_ipaddr(rpl_parent_t *p)
 {
-  linkaddr_t *lladdr = nbr_table_get_lladdr(rpl_parents, p);
-  return uip_ds6_nbr_ipaddr_from_lladdr((uip_lladdr_t *)lladdr);
+  uip_ds6_nbr_t *nbr = rpl_get_nbr(p);
+  return nbr != NULL ? &nbr->ipaddr : NULL;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -537,6 +540,9 @@ rpl_free_instance(rpl_instance_t *instance)
   ctimer_stop(&instance->dio_timer);
   ctimer_stop(&instance->dao_timer);
   ctimer_stop(&instance->dao_lifetime_timer);
+#if RPL_WITH_PROBING
+  ctimer_stop(&instance->probing_timer);
+#endif /* RPL_WITH_PROBING */
 
   if(default_instance == instance) {
     default_instance = NULL;
@@ -556,6 +562,9 @@ rpl_free_dag(rpl_dag_t *dag)
 
     /* Remove routes installed by DAOs. */
     rpl_remove_routes(dag);
+#if RPL_WITH_NON_STORING
+    rpl_ns_free_dag(dag);
+#endif /* RPL_WITH_NON_STORING */
 
    /* Remove autoconfigured address */
     if((dag->prefix_info.flags & UIP_ND6_RA_FLAG_AUTONOMOUS)) {
@@ -607,9 +616,9 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
 static rpl_parent_t *
 find_parent_any_dag_any_instance(uip_ipaddr_t *addr)
 {
-  uip_ds6_nbr_t *ds6_nbr = uip_ds6_nbr_lookup(addr);
-  const uip_lladdr_t *lladdr = uip_ds6_nbr_get_ll(ds6_nbr);
-  return nbr_table_get_from_lladdr(rpl_parents, (linkaddr_t *)lladdr);
+  /* Parents share their slot with the neighbor cache entry */
+  return nbr_table_get_from_item(rpl_parents, ds6_neighbors,
+                                 uip_ds6_nbr_lookup(addr));
 }
 /*---------------------------------------------------------------------------*/
 rpl_parent_t *
@@ -707,7 +716,7 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
   } else if(!acceptable_rank(best_dag, best_dag->rank)) {
     PRINTF("RPL: New rank unacceptable!\n\r");
     rpl_set_preferred_parent(instance->current_dag, NULL);
-    if(instance->mop != RPL_MOP_NO_DOWNWARD_ROUTES && last_parent != NULL) {
+    if(RPL_IS_STORING(instance) && last_parent != NULL) {
       /* Send a No-Path DAO to the removed preferred parent. */
       dao_output(last_parent, RPL_ZERO_LIFETIME);
     }
@@ -720,7 +729,8 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
       (unsigned)old_rank, best_dag->rank);
     RPL_STAT(rpl_stats.parent_switch++);
     if(instance->mop != RPL_MOP_NO_DOWNWARD_ROUTES) {
-      if(last_parent != NULL) {
+      /* In non-storing mode the next DAO replaces the link at the root */
+      if(RPL_IS_STORING(instance) && last_parent != NULL) {
         /* Send a No-Path DAO to the removed preferred parent. */
         dao_output(last_parent, RPL_ZERO_LIFETIME);
       }
@@ -770,6 +780,45 @@ rpl_select_parent(rpl_dag_t *dag)
   return best;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_PROBING
+/*
+ * The preferred parent if its link went stale, otherwise the stale parent
+ * that would give us the lowest rank. NULL if every link is fresh.
+ */
+rpl_parent_t *
+rpl_get_probing_target(rpl_dag_t *dag)
+{
+  rpl_parent_t *p;
+  rpl_parent_t *target;
+  rpl_rank_t rank;
+  rpl_rank_t target_rank;
+
+  if(dag == NULL) {
+    return NULL;
+  }
+
+  if(dag->preferred_parent != NULL &&
+     !rpl_parent_is_fresh(dag->preferred_parent)) {
+    return dag->preferred_parent;
+  }
+
+  target = NULL;
+  target_rank = INFINITE_RANK;
+  p = nbr_table_head(rpl_parents);
+  while(p != NULL) {
+    if(p->dag == dag && p->rank != INFINITE_RANK && !rpl_parent_is_fresh(p)) {
+      rank = dag->instance->of->calculate_rank(p, 0);
+      if(target == NULL || rank < target_rank) {
+        target = p;
+        target_rank = rank;
+      }
+    }
+    p = nbr_table_next(rpl_parents, p);
+  }
+  return target;
+}
+#endif /* RPL_WITH_PROBING */
+/*---------------------------------------------------------------------------*/
 void
 rpl_remove_parent(rpl_parent_t *parent)
 {
@@ -967,6 +1016,9 @@ rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio)
 
   rpl_reset_dio_timer(instance);
   rpl_set_default_route(instance, from);
+#if RPL_WITH_PROBING
+  rpl_schedule_probing(instance);
+#endif /* RPL_WITH_PROBING */
 
   if(instance->mop != RPL_MOP_NO_DOWNWARD_ROUTES) {
     rpl_schedule_dao(instance);
@@ -47,6 +47,7 @@
 #include "tcpip.h"
 #include "uip-ds6.h"
 #include "rpl-private.h"
+#include "rpl-ns.h"
 #include "packetbuf.h"
 
 #define DEBUG DEBUG_NONE
@@ -63,6 +64,7 @@
 #define UIP_EXT_HDR_OPT_BUF       ((struct uip_ext_hdr_opt *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_PADN_BUF  ((struct uip_ext_hdr_opt_padn *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_RPL_BUF   ((struct uip_ext_hdr_opt_rpl *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
+#define UIP_RH_BUF                ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
 /*---------------------------------------------------------------------------*/
 int
 rpl_verify_header(int uip_ext_opt_offset)
@@ -176,6 +178,244 @@ set_rpl_opt(unsigned uip_ext_opt_offset)
     UIP_IP_BUF->len[0]++;
   }
 }
+#if RPL_WITH_NON_STORING
+/*---------------------------------------------------------------------------*/
+static uint8_t
+common_prefix_len(const uip_ipaddr_t *a, const uip_ipaddr_t *b)
+{
+  uint8_t i;
+
+  /* At most 15 octets can be elided from an SRH address */
+  for(i = 0; i < 15 && a->u8[i] == b->u8[i]; i++);
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static int
+has_srh_header(void)
+{
+  return UIP_IP_BUF->proto == UIP_PROTO_ROUTING &&
+    UIP_RH_BUF[2] == RPL_RH_TYPE_SRH;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Insert a Source Routing Header towards the destination of the packet,
+ * which must not carry any extension header. Called at the root only.
+ * Destinations that are not in the DODAG, or that are direct children of
+ * the root, are left alone.
+ *
+ * Returns 1 if the packet must be dropped, 0 otherwise.
+ */
+static int
+insert_srh_header(void)
+{
+  rpl_dag_t *dag;
+  rpl_ns_node_t *dest_node;
+  rpl_ns_node_t *root_node;
+  rpl_ns_node_t *node;
+  uip_ipaddr_t first_hop;
+  uip_ipaddr_t node_addr;
+  uint8_t *hop_ptr;
+  uint8_t cmpri;
+  uint8_t cmpre;
+  uint8_t padding;
+  int path_len;
+  int ext_len;
+  int max_hops;
+  int i;
+
+  dag = default_instance->current_dag;
+  dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
+  if(dest_node == NULL) {
+    /* Not a node of our DODAG, leave the packet to the routing table */
+    return 0;
+  }
+
+  root_node = rpl_ns_get_node(dag, &dag->dag_id);
+  if(root_node == NULL || dest_node == root_node) {
+    return 0;
+  }
+
+  /* Count the hops between the root and the destination. The walk is
+     bounded by the table size in case the links contain a loop. */
+  max_hops = rpl_ns_num_nodes();
+  path_len = 0;
+  node = dest_node->parent;
+  while(node != NULL && node != root_node) {
+    if(++path_len > max_hops) {
+      break;
+    }
+    node = node->parent;
+  }
+  if(node != root_node) {
+    PRINTF("RPL: SRH destination is unreachable\n\r");
+    return 1;
+  }
+
+  if(path_len == 0) {
+    /* Direct child of the root, no source route needed */
+    return 0;
+  }
+
+  /* The packet is sent to the first hop below the root. The remaining
+     hops and the final destination follow in the SRH, with the octets
+     they share with the first hop elided. */
+  node = dest_node;
+  for(i = 0; i < path_len; i++) {
+    node = node->parent;
+  }
+  rpl_ns_get_node_global_addr(&first_hop, node);
+
+  cmpre = common_prefix_len(&first_hop, &UIP_IP_BUF->destipaddr);
+  cmpri = cmpre;
+  for(node = dest_node->parent, i = 1; i < path_len; node = node->parent, i++) {
+    rpl_ns_get_node_global_addr(&node_addr, node);
+    if(common_prefix_len(&first_hop, &node_addr) < cmpri) {
+      cmpri = common_prefix_len(&first_hop, &node_addr);
+    }
+  }
+
+  ext_len = RPL_RH_LEN + RPL_SRH_LEN + (path_len - 1) * (16 - cmpri) + (16 - cmpre);
+  padding = ext_len % 8 == 0 ? 0 : 8 - (ext_len % 8);
+  ext_len += padding;
+
+  if(uip_len + ext_len > UIP_LINK_MTU) {
+    PRINTF("RPL: Packet too long: impossible to add a source routing header\n\r");
+    return 1;
+  }
+
+  PRINTF("RPL: Inserting SRH, %d hops, CmprI %u, CmprE %u, length %d\n\r",
+         path_len, cmpri, cmpre, ext_len);
+
+  memmove(UIP_RH_BUF + ext_len, UIP_RH_BUF, uip_len - UIP_IPH_LEN);
+  memset(UIP_RH_BUF, 0, ext_len);
+  UIP_RH_BUF[0] = UIP_IP_BUF->proto;
+  UIP_RH_BUF[1] = (ext_len / 8) - 1;
+  UIP_RH_BUF[2] = RPL_RH_TYPE_SRH;
+  UIP_RH_BUF[3] = path_len;
+  UIP_RH_BUF[RPL_RH_LEN] = (cmpri << 4) | cmpre;
+  UIP_RH_BUF[RPL_RH_LEN + 1] = padding << 4;
+
+  /* Addresses are listed from the second hop down to the destination, so
+     fill them in backwards while walking up the tree. */
+  hop_ptr = UIP_RH_BUF + RPL_RH_LEN + RPL_SRH_LEN + (path_len - 1) * (16 - cmpri);
+  memcpy(hop_ptr, ((uint8_t *)&UIP_IP_BUF->destipaddr) + cmpre, 16 - cmpre);
+  for(node = dest_node->parent, i = 1; i < path_len; node = node->parent, i++) {
+    hop_ptr -= 16 - cmpri;
+    rpl_ns_get_node_global_addr(&node_addr, node);
+    memcpy(hop_ptr, ((uint8_t *)&node_addr) + cmpri, 16 - cmpri);
+  }
+
+  UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &first_hop);
+  uip_len += ext_len;
+  uip_ext_len += ext_len;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+
+  return 0;
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
+int
+rpl_process_srh_header(void)
+{
+#if RPL_WITH_NON_STORING
+  uint8_t *rh;
+  uint8_t *addr_ptr;
+  uint8_t cmpri;
+  uint8_t cmpre;
+  uint8_t size;
+  uint8_t tmp[16];
+  uip_ipaddr_t next_addr;
+  int ext_len;
+  int path_len;
+  int segments_left;
+  int i;
+
+  rh = &uip_buf[uip_l2_l3_hdr_len];
+  if(rh[2] != RPL_RH_TYPE_SRH) {
+    return 0;
+  }
+
+  ext_len = (rh[1] + 1) * 8;
+  segments_left = rh[3];
+  cmpri = RPL_SRH_GET_CMPRI(rh);
+  cmpre = RPL_SRH_GET_CMPRE(rh);
+  if(ext_len < RPL_RH_LEN + RPL_SRH_LEN + RPL_SRH_GET_PAD(rh) + (16 - cmpre)) {
+    PRINTF("RPL: Malformed SRH\n\r");
+    return 0;
+  }
+  path_len = (ext_len - RPL_SRH_GET_PAD(rh) - RPL_RH_LEN - RPL_SRH_LEN -
+              (16 - cmpre)) / (16 - cmpri) + 1;
+  if(segments_left > path_len) {
+    PRINTF("RPL: SRH with more segments left than addresses\n\r");
+    return 0;
+  }
+
+  /* Swap the destination with the next address of the route, RFC 6554
+     section 4.2. Only the octets that are not elided change. */
+  i = path_len - segments_left;
+  size = i == path_len - 1 ? 16 - cmpre : 16 - cmpri;
+  addr_ptr = rh + RPL_RH_LEN + RPL_SRH_LEN + i * (16 - cmpri);
+
+  uip_ipaddr_copy(&next_addr, &UIP_IP_BUF->destipaddr);
+  memcpy(((uint8_t *)&next_addr) + 16 - size, addr_ptr, size);
+  if(uip_is_addr_mcast(&next_addr) || uip_ds6_is_my_addr(&next_addr)) {
+    PRINTF("RPL: SRH loop or multicast address, dropping\n\r");
+    return 0;
+  }
+
+  memcpy(tmp, ((uint8_t *)&UIP_IP_BUF->destipaddr) + 16 - size, size);
+  memcpy(addr_ptr, tmp, size);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &next_addr);
+  rh[3]--;
+
+  PRINTF("RPL: SRH forwarding to ");
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF(", %u segments left\n\r", rh[3]);
+  return 1;
+#else /* RPL_WITH_NON_STORING */
+  return 0;
+#endif /* RPL_WITH_NON_STORING */
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr)
+{
+#if RPL_WITH_NON_STORING
+  rpl_dag_t *dag;
+  rpl_ns_node_t *dest_node;
+
+  if(!RPL_IS_NON_STORING(default_instance)) {
+    return 0;
+  }
+  dag = default_instance->current_dag;
+
+  if(!has_srh_header() && dag->rank == ROOT_RANK(default_instance)) {
+    /* Locally generated packets that did not pass rpl_insert_header(),
+       such as ICMPv6 replies, get their source route here. */
+    if(insert_srh_header()) {
+      return 0;
+    }
+    if(!has_srh_header()) {
+      dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
+      if(dest_node == NULL || dest_node->parent == NULL ||
+         dest_node->parent != rpl_ns_get_node(dag, &dag->dag_id)) {
+        return 0;
+      }
+    }
+  } else if(!has_srh_header()) {
+    return 0;
+  }
+
+  /* The destination of a source routed packet is always a neighbor */
+  uip_ip6addr(ipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+  memcpy(&ipaddr->u8[8], &UIP_IP_BUF->destipaddr.u8[8], 8);
+  return 1;
+#else /* RPL_WITH_NON_STORING */
+  return 0;
+#endif /* RPL_WITH_NON_STORING */
+}
 /*---------------------------------------------------------------------------*/
 int
 rpl_update_header_empty(void)
@@ -185,6 +425,16 @@ rpl_update_header_empty(void)
   int last_uip_ext_len;
   rpl_parent_t *parent;
 
+#if RPL_WITH_NON_STORING
+  if(RPL_IS_NON_STORING(default_instance) &&
+     default_instance->current_dag->rank == ROOT_RANK(default_instance)) {
+    /* The root of a non-storing DODAG replaces the hop-by-hop option of
+       a packet it forwards down with a source route. */
+    rpl_remove_header();
+    return insert_srh_header();
+  }
+#endif /* RPL_WITH_NON_STORING */
+
   last_uip_ext_len = uip_ext_len;
   uip_ext_len = 0;
   uip_ext_opt_offset = 2;
@@ -374,8 +624,16 @@ rpl_invert_header(void)
 void
 rpl_insert_header(void)
 {
-    if(default_instance != NULL && !uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
-        rpl_update_header_empty();
+  if(default_instance != NULL && !uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
+#if RPL_WITH_NON_STORING
+    if(RPL_IS_NON_STORING(default_instance) &&
+       default_instance->current_dag->rank == ROOT_RANK(default_instance)) {
+      /* The root sends down a source route instead of a hop-by-hop option */
+      insert_srh_header();
+      return;
+    }
+#endif /* RPL_WITH_NON_STORING */
+    rpl_update_header_empty();
   }
 }
 /*---------------------------------------------------------------------------*/
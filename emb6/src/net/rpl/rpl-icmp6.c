@@ -50,6 +50,7 @@
 #include "uip-nd6.h"
 #include "uip-icmp6.h"
 #include "rpl-private.h"
+#include "rpl-ns.h"
 #include "packetbuf.h"
 #if UIP_CONF_IPV6_MULTICAST
 #include "uip-mcast6.h"
@@ -571,41 +572,214 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+/* Result of applying one DAO target */
+#define DAO_TARGET_KNOWN                0 /* Refresh of existing state */
+#define DAO_TARGET_CHANGED              1 /* New state the parent must learn */
+#define DAO_TARGET_FAILED               2 /* Out of memory */
+
+/* State shared by all targets of a received DAO */
+struct dao_input_state {
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  rpl_parent_t *parent;
+  uip_ipaddr_t sender;
+  int learned_from;
+  uint8_t lifetime;
+  uint8_t has_nbr;
+#if RPL_WITH_NON_STORING
+  uint8_t has_parent_addr;
+  uip_ipaddr_t parent_addr;
+#endif /* RPL_WITH_NON_STORING */
+};
+/*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+static int
+dao_input_nonstoring(struct dao_input_state *s, uip_ipaddr_t *prefix)
+{
+  /* The root records the link between the target and the parent named
+     in the transit option. */
+  if(!s->has_parent_addr) {
+    PRINTF("RPL: Ignoring a non-storing DAO target without parent\n\r");
+    return DAO_TARGET_KNOWN;
+  }
+  if(s->lifetime == RPL_ZERO_LIFETIME) {
+    PRINTF("RPL: No-Path DAO received\n\r");
+    rpl_ns_expire_parent(s->dag, prefix, &s->parent_addr);
+  } else if(rpl_ns_update_node(s->dag, prefix, &s->parent_addr,
+                                RPL_LIFETIME(s->instance, s->lifetime)) == NULL) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a link after receiving a DAO\n\r");
+    return DAO_TARGET_FAILED;
+  }
+  return DAO_TARGET_CHANGED;
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
+static int
+dao_input_storing(struct dao_input_state *s, uip_ipaddr_t *prefix,
+                  uint8_t prefixlen)
+{
+  uip_ds6_route_t *rep;
+  uip_ds6_nbr_t *nbr;
+  int changed;
+
+#if RPL_CONF_MULTICAST
+  if(uip_is_addr_mcast_global(prefix)) {
+      changed = uip_mcast6_route_lookup(prefix) == NULL;
+      mcast_group = uip_mcast6_route_add(prefix);
+      if(mcast_group) {
+          mcast_group->dag = s->dag;
+          rpl_set_mcast_route_lifetime(mcast_group, RPL_LIFETIME(s->instance, s->lifetime));
+      }
+      return changed ? DAO_TARGET_CHANGED : DAO_TARGET_KNOWN;
+  }
+#endif
+
+  rep = uip_ds6_route_lookup(prefix);
+
+  if(s->lifetime == RPL_ZERO_LIFETIME) {
+    PRINTF("RPL: No-Path DAO received\n\r");
+    /* No-Path DAO received; invoke the route purging routine. */
+    if(rep != NULL &&
+       rep->state.nopath_received == 0 &&
+       rep->length == prefixlen &&
+       uip_ds6_route_nexthop(rep) != NULL &&
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &s->sender)) {
+      PRINTF("RPL: Setting expiration timer for prefix ");
+      PRINT6ADDR(prefix);
+      PRINTF("\n\r");
+      rep->state.nopath_received = 1;
+      rpl_set_route_lifetime(rep, DAO_EXPIRATION_TIMEOUT);
+      return DAO_TARGET_CHANGED;
+    }
+    return DAO_TARGET_KNOWN;
+  }
+
+  PRINTF("RPL: adding DAO route\n\r");
+
+  if(!s->has_nbr) {
+    if((nbr = uip_ds6_nbr_lookup(&s->sender)) == NULL) {
+        if((nbr = uip_ds6_nbr_add(&s->sender,
+                (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                0, NBR_REACHABLE)) != NULL) {
+            /* set reachable timer */
+            stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+            PRINTF("RPL: Neighbor added to neighbor cache ");
+            PRINT6ADDR(&s->sender);
+            PRINTF(", ");
+            PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+            PRINTF("\n");
+        } else {
+            PRINTF("RPL: Out of Memory, dropping DAO from ");
+            PRINT6ADDR(&s->sender);
+            PRINTF(", ");
+            PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+            PRINTF("\n");
+            return DAO_TARGET_FAILED;
+        }
+    } else {
+        PRINTF("RPL: Neighbor already in neighbor cache\n");
+    }
+    rpl_lock_parent(s->parent);
+    s->has_nbr = 1;
+  }
+
+  changed = rep == NULL || rep->state.nopath_received ||
+    rep->length != prefixlen || uip_ds6_route_nexthop(rep) == NULL ||
+    !uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &s->sender);
+
+  rep = rpl_add_route(s->dag, prefix, prefixlen, &s->sender);
+  if(rep == NULL) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a route after receiving a DAO\n\r");
+    return DAO_TARGET_FAILED;
+  }
+
+  rpl_set_route_lifetime(rep, RPL_LIFETIME(s->instance, s->lifetime));
+  rep->state.learned_from = s->learned_from;
+  rep->state.nopath_received = 0;
+
+  return changed ? DAO_TARGET_CHANGED : DAO_TARGET_KNOWN;
+}
+/*---------------------------------------------------------------------------*/
+/* Apply the Target options in buffer[start, end) with the current transit
+   information. */
+static int
+dao_input_targets(struct dao_input_state *s, unsigned char *buffer,
+                  int start, int end)
+{
+  uip_ipaddr_t prefix;
+  uint8_t prefixlen;
+  int result;
+  int len;
+  int i;
+
+  result = DAO_TARGET_KNOWN;
+  for(i = start; i < end; i += len) {
+    len = buffer[i] == RPL_OPTION_PAD1 ? 1 : 2 + buffer[i + 1];
+    if(buffer[i] != RPL_OPTION_TARGET) {
+      continue;
+    }
+
+    prefixlen = buffer[i + 3];
+    if(prefixlen > sizeof(prefix) * CHAR_BIT ||
+       len < 4 + (prefixlen + 7) / CHAR_BIT) {
+      PRINTF("RPL: Ignoring a malformed DAO target\n\r");
+      continue;
+    }
+    memset(&prefix, 0, sizeof(prefix));
+    memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+
+    PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
+            (unsigned)s->lifetime, (unsigned)prefixlen);
+    PRINT6ADDR(&prefix);
+    PRINTF("\n\r");
+
+#if RPL_WITH_NON_STORING
+    if(RPL_IS_NON_STORING(s->instance)) {
+      result |= dao_input_nonstoring(s, &prefix);
+    } else
+#endif /* RPL_WITH_NON_STORING */
+    {
+      result |= dao_input_storing(s, &prefix, prefixlen);
+    }
+    if(result & DAO_TARGET_FAILED) {
+      break;
+    }
+  }
+  return result;
+}
+/*---------------------------------------------------------------------------*/
 static void
 dao_input(void)
 {
-  uip_ipaddr_t dao_sender_addr;
+  struct dao_input_state s;
   rpl_dag_t *dag;
   rpl_instance_t *instance;
   unsigned char *buffer;
   uint16_t sequence;
   uint8_t instance_id;
-  uint8_t lifetime;
-  uint8_t prefixlen;
   uint8_t flags;
   uint8_t subopt_type;
   /*
   uint8_t pathcontrol;
   uint8_t pathsequence;
   */
-  uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
-  uint8_t buffer_length;
+  uint16_t buffer_length;
   int pos;
   int len;
   int i;
-  int learned_from;
+  int targets;
+  int result;
   rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
 
-  prefixlen = 0;
   parent = NULL;
 
-  uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
+  uip_ipaddr_copy(&s.sender, &UIP_IP_BUF->srcipaddr);
 
   /* Destination Advertisement Object */
   PRINTF("RPL: Received a DAO from ");
-  PRINT6ADDR(&dao_sender_addr);
+  PRINT6ADDR(&s.sender);
   PRINTF("\n\r");
 
   buffer = UIP_ICMP_PAYLOAD;
@@ -621,8 +795,6 @@ dao_input(void)
     return;
   }
 
-  lifetime = instance->default_lifetime;
-
   flags = buffer[pos++];
   /* reserved */
   pos++;
@@ -638,14 +810,14 @@ dao_input(void)
     pos += 16;
   }
 
-  learned_from = uip_is_addr_mcast(&dao_sender_addr) ?
+  s.learned_from = uip_is_addr_mcast(&s.sender) ?
           RPL_ROUTE_FROM_MULTICAST_DAO : RPL_ROUTE_FROM_UNICAST_DAO;
 
   PRINTF("RPL: DAO from %s\n",
-          learned_from == RPL_ROUTE_FROM_UNICAST_DAO? "unicast": "multicast");
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
+          s.learned_from == RPL_ROUTE_FROM_UNICAST_DAO? "unicast": "multicast");
+  if(s.learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
       /* Check whether this is a DAO forwarding loop. */
-      parent = rpl_find_parent(dag, &dao_sender_addr);
+      parent = rpl_find_parent(dag, &s.sender);
       /* check if this is a new DAO registration with an "illegal" rank */
       /* if we already route to this node it is likely */
       if(parent != NULL &&
@@ -666,7 +838,29 @@ dao_input(void)
       }
   }
 
-  /* Check if there are any RPL options present. */
+#if RPL_WITH_NON_STORING
+  if(RPL_IS_NON_STORING(instance) && dag->rank != ROOT_RANK(instance)) {
+    /* Only the root keeps downward state */
+    PRINTF("RPL: Ignoring a non-storing DAO\n\r");
+    uip_len = 0;
+    return;
+  }
+  s.has_parent_addr = 0;
+#endif /* RPL_WITH_NON_STORING */
+
+  s.instance = instance;
+  s.dag = dag;
+  s.parent = parent;
+  s.lifetime = instance->default_lifetime;
+  s.has_nbr = 0;
+
+  /*
+   * A DAO may carry several targets. Each Transit Information option
+   * applies to the Target options that precede it, back to the previous
+   * Transit option; all targets are handled in this single pass.
+   */
+  result = DAO_TARGET_KNOWN;
+  targets = -1;
   for(i = pos; i < buffer_length; i += len) {
     subopt_type = buffer[i];
     if(subopt_type == RPL_OPTION_PAD1) {
@@ -675,117 +869,54 @@ dao_input(void)
       /* The option consists of a two-byte header and a payload. */
       len = 2 + buffer[i + 1];
     }
+    if(i + len > buffer_length) {
+      PRINTF("RPL: Truncated DAO option\n\r");
+      break;
+    }
 
     switch(subopt_type) {
     case RPL_OPTION_TARGET:
-      /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      if(targets < 0) {
+        targets = i;
+      }
       break;
     case RPL_OPTION_TRANSIT:
       /* The path sequence and control are ignored. */
       /*      pathcontrol = buffer[i + 3];
               pathsequence = buffer[i + 4];*/
-      lifetime = buffer[i + 5];
-      /* The parent address is also ignored. */
-      break;
-    }
-  }
-
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n\r");
-
-#if RPL_CONF_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-      mcast_group = uip_mcast6_route_add(&prefix);
-      if(mcast_group) {
-          mcast_group->dag = dag;
-          mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
-      }
-      goto fwd_dao;
-  }
-#endif
-
-  rep = uip_ds6_route_lookup(&prefix);
-
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n\r");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       rep->state.nopath_received == 0 &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n\r");
-      rep->state.nopath_received = 1;
-      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
-      /* We forward the incoming no-path DAO to our parent, if we have
-           one. */
-      if(dag->preferred_parent != NULL &&
-              rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-          PRINTF("RPL: Forwarding no-path DAO to parent ");
-          PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-          PRINTF("\n");
-          uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                  ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+      s.lifetime = buffer[i + 5];
+#if RPL_WITH_NON_STORING
+      /* In non-storing mode the transit option names the parent */
+      s.has_parent_addr = buffer[i + 1] >= 4 + sizeof(s.parent_addr);
+      if(s.has_parent_addr) {
+        memcpy(&s.parent_addr, buffer + i + 6, sizeof(s.parent_addr));
       }
-      if(flags & RPL_DAO_K_FLAG) {
-          dao_ack_output(instance, &dao_sender_addr, sequence);
+#endif /* RPL_WITH_NON_STORING */
+      if(targets >= 0) {
+        result |= dao_input_targets(&s, buffer, targets, i);
+        targets = -1;
       }
+      break;
+    }
+    if(result & DAO_TARGET_FAILED) {
+      break;
     }
-    return;
   }
-
-
-  PRINTF("RPL: adding DAO route\n\r");
-
-  if((nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
-      if((nbr = uip_ds6_nbr_add(&dao_sender_addr,
-              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
-              0, NBR_REACHABLE)) != NULL) {
-          /* set reachable timer */
-          stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
-          PRINTF("RPL: Neighbor added to neighbor cache ");
-          PRINT6ADDR(&dao_sender_addr);
-          PRINTF(", ");
-          PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-          PRINTF("\n");
-      } else {
-          PRINTF("RPL: Out of Memory, dropping DAO from ");
-          PRINT6ADDR(&dao_sender_addr);
-          PRINTF(", ");
-          PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-          PRINTF("\n");
-          return;
-      }
-  } else {
-      PRINTF("RPL: Neighbor already in neighbor cache\n");
+  /* Trailing targets without a Transit option keep the last lifetime */
+  if(targets >= 0 && !(result & DAO_TARGET_FAILED)) {
+    result |= dao_input_targets(&s, buffer, targets, i);
   }
 
-  rpl_lock_parent(parent);
-
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n\r");
+  if(result & DAO_TARGET_FAILED) {
+    uip_len = 0;
     return;
   }
 
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  rep->state.learned_from = learned_from;
-  rep->state.nopath_received = 0;
-
-#if RPL_CONF_MULTICAST
-  fwd_dao:
-#endif
-
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    if(dag->preferred_parent != NULL &&
+  if(s.learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
+    /* Pure refreshes are not forwarded: our own periodic DAO carries all
+       routes learned from descendants. */
+    if(RPL_IS_STORING(instance) && (result & DAO_TARGET_CHANGED) &&
+       dag->preferred_parent != NULL &&
        rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
       PRINTF("RPL: Forwarding DAO to parent ");
       PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
@@ -794,37 +925,49 @@ dao_input(void)
                      ICMP6_RPL, RPL_CODE_DAO, buffer_length);
     }
     if(flags & RPL_DAO_K_FLAG) {
-      dao_ack_output(instance, &dao_sender_addr, sequence);
+      dao_ack_output(instance, &s.sender, sequence);
     }
   }
   uip_len = 0;
 }
 /*---------------------------------------------------------------------------*/
-void
-dao_output(rpl_parent_t *parent, uint8_t lifetime)
+/*
+ * DAOs are assembled in uip_buf between dao_output_begin() and
+ * dao_output_end(). Each target is written as a Target + Transit
+ * Information option pair; a pair that would make the message exceed
+ * RPL_DAO_MAX_LEN sends the pending message first.
+ */
+static rpl_parent_t *dao_out_parent;
+static int dao_out_pos;
+/*---------------------------------------------------------------------------*/
+static void
+dao_output_flush(void)
 {
-  /* Destination Advertisement Object */
-  uip_ipaddr_t prefix;
+  rpl_dag_t *dag;
+  uip_ipaddr_t *dest_ipaddr;
 
-  if(get_global_addr(&prefix) == 0) {
-    PRINTF("RPL: No global address set for this node - suppressing DAO\n\r");
+  if(dao_out_pos == 0) {
     return;
   }
 
-  /* Sending a DAO with own prefix as target */
-  dao_output_target(parent, &prefix, lifetime);
+  dag = dao_out_parent->dag;
+  /* Storing mode DAOs go to the parent, non-storing ones to the root */
+  dest_ipaddr = RPL_IS_NON_STORING(dag->instance) ? &dag->dag_id :
+    rpl_get_parent_ipaddr(dao_out_parent);
+
+  PRINTF("RPL: Sending DAO of %d bytes to ", dao_out_pos);
+  PRINT6ADDR(dest_ipaddr);
+  PRINTF("\n\r");
+
+  uip_icmp6_send(dest_ipaddr, ICMP6_RPL, RPL_CODE_DAO, dao_out_pos);
+  dao_out_pos = 0;
 }
 /*---------------------------------------------------------------------------*/
 void
-dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
+dao_output_begin(rpl_parent_t *parent)
 {
-  rpl_dag_t *dag;
-  rpl_instance_t *instance;
-  unsigned char *buffer;
-  uint8_t prefixlen;
-  int pos;
-
-  /* Destination Advertisement Object */
+  dao_out_parent = NULL;
+  dao_out_pos = 0;
 
   /* If we are in feather mode, we should not send any DAOs */
   if(rpl_get_mode() == RPL_MODE_FEATHER) {
@@ -832,53 +975,83 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   }
 
   if(parent == NULL) {
-    PRINTF("RPL dao_output_target error parent NULL\n\r");
+    PRINTF("RPL dao_output_begin error parent NULL\n\r");
     return;
   }
 
-  dag = parent->dag;
-  if(dag == NULL) {
-    PRINTF("RPL dao_output_target error dag NULL\n\r");
+  if(parent->dag == NULL) {
+    PRINTF("RPL dao_output_begin error dag NULL\n\r");
     return;
   }
 
-  instance = dag->instance;
-
-  if(instance == NULL) {
-    PRINTF("RPL dao_output_target error instance NULL\n\r");
+  if(parent->dag->instance == NULL) {
+    PRINTF("RPL dao_output_begin error instance NULL\n\r");
     return;
   }
-  if(prefix == NULL) {
-    PRINTF("RPL dao_output_target error prefix NULL\n\r");
+  if(rpl_get_parent_ipaddr(parent) == NULL) {
+    PRINTF("RPL dao_output_begin error parent address NULL\n\r");
     return;
   }
+
 #ifdef RPL_DEBUG_DAO_OUTPUT
   RPL_DEBUG_DAO_OUTPUT(parent);
 #endif
 
+  dao_out_parent = parent;
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output_add_target(uip_ipaddr_t *prefix, uint8_t lifetime)
+{
+  rpl_dag_t *dag;
+  rpl_instance_t *instance;
+  unsigned char *buffer;
+  uint8_t prefixlen;
+  int pos;
+  int pair_len;
+
+  if(dao_out_parent == NULL) {
+    return;
+  }
+  if(prefix == NULL) {
+    PRINTF("RPL dao_output_add_target error prefix NULL\n\r");
+    return;
+  }
+
+  dag = dao_out_parent->dag;
+  instance = dag->instance;
+  prefixlen = sizeof(*prefix) * CHAR_BIT;
+  pair_len = 4 + ((prefixlen + 7) / CHAR_BIT) +
+    (RPL_IS_NON_STORING(instance) ? 6 + 16 : 6);
+
+  if(dao_out_pos > 0 && dao_out_pos + pair_len > RPL_DAO_MAX_LEN) {
+    dao_output_flush();
+  }
+
   buffer = UIP_ICMP_PAYLOAD;
+  pos = dao_out_pos;
 
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-  pos = 0;
+  if(pos == 0) {
+    RPL_LOLLIPOP_INCREMENT(dao_sequence);
 
-  buffer[pos++] = instance->instance_id;
-  buffer[pos] = 0;
+    buffer[pos++] = instance->instance_id;
+    buffer[pos] = 0;
 #if RPL_DAO_SPECIFY_DAG
-  buffer[pos] |= RPL_DAO_D_FLAG;
+    buffer[pos] |= RPL_DAO_D_FLAG;
 #endif /* RPL_DAO_SPECIFY_DAG */
 #if RPL_CONF_DAO_ACK
-  buffer[pos] |= RPL_DAO_K_FLAG;
+    buffer[pos] |= RPL_DAO_K_FLAG;
 #endif /* RPL_CONF_DAO_ACK */
-  ++pos;
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = dao_sequence;
+    ++pos;
+    buffer[pos++] = 0; /* reserved */
+    buffer[pos++] = dao_sequence;
 #if RPL_DAO_SPECIFY_DAG
-  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
-  pos+=sizeof(dag->dag_id);
+    memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
+    pos+=sizeof(dag->dag_id);
 #endif /* RPL_DAO_SPECIFY_DAG */
+  }
 
   /* create target subopt */
-  prefixlen = sizeof(*prefix) * CHAR_BIT;
   buffer[pos++] = RPL_OPTION_TARGET;
   buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
   buffer[pos++] = 0; /* reserved */
@@ -888,21 +1061,83 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 
   /* Create a transit information sub-option. */
   buffer[pos++] = RPL_OPTION_TRANSIT;
-  buffer[pos++] = 4;
+  buffer[pos++] = RPL_IS_NON_STORING(instance) ? 4 + 16 : 4;
   buffer[pos++] = 0; /* flags - ignored */
   buffer[pos++] = 0; /* path control - ignored */
   buffer[pos++] = 0; /* path seq - ignored */
   buffer[pos++] = lifetime;
 
-  PRINTF("RPL: Sending DAO with prefix ");
+  if(RPL_IS_NON_STORING(instance)) {
+    /* Global address of the parent: DODAG prefix and the interface
+       identifier of its link-local address */
+    memcpy(buffer + pos, &dag->dag_id, 8);
+    pos += 8;
+    memcpy(buffer + pos, ((unsigned char *)rpl_get_parent_ipaddr(dao_out_parent)) + 8, 8);
+    pos += 8;
+  }
+
+  PRINTF("RPL: Adding DAO target ");
   PRINT6ADDR(prefix);
-  PRINTF(" to ");
-  PRINT6ADDR(rpl_get_parent_ipaddr(parent));
-  PRINTF("\n\r");
+  PRINTF(" lifetime %u\n\r", (unsigned)lifetime);
+
+  dao_out_pos = pos;
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output_add_routes(uint8_t lifetime)
+{
+  uip_ipaddr_t prefix;
+  uip_ds6_route_t *r;
+
+  if(dao_out_parent == NULL) {
+    return;
+  }
+
+  if(get_global_addr(&prefix) == 0) {
+    PRINTF("RPL: No global address set for this node - suppressing DAO\n\r");
+  } else {
+    dao_output_add_target(&prefix, lifetime);
+  }
 
-  if(rpl_get_parent_ipaddr(parent) != NULL) {
-    uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
+  /* In storing mode the routes learned from DAOs of descendants are
+     advertised along with our own address, so that their refreshes need
+     not be forwarded one by one. */
+  if(RPL_IS_STORING(dao_out_parent->dag->instance)) {
+    for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+      if(r->state.dag == dao_out_parent->dag &&
+         r->state.learned_from == RPL_ROUTE_FROM_UNICAST_DAO &&
+         r->state.nopath_received == 0 &&
+         r->length == sizeof(uip_ipaddr_t) * CHAR_BIT) {
+        dao_output_add_target(&r->ipaddr, lifetime);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output_end(void)
+{
+  if(dao_out_parent != NULL) {
+    dao_output_flush();
   }
+  dao_out_parent = NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output(rpl_parent_t *parent, uint8_t lifetime)
+{
+  /* Destination Advertisement Object */
+  dao_output_begin(parent);
+  dao_output_add_routes(lifetime);
+  dao_output_end();
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
+{
+  dao_output_begin(parent);
+  dao_output_add_target(prefix, lifetime);
+  dao_output_end();
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -47,6 +47,7 @@
 
 #include "rpl-private.h"
 #include "nbr-table.h"
+#include "link-stats.h"
 
 #define DEBUG DEBUG_NONE
 #include "uip-debug.h"
@@ -68,13 +69,6 @@ rpl_of_t rpl_mrhof = {
   1
 };
 
-/* Constants for the ETX moving average */
-#define ETX_SCALE   100
-#define ETX_ALPHA   90
-
-/* Reject parents that have a higher link metric than the following. */
-#define MAX_LINK_METRIC            10
-
 /* Reject parents that have a higher path cost than the following. */
 #define MAX_PATH_COST            100
 
@@ -119,42 +113,30 @@ reset(rpl_dag_t *dag)
 static void
 neighbor_link_callback(rpl_parent_t *p, int status, int numtx)
 {
-  uint16_t recorded_etx = 0;
-  uint16_t packet_etx = numtx * RPL_DAG_MC_ETX_DIVISOR;
-  uint16_t new_etx;
   uip_ds6_nbr_t *nbr = NULL;
+  const struct link_stats *stats;
+  uint16_t new_etx;
 
   nbr = rpl_get_nbr(p);
   if(nbr == NULL) {
       /* No neighbor for this parent - something bad has occurred */
       return;
   }
-  recorded_etx = nbr->link_metric;
 
-  /* Do not penalize the ETX when collisions or transmission errors occur. */
-  if(status == MAC_TX_OK || status == MAC_TX_NOACK) {
-    if(status == MAC_TX_NOACK) {
-      packet_etx = MAX_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
-    }
-
-  if(p->flags & RPL_PARENT_FLAG_LINK_METRIC_VALID) {
-      /* We already have a valid link metric, use weighted moving average to update it */
-      new_etx = ((uint32_t)recorded_etx * ETX_ALPHA +
-              (uint32_t)packet_etx * (ETX_SCALE - ETX_ALPHA)) / ETX_SCALE;
-  } else {
-      /* We don't have a valid link metric, set it to the current packet's ETX */
-      new_etx = packet_etx;
-      /* Set link metric as valid */
-      p->flags |= RPL_PARENT_FLAG_LINK_METRIC_VALID;
-  }
-
-    PRINTF("RPL: ETX changed from %u to %u (packet ETX = %u)\n\r",
-        (unsigned)(recorded_etx / RPL_DAG_MC_ETX_DIVISOR),
-        (unsigned)(new_etx  / RPL_DAG_MC_ETX_DIVISOR),
-        (unsigned)(packet_etx / RPL_DAG_MC_ETX_DIVISOR));
-    /* update the link metric for this nbr */
-    nbr->link_metric = new_etx;
+  /* The ETX estimate itself is maintained by link-stats */
+  stats = link_stats_from_lladdr((const linkaddr_t *)uip_ds6_nbr_get_ll(nbr));
+  if(stats == NULL || stats->etx == 0) {
+    return;
   }
+  new_etx = ((uint32_t)stats->etx * RPL_DAG_MC_ETX_DIVISOR) /
+            LINK_STATS_ETX_DIVISOR;
+
+  PRINTF("RPL: ETX changed from %u to %u\n\r",
+      (unsigned)(nbr->link_metric / RPL_DAG_MC_ETX_DIVISOR),
+      (unsigned)(new_etx / RPL_DAG_MC_ETX_DIVISOR));
+  /* update the link metric for this nbr */
+  nbr->link_metric = new_etx;
+  p->flags |= RPL_PARENT_FLAG_LINK_METRIC_VALID;
 }
 
 static rpl_rank_t
@@ -220,6 +202,15 @@ best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
 
   /* Maintain stability of the preferred parent in case of similar ranks. */
   if(p1 == dag->preferred_parent || p2 == dag->preferred_parent) {
+#if RPL_WITH_PROBING
+    /* Never trade a parent we have recent statistics for against one whose
+       ETX is stale. Probing refreshes the other parent first. */
+    if(rpl_parent_is_fresh(dag->preferred_parent) &&
+       !rpl_parent_is_fresh(p1 == dag->preferred_parent ? p2 : p1)) {
+      return dag->preferred_parent;
+    }
+#endif /* RPL_WITH_PROBING */
+
     if(p1_metric < p2_metric + min_diff &&
        p1_metric > p2_metric - min_diff) {
       PRINTF("RPL: MRHOF hysteresis: %u <= %u <= %u\n\r",
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2016, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+/**
+ * \file
+ *         Link table of the root of a non-storing mode RPL DODAG.
+ *
+ *         Nodes are allocated from a fixed memory block and indexed by a
+ *         hash of their interface identifier, so that DAO processing and
+ *         source route computation do not scan the whole table.
+ */
+
+/**
+ * \addtogroup uip6
+ * @{
+ */
+
+#include "rpl-ns.h"
+#include "memb.h"
+
+#define DEBUG DEBUG_NONE
+#include "uip-debug.h"
+
+#include <string.h>
+
+#if RPL_WITH_NON_STORING
+
+#define RPL_NS_HASH_SIZE                ((RPL_NS_LINK_NUM + 3) / 4)
+
+/* Set during rpl_ns_periodic() on nodes that must be kept */
+#define RPL_NS_FLAG_USED                0x01
+
+MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
+static rpl_ns_node_t *nodehash[RPL_NS_HASH_SIZE];
+static int num_nodes;
+/*---------------------------------------------------------------------------*/
+static unsigned
+hash_link_identifier(const uint8_t *link_identifier)
+{
+  unsigned h;
+  int i;
+
+  h = 0;
+  for(i = 0; i < 8; i++) {
+    h = h * 31 + link_identifier[i];
+  }
+  return h % RPL_NS_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static int
+node_matches_address(const rpl_dag_t *dag, const rpl_ns_node_t *node,
+                     const uip_ipaddr_t *addr)
+{
+  return node->dag == dag &&
+    memcmp(addr, &dag->dag_id, 8) == 0 &&
+    memcmp(((const uint8_t *)addr) + 8, node->link_identifier, 8) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+node_is_root(const rpl_ns_node_t *node)
+{
+  return memcmp(((const uint8_t *)&node->dag->dag_id) + 8,
+                node->link_identifier, 8) == 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Walk up from node; a path that does not end at the root within
+   num_nodes hops contains a loop or an unknown parent. */
+static int
+node_is_reachable(const rpl_ns_node_t *node)
+{
+  int hops;
+
+  for(hops = 0; node != NULL && hops <= num_nodes; hops++) {
+    if(node_is_root(node)) {
+      return 1;
+    }
+    node = node->parent;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_node(rpl_ns_node_t *node)
+{
+  rpl_ns_node_t **pp;
+
+  for(pp = &nodehash[hash_link_identifier(node->link_identifier)];
+      *pp != NULL; pp = &(*pp)->next) {
+    if(*pp == node) {
+      *pp = node->next;
+      break;
+    }
+  }
+  memb_free(&nodememb, node);
+  num_nodes--;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_init(void)
+{
+  memb_init(&nodememb);
+  memset(nodehash, 0, sizeof(nodehash));
+  num_nodes = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_num_nodes(void)
+{
+  return num_nodes;
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_node_head(void)
+{
+  int i;
+
+  for(i = 0; i < RPL_NS_HASH_SIZE; i++) {
+    if(nodehash[i] != NULL) {
+      return nodehash[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_node_next(rpl_ns_node_t *item)
+{
+  unsigned i;
+
+  if(item->next != NULL) {
+    return item->next;
+  }
+  for(i = hash_link_identifier(item->link_identifier) + 1;
+      i < RPL_NS_HASH_SIZE; i++) {
+    if(nodehash[i] != NULL) {
+      return nodehash[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  rpl_ns_node_t *node;
+
+  if(dag == NULL || addr == NULL) {
+    return NULL;
+  }
+
+  for(node = nodehash[hash_link_identifier(((const uint8_t *)addr) + 8)];
+      node != NULL; node = node->next) {
+    if(node_matches_address(dag, node, addr)) {
+      return node;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  return node_is_reachable(rpl_ns_get_node(dag, addr));
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, const rpl_ns_node_t *node)
+{
+  memcpy(addr, &node->dag->dag_id, 8);
+  memcpy(((uint8_t *)addr) + 8, node->link_identifier, 8);
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                   const uip_ipaddr_t *parent, uint32_t lifetime)
+{
+  rpl_ns_node_t *child_node;
+  rpl_ns_node_t *parent_node;
+  rpl_ns_node_t *old_parent_node;
+  unsigned h;
+
+  parent_node = NULL;
+  if(parent != NULL) {
+    parent_node = rpl_ns_get_node(dag, parent);
+    if(parent_node == NULL) {
+      /* Keep the parent until it registers with its own lifetime */
+      parent_node = rpl_ns_update_node(dag, parent, NULL,
+                                       RPL_NS_INFINITE_LIFETIME);
+      if(parent_node == NULL) {
+        return NULL;
+      }
+    }
+  }
+
+  child_node = rpl_ns_get_node(dag, child);
+  if(child_node == NULL) {
+    child_node = memb_alloc(&nodememb);
+    if(child_node == NULL) {
+      PRINTF("RPL: No space left in the non-storing link table\n\r");
+      return NULL;
+    }
+    memcpy(child_node->link_identifier, ((const uint8_t *)child) + 8, 8);
+    child_node->dag = dag;
+    child_node->parent = NULL;
+    child_node->flags = 0;
+    h = hash_link_identifier(child_node->link_identifier);
+    child_node->next = nodehash[h];
+    nodehash[h] = child_node;
+    num_nodes++;
+  }
+
+  child_node->lifetime = lifetime;
+
+  if(node_is_reachable(child_node)) {
+    old_parent_node = child_node->parent;
+    child_node->parent = parent_node;
+    if(!node_is_reachable(child_node)) {
+      /* The new parent would create a loop. Keep the old link; the next
+         DAO will be accepted once the topology has settled. */
+      PRINTF("RPL: Ignoring a DAO that would create a loop\n\r");
+      child_node->parent = old_parent_node;
+    }
+  } else {
+    child_node->parent = parent_node;
+  }
+
+  return child_node;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                     const uip_ipaddr_t *parent)
+{
+  rpl_ns_node_t *node;
+
+  node = rpl_ns_get_node(dag, child);
+  if(node != NULL && node->parent != NULL &&
+     node->parent == rpl_ns_get_node(dag, parent)) {
+    node->lifetime = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_free_dag(rpl_dag_t *dag)
+{
+  rpl_ns_node_t *node;
+
+  for(node = rpl_ns_node_head(); node != NULL; node = rpl_ns_node_next(node)) {
+    if(node->dag == dag) {
+      node->lifetime = 0;
+      node->parent = NULL;
+    }
+  }
+  /* Nodes of other DODAGs never point into this one */
+  rpl_ns_periodic();
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_periodic(void)
+{
+  rpl_ns_node_t *node;
+  rpl_ns_node_t *p;
+  rpl_ns_node_t *next;
+  int i;
+
+  /* First pass: age the links */
+  for(node = rpl_ns_node_head(); node != NULL; node = rpl_ns_node_next(node)) {
+    if(node->lifetime != RPL_NS_INFINITE_LIFETIME && node->lifetime > 0) {
+      node->lifetime--;
+    }
+    node->flags &= ~RPL_NS_FLAG_USED;
+  }
+
+  /* Second pass: keep every live node and all of its ancestors. Walks stop
+     at the first node already marked, so each node is visited once. */
+  for(node = rpl_ns_node_head(); node != NULL; node = rpl_ns_node_next(node)) {
+    if(node->lifetime > 0) {
+      for(p = node; p != NULL && !(p->flags & RPL_NS_FLAG_USED); p = p->parent) {
+        p->flags |= RPL_NS_FLAG_USED;
+      }
+    }
+  }
+
+  /* Third pass: anything not marked is expired and only referenced by
+     other expired nodes, which are removed in the same pass. */
+  for(i = 0; i < RPL_NS_HASH_SIZE; i++) {
+    for(node = nodehash[i]; node != NULL; node = next) {
+      next = node->next;
+      if(!(node->flags & RPL_NS_FLAG_USED)) {
+        PRINTF("RPL: Removing expired non-storing link\n\r");
+        remove_node(node);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+#endif /* RPL_WITH_NON_STORING */
+/** @} */
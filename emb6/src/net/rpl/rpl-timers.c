@@ -43,6 +43,7 @@
 //#include "contiki-conf.h"
 #include "emb6.h"
 #include "rpl-private.h"
+#include "rpl-ns.h"
 #if UIP_CONF_IPV6_MULTICAST
 #include "uip-mcast6.h"
 #endif
@@ -69,6 +70,9 @@ static void
 handle_periodic_timer(void *ptr)
 {
   rpl_purge_routes();
+#if RPL_WITH_NON_STORING
+  rpl_ns_periodic();
+#endif /* RPL_WITH_NON_STORING */
   rpl_recalculate_ranks();
 
   /* handle DIS */
@@ -240,9 +244,10 @@ handle_dao_timer(void *ptr)
   /* Send the DAO to the DAO parent set -- the preferred parent in our case. */
   if(instance->current_dag->preferred_parent != NULL) {
     PRINTF("RPL: handle_dao_timer - sending DAO\n\r");
-    /* Set the route lifetime to the default value. */
-    dao_output(instance->current_dag->preferred_parent, instance->default_lifetime);
-
+    /* Set the route lifetime to the default value. Our own address and
+       the routes of our descendants share as few DAOs as possible. */
+    dao_output_begin(instance->current_dag->preferred_parent);
+    dao_output_add_routes(instance->default_lifetime);
 
     #if RPL_CONF_MULTICAST
         /* Send DAOs for multicast prefixes only if the instance is in MOP 3 */
@@ -251,8 +256,8 @@ handle_dao_timer(void *ptr)
           for(i = 0; i < UIP_DS6_MADDR_NB; i++) {
             if(uip_ds6_if.maddr_list[i].isused
                 && uip_is_addr_mcast_global(&uip_ds6_if.maddr_list[i].ipaddr)) {
-              dao_output_target(instance->current_dag->preferred_parent,
-                  &uip_ds6_if.maddr_list[i].ipaddr, RPL_MCAST_LIFETIME);
+              dao_output_add_target(&uip_ds6_if.maddr_list[i].ipaddr,
+                  RPL_MCAST_LIFETIME);
             }
           }
 
@@ -261,13 +266,13 @@ handle_dao_timer(void *ptr)
           while(mcast_route != NULL) {
             /* Don't send if it's also our own address, done that already */
             if(uip_ds6_maddr_lookup(&mcast_route->group) == NULL) {
-              dao_output_target(instance->current_dag->preferred_parent,
-                         &mcast_route->group, RPL_MCAST_LIFETIME);
+              dao_output_add_target(&mcast_route->group, RPL_MCAST_LIFETIME);
             }
             mcast_route = list_item_next(mcast_route);
           }
         }
     #endif
+    dao_output_end();
   } else {
     PRINTF("RPL: No suitable DAO parent\n\r");
   }
@@ -325,4 +330,56 @@ rpl_cancel_dao(rpl_instance_t *instance)
   ctimer_stop(&instance->dao_lifetime_timer);
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_PROBING
+static void
+handle_probing_timer(void *ptr)
+{
+  rpl_instance_t *instance;
+  rpl_parent_t *target;
+  uip_ipaddr_t *target_ipaddr;
+
+  instance = (rpl_instance_t *)ptr;
+
+  /* A unicast DIO is acknowledged by the MAC, which refreshes the link
+     statistics of the probed parent */
+  target = rpl_get_probing_target(instance->current_dag);
+  if(target != NULL) {
+    target_ipaddr = rpl_get_parent_ipaddr(target);
+    if(target_ipaddr != NULL) {
+      PRINTF("RPL: Probing ");
+      PRINT6ADDR(target_ipaddr);
+      PRINTF("\n\r");
+      dio_output(instance, target_ipaddr);
+    }
+  }
+
+  rpl_schedule_probing(instance);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_schedule_probing(rpl_instance_t *instance)
+{
+  clock_time_t delay;
+
+  /* Random delay in [I/2, 3I/2], drawn in whole seconds */
+  delay = RPL_PROBING_INTERVAL / 2 +
+    ((uint32_t)RPL_PROBING_INTERVAL * (uint32_t)random_rand()) / RANDOM_RAND_MAX;
+  ctimer_set(&instance->probing_timer, delay * bsp_get(E_BSP_GET_TRES),
+             handle_probing_timer, instance);
+}
+/*---------------------------------------------------------------------------*/
+/* Probe within a second, unless a probe is already due before that */
+void
+rpl_schedule_probing_now(rpl_instance_t *instance)
+{
+  clock_time_t delay;
+
+  delay = random_rand() % bsp_get(E_BSP_GET_TRES);
+  if(etimer_expired(&instance->probing_timer.etimer) ||
+     etimer_expiration_time(&instance->probing_timer.etimer) - bsp_getTick() > delay) {
+    ctimer_set(&instance->probing_timer, delay, handle_probing_timer, instance);
+  }
+}
+#endif /* RPL_WITH_PROBING */
+/*---------------------------------------------------------------------------*/
 /** @} */
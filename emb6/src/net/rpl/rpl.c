@@ -47,6 +47,7 @@
 #include "uip-ds6.h"
 #include "uip-icmp6.h"
 #include "rpl-private.h"
+#include "rpl-ns.h"
 #if UIP_CONF_IPV6_MULTICAST
 #include "uip-mcast6.h"
 #endif
@@ -103,67 +104,126 @@ rpl_set_mode(enum rpl_mode m)
     return oldmode;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Route lifetimes are stored as absolute expiry times on route_clock, which
+ * advances once per rpl_purge_routes() call. route_wheel counts, per slot
+ * (expiry modulo RPL_ROUTE_WHEEL_SIZE), the routes that may expire in that
+ * second; the routing table is only scanned when the current slot is not
+ * empty. Routes removed by other means leave a stale count behind, which is
+ * corrected by the next scan of their slot.
+ */
+static uint32_t route_clock;
+static uint16_t route_wheel[RPL_ROUTE_WHEEL_SIZE];
+#if RPL_CONF_MULTICAST
+static uint32_t mcast_next_expiry = 0xffffffffUL;
+#endif
+/*---------------------------------------------------------------------------*/
+static uint32_t
+expiry_from_lifetime(uint32_t lifetime)
+{
+  /* A lifetime of zero expires at the next tick, just as a lifetime of one */
+  if(lifetime == 0) {
+    lifetime = 1;
+  }
+  if(lifetime > 0xffffffffUL - route_clock) {
+    return 0xffffffffUL;
+  }
+  return route_clock + lifetime;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_set_route_lifetime(uip_ds6_route_t *r, uint32_t lifetime)
+{
+  uint16_t *slot;
+
+  /* Fresh routes are zeroed by uip_ds6_route_add and not yet counted */
+  if(r->state.expiry > route_clock) {
+    slot = &route_wheel[r->state.expiry % RPL_ROUTE_WHEEL_SIZE];
+    if(*slot > 0) {
+      (*slot)--;
+    }
+  }
+  r->state.expiry = expiry_from_lifetime(lifetime);
+  route_wheel[r->state.expiry % RPL_ROUTE_WHEEL_SIZE]++;
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_CONF_MULTICAST
+void
+rpl_set_mcast_route_lifetime(uip_mcast6_route_t *mcast_route, uint32_t lifetime)
+{
+  mcast_route->expiry = expiry_from_lifetime(lifetime);
+  if(mcast_route->expiry < mcast_next_expiry) {
+    mcast_next_expiry = mcast_route->expiry;
+  }
+}
+#endif
+/*---------------------------------------------------------------------------*/
 void
 rpl_purge_routes(void)
 {
   uip_ds6_route_t *r;
+  uip_ds6_route_t *next;
   uip_ipaddr_t prefix;
   rpl_dag_t *dag;
+  unsigned slot;
+  uint16_t pending;
   #if RPL_CONF_MULTICAST
     uip_mcast6_route_t *mcast_route;
+    uip_mcast6_route_t *mcast_next;
   #endif
 
-  /* First pass, decrement lifetime */
-  r = uip_ds6_route_head();
-
-  while(r != NULL) {
-    if(r->state.lifetime >= 1) {
-      /*
-       * If a route is at lifetime == 1, set it to 0, scheduling it for
-       * immediate removal below. This achieves the same as the original code,
-       * which would delete lifetime <= 1
-       */
-      r->state.lifetime--;
-    }
-    r = uip_ds6_route_next(r);
-  }
+  route_clock++;
+  slot = route_clock % RPL_ROUTE_WHEEL_SIZE;
 
-  /* Second pass, remove dead routes */
-  r = uip_ds6_route_head();
+  if(route_wheel[slot] > 0) {
+    dag = default_instance != NULL ? default_instance->current_dag : NULL;
+    /* Propagate expired routes with No-Path DAOs to the preferred parent
+       if we are not an RPL Root */
+    if(dag != NULL && dag->rank != ROOT_RANK(default_instance)) {
+      dao_output_begin(dag->preferred_parent);
+    } else {
+      dag = NULL;
+    }
+    pending = 0;
+
+    /* Single pass: remove what has expired and recount this slot */
+    for(r = uip_ds6_route_head(); r != NULL; r = next) {
+      next = uip_ds6_route_next(r);
+      if(r->state.expiry > route_clock) {
+        if(r->state.expiry % RPL_ROUTE_WHEEL_SIZE == slot) {
+          pending++;
+        }
+        continue;
+      }
 
-  while(r != NULL) {
-    if(r->state.lifetime < 1) {
-      /* Routes with lifetime == 1 have only just been decremented from 2 to 1,
-       * thus we want to keep them. Hence < and not <= */
       uip_ipaddr_copy(&prefix, &r->ipaddr);
       uip_ds6_route_rm(r);
-      r = uip_ds6_route_head();
       PRINTF("No more routes to ");
       PRINT6ADDR(&prefix);
-      dag = default_instance->current_dag;
-      /* Propagate this information with a No-Path DAO to preferred parent if we are not an RPL Root */
-      if(dag->rank != ROOT_RANK(default_instance)) {
+      if(dag != NULL) {
         PRINTF(" -> generate No-Path DAO\n\r");
-        dao_output_target(dag->preferred_parent, &prefix, RPL_ZERO_LIFETIME);
-        /* Don't schedule more than 1 No-Path DAO, let next iteration handle that */
-        return;
+        dao_output_add_target(&prefix, RPL_ZERO_LIFETIME);
+      } else {
+        PRINTF("\n\r");
       }
-      PRINTF("\n\r");
-    } else {
-      r = uip_ds6_route_next(r);
+    }
+    route_wheel[slot] = pending;
+    if(dag != NULL) {
+      dao_output_end();
     }
   }
 
   #if RPL_CONF_MULTICAST
-    mcast_route = uip_mcast6_route_list_head();
-
-    while(mcast_route != NULL) {
-      if(mcast_route->lifetime <= 1) {
-        uip_mcast6_route_rm(mcast_route);
-        mcast_route = uip_mcast6_route_list_head();
-      } else {
-        mcast_route->lifetime--;
-        mcast_route = list_item_next(mcast_route);
+    if(route_clock >= mcast_next_expiry) {
+      mcast_next_expiry = 0xffffffffUL;
+      for(mcast_route = uip_mcast6_route_list_head(); mcast_route != NULL;
+          mcast_route = mcast_next) {
+        mcast_next = list_item_next(mcast_route);
+        if(mcast_route->expiry <= route_clock) {
+          uip_mcast6_route_rm(mcast_route);
+        } else if(mcast_route->expiry < mcast_next_expiry) {
+          mcast_next_expiry = mcast_route->expiry;
+        }
       }
     }
   #endif
@@ -173,30 +233,25 @@ void
 rpl_remove_routes(rpl_dag_t *dag)
 {
   uip_ds6_route_t *r;
+  uip_ds6_route_t *next;
   #if RPL_CONF_MULTICAST
     uip_mcast6_route_t *mcast_route;
+    uip_mcast6_route_t *mcast_next;
   #endif
 
-  r = uip_ds6_route_head();
-
-  while(r != NULL) {
+  for(r = uip_ds6_route_head(); r != NULL; r = next) {
+    next = uip_ds6_route_next(r);
     if(r->state.dag == dag) {
       uip_ds6_route_rm(r);
-      r = uip_ds6_route_head();
-    } else {
-      r = uip_ds6_route_next(r);
     }
   }
 
   #if RPL_CONF_MULTICAST
-    mcast_route = uip_mcast6_route_list_head();
-
-    while(mcast_route != NULL) {
+    for(mcast_route = uip_mcast6_route_list_head(); mcast_route != NULL;
+        mcast_route = mcast_next) {
+      mcast_next = list_item_next(mcast_route);
       if(mcast_route->dag == dag) {
         uip_mcast6_route_rm(mcast_route);
-        mcast_route = uip_mcast6_route_list_head();
-      } else {
-        mcast_route = list_item_next(mcast_route);
       }
     }
   #endif
@@ -206,16 +261,13 @@ void
 rpl_remove_routes_by_nexthop(uip_ipaddr_t *nexthop, rpl_dag_t *dag)
 {
   uip_ds6_route_t *r;
+  uip_ds6_route_t *next;
 
-  r = uip_ds6_route_head();
-
-  while(r != NULL) {
+  for(r = uip_ds6_route_head(); r != NULL; r = next) {
+    next = uip_ds6_route_next(r);
     if(uip_ipaddr_cmp(uip_ds6_route_nexthop(r), nexthop) &&
        r->state.dag == dag) {
       uip_ds6_route_rm(r);
-      r = uip_ds6_route_head();
-    } else {
-      r = uip_ds6_route_next(r);
     }
   }
   ANNOTATE("#L %u 0\n\r", nexthop->u8[sizeof(uip_ipaddr_t) - 1]);
@@ -233,7 +285,7 @@ rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
   }
 
   rep->state.dag = dag;
-  rep->state.lifetime = RPL_LIFETIME(dag->instance, dag->instance->default_lifetime);
+  rpl_set_route_lifetime(rep, RPL_LIFETIME(dag->instance, dag->instance->default_lifetime));
   rep->state.learned_from = RPL_ROUTE_FROM_INTERNAL;
 
   PRINTF("RPL: Added a route to ");
@@ -266,6 +318,13 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
         if(instance->of->neighbor_link_callback != NULL) {
           instance->of->neighbor_link_callback(parent, status, numtx);
         }
+#if RPL_WITH_PROBING
+        /* Our preferred parent is failing: get fresh statistics for the
+           best backup before the next parent selection */
+        if(status == MAC_TX_NOACK && parent == parent->dag->preferred_parent) {
+          rpl_schedule_probing_now(instance);
+        }
+#endif /* RPL_WITH_PROBING */
       }
     }
   }
@@ -302,6 +361,9 @@ rpl_init(void)
   default_instance = NULL;
 
   rpl_dag_init();
+#if RPL_WITH_NON_STORING
+  rpl_ns_init();
+#endif /* RPL_WITH_NON_STORING */
   rpl_reset_periodic_timer();
   rpl_icmp6_register_handlers();
 
@@ -81,6 +81,7 @@
 #include "framer-802154.h"
 
 #include "uip-ds6-nbr.h"
+#include "link-stats.h"
 
 
 
@@ -126,6 +127,16 @@ void uip_log(char *msg);
 #endif /* SICSLOWPAN_CONF_COMPRESSION */
 #endif /* SICSLOWPAN_COMPRESSION */
 
+#ifdef SICSLOWPAN_CONF_6LORH
+#define SICSLOWPAN_6LORH SICSLOWPAN_CONF_6LORH
+#else
+#define SICSLOWPAN_6LORH 0
+#endif /* SICSLOWPAN_CONF_6LORH */
+
+#if SICSLOWPAN_6LORH && SICSLOWPAN_COMPRESSION != SICSLOWPAN_COMPRESSION_HC06
+#error "6LoRH encoding requires SICSLOWPAN_COMPRESSION_HC06"
+#endif
+
 #define GET16(ptr,index) (((uint16_t)((ptr)[index] << 8)) | ((ptr)[(index) + 1]))
 #define SET16(ptr,index,value) do {     \
   (ptr)[index] = ((value) >> 8) & 0xff; \
@@ -161,10 +172,19 @@ void uip_log(char *msg);
  *  @{
  */
 #define SICSLOWPAN_IP_BUF   ((struct uip_ip_hdr *)&sicslowpan_buf[UIP_LLH_LEN])
+#if SICSLOWPAN_6LORH
+/* The UDP header follows the extension headers carried as 6LoRH */
+#define SICSLOWPAN_UDP_BUF ((struct uip_udp_hdr *)&sicslowpan_buf[UIP_LLIPH_LEN + lorh_ext_len])
+#else
 #define SICSLOWPAN_UDP_BUF ((struct uip_udp_hdr *)&sicslowpan_buf[UIP_LLIPH_LEN])
+#endif /* SICSLOWPAN_6LORH */
 
 #define UIP_IP_BUF          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#if SICSLOWPAN_6LORH
+#define UIP_UDP_BUF          ((struct uip_udp_hdr *)&uip_buf[UIP_LLIPH_LEN + lorh_ext_len])
+#else
 #define UIP_UDP_BUF          ((struct uip_udp_hdr *)&uip_buf[UIP_LLIPH_LEN])
+#endif /* SICSLOWPAN_6LORH */
 #define UIP_TCP_BUF          ((struct uip_tcp_hdr *)&uip_buf[UIP_LLIPH_LEN])
 #define UIP_ICMP_BUF          ((struct uip_icmp_hdr *)&uip_buf[UIP_LLIPH_LEN])
 /** @} */
@@ -211,7 +231,7 @@ static uint8_t *packetbuf_ptr;
  * (fragment headers, IPV6 or HC1, HC2, and HC1 and HC2 non compressed
  * fields).
  */
-static uint8_t packetbuf_hdr_len;
+static uint16_t packetbuf_hdr_len;
 
 /**
  * The length of the payload in the Packetbuf buffer.
@@ -225,10 +245,20 @@ static int packetbuf_payload_len;
  * uncomp_hdr_len is the length of the headers before compression (if HC2
  * is used this includes the UDP header in addition to the IP header).
  */
-static uint8_t uncomp_hdr_len;
+static uint16_t uncomp_hdr_len;
+
+#if SICSLOWPAN_6LORH
+/**
+ * Length of the IPv6 extension headers that are carried as 6LoRH in
+ * front of the IPHC header. They sit between the IPv6 header and the
+ * header compressed by LOWPAN_NHC.
+ */
+static uint16_t lorh_ext_len;
+#endif /* SICSLOWPAN_6LORH */
 
 /**
- * the result of the last transmitted fragment
+ * the result of the last transmitted fragment, MAC_TX_QUEUED while the
+ * MAC has not reported it yet
  */
 static int last_tx_status;
 /** @} */
@@ -474,6 +504,434 @@ uncompress_addr(uip_ipaddr_t *ipaddr, uint8_t const prefix[],
   PRINTF("\n\r");
 }
 
+#if SICSLOWPAN_6LORH
+/*--------------------------------------------------------------------*/
+/** \name 6LoWPAN Routing Header (RFC 8138) related functions
+ * @{                                                                 */
+/*--------------------------------------------------------------------*/
+/* Hop-by-hop header that holds nothing but the RPL option (RFC 6553) */
+#define LORH_RPI_EXT_LEN        8
+#define LORH_OPT_RPL_LEN        4
+/* The O, R and F flags of the RPL option, three bits lower in 6LoRH */
+#define LORH_RPL_FLAGS_MASK     0xe0
+#define LORH_RPL_FLAGS_SHIFT    3
+/* Routing header type 3, the RPL source routing header (RFC 6554) */
+#define LORH_RH_TYPE_SRH        3
+#define LORH_SRH_HDR_LEN        8
+#define LORH_SRH_MAX_HOPS       (SICSLOWPAN_6LORH_SIZE_MASK + 1)
+/* An SRH-6LoRH must leave room for the IPHC header in the first frame */
+#define LORH_SRH_MAX_LEN        64
+
+/** The 6LoRH headers of the packet being uncompressed */
+static uint8_t *lorh_rpi;
+static uint8_t *lorh_srh;
+/*--------------------------------------------------------------------*/
+static uint8_t
+lorh_prefix_len(const uip_ipaddr_t *a, const uip_ipaddr_t *b, uint8_t max)
+{
+  uint8_t i;
+
+  for(i = 0; i < max && a->u8[i] == b->u8[i]; i++);
+  return i;
+}
+/*--------------------------------------------------------------------*/
+/* Length of a source routing header with n hops, padding included */
+static uint16_t
+srh_len(uint8_t n, uint8_t cmpri, uint8_t cmpre)
+{
+  return (LORH_SRH_HDR_LEN + (n - 1) * (16 - cmpri) + (16 - cmpre) + 7) & ~7;
+}
+/*--------------------------------------------------------------------*/
+/* Read hop i of n from a source routing header. The elided octets are
+   those of the IPv6 destination, RFC 6554 section 3. */
+static void
+srh_get_hop(uip_ipaddr_t *hop, const uint8_t *rh, uint8_t i, uint8_t n,
+            uint8_t cmpri, uint8_t cmpre, const uip_ipaddr_t *dest)
+{
+  uint8_t size;
+
+  size = i == n - 1 ? 16 - cmpre : 16 - cmpri;
+  uip_ipaddr_copy(hop, dest);
+  memcpy(&hop->u8[16 - size], rh + LORH_SRH_HDR_LEN + i * (16 - cmpri), size);
+}
+/*--------------------------------------------------------------------*/
+static void
+srh_set_hop(uint8_t *rh, const uip_ipaddr_t *hop, uint8_t i, uint8_t n,
+            uint8_t cmpri, uint8_t cmpre)
+{
+  uint8_t size;
+
+  size = i == n - 1 ? 16 - cmpre : 16 - cmpri;
+  memcpy(rh + LORH_SRH_HDR_LEN + i * (16 - cmpri), &hop->u8[16 - size], size);
+}
+/*--------------------------------------------------------------------*/
+/* Fill in the fixed part and the padding of a source routing header */
+static uint16_t
+srh_set_hdr(uint8_t *rh, uint8_t n, uint8_t cmpri, uint8_t cmpre)
+{
+  uint16_t len;
+  uint8_t pad;
+
+  len = srh_len(n, cmpri, cmpre);
+  pad = len - (LORH_SRH_HDR_LEN + (n - 1) * (16 - cmpri) + (16 - cmpre));
+  rh[1] = len / 8 - 1;
+  rh[2] = LORH_RH_TYPE_SRH;
+  rh[3] = n;
+  rh[4] = (cmpri << 4) | cmpre;
+  rh[5] = pad << 4;
+  rh[6] = 0;
+  rh[7] = 0;
+  memset(rh + len - pad, 0, pad);
+  return len;
+}
+/*--------------------------------------------------------------------*/
+/*
+ * Rewrite the source routing header at rh so that it lists only the hops
+ * that are left, with CmprI and CmprE chosen the way the RPL root does.
+ * This is the header the receiver rebuilds from the SRH-6LoRH, so both
+ * ends agree on the length of the packet, which fragment offsets depend
+ * on. A header with no segment left is removed and *next is updated.
+ *
+ * Returns the number of hops left, or -1 if the header cannot be encoded.
+ */
+static int
+srh_normalize(uint8_t *rh, uint8_t *next)
+{
+  const uip_ipaddr_t *dest;
+  uip_ipaddr_t hop;
+  uint8_t *end;
+  uint8_t old_cmpri;
+  uint8_t old_cmpre;
+  uint8_t cmpri;
+  uint8_t cmpre;
+  uint8_t pad;
+  uint16_t ext_len;
+  uint16_t new_len;
+  int path_len;
+  int first;
+  int left;
+  int i;
+
+  dest = &UIP_IP_BUF->destipaddr;
+  ext_len = (rh[1] + 1) * 8;
+  end = rh + ext_len;
+  old_cmpri = rh[4] >> 4;
+  old_cmpre = rh[4] & 0x0f;
+  pad = rh[5] >> 4;
+  left = rh[3];
+  if(end > &uip_buf[UIP_LLH_LEN + uip_len] ||
+     ext_len < LORH_SRH_HDR_LEN + pad + (16 - old_cmpre)) {
+    return -1;
+  }
+  path_len = (ext_len - pad - LORH_SRH_HDR_LEN - (16 - old_cmpre)) /
+    (16 - old_cmpri) + 1;
+  if(left > path_len || left > LORH_SRH_MAX_HOPS) {
+    return -1;
+  }
+
+  if(left == 0) {
+    *next = rh[0];
+    new_len = 0;
+  } else {
+    first = path_len - left;
+    srh_get_hop(&hop, rh, path_len - 1, path_len, old_cmpri, old_cmpre, dest);
+    cmpre = lorh_prefix_len(dest, &hop, 15);
+    cmpri = cmpre;
+    for(i = first; i < path_len - 1; i++) {
+      srh_get_hop(&hop, rh, i, path_len, old_cmpri, old_cmpre, dest);
+      if(lorh_prefix_len(dest, &hop, 15) < cmpri) {
+        cmpri = lorh_prefix_len(dest, &hop, 15);
+      }
+    }
+
+    /* The hops move towards the start of the header in place, so none
+       of them may grow */
+    new_len = srh_len(left, cmpri, cmpre);
+    if(new_len > ext_len || (left > 1 && cmpri < old_cmpri)) {
+      return -1;
+    }
+    for(i = 0; i < left; i++) {
+      srh_get_hop(&hop, rh, first + i, path_len, old_cmpri, old_cmpre, dest);
+      srh_set_hop(rh, &hop, i, left, cmpri, cmpre);
+    }
+    srh_set_hdr(rh, left, cmpri, cmpre);
+  }
+
+  memmove(rh + new_len, end, &uip_buf[UIP_LLH_LEN + uip_len] - end);
+  uip_len -= ext_len - new_len;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+  return left;
+}
+/*--------------------------------------------------------------------*/
+/*
+ * SRH-6LoRH: every hop is sent as the octets in which it differs from
+ * the hop before it, the first one from the root, which is the IPv6
+ * source (RFC 8138 section 5.1). All hops use the same size, 1, 2, 4, 8
+ * or 16 octets (6LoRH type 0 to 4).
+ */
+static uint8_t *
+compress_srh_6lorh(uint8_t *ptr, const uint8_t *rh, uint8_t n)
+{
+  const uip_ipaddr_t *dest;
+  uip_ipaddr_t ref;
+  uip_ipaddr_t hop;
+  uint8_t cmpri;
+  uint8_t cmpre;
+  uint8_t size;
+  uint8_t type;
+  uint8_t i;
+
+  dest = &UIP_IP_BUF->destipaddr;
+  cmpri = rh[4] >> 4;
+  cmpre = rh[4] & 0x0f;
+
+  size = 1;
+  uip_ipaddr_copy(&ref, &UIP_IP_BUF->srcipaddr);
+  for(i = 0; i < n; i++) {
+    srh_get_hop(&hop, rh, i, n, cmpri, cmpre, dest);
+    while(size < 16 && lorh_prefix_len(&ref, &hop, 16) < 16 - size) {
+      size <<= 1;
+    }
+    uip_ipaddr_copy(&ref, &hop);
+  }
+  if(2 + n * size > LORH_SRH_MAX_LEN) {
+    return NULL;
+  }
+  for(type = 0; (1 << type) < size; type++);
+
+  *ptr++ = SICSLOWPAN_6LORH_CRITICAL | (n - 1);
+  *ptr++ = type;
+  for(i = 0; i < n; i++) {
+    srh_get_hop(&hop, rh, i, n, cmpri, cmpre, dest);
+    memcpy(ptr, &hop.u8[16 - size], size);
+    ptr += size;
+  }
+  return ptr;
+}
+/*--------------------------------------------------------------------*/
+/*
+ * RPI-6LoRH: the flags go in the first byte, the instance is elided when
+ * it is 0 (I flag) and a SenderRank below 256 takes one octet (K flag).
+ */
+static uint8_t *
+compress_rpi_6lorh(uint8_t *ptr, const uint8_t *hbh)
+{
+  uint8_t *first;
+
+  first = ptr;
+  *ptr++ = SICSLOWPAN_6LORH_CRITICAL |
+    ((hbh[4] & LORH_RPL_FLAGS_MASK) >> LORH_RPL_FLAGS_SHIFT);
+  *ptr++ = SICSLOWPAN_6LORH_TYPE_RPI;
+  if(hbh[5] == 0) {
+    *first |= SICSLOWPAN_6LORH_RPI_I;
+  } else {
+    *ptr++ = hbh[5];
+  }
+  if(hbh[6] == 0) {
+    *first |= SICSLOWPAN_6LORH_RPI_K;
+  } else {
+    *ptr++ = hbh[6];
+  }
+  *ptr++ = hbh[7];
+  return ptr;
+}
+/*--------------------------------------------------------------------*/
+/*
+ * Encode the RPL option and the source routing header of the packet in
+ * uip_buf as 6LoRH behind a page 1 dispatch, at the start of packetbuf.
+ * Sets lorh_ext_len and returns the header that follows them, which is
+ * what the IPHC next header field describes. A header that cannot be
+ * encoded, and anything behind it, stays inline after the IPHC header.
+ */
+static uint8_t
+compress_6lorh(void)
+{
+  uint8_t *ext;
+  uint8_t *rpi;
+  uint8_t *srh;
+  uint8_t *next;
+  uint8_t *ptr;
+  int hops;
+
+  lorh_ext_len = 0;
+  next = &UIP_IP_BUF->proto;
+  ext = &uip_buf[UIP_LLIPH_LEN];
+  rpi = NULL;
+  srh = NULL;
+  hops = 0;
+
+  if(*next == UIP_PROTO_HBHO && ext[1] == 0 &&
+     ext[2] == UIP_EXT_HDR_OPT_RPL && ext[3] == LORH_OPT_RPL_LEN) {
+    rpi = ext;
+    next = &ext[0];
+    ext += LORH_RPI_EXT_LEN;
+  }
+  if(*next == UIP_PROTO_ROUTING && ext[2] == LORH_RH_TYPE_SRH) {
+    hops = srh_normalize(ext, next);
+    if(hops > 0) {
+      srh = ext;
+    }
+  }
+  if(rpi == NULL && srh == NULL) {
+    return *next;
+  }
+
+  ptr = packetbuf_ptr;
+  *ptr++ = SICSLOWPAN_DISPATCH_PAGING_1;
+  if(srh != NULL) {
+    ptr = compress_srh_6lorh(ptr, srh, hops);
+    if(ptr == NULL) {
+      /* Too long, leave it inline */
+      if(rpi == NULL) {
+        return *next;
+      }
+      ptr = packetbuf_ptr + 1;
+    } else {
+      lorh_ext_len += (srh[1] + 1) * 8;
+      next = &srh[0];
+    }
+  }
+  if(rpi != NULL) {
+    ptr = compress_rpi_6lorh(ptr, rpi);
+    lorh_ext_len += LORH_RPI_EXT_LEN;
+  }
+  packetbuf_hdr_len = ptr - packetbuf_ptr;
+
+  PRINTF("6LoRH: %u bytes of extension headers in %u bytes\n\r",
+         lorh_ext_len, packetbuf_hdr_len);
+  return *next;
+}
+/*--------------------------------------------------------------------*/
+/*
+ * Skip the page 1 dispatch and the 6LoRH headers behind it, remembering
+ * where the RPI-6LoRH and SRH-6LoRH are. They are expanded once the IPHC
+ * header has given the IPv6 destination. Unknown elective headers are
+ * ignored, unknown critical ones drop the packet.
+ *
+ * Returns -1 if the packet must be dropped.
+ */
+static int
+parse_6lorh(void)
+{
+  uint8_t *ptr;
+  uint8_t *end;
+  uint16_t max_len;
+  uint16_t len;
+
+  ptr = PACKETBUF_HC1_PTR + 1;
+  end = packetbuf_ptr + packetbuf_datalen();
+  max_len = 0;
+
+  while(ptr + 2 <= end &&
+        (ptr[0] & SICSLOWPAN_6LORH_DISPATCH_MASK) == SICSLOWPAN_6LORH_DISPATCH) {
+    if((ptr[0] & SICSLOWPAN_6LORH_MASK) == SICSLOWPAN_6LORH_ELECTIVE) {
+      len = 2 + (ptr[0] & SICSLOWPAN_6LORH_SIZE_MASK);
+    } else if(ptr[1] <= SICSLOWPAN_6LORH_TYPE_SRH_MAX && lorh_srh == NULL) {
+      lorh_srh = ptr;
+      len = 2 + ((ptr[0] & SICSLOWPAN_6LORH_SIZE_MASK) + 1) * (1 << ptr[1]);
+      max_len += LORH_SRH_HDR_LEN +
+        ((ptr[0] & SICSLOWPAN_6LORH_SIZE_MASK) + 1) * 16;
+    } else if(ptr[1] == SICSLOWPAN_6LORH_TYPE_RPI && lorh_rpi == NULL) {
+      lorh_rpi = ptr;
+      len = 2 + ((ptr[0] & SICSLOWPAN_6LORH_RPI_I) ? 0 : 1) +
+        ((ptr[0] & SICSLOWPAN_6LORH_RPI_K) ? 1 : 2);
+      max_len += LORH_RPI_EXT_LEN;
+    } else {
+      PRINTFI("sicslowpan input: unsupported 6LoRH type %u\n\r", ptr[1]);
+      return -1;
+    }
+    ptr += len;
+  }
+
+  if(ptr >= end || (ptr[0] & 0xe0) != SICSLOWPAN_DISPATCH_IPHC ||
+     UIP_LLIPH_LEN + max_len > UIP_BUFSIZE) {
+    PRINTFI("sicslowpan input: malformed 6LoRH\n\r");
+    return -1;
+  }
+  packetbuf_hdr_len = ptr - packetbuf_ptr;
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+/*
+ * Expand the 6LoRH headers found by parse_6lorh() behind the IPv6 header
+ * in sicslowpan_buf. The source routing header is rebuilt exactly as
+ * srh_normalize() left it on the sender, its first hop relative to the
+ * IPv6 source (RFC 8138 section 5.1). Sets lorh_ext_len and returns the
+ * next header field of the last one, which the caller fills in once the
+ * IPHC next header is known; NULL if there is none.
+ */
+static uint8_t *
+uncompress_6lorh(void)
+{
+  const uip_ipaddr_t *dest;
+  uip_ipaddr_t hop;
+  uint8_t *ext;
+  uint8_t *next;
+  uint8_t *data;
+  uint8_t cmpri;
+  uint8_t cmpre;
+  uint8_t size;
+  uint8_t n;
+  uint8_t i;
+
+  lorh_ext_len = 0;
+  next = NULL;
+  ext = (uint8_t *)SICSLOWPAN_IP_BUF + UIP_IPH_LEN;
+  dest = &SICSLOWPAN_IP_BUF->destipaddr;
+
+  if(lorh_rpi != NULL) {
+    data = lorh_rpi + 2;
+    ext[1] = 0;
+    ext[2] = UIP_EXT_HDR_OPT_RPL;
+    ext[3] = LORH_OPT_RPL_LEN;
+    ext[4] = (lorh_rpi[0] << LORH_RPL_FLAGS_SHIFT) & LORH_RPL_FLAGS_MASK;
+    ext[5] = (lorh_rpi[0] & SICSLOWPAN_6LORH_RPI_I) ? 0 : *data++;
+    ext[6] = (lorh_rpi[0] & SICSLOWPAN_6LORH_RPI_K) ? 0 : *data++;
+    ext[7] = *data;
+    next = &ext[0];
+    ext += LORH_RPI_EXT_LEN;
+    lorh_ext_len += LORH_RPI_EXT_LEN;
+  }
+
+  if(lorh_srh != NULL) {
+    if(next != NULL) {
+      *next = UIP_PROTO_ROUTING;
+    }
+    n = (lorh_srh[0] & SICSLOWPAN_6LORH_SIZE_MASK) + 1;
+    size = 1 << lorh_srh[1];
+
+    /* First pass for CmprI and CmprE, second one to write the hops */
+    cmpri = 15;
+    cmpre = 15;
+    uip_ipaddr_copy(&hop, &SICSLOWPAN_IP_BUF->srcipaddr);
+    for(i = 0, data = lorh_srh + 2; i < n; i++, data += size) {
+      memcpy(&hop.u8[16 - size], data, size);
+      if(i < n - 1) {
+        if(lorh_prefix_len(dest, &hop, 15) < cmpri) {
+          cmpri = lorh_prefix_len(dest, &hop, 15);
+        }
+      } else {
+        cmpre = lorh_prefix_len(dest, &hop, 15);
+      }
+    }
+    if(cmpre < cmpri) {
+      cmpri = cmpre;
+    }
+    uip_ipaddr_copy(&hop, &SICSLOWPAN_IP_BUF->srcipaddr);
+    for(i = 0, data = lorh_srh + 2; i < n; i++, data += size) {
+      memcpy(&hop.u8[16 - size], data, size);
+      srh_set_hop(ext, &hop, i, n, cmpri, cmpre);
+    }
+    next = &ext[0];
+    lorh_ext_len += srh_set_hdr(ext, n, cmpri, cmpre);
+  }
+
+  return next;
+}
+/** @} */
+#endif /* SICSLOWPAN_6LORH */
+
 /*--------------------------------------------------------------------*/
 /**
  * \brief Compress IP/UDP header
@@ -512,7 +970,7 @@ uncompress_addr(uip_ipaddr_t *ipaddr, uint8_t const prefix[],
 static void
 compress_hdr_hc06(linkaddr_t *link_destaddr)
 {
-  uint8_t tmp, iphc0, iphc1;
+  uint8_t tmp, iphc0, iphc1, next;
 #if DEBUG
   { uint16_t ndx;
     PRINTF("before compression (%d): ", UIP_IP_BUF->len[1]);
@@ -524,7 +982,14 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
   }
 #endif
 
-  hc06_ptr = packetbuf_ptr + 2;
+#if SICSLOWPAN_6LORH
+  /* RPL artifacts go in front of the IPHC header */
+  next = compress_6lorh();
+#else
+  next = UIP_IP_BUF->proto;
+#endif /* SICSLOWPAN_6LORH */
+
+  hc06_ptr = packetbuf_ptr + packetbuf_hdr_len + 2;
   /*
    * As we copy some bit-length fields, in the IPHC encoding bytes,
    * we sometimes use |=
@@ -601,17 +1066,17 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
 
   /* Next header. We compress it if UDP */
 #if UIP_CONF_UDP || UIP_CONF_ROUTER
-  if(UIP_IP_BUF->proto == UIP_PROTO_UDP) {
+  if(next == UIP_PROTO_UDP) {
     iphc0 |= SICSLOWPAN_IPHC_NH_C;
   }
 #endif /*UIP_CONF_UDP*/
 #ifdef SICSLOWPAN_NH_COMPRESSOR
-  if(SICSLOWPAN_NH_COMPRESSOR.is_compressable(UIP_IP_BUF->proto)) {
+  if(SICSLOWPAN_NH_COMPRESSOR.is_compressable(next)) {
     iphc0 |= SICSLOWPAN_IPHC_NH_C;
   }
 #endif
   if ((iphc0 & SICSLOWPAN_IPHC_NH_C) == 0) {
-    *hc06_ptr = UIP_IP_BUF->proto;
+    *hc06_ptr = next;
     hc06_ptr += 1;
   }
 
@@ -721,10 +1186,13 @@ compress_hdr_hc06(linkaddr_t *link_destaddr)
   }
 
   uncomp_hdr_len = UIP_IPH_LEN;
+#if SICSLOWPAN_6LORH
+  uncomp_hdr_len += lorh_ext_len;
+#endif /* SICSLOWPAN_6LORH */
 
 #if UIP_CONF_UDP || UIP_CONF_ROUTER
   /* UDP header compression */
-  if(UIP_IP_BUF->proto == UIP_PROTO_UDP) {
+  if(next == UIP_PROTO_UDP) {
     PRINTF("IPHC: Uncompressed UDP ports on send side: %x, %x\n\r",
        UIP_HTONS(UIP_UDP_BUF->srcport), UIP_HTONS(UIP_UDP_BUF->destport));
     /* Mask out the last 4 bits can be used as a mask */
@@ -806,6 +1274,9 @@ static void
 uncompress_hdr_hc06(uint16_t ip_len)
 {
   uint8_t tmp, iphc0, iphc1;
+#if SICSLOWPAN_6LORH
+  uint8_t *lorh_next;
+#endif /* SICSLOWPAN_6LORH */
   /* at least two byte will be used for the encoding */
   hc06_ptr = packetbuf_ptr + packetbuf_hdr_len + 2;
 
@@ -949,6 +1420,12 @@ uncompress_hdr_hc06(uint16_t ip_len)
   }
   uncomp_hdr_len += UIP_IPH_LEN;
 
+#if SICSLOWPAN_6LORH
+  /* The extension headers carried as 6LoRH follow the IPv6 header */
+  lorh_next = uncompress_6lorh();
+  uncomp_hdr_len += lorh_ext_len;
+#endif /* SICSLOWPAN_6LORH */
+
   /* Next header processing - continued */
   if((iphc0 & SICSLOWPAN_IPHC_NH_C)) {
     /* The next header is compressed, NHC is following */
@@ -1035,8 +1512,24 @@ uncompress_hdr_hc06(uint16_t ip_len)
 
   /* length field in UDP header */
   if(SICSLOWPAN_IP_BUF->proto == UIP_PROTO_UDP) {
+#if SICSLOWPAN_6LORH
+    uint16_t udp_len;
+
+    udp_len = GET16(SICSLOWPAN_IP_BUF->len, 0) - lorh_ext_len;
+    SET16((uint8_t *)&SICSLOWPAN_UDP_BUF->udplen, 0, udp_len);
+#else
     memcpy(&SICSLOWPAN_UDP_BUF->udplen, &SICSLOWPAN_IP_BUF->len[0], 2);
+#endif /* SICSLOWPAN_6LORH */
+  }
+
+#if SICSLOWPAN_6LORH
+  /* The IPHC next header describes what follows the 6LoRH headers */
+  if(lorh_next != NULL) {
+    *lorh_next = SICSLOWPAN_IP_BUF->proto;
+    SICSLOWPAN_IP_BUF->proto = lorh_rpi != NULL ?
+      UIP_PROTO_HBHO : UIP_PROTO_ROUTING;
   }
+#endif /* SICSLOWPAN_6LORH */
 
   return;
 }
@@ -1361,6 +1854,10 @@ send_packet(linkaddr_t *dest)
     packetbuf_set_attr(PACKETBUF_ATTR_RELIABLE, 1);
 #endif
 
+    /* The MAC may complete the frame asynchronously, a status set from
+     * here on belongs to this frame */
+    last_tx_status = MAC_TX_QUEUED;
+
     if ((p_ns != NULL) && (p_ns->dllsec != NULL)) {
         /* Provide a callback function to receive the result of
          a packet transmission. */
@@ -1396,6 +1893,9 @@ static uint8_t output(const uip_lladdr_t *localdest)
   /* init */
   uncomp_hdr_len = 0;
   packetbuf_hdr_len = 0;
+#if SICSLOWPAN_6LORH
+  lorh_ext_len = 0;
+#endif /* SICSLOWPAN_6LORH */
 
   /* reset packetbuf buffer */
   packetbuf_clear();
@@ -1483,11 +1983,20 @@ static uint8_t output(const uip_lladdr_t *localdest)
      * IPv6/HC1/HC06/HC_UDP dispatchs/headers.
      * The following fragments contain only the fragn dispatch.
      */
-    int estimated_fragments = ((int)uip_len) / ((int)MAC_MAX_PAYLOAD - SICSLOWPAN_FRAGN_HDR_LEN) + 1;
-    int freebuf = queuebuf_numfree() - 1;
-    PRINTFO("uip_len: %d, fragments: %d, free bufs: %d\n", uip_len, estimated_fragments, freebuf);
-    if(freebuf < estimated_fragments) {
-        PRINTFO("Dropping packet, not enough free bufs\n");
+    int estimated_fragments = ((int)uip_len) /
+      ((max_payload - SICSLOWPAN_FRAGN_HDR_LEN) & 0xfffffff8) + 1;
+    uint8_t freebuf = 0xff;
+    e_nsErr_t err = NETSTK_ERR_NONE;
+
+    /* The MAC queues the fragments and sends them in the background. Do
+     * not start a datagram whose fragments do not all fit into its queue,
+     * MACs without a queue do not answer */
+    if(p_ns->dllc != NULL) {
+      p_ns->dllc->ioctrl(NETSTK_CMD_MAC_TXQ_FREE_GET, &freebuf, &err);
+    }
+    PRINTFO("uip_len: %d, fragments: %d, free frames: %d\n", uip_len, estimated_fragments, freebuf);
+    if((err == NETSTK_ERR_NONE) && (freebuf < estimated_fragments)) {
+        PRINTFO("Dropping packet, MAC queue full\n");
         return 0;
     }
 
@@ -1528,8 +2037,10 @@ static uint8_t output(const uip_lladdr_t *localdest)
     queuebuf_free(q);
     q = NULL;
 
-    /* Check tx result. */
+    /* Check tx result. MAC_TX_DEFERRED means the MAC could not queue the
+     * fragment. */
     if((last_tx_status == MAC_TX_COLLISION) ||
+       (last_tx_status == MAC_TX_DEFERRED) ||
        (last_tx_status == MAC_TX_ERR) ||
        (last_tx_status == MAC_TX_ERR_FATAL)) {
       PRINTFO("error in fragment tx, dropping subsequent fragments.\n\r");
@@ -1577,6 +2088,7 @@ static uint8_t output(const uip_lladdr_t *localdest)
 
       /* Check tx result. */
       if((last_tx_status == MAC_TX_COLLISION) ||
+         (last_tx_status == MAC_TX_DEFERRED) ||
          (last_tx_status == MAC_TX_ERR) ||
          (last_tx_status == MAC_TX_NOACK) ||
          (last_tx_status == MAC_TX_ERR_FATAL)) {
@@ -1632,6 +2144,11 @@ input(void)
   /* init */
   uncomp_hdr_len = 0;
   packetbuf_hdr_len = 0;
+#if SICSLOWPAN_6LORH
+  lorh_ext_len = 0;
+  lorh_rpi = NULL;
+  lorh_srh = NULL;
+#endif /* SICSLOWPAN_6LORH */
 
   /* The MAC puts the 15.4 payload inside the packetbuf data buffer */
   packetbuf_ptr = packetbuf_dataptr();
@@ -1639,6 +2156,7 @@ input(void)
   /* Save the RSSI of the incoming packet in case the upper layer will
      want to query us for it later. */
   last_rssi = (signed short)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  link_stats_input_callback(packetbuf_addr(PACKETBUF_ADDR_SENDER));
 
 #if SICSLOWPAN_CONF_FRAG
   /* if reassembly timed out, cancel it */
@@ -1756,6 +2274,14 @@ input(void)
 #endif /* SICSLOWPAN_CONF_FRAG */
 
   /* Process next dispatch and headers */
+#if SICSLOWPAN_6LORH
+  if(PACKETBUF_HC1_PTR[PACKETBUF_HC1_DISPATCH] == SICSLOWPAN_DISPATCH_PAGING_1) {
+    PRINTFI("sicslowpan input: 6LoRH\n\r");
+    if(parse_6lorh() < 0) {
+      return;
+    }
+  }
+#endif /* SICSLOWPAN_6LORH */
 #if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
   if((PACKETBUF_HC1_PTR[PACKETBUF_HC1_DISPATCH] & 0xe0) == SICSLOWPAN_DISPATCH_IPHC) {
     PRINTFI("sicslowpan input: IPHC\n\r");
@@ -15,11 +15,6 @@
 #include "slip.h"
 #include <stdio.h>
 
-#define SLIP_END     0300
-#define SLIP_ESC     0333
-#define SLIP_ESC_END 0334
-#define SLIP_ESC_ESC 0335
-
 #define DEBUG DEBUG_NONE
 #include "uip-debug.h"
 
@@ -32,22 +27,8 @@ slipnet_init(s_ns_t* p_ns)
 void
 slip_send_packet(const uint8_t *ptr, int len)
 {
-  uint16_t i;
-  uint8_t c;
-
-  putchar(SLIP_END);
-  for(i = 0; i < len; ++i) {
-    c = *ptr++;
-    if(c == SLIP_END) {
-        putchar(SLIP_ESC);
-        c = SLIP_ESC_END;
-    } else if(c == SLIP_ESC) {
-        putchar(SLIP_ESC);
-        c = SLIP_ESC_ESC;
-    }
-    putchar(c);
-  }
-  putchar(SLIP_END);
+  /* the SLIP driver encodes the frame and writes it at once */
+  slip_write(ptr, len);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -285,6 +285,15 @@ clock_time_t bsp_getSec(void);
 /*============================================================================*/
 void bsp_delay_us(uint32_t i_delay);
 
+/*============================================================================*/
+/** \brief  Nothing left to do, wait for the next event. Targets without
+ *          HAL_SUPPORT_IDLE wait for the given delay
+ *
+ *  \param  i_delay Delay in microseconds
+ */
+/*============================================================================*/
+void bsp_idle(uint32_t i_delay);
+
 /*============================================================================*/
 /** \brief  This function initialize given control pin
  *
@@ -135,6 +135,9 @@ static void _bsp_ledCallback(c_event_t c_event, p_data_t p_data)
 /*============================================================================*/
 uint8_t bsp_init (s_ns_t * ps_ns)
 {
+  uint8_t i;
+  uint8_t seed[32];
+
   /* Initialize hardware */
   if (!hal_init())
     return 0;
@@ -143,7 +146,18 @@ uint8_t bsp_init (s_ns_t * ps_ns)
   if (!board_conf(ps_ns))
     return 0;
 
-  random_init(hal_getrand());
+  /* Seed the random generators from the platform entropy source. They get
+   * separate bytes, numbers drawn from the fast generator are visible on
+   * the air and must not tell anything about the cryptographic one */
+  for (i = 0; i < sizeof(seed); i++) {
+    seed[i] = hal_getrand();
+  }
+  random_crypto_seed(seed, sizeof(seed));
+  for (i = 0; i < 8; i++) {
+    seed[i] = hal_getrand();
+  }
+  random_seed(seed, 8);
+  memset(seed, 0, sizeof(seed));
 
   /* initialize local variables */
   bsp_numNestedCriticalSection = 0;
@@ -297,7 +311,7 @@ uint32_t bsp_getrand(uint32_t max)
   uint32_t ret;
 
   /* generate random number in a range of 0 to max */
-  ret = (uint32_t) random_rand();
+  ret = random_rand32();
   ret = ret % max;
   return ret;
 } /* bsp_getrand() */
@@ -369,6 +383,19 @@ void bsp_delay_us(uint32_t i_delay)
 } /* bsp_delay_us() */
 
 
+/*============================================================================*/
+/*  bsp_idle()                                                                */
+/*============================================================================*/
+void bsp_idle(uint32_t i_delay)
+{
+#if (HAL_SUPPORT_IDLE == TRUE)
+  hal_idle(i_delay);
+#else
+  hal_delay_us(i_delay);
+#endif
+} /* bsp_idle() */
+
+
 /*============================================================================*/
 /*  bsp_extIntRegister()                                                      */
 /*============================================================================*/
@@ -64,6 +64,13 @@
 
 #define NETSTK_CFG_RF_CRC_EN                TRUE
 
+/* the native target may run in virtual time, see native_sim.h */
+#define HAL_SUPPORT_IDLE                    TRUE
+
+/* SLIP frames go to the pty with a single write */
+#define SLIP_CONF_WRITE(p_data, len)        hal_extifWrite(p_data, len)
+#define SLIP_CONF_TXBUF_SIZE                2600    /* escaped IPv6 MTU */
+
 /*============================================================================*/
 /*!
 \brief    emb6 board configuration fuction
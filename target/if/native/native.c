@@ -65,6 +65,8 @@
 #include <sys/time.h>
 #include <stdio.h>
 #include <lcm/lcm.h>
+#include "native_net.h"
+#include "native_sim.h"
 
 /*==============================================================================
                                     MACROS
@@ -72,11 +74,6 @@
 #define     LOGGER_ENABLE                 LOGGER_RADIO
 #include    "logger.h"
 #define     __ADDRLEN__                   2
-#define     NODE_INFO_MAX                 2048
-
-#ifndef LCM_NETWORK_CONF
-#define LCM_NETWORK_CONF                  "lcmnetwork.conf"
-#endif /*#ifndef LCM_NETWORK_CONF */
 
 /*==============================================================================
                                      ENUMS
@@ -85,14 +82,16 @@
 /*==============================================================================
                              VARIABLE DECLARATIONS
  ==============================================================================*/
+#if (NATIVE_CFG_VIRTUAL_TIME_EN != TRUE)
 static struct etimer ps_nativeTmr;
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 /* Pointer to the lmac structure */
 static const s_nsPHY_t* p_phy = NULL;
 extern uip_lladdr_t uip_lladdr;
-static lcm_t *ps_lcm;
-static char pc_publish_ch[NODE_INFO_MAX];
+static s_nativeNet_t s_net;
 static char *pc_subscribe_ch;
-static lcm_subscription_t *subscr;
+/* received power of the last frame handed to the PHY, in dBm */
+static int8_t c_rssi = NATIVE_SIM_RSSI_DEFAULT;
 /*==============================================================================
                                  GLOBAL CONSTANTS
  ==============================================================================*/
@@ -110,9 +109,15 @@ static void _native_send( uint8_t *p_data, uint16_t len, e_nsErr_t *p_err );
 static void _native_recv(uint8_t *p_buf, uint16_t len, e_nsErr_t *p_err);
 static void _native_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err);
 
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+static uint32_t _native_airtime( uint16_t len );
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+static void _native_deliver( uint8_t *p_data, uint16_t len, int8_t rssi );
 static void _native_read( const lcm_recv_buf_t *rbuf, const char * channel,
         void * p_macAddr );
+#if (NATIVE_CFG_VIRTUAL_TIME_EN != TRUE)
 static void _native_handler( c_event_t c_event, p_data_t p_data );
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 static void _beautiful_split_messages( const lcm_recv_buf_t *rps_rbuf,
         const char * rpc_channel, void * userdata );
 static void _beautiful_comand_parser( const char *line);
@@ -161,13 +166,6 @@ static void _printAndExit( const char* rpc_reason )
 static void _native_init( void *p_netstk, e_nsErr_t *p_err )
 {
     linkaddr_t un_addr;
-    FILE* fp;
-    char pc_node_info[NODE_INFO_MAX];
-    char* pch;
-
-    uint16_t addr;    // mac address of node read from configuration file
-    uint8_t  addr_6;  // high byte of two last parts of mac address
-    uint8_t  addr_7;  // low byte of two last parts of mac address
 
 #if NETSTK_CFG_ARG_CHK_EN
     if (p_err == NULL) {
@@ -179,79 +177,8 @@ static void _native_init( void *p_netstk, e_nsErr_t *p_err )
 
     LOG_INFO( "Try to initialize Broadcasting Client for native radio driver" );
 
-    /* Please refer to lcm_create() reference. Default parameter is taken
-     from there */
-    ps_lcm = lcm_create( NULL );
-
-    if( !ps_lcm )
-        _printAndExit("LCM init failed");
-
-    /* reset channel name */
-    memset( pc_publish_ch, 0, NODE_INFO_MAX );
-
-    /* Read configuration file */
-    fp = fopen( LCM_NETWORK_CONF, "r" );
-
-    if( fp == NULL )
-    {
-        _printAndExit( "Can't open LCM network configuration file");
-    }
-
-    /* assemble the parser command */
-    while( !feof(fp) )
-    {
-        memset(pc_node_info, 0, NODE_INFO_MAX);
-        fgets( pc_node_info, NODE_INFO_MAX, fp );
-        if( pc_node_info[0] == '#' ) continue;
-
-        pch = strtok (pc_node_info," \t\n,");
-        if( pch == NULL ) continue;
-
-        /* get address */
-        sscanf( pch, "%hx", &addr );
-
-        /* split mac address read from the file into two parts */
-        addr_7 = (uint8_t)addr;
-        addr_6 = (uint8_t)(addr >> 8);
-
-        if( addr_6 != mac_phy_config.mac_address[6] ||
-            addr_7 != mac_phy_config.mac_address[7] )
-            continue;
-        LOG1_INFO("addr=0x%04X", addr);
-
-        /* read for the subscribe channel */
-        if ( pch != NULL )
-        {
-            int tmpChLen = strlen(pch) + 10;
-            char* tmpCh = malloc( tmpChLen );
-            if( tmpCh != NULL )
-            {
-                snprintf( tmpCh, tmpChLen, ".*_%s_.*", pch );
-                subscr = lcm_subscribe( ps_lcm, tmpCh, _beautiful_split_messages, NULL );
-                LOG1_INFO("Subscription channel = %s", tmpCh);
-                free( tmpCh );
-            }
-            else
-            {
-                _printAndExit( "Can't create virtual channel.\n" );
-            }
-
-            pch = strtok ( NULL, " \t\n," );
-        }
-
-        /* read for the public channel */
-        while ( pch != NULL )
-        {
-            if( pch != NULL )
-            snprintf( pc_publish_ch + strlen(pc_publish_ch),
-                    (NODE_INFO_MAX-strlen(pc_publish_ch)), "_%s_", pch );
-            pch = strtok ( NULL, " \t\n," );
-        }
-        LOG1_INFO("Publication channel = %s", pc_publish_ch);
-    }
-
-    /* Close the file */
-    fclose(fp);
+    /* join the network described in LCM_NETWORK_CONF */
+    native_net_open( &s_net, _beautiful_split_messages, NULL );
 
     LOG1_OK( "Native driver init" );
 
@@ -282,8 +209,15 @@ static void _native_init( void *p_netstk, e_nsErr_t *p_err )
         *p_err = NETSTK_ERR_INIT;
     }
 
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    /* Frames are received while the nodes synchronize their clocks, no
+     * polling is needed */
+    native_sim_start( s_net.p_lcm, s_net.addr, s_net.nodeNum,
+            _native_deliver );
+#else
     /* Start the packet receive process */
     etimer_set( &ps_nativeTmr, 10, _native_handler );
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 
     return;
 } /* _native_init() */
@@ -308,7 +242,12 @@ static void _native_send( uint8_t *p_data, uint16_t len, e_nsErr_t *p_err )
 #endif
 
     *p_err = NETSTK_ERR_NONE;
-    status = lcm_publish( ps_lcm, pc_publish_ch, p_data, len );
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    status = native_sim_send( s_net.publishCh, p_data, len,
+            _native_airtime( len ) );
+#else
+    status = lcm_publish( s_net.p_lcm, s_net.publishCh, p_data, len );
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 
     /* Return execution status to a caller */
     if( status == -1 )
@@ -344,6 +283,25 @@ static void _native_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err)
 #endif
 
     *p_err = NETSTK_ERR_NONE;
+    switch( cmd )
+    {
+        case NETSTK_CMD_RF_RSSI_GET:
+            *((int8_t *)p_val) = c_rssi;
+            break;
+
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+        case NETSTK_CMD_RF_CCA_GET:
+            /* a neighbour is transmitting */
+            if( native_sim_isChannelBusy() )
+            {
+                *p_err = NETSTK_ERR_CHANNEL_ACESS_FAILURE;
+            }
+            break;
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+
+        default:
+            break;
+    }
 } /* _native_on() */
 
 /*----------------------------------------------------------------------------*/
@@ -359,32 +317,85 @@ static void _native_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err)
 static void _native_read( const lcm_recv_buf_t *rps_rbuf,
         const char * rpc_channel, void * userdata )
 {
-    uint16_t i_dSize = rps_rbuf->data_size;
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    /* hold the frame back until its delivery time */
+    native_sim_recv( rps_rbuf->data, rps_rbuf->data_size );
+#else
+    if( rps_rbuf->data_size > 0xFFFF )
+    {
+        LOG_ERR( "Received packet too long" );
+        return;
+    }
+    _native_deliver( rps_rbuf->data, (uint16_t)rps_rbuf->data_size,
+            NATIVE_SIM_RSSI_DEFAULT );
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+} /* _native_read() */
+
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+/*----------------------------------------------------------------------------*/
+/** \brief  Time a frame occupies the channel with the configured modulation
+ *  \param  len           Length of the PSDU.
+ *  \return Airtime in microseconds, including SHR and PHR
+ */
+/*----------------------------------------------------------------------------*/
+static uint32_t _native_airtime( uint16_t len )
+{
+    switch( mac_phy_config.modulation )
+    {
+        case MODULATION_2FSK50:
+            /* 50 kbps, preamble, 2 byte SFD and 2 byte PHR */
+            return (uint32_t)(mac_phy_config.preamble_len + 4 + len) * 160;
+
+        case MODULATION_QPSK100:
+            /* 100 kbps, 4 byte preamble, SFD and PHR */
+            return (uint32_t)(6 + len) * 80;
+
+        case MODULATION_BPSK20:
+        default:
+            /* 20 kbps, 4 byte preamble, SFD and PHR */
+            return (uint32_t)(6 + len) * 400;
+    }
+} /* _native_airtime() */
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Hand a received frame to the PHY
+ *  \param  p_data        Pointer to the frame.
+ *  \param  len           Length of the frame.
+ *  \param  rssi          Received power in dBm.
+ *  \return void
+ */
+/*----------------------------------------------------------------------------*/
+static void _native_deliver( uint8_t *p_data, uint16_t len, int8_t rssi )
+{
     e_nsErr_t s_err = NETSTK_ERR_NONE;
 
     /* Clear buffer where to store received payload */
     packetbuf_clear();
 
+    /* the DLLC asks for it with NETSTK_CMD_RF_RSSI_GET */
+    c_rssi = rssi;
+
     /* Check whether recieved packet is not too long */
-    if( i_dSize > PACKETBUF_SIZE )
+    if( len > PACKETBUF_SIZE )
     {
         LOG_ERR( "Received packet too long" );
     }
     else
     {
-        LOG_OK( "RX packet [%d]", i_dSize);
-        LOG2_HEXDUMP( rps_rbuf->data, i_dSize  );
-        if( ( rps_rbuf->data_size > 0 ) && ( p_phy != NULL ) )
+        LOG_OK( "RX packet [%d]", len);
+        LOG2_HEXDUMP( p_data, len );
+        if( ( len > 0 ) && ( p_phy != NULL ) )
         {
-            packetbuf_set_datalen( i_dSize );
-            p_phy->recv( rps_rbuf->data, i_dSize, &s_err );
+            packetbuf_set_datalen( len );
+            p_phy->recv( p_data, len, &s_err );
         }
         else
         {
             LOG_ERR( "Failed to receive packet" );
         }
     }
-} /* _native_read() */
+} /* _native_deliver() */
 
 /*----------------------------------------------------------------------------*/
 /** \brief  NATIVE transport wrapper function
@@ -400,6 +411,9 @@ static void _native_on( e_nsErr_t *p_err )
 #endif
 
     *p_err = NETSTK_ERR_NONE;
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    native_sim_setRx( TRUE );
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 } /* _native_on() */
 
 /*----------------------------------------------------------------------------*/
@@ -417,8 +431,12 @@ static void _native_off( e_nsErr_t *p_err )
 #endif
 
     *p_err = NETSTK_ERR_NONE;
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    native_sim_setRx( FALSE );
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 } /* _native_off() */
 
+#if (NATIVE_CFG_VIRTUAL_TIME_EN != TRUE)
 /*----------------------------------------------------------------------------*/
 /** \brief  NATIVE transport handler for periodic polling
  *          triggered every 10 msec
@@ -441,7 +459,7 @@ static void _native_handler( c_event_t c_event, p_data_t p_data )
          * it's a blocking operation. We should instead check whether a lcm file
          * descriptor is available for reading. We put 10 usec as a timeout.
          */
-        lcm_fd = lcm_get_fileno( ps_lcm );
+        lcm_fd = lcm_get_fileno( s_net.p_lcm );
         FD_ZERO( &fds );
         FD_SET( lcm_fd, &fds );
 
@@ -451,13 +469,14 @@ static void _native_handler( c_event_t c_event, p_data_t p_data )
          */
         if( FD_ISSET( lcm_fd, &fds ) )
         {
-            lcm_handle( ps_lcm );
+            lcm_handle( s_net.p_lcm );
         }
         /* Restart a timer anyway. */
         etimer_restart( &ps_nativeTmr );
 
     }
 }
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 
 /*----------------------------------------------------------------------------*/
 /** \brief  "BEAUTIFUL" split messages reception
@@ -509,9 +528,9 @@ static void _beautiful_comand_parser( const char *line)
         strcpy(new_channel, line+10);
         if (strcmp(new_channel, pc_subscribe_ch) == 0) return;
         pc_subscribe_ch = new_channel;
-        lcm_unsubscribe(ps_lcm, subscr);
-        subscr = lcm_subscribe( ps_lcm, pc_subscribe_ch, _beautiful_split_messages, NULL );
-        lcm_publish( ps_lcm, "EMB6COMMAND", pc_subscribe_ch, strlen(pc_subscribe_ch)+1 );
+        lcm_unsubscribe(s_net.p_lcm, s_net.p_subscr);
+        s_net.p_subscr = lcm_subscribe( s_net.p_lcm, pc_subscribe_ch, _beautiful_split_messages, NULL );
+        lcm_publish( s_net.p_lcm, "EMB6COMMAND", pc_subscribe_ch, strlen(pc_subscribe_ch)+1 );
         free(new_channel);
     }
     if (strncmp(line, "publish name", 8) == 0)
@@ -520,10 +539,10 @@ static void _beautiful_comand_parser( const char *line)
         char *new_channel = (char *)malloc(length*sizeof(char));
         memset(new_channel, '\0', length);
         strcpy(new_channel, line+8);
-        if (strcmp(new_channel, pc_publish_ch) == 0) return;
-        memset( pc_publish_ch, '\0', NODE_INFO_MAX );
-        strncpy(pc_publish_ch, new_channel, length);
-        lcm_publish( ps_lcm, "EMB6COMMAND", pc_publish_ch, strlen(pc_publish_ch)+1 );
+        if (strcmp(new_channel, s_net.publishCh) == 0) return;
+        memset( s_net.publishCh, '\0', NATIVE_NET_LINE_MAX );
+        strncpy(s_net.publishCh, new_channel, length);
+        lcm_publish( s_net.p_lcm, "EMB6COMMAND", s_net.publishCh, strlen(s_net.publishCh)+1 );
         free(new_channel);
     }
     if (strncmp(line, "exit", 4) == 0)
@@ -0,0 +1,1181 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**
+ * \addtogroup linux
+ * @{
+ */
+/*============================================================================*/
+/*! \file   cc112x_emu.c
+
+ \brief  Emulated CC112x transceiver for the native target, see
+         cc112x_emu.h.
+
+ \version 0.0.1
+ */
+/*============================================================================*/
+#define     _POSIX_C_SOURCE      199309L
+
+/*==============================================================================
+                                 INCLUDE FILES
+ ==============================================================================*/
+#include "cc112x_emu.h"
+
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+#include "cc112x.h"
+#include "native_net.h"
+#include "packetbuf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*==============================================================================
+                                    MACROS
+ ==============================================================================*/
+#define     LOGGER_ENABLE                 LOGGER_RADIO
+#include    "logger.h"
+
+/* header byte of a SPI access */
+#define EMU_READ_ACCESS                     0x80
+#define EMU_BURST_ACCESS                    0x40
+#define EMU_ADDR_MASK                       0x3F
+#define EMU_ADDR_EXT                        0x2F
+#define EMU_ADDR_DMA                        0x3E
+#define EMU_ADDR_FIFO                       0x3F
+
+#define EMU_PARTNUMBER                      0x48
+#define EMU_PARTVERSION                     0x21
+
+/* MARC_STATUS1 */
+#define EMU_MARC_NO_FAILURE                 0x00
+#define EMU_MARC_TX_OVERFLOW                0x07
+#define EMU_MARC_TX_UNDERFLOW               0x08
+#define EMU_MARC_RX_OVERFLOW                0x09
+#define EMU_MARC_RX_UNDERFLOW               0x0A
+#define EMU_MARC_TX_ON_CCA_FAILED           0x0B
+#define EMU_MARC_TX_FINI                    0x40
+#define EMU_MARC_RX_FINI                    0x80
+/* MARC_STATUS0 */
+#define EMU_MARC0_TXONCCA_FAILED            0x04
+
+/* RSSI0 */
+#define EMU_RSSI0_VALID                     0x01
+#define EMU_RSSI0_CS_VALID                  0x02
+#define EMU_RSSI0_CS                        0x04
+
+/* GPIO signals of IOCFGx */
+#define EMU_IOCFG_INV                       0x40
+#define EMU_IOCFG_CFG                       0x3F
+#define EMU_GPIO_RXFIFO_THR                 0x00
+#define EMU_GPIO_RXFIFO_THR_PKT             0x01
+#define EMU_GPIO_TXFIFO_THR                 0x02
+#define EMU_GPIO_TXFIFO_THR_PKT             0x03
+#define EMU_GPIO_PKT_SYNC_RXTX              0x06
+
+/* offset of the RSSI registers and of the appended status */
+#define EMU_RSSI_OFFSET                     102
+
+/* number of interrupt lines */
+#define EMU_EXTI_NUM                        3
+
+/* index of a register, the extended space follows the normal one */
+#define EMU_REG_IX(addr_)                   \
+    (((addr_) & 0xFF00) ? (0x100 | ((addr_) & 0xFF)) : ((addr_) & 0xFF))
+
+/*==============================================================================
+                                     ENUMS
+ ==============================================================================*/
+typedef enum
+{
+    E_EMU_SPI_HEADER,
+    E_EMU_SPI_EXT,
+    E_EMU_SPI_REG,
+    E_EMU_SPI_FIFO,
+    E_EMU_SPI_IGNORE,
+} e_emuSpi_t;
+
+/*==============================================================================
+                         STRUCTURES AND OTHER TYPEDEFS
+ ==============================================================================*/
+typedef struct
+{
+    uint8_t buf[CC112X_EMU_FIFO_SIZE];
+    uint8_t first;
+    uint8_t num;
+} s_emuFifo_t;
+
+typedef struct
+{
+    uint16_t len;
+    int8_t   rssi;
+    uint8_t  data[PACKETBUF_SIZE];
+} s_emuFrame_t;
+
+/* duration of a driver activity, in SPI time and in host time */
+typedef struct
+{
+    uint32_t num;
+    uint64_t busNs;
+    uint64_t busNsMax;
+    uint64_t hostNs;
+    uint64_t hostNsMax;
+    uint64_t busStart;
+    uint64_t hostStart;
+    uint8_t  isRunning;
+} s_emuTiming_t;
+
+typedef struct
+{
+    /* SPI */
+    uint8_t isSelected;
+    e_emuSpi_t spi;
+    uint8_t spiHdr;
+    uint16_t spiAddr;
+    uint64_t busNs;
+    uint64_t busPaidNs;
+
+    /* chip */
+    uint8_t regs[0x200];
+    s_emuFifo_t rxFifo;
+    s_emuFifo_t txFifo;
+    uint8_t state;
+    uint8_t isSleeping;
+    uint8_t isPktSync;
+    uint8_t isTxReq;
+    uint32_t rxEpoch;
+
+    /* interrupt lines */
+    pfn_intCallb_t pfn_exti[EMU_EXTI_NUM];
+    uint8_t extiEdge[EMU_EXTI_NUM];
+    uint8_t extiLevel[EMU_EXTI_NUM];
+    uint8_t extiPending;
+    uint8_t extiEnabled;
+    uint8_t critical;
+    uint8_t isBusy;
+
+    /* frames waiting for the receiver */
+    s_emuFrame_t rxq[CC112X_EMU_RXQ_SIZE];
+    uint8_t rxqLen;
+
+    /* statistics */
+    s_emuTiming_t txLoad;
+    s_emuTiming_t rxDrain;
+    uint8_t rxDrainLevel;
+    uint32_t txNum;
+    uint32_t rxNum;
+    uint32_t rxDropped;
+    uint32_t rxOverflow;
+    uint32_t ccaFailed;
+} s_emu_t;
+
+/*==============================================================================
+                             VARIABLE DECLARATIONS
+ ==============================================================================*/
+static s_emu_t emu;
+static s_nativeNet_t emu_net;
+static uint8_t emu_isInit;
+
+/* reset values of the registers the emulation depends on */
+static const struct
+{
+    uint16_t addr;
+    uint8_t  val;
+} emu_regsReset[] = {
+    { CC112X_IOCFG3,            0x06 },
+    { CC112X_IOCFG2,            0x07 },
+    { CC112X_IOCFG1,            0x30 },
+    { CC112X_IOCFG0,            0x3C },
+    { CC112X_SYNC_CFG0,         0x17 },
+    { CC112X_MODCFG_DEV_E,      0x03 },
+    { CC112X_PREAMBLE_CFG1,     0x14 },
+    { CC112X_SYMBOL_RATE2,      0x43 },
+    { CC112X_SYMBOL_RATE1,      0xA9 },
+    { CC112X_SYMBOL_RATE0,      0x2A },
+    { CC112X_FIFO_CFG,          0x80 },
+    { CC112X_PKT_CFG2,          0x04 },
+    { CC112X_PKT_CFG1,          0x05 },
+    { CC112X_PKT_CFG0,          0x00 },
+    { CC112X_RFEND_CFG1,        0x0F },
+    { CC112X_RFEND_CFG0,        0x00 },
+    { CC112X_PKT_LEN,           0x03 },
+    { CC112X_FS_CAL2,           0x20 },
+};
+
+/* GPIO behind each interrupt line, see target.h */
+static const uint16_t emu_extiIocfg[EMU_EXTI_NUM] = {
+    CC112X_IOCFG0, CC112X_IOCFG2, CC112X_IOCFG3
+};
+
+/* NUM_PREAMBLE in half bytes */
+static const uint8_t emu_preambleTab[16] = {
+    0, 1, 2, 3, 4, 6, 8, 10, 12, 14, 16, 24, 48, 60, 60, 60
+};
+
+/* SYNC_MODE in bits */
+static const uint8_t emu_syncTab[8] = {
+    0, 11, 16, 18, 24, 32, 16, 16
+};
+
+/*==============================================================================
+                             LOCAL FUNCTION PROTOTYPES
+ ==============================================================================*/
+static uint64_t _emu_hostNs(void);
+static void _emu_timingStart(s_emuTiming_t *p_tm);
+static void _emu_timingStop(s_emuTiming_t *p_tm);
+static void _emu_printTiming(FILE *fp, const char *pc_name,
+        const s_emuTiming_t *p_tm);
+static void _emu_printStats(void);
+static uint8_t _emu_reg(uint16_t addr);
+static uint8_t _emu_fifoThr(void);
+static void _emu_fifoSetNum(s_emuFifo_t *p_fifo, uint8_t first, uint8_t last);
+static void _emu_rxFifoPush(uint8_t val);
+static uint8_t _emu_rxFifoPop(void);
+static void _emu_txFifoPush(uint8_t val);
+static uint8_t _emu_txFifoPop(void);
+static void _emu_setState(uint8_t state);
+static void _emu_setPktSync(uint8_t is_on);
+static void _emu_updatePins(void);
+static void _emu_reset(void);
+static void _emu_strobe(uint8_t cmd);
+static uint8_t _emu_status(void);
+static uint8_t _emu_regRead(uint16_t addr);
+static void _emu_regWrite(uint16_t addr, uint8_t val);
+static uint8_t _emu_spiByte(uint8_t tx);
+static uint32_t _emu_airtime(uint16_t len);
+static void _emu_payBus(void);
+static uint8_t _emu_dispatch(void);
+static void _emu_service(void);
+static void _emu_transmit(void);
+static void _emu_receive(void);
+static void _emu_run(void);
+static void _emu_poll(void);
+static void _emu_rx(uint8_t *p_data, uint16_t len, int8_t rssi);
+static void _emu_onMsg(const lcm_recv_buf_t *rps_rbuf,
+        const char *pc_channel, void *p_user);
+
+/*==============================================================================
+                                LOCAL FUNCTIONS
+ ==============================================================================*/
+static uint64_t _emu_hostNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _emu_timingStart(s_emuTiming_t *p_tm)
+{
+    p_tm->busStart = emu.busNs;
+    p_tm->hostStart = _emu_hostNs();
+    p_tm->isRunning = TRUE;
+}
+
+static void _emu_timingStop(s_emuTiming_t *p_tm)
+{
+    uint64_t bus;
+    uint64_t host;
+
+    if (p_tm->isRunning == FALSE) {
+        return;
+    }
+    bus = emu.busNs - p_tm->busStart;
+    host = _emu_hostNs() - p_tm->hostStart;
+    p_tm->isRunning = FALSE;
+
+    p_tm->num++;
+    p_tm->busNs += bus;
+    p_tm->hostNs += host;
+    if (bus > p_tm->busNsMax) {
+        p_tm->busNsMax = bus;
+    }
+    if (host > p_tm->hostNsMax) {
+        p_tm->hostNsMax = host;
+    }
+}
+
+static void _emu_printTiming(FILE *fp, const char *pc_name,
+        const s_emuTiming_t *p_tm)
+{
+    uint32_t num = (p_tm->num > 0) ? p_tm->num : 1;
+
+    fprintf(fp, "cc112x,%04x,%s,%lu,%llu,%llu,%llu,%llu\n", emu_net.addr,
+            pc_name, (unsigned long)p_tm->num,
+            (unsigned long long)(p_tm->busNs / num / 1000),
+            (unsigned long long)(p_tm->busNsMax / 1000),
+            (unsigned long long)(p_tm->hostNs / num),
+            (unsigned long long)p_tm->hostNsMax);
+}
+
+static void _emu_printStats(void)
+{
+    const char *pc_env;
+    FILE *fp = stdout;
+
+    pc_env = getenv(NATIVE_SIM_STATS_ENV);
+    if (pc_env != NULL) {
+        fp = fopen(pc_env, "a");
+        if (fp == NULL) {
+            LOG_ERR("cc112x: can't open %s", pc_env);
+            return;
+        }
+    }
+
+    _emu_printTiming(fp, "txload", &emu.txLoad);
+    _emu_printTiming(fp, "rxdrain", &emu.rxDrain);
+    fprintf(fp, "cc112x,%04x,frames,%lu,%lu,%lu,%lu,%lu\n", emu_net.addr,
+            (unsigned long)emu.txNum, (unsigned long)emu.rxNum,
+            (unsigned long)emu.rxDropped, (unsigned long)emu.rxOverflow,
+            (unsigned long)emu.ccaFailed);
+
+    if (fp != stdout) {
+        fclose(fp);
+    }
+}
+
+static uint8_t _emu_reg(uint16_t addr)
+{
+    return emu.regs[EMU_REG_IX(addr)];
+}
+
+static uint8_t _emu_fifoThr(void)
+{
+    return _emu_reg(CC112X_FIFO_CFG) & 0x7F;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Take over FIRST and LAST pointers written by the driver
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_fifoSetNum(s_emuFifo_t *p_fifo, uint8_t first, uint8_t last)
+{
+    p_fifo->first = first & (CC112X_EMU_FIFO_SIZE - 1);
+    p_fifo->num = (last - first) & (CC112X_EMU_FIFO_SIZE - 1);
+}
+
+static void _emu_rxFifoPush(uint8_t val)
+{
+    s_emuFifo_t *p_fifo = &emu.rxFifo;
+
+    p_fifo->buf[(p_fifo->first + p_fifo->num) & (CC112X_EMU_FIFO_SIZE - 1)] =
+            val;
+    p_fifo->num++;
+
+    if ((p_fifo->num == (uint8_t)(_emu_fifoThr() + 1)) &&
+        (emu.rxDrain.isRunning == FALSE)) {
+        /* RXFIFO_THR goes up, the driver has to make room */
+        emu.rxDrainLevel = _emu_fifoThr();
+        _emu_timingStart(&emu.rxDrain);
+    }
+}
+
+static uint8_t _emu_rxFifoPop(void)
+{
+    s_emuFifo_t *p_fifo = &emu.rxFifo;
+    uint8_t val;
+
+    if (p_fifo->num == 0) {
+        emu.regs[EMU_REG_IX(CC112X_MARC_STATUS1)] = EMU_MARC_RX_UNDERFLOW;
+        _emu_setState(CC112X_STATE_RXFIFO_ERROR);
+        return 0;
+    }
+
+    val = p_fifo->buf[p_fifo->first];
+    p_fifo->first = (p_fifo->first + 1) & (CC112X_EMU_FIFO_SIZE - 1);
+    p_fifo->num--;
+
+    if (p_fifo->num <= emu.rxDrainLevel) {
+        _emu_timingStop(&emu.rxDrain);
+    }
+    return val;
+}
+
+static void _emu_txFifoPush(uint8_t val)
+{
+    s_emuFifo_t *p_fifo = &emu.txFifo;
+
+    if (p_fifo->num >= CC112X_EMU_FIFO_SIZE) {
+        emu.regs[EMU_REG_IX(CC112X_MARC_STATUS1)] = EMU_MARC_TX_OVERFLOW;
+        _emu_setState(CC112X_STATE_TXFIFO_ERROR);
+        return;
+    }
+
+    if ((p_fifo->num == 0) && (emu.state != CC112X_STATE_TX)) {
+        /* the driver starts to load a frame */
+        _emu_timingStart(&emu.txLoad);
+    }
+    p_fifo->buf[(p_fifo->first + p_fifo->num) & (CC112X_EMU_FIFO_SIZE - 1)] =
+            val;
+    p_fifo->num++;
+}
+
+static uint8_t _emu_txFifoPop(void)
+{
+    s_emuFifo_t *p_fifo = &emu.txFifo;
+    uint8_t val;
+
+    val = p_fifo->buf[p_fifo->first];
+    p_fifo->first = (p_fifo->first + 1) & (CC112X_EMU_FIFO_SIZE - 1);
+    p_fifo->num--;
+    return val;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Change the radio state, the medium only hears us in RX
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_setState(uint8_t state)
+{
+    if ((emu.state == CC112X_STATE_RX) && (state != CC112X_STATE_RX)) {
+        /* a frame being received is lost */
+        emu.rxEpoch++;
+    }
+    if (state != emu.state) {
+        emu.isPktSync = FALSE;
+    }
+    emu.state = state;
+    native_sim_setRx((state == CC112X_STATE_RX) && (emu.isSleeping == FALSE));
+    _emu_updatePins();
+}
+
+static void _emu_setPktSync(uint8_t is_on)
+{
+    emu.isPktSync = is_on;
+    _emu_updatePins();
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Compute the GPIO levels and latch the edges the driver asked for
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_updatePins(void)
+{
+    uint8_t i;
+    uint8_t cfg;
+    uint8_t level;
+
+    for (i = 0; i < EMU_EXTI_NUM; i++) {
+        cfg = _emu_reg(emu_extiIocfg[i]);
+        switch (cfg & EMU_IOCFG_CFG) {
+            case EMU_GPIO_RXFIFO_THR:
+            case EMU_GPIO_RXFIFO_THR_PKT:
+                level = (emu.rxFifo.num > _emu_fifoThr());
+                break;
+            case EMU_GPIO_TXFIFO_THR:
+            case EMU_GPIO_TXFIFO_THR_PKT:
+                level = (emu.txFifo.num > 127 - _emu_fifoThr());
+                break;
+            case EMU_GPIO_PKT_SYNC_RXTX:
+                level = emu.isPktSync;
+                break;
+            default:
+                level = 0;
+                break;
+        }
+        if (cfg & EMU_IOCFG_INV) {
+            level = !level;
+        }
+
+        if (level != emu.extiLevel[i]) {
+            emu.extiLevel[i] = level;
+            if ((level && (emu.extiEdge[i] == E_TARGET_INT_EDGE_RISING)) ||
+                (!level && (emu.extiEdge[i] == E_TARGET_INT_EDGE_FALLING))) {
+                emu.extiPending |= (1 << i);
+            }
+        }
+    }
+}
+
+static void _emu_reset(void)
+{
+    uint8_t i;
+
+    memset(emu.regs, 0, sizeof(emu.regs));
+    for (i = 0; i < sizeof(emu_regsReset) / sizeof(emu_regsReset[0]); i++) {
+        emu.regs[EMU_REG_IX(emu_regsReset[i].addr)] = emu_regsReset[i].val;
+    }
+    memset(&emu.rxFifo, 0, sizeof(emu.rxFifo));
+    memset(&emu.txFifo, 0, sizeof(emu.txFifo));
+    emu.rxDrain.isRunning = FALSE;
+    emu.txLoad.isRunning = FALSE;
+    emu.isSleeping = FALSE;
+    emu.isTxReq = FALSE;
+    _emu_setState(CC112X_STATE_IDLE);
+}
+
+static void _emu_strobe(uint8_t cmd)
+{
+    uint8_t pktCfg2;
+
+    switch (cmd) {
+        case CC112X_SRES:
+            _emu_reset();
+            break;
+
+        case CC112X_SRX:
+        case CC112X_SWOR:
+            /* eWOR is not modelled, the receiver stays on */
+            if ((emu.state != CC112X_STATE_RXFIFO_ERROR) &&
+                (emu.state != CC112X_STATE_TXFIFO_ERROR)) {
+                _emu_setState(CC112X_STATE_RX);
+            }
+            break;
+
+        case CC112X_STX:
+            if ((emu.state == CC112X_STATE_RXFIFO_ERROR) ||
+                (emu.state == CC112X_STATE_TXFIFO_ERROR) ||
+                (emu.state == CC112X_STATE_TX)) {
+                break;
+            }
+            pktCfg2 = _emu_reg(CC112X_PKT_CFG2);
+            if ((emu.state == CC112X_STATE_RX) && (pktCfg2 & 0x1C) &&
+                native_sim_isChannelBusy()) {
+                /* TX on CCA, the channel is taken */
+                emu.regs[EMU_REG_IX(CC112X_MARC_STATUS0)] |=
+                        EMU_MARC0_TXONCCA_FAILED;
+                emu.regs[EMU_REG_IX(CC112X_MARC_STATUS1)] =
+                        EMU_MARC_TX_ON_CCA_FAILED;
+                emu.ccaFailed++;
+                break;
+            }
+            emu.regs[EMU_REG_IX(CC112X_MARC_STATUS0)] &=
+                    ~EMU_MARC0_TXONCCA_FAILED;
+            _emu_timingStop(&emu.txLoad);
+            _emu_setState(CC112X_STATE_TX);
+            emu.isTxReq = TRUE;
+            break;
+
+        case CC112X_SFSTXON:
+            _emu_setState(CC112X_STATE_FSTXON);
+            break;
+
+        case CC112X_SIDLE:
+        case CC112X_SCAL:
+            /* calibration is instant */
+            emu.isTxReq = FALSE;
+            _emu_setState(CC112X_STATE_IDLE);
+            break;
+
+        case CC112X_SPWD:
+        case CC112X_SXOFF:
+            emu.isTxReq = FALSE;
+            emu.isSleeping = TRUE;
+            _emu_setState(CC112X_STATE_IDLE);
+            break;
+
+        case CC112X_SFRX:
+            if ((emu.state == CC112X_STATE_IDLE) ||
+                (emu.state == CC112X_STATE_RXFIFO_ERROR)) {
+                emu.rxFifo.first = 0;
+                emu.rxFifo.num = 0;
+                emu.rxDrain.isRunning = FALSE;
+                emu.rxEpoch++;
+                if (emu.state == CC112X_STATE_RXFIFO_ERROR) {
+                    _emu_setState(CC112X_STATE_IDLE);
+                }
+                _emu_updatePins();
+            }
+            break;
+
+        case CC112X_SFTX:
+            if ((emu.state == CC112X_STATE_IDLE) ||
+                (emu.state == CC112X_STATE_TXFIFO_ERROR)) {
+                emu.txFifo.first = 0;
+                emu.txFifo.num = 0;
+                emu.txLoad.isRunning = FALSE;
+                if (emu.state == CC112X_STATE_TXFIFO_ERROR) {
+                    _emu_setState(CC112X_STATE_IDLE);
+                }
+                _emu_updatePins();
+            }
+            break;
+
+        default:
+            /* SNOP, SAFC and SWORRST */
+            break;
+    }
+}
+
+static uint8_t _emu_status(void)
+{
+    return (emu.isSleeping ? CC112X_STATE_CHIP_RDYn : 0) | emu.state;
+}
+
+static uint8_t _emu_regRead(uint16_t addr)
+{
+    uint8_t val;
+
+    switch (addr) {
+        case CC112X_MARCSTATE:
+            switch (emu.state) {
+                case CC112X_STATE_RX:           return 0x6D;
+                case CC112X_STATE_TX:           return 0x33;
+                case CC112X_STATE_FSTXON:       return 0x32;
+                case CC112X_STATE_RXFIFO_ERROR: return 0x11;
+                case CC112X_STATE_TXFIFO_ERROR: return 0x16;
+                default:                        return 0x41;
+            }
+
+        case CC112X_MARC_STATUS1:
+            /* cleared when read */
+            val = _emu_reg(addr);
+            emu.regs[EMU_REG_IX(addr)] = EMU_MARC_NO_FAILURE;
+            return val;
+
+        case CC112X_RSSI1:
+            return (uint8_t)(native_sim_isChannelBusy() ?
+                    NATIVE_SIM_CCA_DBM + EMU_RSSI_OFFSET :
+                    NATIVE_SIM_NOISE_DBM + EMU_RSSI_OFFSET);
+
+        case CC112X_RSSI0:
+            if (emu.state != CC112X_STATE_RX) {
+                return 0;
+            }
+            return EMU_RSSI0_VALID | EMU_RSSI0_CS_VALID |
+                   (native_sim_isChannelBusy() ? EMU_RSSI0_CS : 0);
+
+        case CC112X_PARTNUMBER:
+            return EMU_PARTNUMBER;
+        case CC112X_PARTVERSION:
+            return EMU_PARTVERSION;
+
+        case CC112X_NUM_RXBYTES:
+        case CC112X_FIFO_NUM_RXBYTES:
+            return emu.rxFifo.num;
+        case CC112X_NUM_TXBYTES:
+            return emu.txFifo.num;
+        case CC112X_FIFO_NUM_TXBYTES:
+            /* free entries, at most 15 are reported */
+            val = CC112X_EMU_FIFO_SIZE - emu.txFifo.num;
+            return (val > 15) ? 15 : val;
+
+        case CC112X_RXFIRST:
+            return emu.rxFifo.first;
+        case CC112X_TXFIRST:
+            return emu.txFifo.first;
+        case CC112X_RXLAST:
+            return (emu.rxFifo.first + emu.rxFifo.num) &
+                   (CC112X_EMU_FIFO_SIZE - 1);
+        case CC112X_TXLAST:
+            return (emu.txFifo.first + emu.txFifo.num) &
+                   (CC112X_EMU_FIFO_SIZE - 1);
+
+        default:
+            return _emu_reg(addr);
+    }
+}
+
+static void _emu_regWrite(uint16_t addr, uint8_t val)
+{
+    switch (addr) {
+        case CC112X_RXFIRST:
+            _emu_fifoSetNum(&emu.rxFifo, val, _emu_regRead(CC112X_RXLAST));
+            break;
+        case CC112X_TXFIRST:
+            _emu_fifoSetNum(&emu.txFifo, val, _emu_regRead(CC112X_TXLAST));
+            break;
+        case CC112X_RXLAST:
+            _emu_fifoSetNum(&emu.rxFifo, emu.rxFifo.first, val);
+            break;
+        case CC112X_TXLAST:
+            _emu_fifoSetNum(&emu.txFifo, emu.txFifo.first, val);
+            break;
+
+        case CC112X_MARCSTATE:
+        case CC112X_MARC_STATUS1:
+        case CC112X_NUM_RXBYTES:
+        case CC112X_NUM_TXBYTES:
+        case CC112X_FIFO_NUM_RXBYTES:
+        case CC112X_FIFO_NUM_TXBYTES:
+        case CC112X_PARTNUMBER:
+        case CC112X_PARTVERSION:
+            /* read only */
+            break;
+
+        default:
+            emu.regs[EMU_REG_IX(addr)] = val;
+            break;
+    }
+    _emu_updatePins();
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  One byte on the bus
+ */
+/*----------------------------------------------------------------------------*/
+static uint8_t _emu_spiByte(uint8_t tx)
+{
+    uint8_t rx = 0;
+    uint8_t addr;
+
+    emu.busNs += CC112X_EMU_SPI_BYTE_NS;
+
+    switch (emu.spi) {
+        case E_EMU_SPI_HEADER:
+            rx = _emu_status();
+            emu.spiHdr = tx;
+            addr = tx & EMU_ADDR_MASK;
+            if (addr == EMU_ADDR_EXT) {
+                emu.spi = E_EMU_SPI_EXT;
+            } else if (addr == EMU_ADDR_FIFO) {
+                emu.spi = E_EMU_SPI_FIFO;
+            } else if (addr >= CC112X_SRES) {
+                /* command strobes, direct FIFO access is not supported */
+                if (addr != EMU_ADDR_DMA) {
+                    _emu_strobe(addr);
+                }
+                emu.spi = E_EMU_SPI_IGNORE;
+            } else {
+                emu.spiAddr = addr;
+                emu.spi = E_EMU_SPI_REG;
+            }
+            break;
+
+        case E_EMU_SPI_EXT:
+            rx = _emu_status();
+            emu.spiAddr = (EMU_ADDR_EXT << 8) | tx;
+            emu.spi = E_EMU_SPI_REG;
+            break;
+
+        case E_EMU_SPI_REG:
+            if (emu.spiHdr & EMU_READ_ACCESS) {
+                rx = _emu_regRead(emu.spiAddr);
+            } else {
+                _emu_regWrite(emu.spiAddr, tx);
+            }
+            if (emu.spiHdr & EMU_BURST_ACCESS) {
+                emu.spiAddr = (emu.spiAddr & 0xFF00) |
+                              ((emu.spiAddr + 1) & 0x00FF);
+            } else {
+                emu.spi = E_EMU_SPI_IGNORE;
+            }
+            break;
+
+        case E_EMU_SPI_FIFO:
+            if (emu.spiHdr & EMU_READ_ACCESS) {
+                rx = _emu_rxFifoPop();
+            } else {
+                _emu_txFifoPush(tx);
+            }
+            if ((emu.spiHdr & EMU_BURST_ACCESS) == 0) {
+                emu.spi = E_EMU_SPI_IGNORE;
+            }
+            _emu_updatePins();
+            break;
+
+        default:
+            break;
+    }
+    return rx;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Airtime of a frame with the configured preamble, sync word, CRC
+ *          and data rate
+ */
+/*----------------------------------------------------------------------------*/
+static uint32_t _emu_airtime(uint16_t len)
+{
+    uint32_t bits;
+    uint32_t mant;
+    uint8_t exp;
+    double rate;
+
+    bits = emu_preambleTab[(_emu_reg(CC112X_PREAMBLE_CFG1) >> 2) & 0x0F] * 4;
+    bits += emu_syncTab[(_emu_reg(CC112X_SYNC_CFG0) >> 2) & 0x07];
+    bits += len * 8;
+    if (_emu_reg(CC112X_PKT_CFG1) & 0x06) {
+        bits += 16;
+    }
+
+    exp = _emu_reg(CC112X_SYMBOL_RATE2) >> 4;
+    mant = ((uint32_t)(_emu_reg(CC112X_SYMBOL_RATE2) & 0x0F) << 16) |
+           ((uint32_t)_emu_reg(CC112X_SYMBOL_RATE1) << 8) |
+           _emu_reg(CC112X_SYMBOL_RATE0);
+    if (exp == 0) {
+        rate = (double)mant * CC112X_EMU_XOSC_HZ / (1ULL << 38);
+    } else {
+        rate = (double)((1UL << 20) + mant) * (1UL << exp) *
+               CC112X_EMU_XOSC_HZ / (1ULL << 39);
+    }
+    if (((_emu_reg(CC112X_MODCFG_DEV_E) >> 3) & 0x07) >= 4) {
+        /* 4-(G)FSK carries two bits per symbol */
+        rate *= 2;
+    }
+    return (uint32_t)(bits * 1e6 / rate);
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Let the virtual time run for the bytes shifted so far
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_payBus(void)
+{
+    uint64_t us;
+
+    us = (emu.busNs - emu.busPaidNs) / 1000;
+    if (us > 0) {
+        emu.busPaidNs += us * 1000;
+        native_sim_delay((uint32_t)us);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Call the handler of one pending and enabled interrupt line
+ *
+ *  \return 1 if a handler was called, 0 otherwise
+ */
+/*----------------------------------------------------------------------------*/
+static uint8_t _emu_dispatch(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < EMU_EXTI_NUM; i++) {
+        if ((emu.extiPending & emu.extiEnabled & (1 << i)) &&
+            (emu.pfn_exti[i] != NULL)) {
+            emu.extiPending &= ~(1 << i);
+            emu.pfn_exti[i](NULL);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Pay the SPI time and run the interrupts raised meanwhile
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_service(void)
+{
+    do {
+        _emu_payBus();
+    } while (_emu_dispatch());
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Send the TX FIFO after STX, with the interrupts a real chip
+ *          raises at the sync word and at the end of the packet
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_transmit(void)
+{
+    uint8_t frame[CC112X_EMU_FIFO_SIZE];
+    uint16_t len = 0;
+    uint8_t txoff;
+
+    emu.isTxReq = FALSE;
+    if (emu.txFifo.num == 0) {
+        emu.regs[EMU_REG_IX(CC112X_MARC_STATUS1)] = EMU_MARC_TX_UNDERFLOW;
+        _emu_setState(CC112X_STATE_TXFIFO_ERROR);
+        return;
+    }
+
+    /* sync word sent */
+    _emu_setPktSync(TRUE);
+    _emu_service();
+    if (emu.state != CC112X_STATE_TX) {
+        return;
+    }
+
+    while (emu.txFifo.num > 0) {
+        frame[len++] = _emu_txFifoPop();
+    }
+    native_sim_send(emu_net.publishCh, frame, len, _emu_airtime(len));
+    emu.txNum++;
+    if (emu.state != CC112X_STATE_TX) {
+        return;
+    }
+
+    emu.regs[EMU_REG_IX(CC112X_MARC_STATUS1)] = EMU_MARC_TX_FINI;
+    txoff = (_emu_reg(CC112X_RFEND_CFG0) >> 4) & 0x03;
+    _emu_setState((txoff == 1) ? CC112X_STATE_FSTXON :
+                  (txoff == 2) ? CC112X_STATE_TX :
+                  (txoff == 3) ? CC112X_STATE_RX : CC112X_STATE_IDLE);
+    _emu_setPktSync(FALSE);
+    _emu_service();
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Play the oldest received frame into the RX FIFO
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_receive(void)
+{
+    static s_emuFrame_t frame;
+    uint32_t epoch;
+    uint16_t i;
+    uint8_t status[2];
+    uint8_t len;
+    uint8_t rxoff;
+    int16_t margin;
+
+    memcpy(&frame, &emu.rxq[0], sizeof(frame));
+    emu.rxqLen--;
+    memmove(&emu.rxq[0], &emu.rxq[1], emu.rxqLen * sizeof(emu.rxq[0]));
+
+    if ((emu.state != CC112X_STATE_RX) || emu.isSleeping) {
+        emu.rxDropped++;
+        return;
+    }
+
+    /* sync word found */
+    epoch = emu.rxEpoch;
+    _emu_setPktSync(TRUE);
+    _emu_service();
+
+    /* the LQI gets better with the margin above the noise */
+    margin = frame.rssi - NATIVE_SIM_NOISE_DBM;
+    status[0] = (uint8_t)(frame.rssi + EMU_RSSI_OFFSET);
+    status[1] = CC112X_LQI_CRC_OK_BM |
+                ((margin >= 64) ? 0 : (margin <= 0) ? 64 : 64 - margin);
+    len = frame.len;
+    if (_emu_reg(CC112X_PKT_CFG1) & 0x01) {
+        len += sizeof(status);
+    }
+
+    for (i = 0; i < len; i++) {
+        if (emu.rxEpoch != epoch) {
+            /* the driver gave up on the frame */
+            emu.rxDropped++;
+            return;
+        }
+        if (emu.rxFifo.num >= CC112X_EMU_FIFO_SIZE) {
+            emu.rxOverflow++;
+            emu.regs[EMU_REG_IX(CC112X_MARC_STATUS1)] = EMU_MARC_RX_OVERFLOW;
+            _emu_setState(CC112X_STATE_RXFIFO_ERROR);
+            _emu_service();
+            return;
+        }
+        _emu_rxFifoPush((i < frame.len) ? frame.data[i] :
+                                          status[i - frame.len]);
+        _emu_updatePins();
+        _emu_service();
+    }
+    if (emu.rxEpoch != epoch) {
+        emu.rxDropped++;
+        return;
+    }
+
+    /* the rest of the frame is up to the end of packet handler */
+    if (emu.rxFifo.num > 0) {
+        emu.rxDrainLevel = 0;
+        _emu_timingStart(&emu.rxDrain);
+    }
+    emu.rxNum++;
+    emu.regs[EMU_REG_IX(CC112X_MARC_STATUS1)] = EMU_MARC_RX_FINI;
+    rxoff = (_emu_reg(CC112X_RFEND_CFG1) >> 4) & 0x03;
+    _emu_setState((rxoff == 1) ? CC112X_STATE_FSTXON :
+                  (rxoff == 2) ? CC112X_STATE_TX :
+                  (rxoff == 3) ? CC112X_STATE_RX : CC112X_STATE_IDLE);
+    if (rxoff == 2) {
+        emu.isTxReq = TRUE;
+    }
+    _emu_setPktSync(FALSE);
+    _emu_service();
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Run the chip until it waits for the driver again. Only when the
+ *          CPU would take interrupts, never nested
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_run(void)
+{
+    if (emu.isBusy || emu.isSelected || emu.critical) {
+        return;
+    }
+
+    emu.isBusy = TRUE;
+    while (1) {
+        _emu_service();
+        if (emu.isTxReq) {
+            _emu_transmit();
+        } else if (emu.rxqLen > 0) {
+            _emu_receive();
+        } else {
+            break;
+        }
+    }
+    emu.isBusy = FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  The driver released the bus or unmasked its interrupts
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_poll(void)
+{
+    uint8_t isBusy;
+
+    if (emu.isSelected || emu.critical) {
+        return;
+    }
+
+    /* frames reaching us meanwhile wait in the queue */
+    isBusy = emu.isBusy;
+    emu.isBusy = TRUE;
+    _emu_payBus();
+    emu.isBusy = isBusy;
+    _emu_run();
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  A frame reached this node, called by native_sim
+ */
+/*----------------------------------------------------------------------------*/
+static void _emu_rx(uint8_t *p_data, uint16_t len, int8_t rssi)
+{
+    if ((emu.rxqLen >= CC112X_EMU_RXQ_SIZE) || (len > PACKETBUF_SIZE)) {
+        emu.rxDropped++;
+        return;
+    }
+
+    emu.rxq[emu.rxqLen].len = len;
+    emu.rxq[emu.rxqLen].rssi = rssi;
+    memcpy(emu.rxq[emu.rxqLen].data, p_data, len);
+    emu.rxqLen++;
+    _emu_run();
+}
+
+static void _emu_onMsg(const lcm_recv_buf_t *rps_rbuf,
+        const char *pc_channel, void *p_user)
+{
+    (void)pc_channel;
+    (void)p_user;
+
+    native_sim_recv(rps_rbuf->data, rps_rbuf->data_size);
+}
+
+/*==============================================================================
+                                 API FUNCTIONS
+ ==============================================================================*/
+void *cc112x_emu_init(void)
+{
+    if (emu_isInit) {
+        return &emu;
+    }
+    emu_isInit = TRUE;
+
+    memset(&emu, 0, sizeof(emu));
+    native_net_open(&emu_net, _emu_onMsg, NULL);
+    native_sim_start(emu_net.p_lcm, emu_net.addr, emu_net.nodeNum, _emu_rx);
+    atexit(_emu_printStats);
+
+    /* power on reset */
+    _emu_reset();
+    LOG1_OK("cc112x: emulation of node 0x%04X started", emu_net.addr);
+    return &emu;
+}
+
+void cc112x_emu_select(uint8_t is_sel)
+{
+    if (is_sel) {
+        /* chip select wakes the chip up */
+        if (emu.isSleeping) {
+            emu.isSleeping = FALSE;
+            _emu_setState(CC112X_STATE_IDLE);
+        }
+        emu.spi = E_EMU_SPI_HEADER;
+        emu.isSelected = TRUE;
+    } else {
+        emu.isSelected = FALSE;
+        _emu_poll();
+    }
+}
+
+void cc112x_emu_transfer(const uint8_t *p_tx, uint8_t *p_rx, uint16_t len)
+{
+    uint16_t i;
+    uint8_t rx;
+
+    for (i = 0; i < len; i++) {
+        rx = _emu_spiByte((p_tx != NULL) ? p_tx[i] : 0xFF);
+        if (p_rx != NULL) {
+            p_rx[i] = rx;
+        }
+    }
+}
+
+void cc112x_emu_enterCritical(void)
+{
+    emu.critical++;
+}
+
+void cc112x_emu_exitCritical(void)
+{
+    if (emu.critical > 0) {
+        emu.critical--;
+    }
+    _emu_poll();
+}
+
+void cc112x_emu_extiRegister(en_targetExtInt_t e_extInt,
+        en_targetIntEdge_t e_edge, pfn_intCallb_t pfn_intCallback)
+{
+    if (e_extInt >= EMU_EXTI_NUM) {
+        return;
+    }
+    emu.pfn_exti[e_extInt] = pfn_intCallback;
+    emu.extiEdge[e_extInt] = e_edge;
+}
+
+void cc112x_emu_extiClear(en_targetExtInt_t e_extInt)
+{
+    if (e_extInt < EMU_EXTI_NUM) {
+        emu.extiPending &= ~(1 << e_extInt);
+    }
+}
+
+void cc112x_emu_extiEnable(en_targetExtInt_t e_extInt)
+{
+    if (e_extInt < EMU_EXTI_NUM) {
+        emu.extiEnabled |= (1 << e_extInt);
+        _emu_run();
+    }
+}
+
+void cc112x_emu_extiDisable(en_targetExtInt_t e_extInt)
+{
+    if (e_extInt < EMU_EXTI_NUM) {
+        emu.extiEnabled &= ~(1 << e_extInt);
+    }
+}
+
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
+/** @} */
@@ -0,0 +1,164 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**
+ * \addtogroup linux
+ * @{
+ */
+/*============================================================================*/
+/*! \file   cc112x_emu.h
+
+ \brief  Emulated CC112x transceiver for the native target.
+
+         With NATIVE_CFG_CC112X_EMU_EN the SPI and external interrupt HAL
+         of the native target talk to a register level model of the CC112x
+         instead of real hardware, so that the unmodified driver of
+         target/if/cc112x runs on the host and sends its frames over the
+         virtual time medium of native_sim.h.
+
+         The model covers what the driver relies on:
+
+         - register and extended register space, burst access and the
+           command strobes, including the chip status byte returned with
+           every header byte.
+         - 128 byte RX and TX FIFOs with their FIRST/LAST pointers, byte
+           counters and over- and underflow handling.
+         - the radio states IDLE, RX, TX, FSTXON and SLEEP, RXOFF_MODE and
+           TXOFF_MODE, MARC_STATUS0/1, MARCSTATE and carrier sense in RSSI0.
+           STX in RX fails with TXONCCA_FAILED while a neighbour is on the
+           air and PKT_CFG2 asks for clear channel assessment.
+         - the GPIO0, GPIO2 and GPIO3 signals RXFIFO_THR, TXFIFO_THR and
+           PKT_SYNC_RXTX mapped to E_TARGET_EXT_INT_0..2 as on the boards.
+
+         SPI transfers take CC112X_EMU_SPI_BYTE_NS per byte of virtual time,
+         interrupts are delivered when the CPU leaves its critical sections.
+         A received frame is played into the RX FIFO once it is completely
+         on the air and the interrupts fire as its bytes come in, the
+         airtime itself is accounted for by the sender. Calibration is
+         instant, eWOR behaves as RX, CRC and whitening are not modelled.
+
+         The time the driver needs to load the TX FIFO and to drain the RX
+         FIFO is appended to the file given by NATIVE_SIM_STATS_ENV when the
+         node exits:
+
+         cc112x,<addr>,txload,<num>,<avg us>,<max us>,<avg ns>,<max ns>
+         cc112x,<addr>,rxdrain,<num>,<avg us>,<max us>,<avg ns>,<max ns>
+         cc112x,<addr>,frames,<tx>,<rx>,<dropped>,<overflow>,<cca failed>
+
+         The us values are the SPI time in virtual time, the ns values the
+         CPU time of the host spent in the driver meanwhile.
+
+ \version 0.0.1
+ */
+/*============================================================================*/
+#ifndef CC112X_EMU_H_
+#define CC112X_EMU_H_
+
+/*==============================================================================
+                                 INCLUDE FILES
+ ==============================================================================*/
+#include "emb6.h"
+#include "target.h"
+#include "native_sim.h"
+
+/*==============================================================================
+                                    MACROS
+ ==============================================================================*/
+/** Emulate a CC112x behind the SPI of the native target */
+#ifndef NATIVE_CFG_CC112X_EMU_EN
+#define NATIVE_CFG_CC112X_EMU_EN            FALSE
+#endif
+
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+#if (NATIVE_CFG_VIRTUAL_TIME_EN != TRUE)
+#error "the CC112x emulation requires NATIVE_CFG_VIRTUAL_TIME_EN"
+#endif
+
+/** Duration of a SPI byte in ns, 4 MHz SCLK as on the EFM32 boards */
+#ifndef CC112X_EMU_SPI_BYTE_NS
+#define CC112X_EMU_SPI_BYTE_NS              2000
+#endif
+/** Crystal frequency in Hz */
+#ifndef CC112X_EMU_XOSC_HZ
+#define CC112X_EMU_XOSC_HZ                  32000000
+#endif
+/** Size of each FIFO */
+#define CC112X_EMU_FIFO_SIZE                128
+/** Number of received frames waiting to be played into the RX FIFO */
+#define CC112X_EMU_RXQ_SIZE                 4
+
+/*==============================================================================
+                             FUNCTION PROTOTYPES
+ ==============================================================================*/
+/** \brief  Join the network of LCM_NETWORK_CONF and reset the chip. Called
+ *          by hal_spiInit(), further calls only return the handle
+ *
+ *  \return SPI handle
+ */
+void *cc112x_emu_init(void);
+
+/** \brief  Drive the chip select line
+ *
+ *  \param  is_sel      TRUE to select the chip
+ */
+void cc112x_emu_select(uint8_t is_sel);
+
+/** \brief  Shift bytes through the SPI
+ *
+ *  \param  p_tx        Bytes to send, NULL sends 0xFF
+ *  \param  p_rx        Received bytes, may be NULL
+ *  \param  len         Number of bytes
+ */
+void cc112x_emu_transfer(const uint8_t *p_tx, uint8_t *p_rx, uint16_t len);
+
+/** \brief  The CPU masks or unmasks its interrupts */
+void cc112x_emu_enterCritical(void);
+void cc112x_emu_exitCritical(void);
+
+/** \brief  Interrupt lines of the radio, see hal_extiRegister() */
+void cc112x_emu_extiRegister(en_targetExtInt_t e_extInt,
+        en_targetIntEdge_t e_edge, pfn_intCallb_t pfn_intCallback);
+void cc112x_emu_extiClear(en_targetExtInt_t e_extInt);
+void cc112x_emu_extiEnable(en_targetExtInt_t e_extInt);
+void cc112x_emu_extiDisable(en_targetExtInt_t e_extInt);
+
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
+
+#endif /* CC112X_EMU_H_ */
+/** @} */
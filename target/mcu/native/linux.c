@@ -83,8 +83,22 @@
 #include <sys/time.h>
 #include <sys/signal.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#if DEMO_USE_EXTIF
+#include <sys/epoll.h>
+#endif /* #if DEMO_USE_EXTIF */
 
 #include "logger.h"
+#include "native_sim.h"
+#include "cc112x_emu.h"
+#if DEMO_USE_EXTIF
+/* bytes read from the pty at once */
+#define     EXTIF_RX_BUF_SIZE    2048
+/* time a blocked pty may hold back a frame, in milliseconds */
+#define     EXTIF_TX_TIMEOUT     100
+#endif /* #if DEMO_USE_EXTIF */
+
 /*==============================================================================
                                      ENUMS
 ==============================================================================*/
@@ -98,16 +112,17 @@
 ==============================================================================*/
 #if DEMO_USE_EXTIF
 static void _printAndExit( const char* rpc_reason );
-static void signal_handler_IO (int status);
+static void _extif_drain(void);
 static void signal_handler_interrupt(int signum);
 #endif /* #if DEMO_USE_EXTIF */
 
 /*==============================================================================
                           VARIABLE DECLARATIONS
 ==============================================================================*/
-static    struct timespec             tim = {0,0};
 #if DEMO_USE_EXTIF
 static int fdm = -1;
+static int epfd = -1;
+static uint8_t extif_rxBuf[EXTIF_RX_BUF_SIZE];
 pfn_intCallb_t isr_rxCallb = NULL;
 #endif /* #if DEMO_USE_EXTIF */
 /*==============================================================================
@@ -136,17 +151,31 @@ static void _printAndExit( const char* rpc_reason )
     exit( 1 );
 }
 
-static void signal_handler_IO (int status)
+/* Read everything the pty holds with as few calls as possible and hand
+ * it to the receive callback */
+static void _extif_drain(void)
 {
-    char bufin;
-    int ret;
+    ssize_t ret;
+    ssize_t i;
+
+    if( fdm < 0 )
+        return;
 
     do
     {
-        ret=read(fdm, &bufin, 1);
-        if((isr_rxCallb != NULL) && (ret > 0))
-            isr_rxCallb(&bufin);
-    } while( ret > 0 );
+        ret = read(fdm, extif_rxBuf, sizeof(extif_rxBuf));
+        if( ret < 0 )
+        {
+            /* EAGAIN when the pty is empty, EIO when its other side is
+             * closed, see hal_idle() */
+            break;
+        }
+        if( isr_rxCallb != NULL )
+        {
+            for( i = 0; i < ret; i++ )
+                isr_rxCallb(&extif_rxBuf[i]);
+        }
+    } while( ret == (ssize_t)sizeof(extif_rxBuf) );
 }
 
 static void signal_handler_interrupt(int signum)
@@ -175,6 +204,13 @@ void hal_extiRegister( en_targetExtInt_t e_extInt, en_targetIntEdge_t e_edge,
 		{
 			case E_TARGET_RADIO_INT:
 				break;
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+			case E_TARGET_EXT_INT_0:
+			case E_TARGET_EXT_INT_1:
+			case E_TARGET_EXT_INT_2:
+				cc112x_emu_extiRegister(e_extInt, e_edge, pfn_intCallback);
+				break;
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
 #if DEMO_USE_EXTIF
 			case E_TARGET_USART_INT:
 				isr_rxCallb = pfn_intCallback;
@@ -192,6 +228,9 @@ void hal_extiRegister( en_targetExtInt_t e_extInt, en_targetIntEdge_t e_edge,
  =============================================================================*/
 void hal_extiClear(en_targetExtInt_t e_extInt)
 {
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    cc112x_emu_extiClear(e_extInt);
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
 } /* hal_extiClear() */
 
 /*==============================================================================
@@ -199,6 +238,9 @@ void hal_extiClear(en_targetExtInt_t e_extInt)
  =============================================================================*/
 void hal_extiEnable(en_targetExtInt_t e_extInt)
 {
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    cc112x_emu_extiEnable(e_extInt);
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
 } /* hal_extiEnable() */
 
 /*==============================================================================
@@ -206,6 +248,9 @@ void hal_extiEnable(en_targetExtInt_t e_extInt)
  =============================================================================*/
 void hal_extiDisable(en_targetExtInt_t e_extInt)
 {
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    cc112x_emu_extiDisable(e_extInt);
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
 } /* hal_extiDisable() */
 
 /*==============================================================================
@@ -213,22 +258,172 @@ void hal_extiDisable(en_targetExtInt_t e_extInt)
  =============================================================================*/
 void hal_delay_us(uint32_t l_delay)
 {
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    native_sim_delay(l_delay);
+#else
+    struct timespec tim = {0,0};
+
     tim.tv_nsec = l_delay*1000;
     nanosleep(&tim, NULL);
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+#if DEMO_USE_EXTIF
+    _extif_drain();
+#endif /* #if DEMO_USE_EXTIF */
 } /* hal_delay_us() */
+
+/*==============================================================================
+  hal_idle()
+ =============================================================================*/
+void hal_idle(uint32_t l_delay)
+{
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    /* jump to the next timer, the delay only matters in real time */
+    native_sim_idle();
+#if DEMO_USE_EXTIF
+    _extif_drain();
+#endif /* #if DEMO_USE_EXTIF */
+#elif DEMO_USE_EXTIF
+    struct epoll_event ev;
+
+    /* sleep until the pty has data, but not longer than asked for */
+    if( epoll_wait(epfd, &ev, 1, (l_delay + 999) / 1000) > 0 )
+    {
+        if( ev.events & (EPOLLHUP | EPOLLERR) )
+        {
+            /* as long as nobody holds the other side of the pty, epoll
+             * reports the hang-up at once, sleep as without the pty */
+            hal_delay_us(l_delay);
+        }
+        else
+        {
+            _extif_drain();
+        }
+    }
+#else
+    hal_delay_us(l_delay);
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+} /* hal_idle() */
+
+#if DEMO_USE_EXTIF
+/*==============================================================================
+  hal_extifWrite()
+ =============================================================================*/
+int16_t hal_extifWrite(const uint8_t *p_data, uint16_t len)
+{
+    struct pollfd pfd;
+    ssize_t ret;
+    uint16_t done = 0;
+
+    while( done < len )
+    {
+        ret = write(fdm, p_data + done, len - done);
+        if( ret > 0 )
+        {
+            done += ret;
+        }
+        else if( (ret < 0) && (errno != EAGAIN) && (errno != EINTR) )
+        {
+            break;
+        }
+        else
+        {
+            /* the pty is full, wait until the other side reads */
+            pfd.fd = fdm;
+            pfd.events = POLLOUT;
+            if( poll(&pfd, 1, EXTIF_TX_TIMEOUT) <= 0 )
+                break;
+        }
+    }
+    return done;
+} /* hal_extifWrite() */
+#endif /* #if DEMO_USE_EXTIF */
 /*==============================================================================
  hal_enterCritical()
  =============================================================================*/
 void hal_enterCritical(void)
 {
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    /* the emulated radio holds back its interrupts */
+    cc112x_emu_enterCritical();
+#else
     /* Not implemented */
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
 }
 /*==============================================================================
  hal_exitCritical()
  =============================================================================*/
 void hal_exitCritical(void)
 {
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    cc112x_emu_exitCritical();
+#else
+    /* Not implemented */
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
+}
+/*==============================================================================
+ hal_spiInit()
+ =============================================================================*/
+void *hal_spiInit(void)
+{
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    return cc112x_emu_init();
+#else
+    /* Not implemented */
+    return NULL;
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
+}
+/*==============================================================================
+ hal_spiSlaveSel()
+ =============================================================================*/
+uint8_t hal_spiSlaveSel(void *p_spi, bool enable)
+{
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    if( p_spi == NULL )
+    {
+        LOG_ERR("SPI was not initialized!");
+        return 0;
+    }
+    cc112x_emu_select(enable);
+    return 1;
+#else
     /* Not implemented */
+    return 0;
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
+}
+/*==============================================================================
+ hal_spiRead()
+ =============================================================================*/
+uint8_t hal_spiRead(uint8_t *p_reg, uint16_t i_length)
+{
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    cc112x_emu_transfer(NULL, p_reg, i_length);
+    return *p_reg;
+#else
+    /* Not implemented */
+    return 0;
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
+}
+/*==============================================================================
+ hal_spiWrite()
+ =============================================================================*/
+void hal_spiWrite(uint8_t *c_value, uint16_t i_length)
+{
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    cc112x_emu_transfer(c_value, NULL, i_length);
+#else
+    /* Not implemented */
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
+}
+/*==============================================================================
+ hal_spiTxRx()
+ =============================================================================*/
+void hal_spiTxRx(uint8_t *p_tx, uint8_t *p_rx, uint16_t len)
+{
+#if (NATIVE_CFG_CC112X_EMU_EN == TRUE)
+    cc112x_emu_transfer(p_tx, p_rx, len);
+#else
+    /* Not implemented */
+#endif /* NATIVE_CFG_CC112X_EMU_EN */
 }
 /*==============================================================================
  hal_ledOff()
@@ -252,7 +447,7 @@ void hal_ledOn(uint16_t ui_led)
 int8_t hal_init (void)
 {
 #if DEMO_USE_EXTIF
-    struct sigaction saio;
+    struct epoll_event ev;
     struct sigaction saint;
     const char *symlink_path;
 
@@ -270,16 +465,25 @@ int8_t hal_init (void)
         _printAndExit( "Error on unlockpt()" );
     }
 
-    saio.sa_handler = signal_handler_IO;
-    saio.sa_flags = 0;
-    saio.sa_restorer = NULL;
-    sigaction(SIGIO,&saio,NULL);
-
     memset(&saint, 0, sizeof(struct sigaction));
     saint.sa_handler = signal_handler_interrupt;
     sigaction(SIGINT ,&saint,NULL);
 
-    fcntl(fdm, F_SETFL, O_NDELAY | O_NONBLOCK | O_ASYNC);
+    fcntl(fdm, F_SETFL, O_NDELAY | O_NONBLOCK);
+
+    /* the pty is read from the main loop, see hal_idle() */
+    epfd = epoll_create1(0);
+    if( epfd < 0 )
+    {
+        _printAndExit( "Error on epoll_create1()" );
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fdm;
+    if( epoll_ctl(epfd, EPOLL_CTL_ADD, fdm, &ev) < 0 )
+    {
+        _printAndExit( "Error on epoll_ctl()" );
+    }
 
     symlink_path = "/dev/6lbr/if";
 
@@ -291,6 +495,10 @@ int8_t hal_init (void)
 
 #endif /* DEMO_USE_EXTIF */
 
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    native_sim_init();
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+
     return 1;
 }
 /*==============================================================================
@@ -319,10 +527,25 @@ void hal_watchdogStop(void)
  =============================================================================*/
 uint8_t hal_getrand(void)
 {
-    // We don't need special kind of seed or rand.
-    srand(time(NULL));
-    int r = rand();
-    return ((uint8_t) r);
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    /* runs must be reproducible */
+    return native_sim_getrand();
+#else
+    uint8_t r;
+    FILE *p_urandom;
+
+    p_urandom = fopen("/dev/urandom", "rb");
+    if ((p_urandom == NULL) || (fread(&r, 1, 1, p_urandom) != 1)) {
+        /* no entropy source, better than nothing */
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        r = (uint8_t)(tv.tv_usec ^ (tv.tv_usec >> 8) ^ getpid());
+    }
+    if (p_urandom != NULL) {
+        fclose(p_urandom);
+    }
+    return r;
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 }
 
 clock_time_t hal_getTRes(void)
@@ -334,9 +557,13 @@ clock_time_t hal_getTRes(void)
  =============================================================================*/
 uint32_t hal_getTick(void)
 {
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    return (uint32_t)(native_sim_now() / 1000);
+#else
     struct timeval tv;
     gettimeofday(&tv, NULL);
     return ((tv.tv_sec * 1000 + tv.tv_usec / 1000) & 0xffffffff);
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 } /* hal_getTick() */
 
 /*==============================================================================
@@ -344,9 +571,13 @@ uint32_t hal_getTick(void)
  =============================================================================*/
 uint32_t hal_getSec(void)
 {
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+    return (uint32_t)(native_sim_now() / 1000000);
+#else
     struct timeval tv;
     gettimeofday(&tv, NULL);
     return tv.tv_sec;
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
 } /* hal_getSec() */
 /** @} */
 /** @} */
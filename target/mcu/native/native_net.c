@@ -0,0 +1,192 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**
+ * \addtogroup linux
+ * @{
+ */
+/*============================================================================*/
+/*! \file   native_net.c
+
+ \brief  LCM network of the native target, see native_net.h.
+
+ \version 0.0.1
+ */
+/*============================================================================*/
+
+/*==============================================================================
+                                 INCLUDE FILES
+ ==============================================================================*/
+#include "native_net.h"
+#include "native_sim.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*==============================================================================
+                                    MACROS
+ ==============================================================================*/
+#define     LOGGER_ENABLE                 LOGGER_RADIO
+#include    "logger.h"
+
+/*==============================================================================
+                             LOCAL FUNCTION PROTOTYPES
+ ==============================================================================*/
+static void _printAndExit( const char* rpc_reason );
+
+/*==============================================================================
+                                 LOCAL FUNCTIONS
+ ==============================================================================*/
+static void _printAndExit( const char* rpc_reason )
+{
+    fputs( strerror( errno ), stderr );
+    fputs( ": ", stderr );
+    fputs( rpc_reason, stderr );
+    fputc( '\n', stderr );
+    exit( 1 );
+}
+
+/*==============================================================================
+                                 API FUNCTIONS
+ ==============================================================================*/
+void native_net_open(s_nativeNet_t *p_net, lcm_msg_handler_t pfn_rx,
+        void *p_user)
+{
+    FILE* fp;
+    char pc_node_info[NATIVE_NET_LINE_MAX];
+    char* pch;
+
+    uint16_t addr;    // mac address of node read from configuration file
+    uint8_t  addr_6;  // high byte of two last parts of mac address
+    uint8_t  addr_7;  // low byte of two last parts of mac address
+
+    memset( p_net, 0, sizeof(*p_net) );
+
+    /* Please refer to lcm_create() reference. Default parameter is taken
+     from there */
+    p_net->p_lcm = lcm_create( NULL );
+
+    if( !p_net->p_lcm )
+        _printAndExit("LCM init failed");
+
+    /* Read configuration file */
+    fp = fopen( LCM_NETWORK_CONF, "r" );
+
+    if( fp == NULL )
+    {
+        _printAndExit( "Can't open LCM network configuration file");
+    }
+
+    /* assemble the parser command */
+    while( !feof(fp) )
+    {
+        memset(pc_node_info, 0, NATIVE_NET_LINE_MAX);
+        fgets( pc_node_info, NATIVE_NET_LINE_MAX, fp );
+        if( pc_node_info[0] == '#' ) continue;
+
+        pch = strtok (pc_node_info," \t\n,");
+        if( pch == NULL ) continue;
+
+        /* get address */
+        sscanf( pch, "%hx", &addr );
+        p_net->nodeNum++;
+
+        /* split mac address read from the file into two parts */
+        addr_7 = (uint8_t)addr;
+        addr_6 = (uint8_t)(addr >> 8);
+
+        if( addr_6 != mac_phy_config.mac_address[6] ||
+            addr_7 != mac_phy_config.mac_address[7] )
+        {
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+            /* look for the power at which we hear this node */
+            while( (pch = strtok( NULL, " \t\n," )) != NULL )
+            {
+                uint16_t listener;
+                int rssi = NATIVE_SIM_RSSI_DEFAULT;
+
+                if( (sscanf( pch, "%hx/%d", &listener, &rssi ) >= 1) &&
+                    (listener == (((uint16_t)mac_phy_config.mac_address[6] << 8) |
+                                  mac_phy_config.mac_address[7])) )
+                {
+                    native_sim_setLink( addr, (int8_t)rssi );
+                }
+            }
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+            continue;
+        }
+        LOG1_INFO("addr=0x%04X", addr);
+        p_net->addr = addr;
+
+        /* read for the subscribe channel */
+        if ( pch != NULL )
+        {
+            int tmpChLen = strlen(pch) + 10;
+            char* tmpCh = malloc( tmpChLen );
+            if( tmpCh != NULL )
+            {
+                snprintf( tmpCh, tmpChLen, ".*_%s_.*", pch );
+                p_net->p_subscr = lcm_subscribe( p_net->p_lcm, tmpCh, pfn_rx, p_user );
+                LOG1_INFO("Subscription channel = %s", tmpCh);
+                free( tmpCh );
+            }
+            else
+            {
+                _printAndExit( "Can't create virtual channel.\n" );
+            }
+
+            pch = strtok ( NULL, " \t\n," );
+        }
+
+        /* read for the public channel */
+        while ( pch != NULL )
+        {
+            /* the received power is not part of the channel name */
+            pch[strcspn( pch, "/" )] = '\0';
+            snprintf( p_net->publishCh + strlen(p_net->publishCh),
+                    (NATIVE_NET_LINE_MAX-strlen(p_net->publishCh)), "_%s_", pch );
+            pch = strtok ( NULL, " \t\n," );
+        }
+        LOG1_INFO("Publication channel = %s", p_net->publishCh);
+    }
+
+    /* Close the file */
+    fclose(fp);
+} /* native_net_open() */
+/** @} */
@@ -0,0 +1,114 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**
+ * \addtogroup linux
+ * @{
+ */
+/*============================================================================*/
+/*! \file   native_net.h
+
+ \brief  LCM network of the native target.
+
+         The nodes of a native network and the way they hear each other are
+         described in LCM_NETWORK_CONF, one node per line:
+
+         <addr> <listener> [<listener> ...]
+
+         A node receives the frames published on channels naming its own
+         address and publishes on a channel naming all its listeners. A
+         listener written as <addr>/<dBm> hears the node at <dBm> in virtual
+         time, see native_sim.h.
+
+         The file is shared by the native radio driver and the emulated
+         transceivers.
+
+ \version 0.0.1
+ */
+/*============================================================================*/
+#ifndef NATIVE_NET_H_
+#define NATIVE_NET_H_
+
+/*==============================================================================
+                                 INCLUDE FILES
+ ==============================================================================*/
+#include "emb6.h"
+#include <lcm/lcm.h>
+
+/*==============================================================================
+                                    MACROS
+ ==============================================================================*/
+#ifndef LCM_NETWORK_CONF
+#define LCM_NETWORK_CONF                    "lcmnetwork.conf"
+#endif /*#ifndef LCM_NETWORK_CONF */
+
+/** Maximum length of a line of LCM_NETWORK_CONF and of the publish channel */
+#define NATIVE_NET_LINE_MAX                 2048
+
+/*==============================================================================
+                         STRUCTURES AND OTHER TYPEDEFS
+ ==============================================================================*/
+/** This node as described in LCM_NETWORK_CONF */
+typedef struct
+{
+    lcm_t *p_lcm;
+    lcm_subscription_t *p_subscr;
+    /** Address of this node */
+    uint16_t addr;
+    /** Number of nodes in the file */
+    uint16_t nodeNum;
+    /** Channels of all listeners */
+    char publishCh[NATIVE_NET_LINE_MAX];
+} s_nativeNet_t;
+
+/*==============================================================================
+                             FUNCTION PROTOTYPES
+ ==============================================================================*/
+/** \brief  Create the LCM instance and join the network of LCM_NETWORK_CONF
+ *          under the address taken from mac_phy_config. Exits on errors.
+ *
+ *  \param  p_net       Returns the description of this node
+ *  \param  pfn_rx      Handler of the messages on the subscribe channel
+ *  \param  p_user      Argument of the handler
+ */
+void native_net_open(s_nativeNet_t *p_net, lcm_msg_handler_t pfn_rx,
+        void *p_user);
+
+#endif /* NATIVE_NET_H_ */
+/** @} */
@@ -0,0 +1,845 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**
+ * \addtogroup linux
+ * @{
+ */
+/*============================================================================*/
+/*! \file   native_sim.c
+
+ \brief  Virtual time and radio medium for the native target, see
+         native_sim.h.
+
+ \version 0.0.1
+ */
+/*============================================================================*/
+
+/*==============================================================================
+                                 INCLUDE FILES
+ ==============================================================================*/
+#include "native_sim.h"
+
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+#include "etimer.h"
+#include "rt_tmr.h"
+#include "packetbuf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+/*==============================================================================
+                                    MACROS
+ ==============================================================================*/
+#define     LOGGER_ENABLE                 LOGGER_RADIO
+#include    "logger.h"
+
+#define NATIVE_SIM_TIME_NEVER               UINT64_MAX
+
+/* frame header: start of the frame, delivery time, sender */
+#define NATIVE_SIM_HDR_LEN                  18
+/* round message: round, sender, next event */
+#define NATIVE_SIM_MSG_LEN                  14
+
+/* range of the bit error table */
+#define NATIVE_SIM_SINR_MIN                 (-4)
+#define NATIVE_SIM_SINR_MAX                 3
+
+/*==============================================================================
+                                     ENUMS
+ ==============================================================================*/
+/* fate of a frame at this node, decided while it is on the air */
+typedef enum
+{
+    E_NATIVE_SIM_RX_OK,         /* receiver locked on the frame */
+    E_NATIVE_SIM_RX_MISSED,     /* receiver was off or transmitting */
+    E_NATIVE_SIM_RX_LOCKED,     /* receiver locked on an earlier frame */
+} e_nativeSimRx_t;
+
+/*==============================================================================
+                         STRUCTURES AND OTHER TYPEDEFS
+ ==============================================================================*/
+typedef struct
+{
+    uint64_t start;
+    uint64_t time;
+    uint16_t src;
+    uint16_t len;
+    int8_t   rssi;
+    int8_t   intf;              /* strongest overlapping frame */
+    uint8_t  status;
+    uint8_t  data[PACKETBUF_SIZE];
+} s_nativeSimFrame_t;
+
+/* a sender this node hears */
+typedef struct
+{
+    uint16_t addr;
+    uint8_t  isUsed;
+    int8_t   rssi;
+    uint32_t ok;
+    uint32_t collision;
+    uint32_t error;
+    uint32_t missed;
+} s_nativeSimLink_t;
+
+/* Round messages of a node. Nodes are at most one round apart, one slot
+ * per round parity is enough */
+typedef struct
+{
+    uint16_t addr;
+    uint8_t  isValid[2];
+    uint32_t round[2];
+    uint64_t next[2];
+} s_nativeSimNode_t;
+
+/*==============================================================================
+                             VARIABLE DECLARATIONS
+ ==============================================================================*/
+static lcm_t *ps_simLcm;
+static pfn_nativeSimRx_t pfn_simRx;
+static uint16_t sim_addr;
+static uint16_t sim_nodeNum;
+
+static uint64_t sim_now;
+static uint64_t sim_grant;
+static uint64_t sim_end;
+static uint64_t sim_txNext;
+static uint32_t sim_round;
+static uint8_t  sim_isStarted;
+static uint64_t sim_rand;
+static uint64_t sim_perRand;
+
+static uint8_t  sim_rxOn;
+static uint64_t sim_txStart;
+static uint64_t sim_txEnd;
+static uint32_t sim_txNum;
+static uint64_t sim_txAirtime;
+static s_nativeSimLink_t sim_links[NATIVE_SIM_NODES_MAX];
+
+static s_nativeSimNode_t sim_nodes[NATIVE_SIM_NODES_MAX];
+static s_nativeSimFrame_t sim_rxq[NATIVE_SIM_RXQ_SIZE];
+static uint8_t sim_rxqLen;
+
+/* bit error rate of the 802.15.4 O-QPSK PHY from NATIVE_SIM_SINR_MIN to
+ * NATIVE_SIM_SINR_MAX dB, IEEE 802.15.4-2011 annex E */
+static const double sim_berTab[] = {
+    3.916e-02, 1.642e-02, 5.197e-03, 1.149e-03,
+    1.615e-04, 1.291e-05, 5.131e-07, 8.597e-09
+};
+
+/*==============================================================================
+                             LOCAL FUNCTION PROTOTYPES
+ ==============================================================================*/
+static void _sim_put(uint8_t *p_buf, uint64_t val, uint8_t len);
+static uint64_t _sim_get(const uint8_t *p_buf, uint8_t len);
+static uint64_t _sim_realMs(void);
+static uint64_t _sim_splitmix(uint64_t *p_state);
+static s_nativeSimLink_t *_sim_getLink(uint16_t addr);
+static uint8_t _sim_isReceived(const s_nativeSimFrame_t *p_frame);
+static void _sim_miss(uint64_t start, uint64_t end);
+static void _sim_detect(uint64_t time);
+static void _sim_printStats(void);
+static void _sim_publishRound(uint64_t next);
+static void _sim_onRound(const lcm_recv_buf_t *rps_rbuf,
+        const char *rpc_channel, void *p_user);
+static uint8_t _sim_isRoundComplete(uint64_t *p_next);
+static void _sim_sync(uint64_t next);
+static void _sim_setTime(uint64_t time);
+static uint8_t _sim_deliver(void);
+static void _sim_advance(uint64_t target, uint8_t is_idle);
+
+/*==============================================================================
+                                 LOCAL FUNCTIONS
+ ==============================================================================*/
+/* little endian helpers for the messages exchanged between nodes */
+static void _sim_put(uint8_t *p_buf, uint64_t val, uint8_t len)
+{
+    uint8_t i;
+    for (i = 0; i < len; i++) {
+        p_buf[i] = (uint8_t)(val >> (8 * i));
+    }
+}
+
+static uint64_t _sim_get(const uint8_t *p_buf, uint8_t len)
+{
+    uint64_t val = 0;
+    while (len--) {
+        val = (val << 8) | p_buf[len];
+    }
+    return val;
+}
+
+static uint64_t _sim_realMs(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static uint64_t _sim_splitmix(uint64_t *p_state)
+{
+    uint64_t z;
+
+    z = (*p_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Find a sender, links heard for the first time get the default
+ *          received power
+ */
+/*----------------------------------------------------------------------------*/
+static s_nativeSimLink_t *_sim_getLink(uint16_t addr)
+{
+    uint8_t i;
+
+    for (i = 0; i < NATIVE_SIM_NODES_MAX; i++) {
+        if (sim_links[i].isUsed == 0) {
+            sim_links[i].isUsed = 1;
+            sim_links[i].addr = addr;
+            sim_links[i].rssi = NATIVE_SIM_RSSI_DEFAULT;
+            return &sim_links[i];
+        }
+        if (sim_links[i].addr == addr) {
+            return &sim_links[i];
+        }
+    }
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Decide whether a frame the receiver locked on is received
+ *          without bit errors
+ */
+/*----------------------------------------------------------------------------*/
+static uint8_t _sim_isReceived(const s_nativeSimFrame_t *p_frame)
+{
+    int16_t sinr;
+    uint32_t bits;
+    double ok;
+    double pow;
+
+    /* the strongest interferer stands for the sum of all of them */
+    sinr = p_frame->rssi - ((p_frame->intf > NATIVE_SIM_NOISE_DBM) ?
+                            p_frame->intf : NATIVE_SIM_NOISE_DBM);
+    if (sinr < NATIVE_SIM_SINR_MIN) {
+        return 0;
+    }
+    if (sinr > NATIVE_SIM_SINR_MAX) {
+        return 1;
+    }
+
+    /* probability of the frame without bit error, (1 - ber) ^ bits */
+    ok = 1.0;
+    pow = 1.0 - sim_berTab[sinr - NATIVE_SIM_SINR_MIN];
+    for (bits = (uint32_t)p_frame->len * 8; bits != 0; bits >>= 1) {
+        if (bits & 1) {
+            ok *= pow;
+        }
+        pow *= pow;
+    }
+    return (_sim_splitmix(&sim_perRand) >> 11) * (1.0 / 9007199254740992.0) < ok;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  The receiver is busy or off, frames on the air meanwhile are lost
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_miss(uint64_t start, uint64_t end)
+{
+    uint8_t i;
+
+    for (i = 0; i < sim_rxqLen; i++) {
+        if ((sim_rxq[i].start < end) && (sim_rxq[i].time > start)) {
+            sim_rxq[i].status = E_NATIVE_SIM_RX_MISSED;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  A receiver detects a frame just after it started, frames which
+ *          start before the clock moves on to time are missed if the
+ *          receiver is off by then. Switching the receiver at the very
+ *          instant a frame starts does therefore not depend on the order in
+ *          which frames and switches come in.
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_detect(uint64_t time)
+{
+    uint8_t i;
+
+    if (sim_rxOn) {
+        return;
+    }
+    for (i = 0; i < sim_rxqLen; i++) {
+        if ((sim_rxq[i].start >= sim_now) && (sim_rxq[i].start < time)) {
+            sim_rxq[i].status = E_NATIVE_SIM_RX_MISSED;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Export the statistics of all links heard by this node
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_printStats(void)
+{
+    const char *pc_env;
+    FILE *fp = stdout;
+    uint8_t i;
+
+    pc_env = getenv(NATIVE_SIM_STATS_ENV);
+    if (pc_env != NULL) {
+        fp = fopen(pc_env, "a");
+        if (fp == NULL) {
+            LOG_ERR("sim: can't open %s", pc_env);
+            return;
+        }
+    }
+
+    fprintf(fp, "node,%04x,%llu,%lu,%llu\n", sim_addr,
+            (unsigned long long)sim_now, (unsigned long)sim_txNum,
+            (unsigned long long)sim_txAirtime);
+    for (i = 0; (i < NATIVE_SIM_NODES_MAX) && sim_links[i].isUsed; i++) {
+        fprintf(fp, "link,%04x,%04x,%d,%lu,%lu,%lu,%lu\n",
+                sim_links[i].addr, sim_addr, sim_links[i].rssi,
+                (unsigned long)sim_links[i].ok,
+                (unsigned long)sim_links[i].collision,
+                (unsigned long)sim_links[i].error,
+                (unsigned long)sim_links[i].missed);
+    }
+
+    if (fp != stdout) {
+        fclose(fp);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Tell the other nodes when this node has something to do next
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_publishRound(uint64_t next)
+{
+    uint8_t msg[NATIVE_SIM_MSG_LEN];
+
+    _sim_put(&msg[0], sim_round, 4);
+    _sim_put(&msg[4], sim_addr, 2);
+    _sim_put(&msg[6], next, 8);
+    lcm_publish(ps_simLcm, NATIVE_SIM_CHANNEL, msg, sizeof(msg));
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Store the round message of a node, our own ones included
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_onRound(const lcm_recv_buf_t *rps_rbuf,
+        const char *rpc_channel, void *p_user)
+{
+    const uint8_t *p_msg = rps_rbuf->data;
+    uint16_t addr;
+    uint32_t round;
+    uint8_t i;
+    uint8_t free_idx = NATIVE_SIM_NODES_MAX;
+
+    if (rps_rbuf->data_size != NATIVE_SIM_MSG_LEN) {
+        return;
+    }
+
+    round = (uint32_t)_sim_get(&p_msg[0], 4);
+    addr = (uint16_t)_sim_get(&p_msg[4], 2);
+    for (i = 0; i < NATIVE_SIM_NODES_MAX; i++) {
+        if (sim_nodes[i].isValid[0] || sim_nodes[i].isValid[1]) {
+            if (sim_nodes[i].addr == addr) {
+                break;
+            }
+        } else if (free_idx == NATIVE_SIM_NODES_MAX) {
+            free_idx = i;
+        }
+    }
+    if (i == NATIVE_SIM_NODES_MAX) {
+        if (free_idx == NATIVE_SIM_NODES_MAX) {
+            LOG_ERR("too many simulated nodes");
+            return;
+        }
+        i = free_idx;
+        sim_nodes[i].addr = addr;
+    }
+
+    sim_nodes[i].isValid[round & 1] = 1;
+    sim_nodes[i].round[round & 1] = round;
+    sim_nodes[i].next[round & 1] = _sim_get(&p_msg[6], 8);
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Check whether all nodes finished the current round
+ *
+ *  \param  p_next      Returns the earliest next event of all nodes
+ */
+/*----------------------------------------------------------------------------*/
+static uint8_t _sim_isRoundComplete(uint64_t *p_next)
+{
+    uint8_t i;
+    uint8_t slot = sim_round & 1;
+    uint16_t done = 0;
+    uint64_t next = NATIVE_SIM_TIME_NEVER;
+
+    for (i = 0; i < NATIVE_SIM_NODES_MAX; i++) {
+        if (sim_nodes[i].isValid[slot] &&
+            (sim_nodes[i].round[slot] == sim_round)) {
+            done++;
+            if (sim_nodes[i].next[slot] < next) {
+                next = sim_nodes[i].next[slot];
+            }
+        } else if ((sim_round == 0) &&
+                   (sim_nodes[i].isValid[0] || sim_nodes[i].isValid[1])) {
+            /* the start-up barrier, a node that moved on has passed it */
+            done++;
+        }
+    }
+    *p_next = next;
+    return done >= sim_nodeNum;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Finish a round and wait for the new global time
+ *
+ *  \param  next    Next event of this node
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_sync(uint64_t next)
+{
+    int fd;
+    fd_set fds;
+    struct timeval tv;
+    uint64_t sent_ms;
+    uint64_t warn_ms;
+    uint64_t global_next;
+
+    /* our frames are published before this message, listeners have them
+     * queued by the time the round completes */
+    if (sim_txNext < next) {
+        next = sim_txNext;
+    }
+    sim_txNext = NATIVE_SIM_TIME_NEVER;
+
+    _sim_publishRound(next);
+    sent_ms = _sim_realMs();
+    warn_ms = sent_ms;
+    fd = lcm_get_fileno(ps_simLcm);
+
+    while (!_sim_isRoundComplete(&global_next)) {
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        tv.tv_sec = 0;
+        tv.tv_usec = NATIVE_SIM_REPEAT_MS * 1000;
+        if (select(fd + 1, &fds, NULL, NULL, &tv) > 0) {
+            lcm_handle(ps_simLcm);
+        }
+
+        /* nodes starting late or lost messages, say it again */
+        if (_sim_realMs() - sent_ms >= NATIVE_SIM_REPEAT_MS) {
+            _sim_publishRound(next);
+            sent_ms = _sim_realMs();
+        }
+        if (_sim_realMs() - warn_ms >= 5000) {
+            LOG_INFO("sim: round %u waits for other nodes", sim_round);
+            warn_ms = _sim_realMs();
+        }
+    }
+
+    if (global_next == NATIVE_SIM_TIME_NEVER) {
+        LOG_INFO("sim: no node has anything left to do, exit");
+        exit(0);
+    }
+
+    sim_grant = global_next;
+    sim_round++;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Move the clock, rt_tmr ticks elapse on the way
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_setTime(uint64_t time)
+{
+    uint64_t ticks;
+
+    _sim_detect(time);
+    ticks = time / 1000 - sim_now / 1000;
+    sim_now = time;
+    if (pTmrListHead == NULL) {
+        TmrCurTick += (rt_tmr_tick_t)ticks;
+    } else {
+        while (ticks--) {
+            rt_tmr_update();
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Hand the frames whose time has come to the radio driver
+ *
+ *  \return Number of frames delivered
+ */
+/*----------------------------------------------------------------------------*/
+static uint8_t _sim_deliver(void)
+{
+    static s_nativeSimFrame_t frame;
+    s_nativeSimLink_t *p_link;
+    uint8_t num = 0;
+
+    while ((sim_rxqLen > 0) && (sim_rxq[0].time <= sim_now)) {
+        /* the driver may queue frames again while handling this one */
+        memcpy(&frame, &sim_rxq[0], sizeof(frame));
+        sim_rxqLen--;
+        memmove(&sim_rxq[0], &sim_rxq[1], sim_rxqLen * sizeof(sim_rxq[0]));
+
+        p_link = _sim_getLink(frame.src);
+        if (frame.status == E_NATIVE_SIM_RX_MISSED) {
+            p_link->missed++;
+        } else if (frame.status == E_NATIVE_SIM_RX_LOCKED) {
+            p_link->collision++;
+        } else if (_sim_isReceived(&frame) == 0) {
+            if (frame.intf > NATIVE_SIM_NOISE_DBM) {
+                p_link->collision++;
+            } else {
+                p_link->error++;
+            }
+        } else {
+            p_link->ok++;
+            if (pfn_simRx != NULL) {
+                pfn_simRx(frame.data, frame.len, frame.rssi);
+            }
+            num++;
+        }
+    }
+    return num;
+}
+
+/*----------------------------------------------------------------------------*/
+/** \brief  Advance the clock up to a given time
+ *
+ *  \param  target      Time to reach
+ *  \param  is_idle     Return early once a frame was delivered
+ */
+/*----------------------------------------------------------------------------*/
+static void _sim_advance(uint64_t target, uint8_t is_idle)
+{
+    uint64_t next;
+
+    if (sim_isStarted == 0) {
+        /* the clock only starts with the simulation */
+        return;
+    }
+
+    if (target > sim_end) {
+        target = sim_end;
+    }
+
+    while (sim_now < target) {
+        next = target;
+        if ((sim_rxqLen > 0) && (sim_rxq[0].time < next)) {
+            next = sim_rxq[0].time;
+        }
+
+        if (sim_now >= sim_grant) {
+            _sim_sync(next);
+            continue;
+        }
+
+        _sim_setTime((next < sim_grant) ? next : sim_grant);
+        if (_sim_deliver() && is_idle) {
+            return;
+        }
+    }
+
+    if (sim_now >= sim_end) {
+        LOG_INFO("sim: end of simulation reached, exit");
+        exit(0);
+    }
+}
+
+/*==============================================================================
+                                 API FUNCTIONS
+ ==============================================================================*/
+void native_sim_init(void)
+{
+    const char *pc_env;
+
+    sim_now = 0;
+    sim_grant = 0;
+    sim_round = 0;
+    sim_rxqLen = 0;
+    sim_isStarted = 0;
+    sim_txNext = NATIVE_SIM_TIME_NEVER;
+    sim_rxOn = 1;
+    sim_txStart = 0;
+    sim_txEnd = 0;
+    sim_txNum = 0;
+    sim_txAirtime = 0;
+    memset(sim_nodes, 0, sizeof(sim_nodes));
+    memset(sim_links, 0, sizeof(sim_links));
+
+    pc_env = getenv(NATIVE_SIM_SEED_ENV);
+    sim_rand = (pc_env != NULL) ? strtoull(pc_env, NULL, 0) : 0;
+
+    pc_env = getenv(NATIVE_SIM_END_ENV);
+    sim_end = (pc_env != NULL) ? strtoull(pc_env, NULL, 0) * 1000000 :
+                                 NATIVE_SIM_TIME_NEVER;
+}
+
+void native_sim_start(lcm_t *p_lcm, uint16_t addr, uint16_t nodes,
+        pfn_nativeSimRx_t pfn_rx)
+{
+    ps_simLcm = p_lcm;
+    sim_addr = addr;
+    sim_nodeNum = nodes;
+    pfn_simRx = pfn_rx;
+    lcm_subscribe(ps_simLcm, NATIVE_SIM_CHANNEL, _sim_onRound, NULL);
+
+    /* bit errors differ from node to node but not from run to run */
+    sim_perRand = sim_rand ^ ((uint64_t)addr << 32);
+    atexit(_sim_printStats);
+
+    /* everybody starts at time 0 */
+    LOG1_INFO("sim: waiting for %u nodes", nodes);
+    sim_isStarted = 1;
+    _sim_sync(0);
+    LOG1_OK("sim: started");
+}
+
+void native_sim_setLink(uint16_t src, int8_t rssi)
+{
+    s_nativeSimLink_t *p_link;
+
+    p_link = _sim_getLink(src);
+    if (p_link != NULL) {
+        p_link->rssi = rssi;
+    }
+}
+
+void native_sim_setRx(uint8_t is_on)
+{
+    if (sim_rxOn && !is_on) {
+        /* frames detected before are cut off, frames starting right now
+         * are not detected any more, see _sim_detect() */
+        _sim_miss(sim_now, sim_now);
+    }
+    sim_rxOn = is_on;
+}
+
+uint8_t native_sim_isChannelBusy(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < sim_rxqLen; i++) {
+        /* a frame starting right now is not detected yet */
+        if ((sim_rxq[i].start < sim_now) && (sim_rxq[i].time > sim_now) &&
+            (sim_rxq[i].rssi >= NATIVE_SIM_CCA_DBM)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t native_sim_now(void)
+{
+    return sim_now;
+}
+
+void native_sim_delay(uint32_t us)
+{
+    _sim_advance(sim_now + us, FALSE);
+}
+
+void native_sim_idle(void)
+{
+    uint64_t target = NATIVE_SIM_TIME_NEVER;
+    uint64_t now_ms = sim_now / 1000;
+    clock_time_t exp;
+    int32_t rel;
+
+    /* next etimer, clock ticks are milliseconds */
+    exp = etimer_nextEvent();
+    if (exp != TMR_NOT_ACTIVE) {
+        rel = (int32_t)(exp - (clock_time_t)now_ms);
+        target = (now_ms + ((rel > 0) ? rel : 0)) * 1000;
+    }
+
+    /* next rt_tmr */
+    if (pTmrListHead != NULL) {
+        rel = (int32_t)(pTmrListHead->counter - TmrCurTick);
+        if ((now_ms + ((rel > 0) ? rel : 0)) * 1000 < target) {
+            target = (now_ms + ((rel > 0) ? rel : 0)) * 1000;
+        }
+    }
+
+    /* always move on, an expired timer is handled after this */
+    if (target <= sim_now) {
+        target = sim_now + 1;
+    }
+    _sim_advance(target, TRUE);
+}
+
+uint8_t native_sim_getrand(void)
+{
+    return (uint8_t)(_sim_splitmix(&sim_rand) >> 56);
+}
+
+int native_sim_send(const char *pc_channel, const uint8_t *p_data,
+        uint16_t len, uint32_t airtime_us)
+{
+    uint8_t buf[NATIVE_SIM_HDR_LEN + PACKETBUF_SIZE];
+    uint64_t time;
+    int ret;
+
+    if (len > PACKETBUF_SIZE) {
+        return -1;
+    }
+
+    time = sim_now + (airtime_us ? airtime_us : 1);
+    _sim_put(&buf[0], sim_now, 8);
+    _sim_put(&buf[8], time, 8);
+    _sim_put(&buf[16], sim_addr, 2);
+    memcpy(&buf[NATIVE_SIM_HDR_LEN], p_data, len);
+    if (time < sim_txNext) {
+        sim_txNext = time;
+    }
+
+    /* half duplex, nothing is received while transmitting */
+    sim_txStart = sim_now;
+    sim_txEnd = time;
+    _sim_miss(sim_txStart, sim_txEnd);
+    sim_txNum++;
+    sim_txAirtime += time - sim_now;
+
+    ret = lcm_publish(ps_simLcm, pc_channel, buf, NATIVE_SIM_HDR_LEN + len);
+
+    /* the radio is busy until the frame is out */
+    _sim_advance(sim_txEnd, FALSE);
+    return ret;
+}
+
+void native_sim_recv(const uint8_t *p_data, uint32_t len)
+{
+    uint64_t start;
+    uint64_t time;
+    uint16_t src;
+    uint8_t status = E_NATIVE_SIM_RX_OK;
+    int8_t rssi;
+    int8_t intf = INT8_MIN;
+    s_nativeSimLink_t *p_link;
+    uint8_t i;
+
+    if ((len <= NATIVE_SIM_HDR_LEN) ||
+        (len - NATIVE_SIM_HDR_LEN > PACKETBUF_SIZE)) {
+        return;
+    }
+    start = _sim_get(&p_data[0], 8);
+    time = _sim_get(&p_data[8], 8);
+    src = (uint16_t)_sim_get(&p_data[16], 2);
+
+    p_link = _sim_getLink(src);
+    if (p_link == NULL) {
+        return;
+    }
+    if (sim_rxqLen >= NATIVE_SIM_RXQ_SIZE) {
+        LOG_ERR("sim: RX queue full, frame dropped");
+        p_link->missed++;
+        return;
+    }
+    rssi = p_link->rssi;
+
+    /* whether the receiver is on when a frame starts from now on is only
+     * known once the clock moves past its start, see _sim_detect() */
+    if ((!sim_rxOn && (start < sim_now)) ||
+        ((start < sim_txEnd) && (time > sim_txStart))) {
+        status = E_NATIVE_SIM_RX_MISSED;
+    }
+
+    /* frames on the air at the same time interfere, the receiver stays
+     * locked on the frame it detected first */
+    for (i = 0; i < sim_rxqLen; i++) {
+        if ((sim_rxq[i].start >= time) || (sim_rxq[i].time <= start)) {
+            continue;
+        }
+        if (sim_rxq[i].intf < rssi) {
+            sim_rxq[i].intf = rssi;
+        }
+        if (intf < sim_rxq[i].rssi) {
+            intf = sim_rxq[i].rssi;
+        }
+        if ((sim_rxq[i].start < start) &&
+            (sim_rxq[i].status == E_NATIVE_SIM_RX_OK) &&
+            (sim_rxq[i].rssi >= NATIVE_SIM_NOISE_DBM) &&
+            (status == E_NATIVE_SIM_RX_OK)) {
+            status = E_NATIVE_SIM_RX_LOCKED;
+        } else if ((start < sim_rxq[i].start) &&
+                   (sim_rxq[i].status == E_NATIVE_SIM_RX_OK) &&
+                   (rssi >= NATIVE_SIM_NOISE_DBM) &&
+                   (status == E_NATIVE_SIM_RX_OK)) {
+            sim_rxq[i].status = E_NATIVE_SIM_RX_LOCKED;
+        }
+    }
+
+    /* keep the queue ordered by time, then by sender */
+    for (i = sim_rxqLen; i > 0; i--) {
+        if ((sim_rxq[i - 1].time < time) ||
+            ((sim_rxq[i - 1].time == time) && (sim_rxq[i - 1].src <= src))) {
+            break;
+        }
+        sim_rxq[i] = sim_rxq[i - 1];
+    }
+    sim_rxq[i].start = start;
+    sim_rxq[i].time = time;
+    sim_rxq[i].src = src;
+    sim_rxq[i].rssi = rssi;
+    sim_rxq[i].intf = intf;
+    sim_rxq[i].status = status;
+    sim_rxq[i].len = (uint16_t)(len - NATIVE_SIM_HDR_LEN);
+    memcpy(sim_rxq[i].data, &p_data[NATIVE_SIM_HDR_LEN], sim_rxq[i].len);
+    sim_rxqLen++;
+}
+
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+/** @} */
@@ -0,0 +1,209 @@
+/*
+ * emb6 is licensed under the 3-clause BSD license. This license gives everyone
+ * the right to use and distribute the code, either in binary or source code
+ * format, as long as the copyright license is retained in the source code.
+ *
+ * The emb6 is derived from the Contiki OS platform with the explicit approval
+ * from Adam Dunkels. However, emb6 is made independent from the OS through the
+ * removal of protothreads. In addition, APIs are made more flexible to gain
+ * more adaptivity during run-time.
+ *
+ * The license text is:
+ *
+ * Copyright (c) 2015,
+ * Hochschule Offenburg, University of Applied Sciences
+ * Laboratory Embedded Systems and Communications Electronics.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**
+ * \addtogroup linux
+ * @{
+ */
+/*============================================================================*/
+/*! \file   native_sim.h
+
+ \brief  Virtual time and radio medium for the native target.
+
+         With NATIVE_CFG_VIRTUAL_TIME_EN the native nodes no longer follow the
+         wall clock. Every node keeps a virtual clock in microseconds, and all
+         nodes listed in LCM_NETWORK_CONF advance it in lockstep rounds over
+         the LCM channel NATIVE_SIM_CHANNEL:
+
+         - at the end of a round every node publishes the time of its next
+           local event (timer, end of a busy wait, frame delivery) together
+           with the delivery time of the frames it sent during the round.
+         - once a node has the messages of all nodes for the round, the
+           minimum of these times becomes the new global time.
+
+         Idle nodes therefore jump straight to the next pending event of the
+         whole network. Frames carry their delivery time and are handed to
+         the PHY in (time, sender) order, so a run only depends on the seed
+         taken from the environment variable NATIVE_SIM_SEED_ENV.
+
+         All nodes of the configuration must be started, the simulation
+         stops at the time given by NATIVE_SIM_END_ENV (seconds) or when no
+         node has anything left to do.
+
+         The medium follows the usual half-duplex radio model:
+
+         - a frame occupies the channel for its airtime, the sender is
+           blocked meanwhile and clear channel assessment at the listeners
+           reports the channel busy when the frame is above
+           NATIVE_SIM_CCA_DBM.
+         - frames starting while the radio is off or transmitting are lost.
+           A frame is only detected just after the microsecond it starts
+           in, CCA and switching the radio at that very instant do not see
+           it yet, whatever order the nodes act in.
+         - a receiver locks on the first frame it detects, frames starting
+           later are lost. The locked frame survives overlapping ones if its
+           signal to interference and noise ratio is high enough (capture).
+         - the packet error rate follows the bit error rate of the 802.15.4
+           O-QPSK PHY for this ratio and the length of the frame.
+
+         The received power of every link is taken from LCM_NETWORK_CONF,
+         a listener written as <addr>/<dBm> hears the sender at <dBm>.
+         The statistics of all links are appended to the file given by
+         NATIVE_SIM_STATS_ENV when the node exits, one line per node and per
+         link heard by it:
+
+         node,<addr>,<time us>,<frames sent>,<airtime us>
+         link,<src>,<dst>,<dBm>,<ok>,<collision>,<error>,<missed>
+
+ \version 0.0.1
+ */
+/*============================================================================*/
+#ifndef NATIVE_SIM_H_
+#define NATIVE_SIM_H_
+
+/*==============================================================================
+                                 INCLUDE FILES
+ ==============================================================================*/
+#include "emb6.h"
+
+/*==============================================================================
+                                    MACROS
+ ==============================================================================*/
+/** Run the native target in virtual time */
+#ifndef NATIVE_CFG_VIRTUAL_TIME_EN
+#define NATIVE_CFG_VIRTUAL_TIME_EN          FALSE
+#endif
+
+/** Received power of links without a configured value, in dBm */
+#ifndef NATIVE_SIM_RSSI_DEFAULT
+#define NATIVE_SIM_RSSI_DEFAULT             (-60)
+#endif
+
+#if (NATIVE_CFG_VIRTUAL_TIME_EN == TRUE)
+#include <lcm/lcm.h>
+
+/** LCM channel used for the synchronization rounds */
+#define NATIVE_SIM_CHANNEL                  "EMB6SIM"
+/** Environment variable holding the seed of the simulation */
+#define NATIVE_SIM_SEED_ENV                 "EMB6_SIM_SEED"
+/** Environment variable holding the simulated time in seconds */
+#define NATIVE_SIM_END_ENV                  "EMB6_SIM_END"
+/** Environment variable holding the file the link statistics go to */
+#define NATIVE_SIM_STATS_ENV                "EMB6_SIM_STATS"
+/** Maximum number of nodes in a simulation */
+#define NATIVE_SIM_NODES_MAX                64
+/** Number of received frames waiting for their delivery time */
+#define NATIVE_SIM_RXQ_SIZE                 16
+/** Real time in milliseconds after which a round message is repeated */
+#define NATIVE_SIM_REPEAT_MS                100
+
+/** Noise floor of the receivers in dBm */
+#ifndef NATIVE_SIM_NOISE_DBM
+#define NATIVE_SIM_NOISE_DBM                (-100)
+#endif
+/** Energy above which clear channel assessment reports a busy channel */
+#ifndef NATIVE_SIM_CCA_DBM
+#define NATIVE_SIM_CCA_DBM                  (-85)
+#endif
+
+/*==============================================================================
+                         STRUCTURES AND OTHER TYPEDEFS
+ ==============================================================================*/
+/** Hands a frame to the radio driver once its delivery time is reached */
+typedef void (*pfn_nativeSimRx_t)(uint8_t *p_data, uint16_t len, int8_t rssi);
+
+/*==============================================================================
+                             FUNCTION PROTOTYPES
+ ==============================================================================*/
+/** \brief  Reset the virtual clock, called by hal_init() */
+void native_sim_init(void);
+
+/** \brief  Join the simulation, the clock stands still until then
+ *
+ *  \param  p_lcm       LCM instance also used for the frames
+ *  \param  addr        Address of this node in LCM_NETWORK_CONF
+ *  \param  nodes       Number of nodes in LCM_NETWORK_CONF
+ *  \param  pfn_rx      Frame delivery function of the radio driver
+ */
+void native_sim_start(lcm_t *p_lcm, uint16_t addr, uint16_t nodes,
+        pfn_nativeSimRx_t pfn_rx);
+
+/** \brief  Set the power at which this node hears a sender
+ *
+ *  \param  src         Address of the sender in LCM_NETWORK_CONF
+ *  \param  rssi        Received power in dBm
+ */
+void native_sim_setLink(uint16_t src, int8_t rssi);
+
+/** \brief  Turn the receiver on or off */
+void native_sim_setRx(uint8_t is_on);
+
+/** \brief  Clear channel assessment
+ *
+ *  \return 1 when a neighbour is transmitting, 0 otherwise
+ */
+uint8_t native_sim_isChannelBusy(void);
+
+/** \brief  Virtual time in microseconds */
+uint64_t native_sim_now(void);
+
+/** \brief  Busy wait, frames reaching the node meanwhile are delivered */
+void native_sim_delay(uint32_t us);
+
+/** \brief  Nothing to do, advance to the next event of this node */
+void native_sim_idle(void);
+
+/** \brief  Entropy source derived from the seed of the simulation */
+uint8_t native_sim_getrand(void);
+
+/** \brief  Publish a frame, delivered to the listeners after airtime_us.
+ *          Returns at the end of the transmission
+ *
+ *  \return 0 on success, -1 otherwise
+ */
+int native_sim_send(const char *pc_channel, const uint8_t *p_data,
+        uint16_t len, uint32_t airtime_us);
+
+/** \brief  Queue a frame published by native_sim_send() on another node */
+void native_sim_recv(const uint8_t *p_data, uint32_t len);
+
+#endif /* NATIVE_CFG_VIRTUAL_TIME_EN */
+
+#endif /* NATIVE_SIM_H_ */
+/** @} */
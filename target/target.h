@@ -211,6 +211,29 @@ void hal_extiDisable(en_targetExtInt_t e_extInt);
 /*============================================================================*/
 void hal_delay_us(uint32_t i_delay);
 
+/*============================================================================*/
+/** \brief  This function waits until the next timer or interrupt, it is only
+ *          needed by targets defining HAL_SUPPORT_IDLE
+ *
+ *  \param  i_delay Delay the target would wait otherwise, in micro seconds
+ *
+ *  \retval    none
+ */
+/*============================================================================*/
+void hal_idle(uint32_t i_delay);
+
+/*============================================================================*/
+/** \brief  This function writes a block to the external interface, it is
+ *          only needed by targets defining SLIP_CONF_WRITE
+ *
+ *  \param  p_data  Pointer to the data
+ *  \param  len     Number of bytes to write
+ *
+ *  \return Number of bytes written
+ */
+/*============================================================================*/
+int16_t hal_extifWrite(const uint8_t *p_data, uint16_t len);
+
 /*============================================================================*/
 /** \brief  This function initialise given gpio pin
  *
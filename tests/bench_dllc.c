@@ -0,0 +1,173 @@
+/*
+ * MAC header construction in dllc_send()
+ *
+ * Sends frames to three destinations (two unicast, one broadcast) through
+ * dllc_802154 down to a stub MAC and times dllc_send() per frame, with the
+ * header templates of NETSTK_CFG_DLLC_HDR_CACHE_NUM entries (set with
+ * -DNETSTK_CFG_DLLC_HDR_CACHE_NUM, 0 builds every header field by field).
+ * The time of the same loop without the send is subtracted.
+ *
+ * Every header the MAC gets has to be the one frame802154_create() writes
+ * for the parameters of the frame, for all combinations of destination,
+ * frame pending bit, ACK request and sequence number.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "emb6.h"
+#include "packetbuf.h"
+#include "framer_802154.h"
+#include "random.h"
+
+#define FRAMES_PER_RUN      2000000
+#define RUNS                10
+#define PAYLOAD_LEN         40
+#define PAN_ID              0xabcd
+#define DEST_NUM            3
+
+extern const s_nsDLLC_t dllc_driver_802154;
+
+/*
+ * Stubs of the parts of the stack the benchmark does not link
+ */
+s_mac_phy_conf_t mac_phy_config;
+
+unsigned short random_rand(void) { return 0; }
+
+/* MAC keeping the last frame */
+static uint8_t frame[PACKETBUF_SIZE];
+static uint16_t frame_len;
+
+static void mac_init(void *p_netstk, e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void mac_on(e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void mac_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
+{
+  memcpy(frame, p_data, len);
+  frame_len = len;
+  *p_err = NETSTK_ERR_NONE;
+}
+static void mac_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static const s_nsMAC_t mac = { "MAC BENCH", mac_init, mac_on, mac_on, mac_send, NULL, mac_ioctl };
+
+static s_ns_t ns;
+
+static const linkaddr_t node = {{ 0x02, 0x12, 0x4b, 0, 0, 0, 0, 0x01 }};
+static const linkaddr_t dests[DEST_NUM] = {
+  {{ 0x02, 0x12, 0x4b, 0, 0, 0, 0, 0x02 }},
+  {{ 0x02, 0x12, 0x4b, 0, 0, 0, 0, 0x03 }},
+  {{ 0 }},                                  /* broadcast */
+};
+
+/* puts a frame to destination d into the packetbuf */
+static void prepare(int d, int pending, int reliable, int seq)
+{
+  packetbuf_clear();
+  packetbuf_set_datalen(PAYLOAD_LEN);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dests[d]);
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_PAN_ID, PAN_ID);
+  packetbuf_set_attr(PACKETBUF_ATTR_PENDING, pending);
+  packetbuf_set_attr(PACKETBUF_ATTR_RELIABLE, reliable);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, seq);
+}
+
+/* header of the frame to destination d as written by the framer */
+static int ref_header(int d, int pending, int reliable, int seq, uint8_t *p_hdr)
+{
+  frame802154_t params;
+  int is_broadcast = linkaddr_cmp(&dests[d], &linkaddr_null);
+
+  memset(&params, 0, sizeof(params));
+  params.fcf.frame_type = FRAME802154_DATAFRAME;
+  params.fcf.frame_pending = pending;
+  params.fcf.ack_required = is_broadcast ? 0 : reliable;
+  params.fcf.frame_version = FRAME802154_IEEE802154_2006;
+  params.seq = seq;
+  params.dest_pid = PAN_ID;
+  if (is_broadcast) {
+    params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
+    params.dest_addr[0] = 0xff;
+    params.dest_addr[1] = 0xff;
+  } else {
+    params.fcf.dest_addr_mode = FRAME802154_LONGADDRMODE;
+    linkaddr_copy((linkaddr_t *)&params.dest_addr, &dests[d]);
+  }
+  params.src_pid = PAN_ID;
+  params.fcf.src_addr_mode = FRAME802154_LONGADDRMODE;
+  linkaddr_copy((linkaddr_t *)&params.src_addr, &node);
+  return frame802154_create(&params, p_hdr);
+}
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+  uint8_t hdr[PACKETBUF_SIZE];
+  e_nsErr_t err;
+  int d, pending, reliable, seq, len;
+  int i, k, run;
+  int fails = 0;
+  double t0, t, best[2] = { 1e9, 1e9 };
+
+  packetbuf_clear();
+  linkaddr_set_node_addr((linkaddr_t *)&node);
+  mac_phy_config.pan_id = PAN_ID;
+  ns.dllc = &dllc_driver_802154;
+  ns.mac = &mac;
+  dllc_driver_802154.init(&ns, &err);
+
+  /* headers, twice so that the second round goes through the templates */
+  for (k = 0; k < 2; k++) {
+    for (seq = 1; seq < 256; seq += 127) {
+      for (d = 0; d < DEST_NUM; d++) {
+        for (pending = 0; pending < 2; pending++) {
+          for (reliable = 0; reliable < 2; reliable++) {
+            prepare(d, pending, reliable, seq);
+            dllc_driver_802154.send(packetbuf_dataptr(), PAYLOAD_LEN, &err);
+            len = ref_header(d, pending, reliable, seq, hdr);
+            if ((err != NETSTK_ERR_NONE) ||
+                (frame_len != len + PAYLOAD_LEN) ||
+                (memcmp(frame, hdr, len) != 0)) {
+              printf("header differs: dest %d, pending %d, reliable %d, seq %d\n",
+                     d, pending, reliable, seq);
+              fails++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /* k = 0 the loop alone, k = 1 with dllc_send() */
+  for (run = 0; run < RUNS; run++) {
+    for (k = 0; k < 2; k++) {
+      t0 = now();
+      for (i = 0; i < FRAMES_PER_RUN; i++) {
+        prepare(i % DEST_NUM, 0, 1, (i & 0xff) | 1);
+        if (k) {
+          dllc_driver_802154.send(packetbuf_dataptr(), PAYLOAD_LEN, &err);
+        }
+        __asm__ volatile("" ::: "memory");
+      }
+      t = now() - t0;
+      if (t < best[k]) {
+        best[k] = t;
+      }
+    }
+  }
+
+  printf("%u header templates: dllc_send %5.1f ns per frame\n",
+         (unsigned)NETSTK_CFG_DLLC_HDR_CACHE_NUM,
+         (best[1] - best[0]) * 1e9 / FRAMES_PER_RUN);
+
+  return fails ? 1 : 0;
+}
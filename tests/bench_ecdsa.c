@@ -0,0 +1,106 @@
+/*
+ * ECDSA (secp256r1) signature verification
+ *
+ * Times the ways of verifying a signature with ecc.c:
+ *  - two independent scalar multiplications u1 * G and u2 * Q, which is
+ *    what ecc_ecdsa_validate() cost before it used Shamir's trick (the
+ *    final point addition is not included)
+ *  - ecc_ecdsa_validate(), a joint multiplication
+ *  - ecc_ecdsa_validate_table() with the table of a cached peer key
+ * It also times the steps a cached key saves: the curve check of the
+ * public key and the table precomputation.
+ *
+ * Every signature has to verify with both functions, and a tampered
+ * message digest has to be rejected by both.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ecc.h"
+
+#define NUM_SIGS        40
+
+static void rand_scalar(uint32_t *a)
+{
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    a[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+  }
+  /* stay below the group order */
+  a[7] &= 0x7fffffff;
+}
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+  uint32_t d[8], qx[8], qy[8];
+  uint32_t e[NUM_SIGS][8], r[NUM_SIGS][9], s[NUM_SIGS][9];
+  uint32_t k[8], px[8], py[8];
+  ecc_table_t table;
+  double t0, t_mult = 0, t_validate = 0, t_table = 0, t_point, t_init;
+  int i, fails = 0;
+
+  srand(1);
+  do {
+    rand_scalar(d);
+  } while (!ecc_is_valid_key(d));
+  ecc_gen_pub_key(d, qx, qy);
+
+  for (i = 0; i < NUM_SIGS; i++) {
+    rand_scalar(e[i]);
+    do {
+      rand_scalar(k);
+    } while (ecc_ecdsa_sign(d, e[i], k, r[i], s[i]));
+  }
+
+  t0 = now();
+  for (i = 0; i < NUM_SIGS; i++) {
+    fails += !ecc_is_valid_point(qx, qy);
+  }
+  t_point = (now() - t0) / NUM_SIGS;
+
+  t0 = now();
+  for (i = 0; i < NUM_SIGS; i++) {
+    ecc_table_init(&table, qx, qy);
+  }
+  t_init = (now() - t0) / NUM_SIGS;
+
+  for (i = 0; i < NUM_SIGS; i++) {
+    t0 = now();
+    ecc_ec_mult(ecc_g_point_x, ecc_g_point_y, s[i], px, py);
+    ecc_ec_mult(qx, qy, r[i], px, py);
+    t_mult += now() - t0;
+
+    t0 = now();
+    fails += (ecc_ecdsa_validate(qx, qy, e[i], r[i], s[i]) != 0);
+    t_validate += now() - t0;
+
+    t0 = now();
+    fails += (ecc_ecdsa_validate_table(&table, e[i], r[i], s[i]) != 0);
+    t_table += now() - t0;
+
+    e[i][3] ^= 4;
+    fails += (ecc_ecdsa_validate(qx, qy, e[i], r[i], s[i]) == 0);
+    fails += (ecc_ecdsa_validate_table(&table, e[i], r[i], s[i]) == 0);
+  }
+
+  printf("two scalar multiplications   %7.2f ms\n", t_mult / NUM_SIGS * 1e3);
+  printf("ecc_ecdsa_validate()         %7.2f ms\n", t_validate / NUM_SIGS * 1e3);
+  printf("ecc_ecdsa_validate_table()   %7.2f ms\n", t_table / NUM_SIGS * 1e3);
+  printf("ecc_is_valid_point()         %7.2f ms\n", t_point * 1e3);
+  printf("ecc_table_init()             %7.2f ms\n", t_init * 1e3);
+  printf("table size                   %7u bytes\n", (unsigned)sizeof(table));
+  printf("verification failures        %7d\n", fails);
+
+  return fails ? 1 : 0;
+}
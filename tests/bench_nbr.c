@@ -0,0 +1,132 @@
+/*
+ * IPv6 neighbor cache lookup
+ *
+ * Fills the neighbor cache (NBR_TABLE_MAX_NEIGHBORS entries, set with
+ * -DNBR_TABLE_CONF_MAX_NEIGHBORS) and times uip_ds6_nbr_lookup(), which
+ * goes through the address hash index of uip-ds6-nbr.c, against a linear
+ * scan of the neighbor table, which is what the lookup did before.
+ *
+ * A quarter of the entries is removed and added again first so that the
+ * index is exercised by removals too. Both lookups have to return the
+ * same entry for every address.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "uip-ds6.h"
+#include "uip-ds6-nbr.h"
+#include "link-stats.h"
+
+#define LOOKUPS_PER_RUN     2000000
+
+/*
+ * Stubs of the parts of the stack the neighbor cache refers to
+ */
+uint16_t uip_len;
+uip_ds6_netif_t uip_ds6_if;
+
+void link_stats_init(void) {}
+void link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx) {}
+const linkaddr_t *packetbuf_addr(uint8_t type) { return NULL; }
+void stimer_set(struct stimer *t, unsigned long interval) {}
+int stimer_expired(struct stimer *t) { return 0; }
+unsigned long stimer_remaining(struct stimer *t) { return 0; }
+void uip_ds6_schedule_periodic(unsigned long interval) {}
+void uip_ds6_schedule_stimer(struct stimer *t) {}
+uip_ds6_defrt_t *uip_ds6_defrt_lookup(uip_ipaddr_t *ipaddr) { return NULL; }
+void uip_ds6_defrt_rm(uip_ds6_defrt_t *defrt) {}
+void uip_nd6_ns_output(uip_ipaddr_t *src, uip_ipaddr_t *dest, uip_ipaddr_t *tgt) {}
+void uip_packetqueue_new(struct uip_packetqueue_handle *handle) {}
+void uip_packetqueue_free(struct uip_packetqueue_handle *handle) {}
+uint16_t uip_htons(uint16_t val) { return (uint16_t)((val << 8) | (val >> 8)); }
+void rpl_ipv6_neighbor_callback(uip_ds6_nbr_t *nbr) {}
+
+/* the lookup without the index */
+static uip_ds6_nbr_t *scan_lookup(const uip_ipaddr_t *ipaddr)
+{
+  uip_ds6_nbr_t *nbr;
+
+  for (nbr = nbr_table_head(ds6_neighbors); nbr != NULL;
+       nbr = nbr_table_next(ds6_neighbors, nbr)) {
+    if (uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
+      return nbr;
+    }
+  }
+  return NULL;
+}
+
+static uip_ds6_nbr_t *add(const uip_ipaddr_t *ipaddr, int node)
+{
+  uip_lladdr_t ll;
+
+  memset(&ll, 0, sizeof(ll));
+  ll.addr[sizeof(ll.addr) - 2] = node >> 8;
+  ll.addr[sizeof(ll.addr) - 1] = node & 0xff;
+  return uip_ds6_nbr_add(ipaddr, &ll, 0, NBR_REACHABLE);
+}
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+  static uip_ipaddr_t addrs[NBR_TABLE_MAX_NEIGHBORS];
+  int i, r, n = NBR_TABLE_MAX_NEIGHBORS, rounds = LOOKUPS_PER_RUN / n;
+  int fails = 0;
+  double t0, t_scan, t_index;
+  volatile uintptr_t sink = 0;
+
+  uip_ds6_neighbors_init();
+  for (i = 0; i < n; i++) {
+    uip_ip6addr(&addrs[i], 0xfe80, 0, 0, 0, 0, 0x00ff, 0xfe00, i + 1);
+    if (add(&addrs[i], i + 1) == NULL) {
+      printf("neighbor %d not added\n", i);
+      return 1;
+    }
+  }
+  for (i = 0; i < n; i += 4) {
+    uip_ds6_nbr_rm(uip_ds6_nbr_lookup(&addrs[i]));
+    if (uip_ds6_nbr_lookup(&addrs[i]) != NULL) {
+      printf("neighbor %d still found after removal\n", i);
+      fails++;
+    }
+    add(&addrs[i], i + 1);
+  }
+  for (i = 0; i < n; i++) {
+    if ((scan_lookup(&addrs[i]) == NULL) ||
+        (uip_ds6_nbr_lookup(&addrs[i]) != scan_lookup(&addrs[i]))) {
+      printf("lookups differ for neighbor %d\n", i);
+      fails++;
+    }
+  }
+
+  t0 = now();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < n; i++) {
+      sink += (uintptr_t)scan_lookup(&addrs[i]);
+    }
+  }
+  t_scan = now() - t0;
+
+  t0 = now();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < n; i++) {
+      sink += (uintptr_t)uip_ds6_nbr_lookup(&addrs[i]);
+    }
+  }
+  t_index = now() - t0;
+
+  printf("%3d neighbors: scan %7.1f ns, index %5.1f ns per lookup\n", n,
+         t_scan * 1e9 / ((double)rounds * n),
+         t_index * 1e9 / ((double)rounds * n));
+
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * SHA-256 compressions spent in the DTLS PRF
+ *
+ * dtls_prf() keeps the ipad/opad midstates of the secret for all the HMAC
+ * computations of one PRF call. The reference below is the PRF of RFC 5246
+ * with every HMAC keyed from scratch, which is what dtls_p_hash() did
+ * before. Both are run on the PRF calls of a PSK handshake, the outputs
+ * have to match.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "crypto.h"
+#include "hmac.h"
+#include "sha2.h"
+
+#define REF_MSG_MAX     (DTLS_HMAC_DIGEST_SIZE + 128)
+
+/* HMAC-SHA256 keyed from scratch, the key is not longer than a block */
+static void ref_hmac(const unsigned char *key, size_t klen,
+                     const unsigned char *msg, size_t mlen,
+                     unsigned char *out)
+{
+  unsigned char pad[DTLS_HMAC_BLOCKSIZE];
+  unsigned char inner[DTLS_HMAC_DIGEST_SIZE];
+  SHA256_CTX ctx;
+  size_t i;
+
+  memset(pad, 0, sizeof(pad));
+  memcpy(pad, key, klen);
+  for (i = 0; i < sizeof(pad); i++) {
+    pad[i] ^= 0x36;
+  }
+  SHA256_Init(&ctx);
+  SHA256_Update(&ctx, pad, sizeof(pad));
+  SHA256_Update(&ctx, msg, mlen);
+  SHA256_Final(inner, &ctx);
+
+  for (i = 0; i < sizeof(pad); i++) {
+    pad[i] ^= 0x36 ^ 0x5c;
+  }
+  SHA256_Init(&ctx);
+  SHA256_Update(&ctx, pad, sizeof(pad));
+  SHA256_Update(&ctx, inner, sizeof(inner));
+  SHA256_Final(out, &ctx);
+}
+
+/* P_SHA256(secret, label + seed) */
+static void ref_prf(const unsigned char *key, size_t klen,
+                    const char *label,
+                    const unsigned char *seed1, size_t seed1len,
+                    const unsigned char *seed2, size_t seed2len,
+                    unsigned char *out, size_t outlen)
+{
+  unsigned char seed[REF_MSG_MAX - DTLS_HMAC_DIGEST_SIZE];
+  unsigned char msg[REF_MSG_MAX];
+  unsigned char a[DTLS_HMAC_DIGEST_SIZE];
+  unsigned char block[DTLS_HMAC_DIGEST_SIZE];
+  size_t seedlen, n;
+
+  seedlen = strlen(label);
+  memcpy(seed, label, seedlen);
+  memcpy(seed + seedlen, seed1, seed1len);
+  seedlen += seed1len;
+  memcpy(seed + seedlen, seed2, seed2len);
+  seedlen += seed2len;
+
+  /* A(1) = HMAC(secret, seed) */
+  ref_hmac(key, klen, seed, seedlen, a);
+  while (outlen > 0) {
+    memcpy(msg, a, sizeof(a));
+    memcpy(msg + sizeof(a), seed, seedlen);
+    ref_hmac(key, klen, msg, sizeof(a) + seedlen, block);
+    n = outlen < sizeof(block) ? outlen : sizeof(block);
+    memcpy(out, block, n);
+    out += n;
+    outlen -= n;
+    if (outlen > 0) {
+      ref_hmac(key, klen, a, sizeof(a), a);
+    }
+  }
+}
+
+static int run(const char *name,
+               const unsigned char *key, size_t klen, const char *label,
+               const unsigned char *seed1, size_t seed1len,
+               const unsigned char *seed2, size_t seed2len,
+               unsigned char *out, size_t outlen)
+{
+  unsigned char ref[64];
+  unsigned long start, ref_cnt, prf_cnt;
+
+  start = sha256_compressions;
+  ref_prf(key, klen, label, seed1, seed1len, seed2, seed2len, ref, outlen);
+  ref_cnt = sha256_compressions - start;
+
+  start = sha256_compressions;
+  dtls_prf(key, klen, (const unsigned char *)label, strlen(label),
+           seed1, seed1len, seed2, seed2len, out, outlen);
+  prf_cnt = sha256_compressions - start;
+
+  printf("%-16s %2lu -> %2lu compressions%s\n", name, ref_cnt, prf_cnt,
+         memcmp(ref, out, outlen) ? "  OUTPUT MISMATCH" : "");
+  return memcmp(ref, out, outlen) != 0;
+}
+
+int main(void)
+{
+  unsigned char premaster[32];
+  unsigned char client_random[32];
+  unsigned char server_random[32];
+  unsigned char master[48];
+  unsigned char key_block[40];
+  unsigned char verify_data[12];
+  unsigned char msg[600];
+  unsigned char hs_hash[DTLS_HMAC_DIGEST_SIZE];
+  dtls_hash_ctx hs;
+  unsigned long start;
+  int fails = 0;
+
+  dtls_hmac_storage_init();
+  memset(premaster, 0x11, sizeof(premaster));
+  memset(client_random, 0x22, sizeof(client_random));
+  memset(server_random, 0x33, sizeof(server_random));
+  memset(msg, 0x44, sizeof(msg));
+
+  fails += run("master secret", premaster, sizeof(premaster), "master secret",
+               client_random, sizeof(client_random),
+               server_random, sizeof(server_random),
+               master, sizeof(master));
+  fails += run("key block", master, sizeof(master), "key expansion",
+               server_random, sizeof(server_random),
+               client_random, sizeof(client_random),
+               key_block, sizeof(key_block));
+
+  /* the handshake hash keeps running after the Finished computation */
+  dtls_hash_init(&hs);
+  dtls_hash_update(&hs, msg, sizeof(msg));
+  start = sha256_compressions;
+  dtls_hash_finalize_copy(hs_hash, &hs);
+  printf("%-16s %2lu compressions\n", "hash snapshot", sha256_compressions - start);
+  fails += run("finished", master, sizeof(master), "client finished",
+               hs_hash, sizeof(hs_hash), NULL, 0,
+               verify_data, sizeof(verify_data));
+
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * RPL non-storing mode root at 1000 nodes
+ *
+ * Builds a random DODAG of BENCH_NODES nodes in the link table of the root
+ * (rpl-ns.c), the way DAOs do, then measures:
+ *  - the memory of the link table
+ *  - DAO processing (rpl_ns_update_node)
+ *  - path computation plus Source Routing Header insertion
+ *    (rpl_insert_header) for packets from the root
+ *  - a periodic aging pass over all links
+ *
+ * Every source route is followed hop by hop with rpl_process_srh_header()
+ * and rpl_srh_get_next_hop() and has to match the tree. After half of the
+ * nodes have expired, all live nodes must still be reachable, and a DAO
+ * that would form a loop must be rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rpl-ns.h"
+
+#define BENCH_NODES         1000
+#define BENCH_SRH_ROUNDS    20
+
+#define UIP_IP_BUF          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/*
+ * Stubs of the parts of the stack the root code refers to
+ */
+uip_buf_t uip_aligned_buf;
+uint16_t uip_len;
+uint8_t uip_ext_len;
+rpl_instance_t *default_instance;
+
+static rpl_instance_t instance;
+static rpl_dag_t dag;
+static uip_ipaddr_t own_addr;
+
+rpl_instance_t *rpl_get_instance(uint8_t instance_id) { return &instance; }
+uip_ds6_route_t *uip_ds6_route_lookup(uip_ipaddr_t *addr) { return NULL; }
+void uip_ds6_route_rm(uip_ds6_route_t *route) {}
+void rpl_reset_dio_timer(rpl_instance_t *inst) {}
+rpl_parent_t *rpl_get_parent(uip_lladdr_t *addr) { return NULL; }
+const linkaddr_t *packetbuf_addr(uint8_t type) { return NULL; }
+void dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime) {}
+rpl_parent_t *rpl_find_parent(rpl_dag_t *d, uip_ipaddr_t *addr) { return NULL; }
+uip_ds6_addr_t *uip_ds6_addr_lookup(uip_ipaddr_t *addr)
+{
+  /* the node the packet is at owns its address */
+  return memcmp(addr, &own_addr, sizeof(own_addr)) ? NULL : (uip_ds6_addr_t *)&own_addr;
+}
+
+/* parent of every node, the root is node 0 */
+static int parent_of[BENCH_NODES];
+
+static void node_addr(uip_ipaddr_t *addr, int node)
+{
+  uip_ip6addr(addr, 0x2001, 0xdb8, 0, 0, 0x0212, 0, 0, node);
+}
+
+/* UDP packet of 20 bytes from the root to node dst in uip_buf */
+static void make_packet(int dst)
+{
+  memset(uip_buf, 0, sizeof(uip_buf));
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  node_addr(&UIP_IP_BUF->srcipaddr, 0);
+  node_addr(&UIP_IP_BUF->destipaddr, dst);
+  UIP_IP_BUF->len[1] = 8 + 20;
+  uip_len = UIP_IPH_LEN + 8 + 20;
+  uip_ext_len = 0;
+}
+
+/* Follows the source route of a packet to node dst, returns its hop count
+ * or -1 if the route does not match the tree */
+static int follow_route(int dst)
+{
+  int path[BENCH_NODES];
+  int hops, i, n;
+  uip_ipaddr_t addr, nexthop;
+
+  n = 0;
+  for (i = dst; i != 0; i = parent_of[i]) {
+    path[n++] = i;
+  }
+
+  make_packet(dst);
+  rpl_insert_header();
+  for (hops = 0; hops < n; hops++) {
+    /* the packet leaves for path[n - 1 - hops] */
+    if ((n > 1) && !rpl_srh_get_next_hop(&nexthop)) {
+      return -1;
+    }
+    node_addr(&addr, path[n - 1 - hops]);
+    if (memcmp(&UIP_IP_BUF->destipaddr, &addr, sizeof(addr))) {
+      return -1;
+    }
+    if (hops == n - 1) {
+      break;
+    }
+    /* and gets forwarded there */
+    own_addr = addr;
+    uip_ext_len = 0;
+    if (!rpl_process_srh_header()) {
+      return -1;
+    }
+  }
+
+  /* all segments have to be consumed at the destination */
+  if ((UIP_IP_BUF->proto == UIP_PROTO_ROUTING) &&
+      (uip_buf[UIP_LLIPH_LEN + 3] != 0)) {
+    return -1;
+  }
+  return n;
+}
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+  uip_ipaddr_t child, parent;
+  rpl_ns_node_t *node;
+  long total_hops = 0;
+  int i, hops, max_hops = 0, fails = 0;
+  double t0;
+
+  instance.mop = RPL_MOP_NON_STORING;
+  instance.min_hoprankinc = RPL_MIN_HOPRANKINC;
+  instance.used = 1;
+  instance.current_dag = &dag;
+  dag.instance = &instance;
+  dag.rank = ROOT_RANK(&instance);
+  dag.joined = 1;
+  node_addr(&dag.dag_id, 0);
+  default_instance = &instance;
+  rpl_ns_init();
+
+  /* a deep tree: the parent is one of the 20 nodes that joined last */
+  srand(1);
+  parent_of[0] = -1;
+  t0 = now();
+  for (i = 1; i < BENCH_NODES; i++) {
+    parent_of[i] = i - 1 - rand() % (i < 20 ? i : 20);
+    node_addr(&child, i);
+    node_addr(&parent, parent_of[i]);
+    if (rpl_ns_update_node(&dag, &child, &parent, 600) == NULL) {
+      printf("link table full at node %d\n", i);
+      return 1;
+    }
+  }
+  printf("DAO processing               %7.3f us per DAO\n",
+         (now() - t0) * 1e6 / (BENCH_NODES - 1));
+  printf("link table                   %7u bytes, %u per node on this host\n",
+         (unsigned)(sizeof(rpl_ns_node_t) * RPL_NS_LINK_NUM +
+                    sizeof(rpl_ns_node_t *) * ((RPL_NS_LINK_NUM + 3) / 4) +
+                    RPL_NS_LINK_NUM),
+         (unsigned)sizeof(rpl_ns_node_t));
+
+  for (i = 1; i < BENCH_NODES; i++) {
+    hops = follow_route(i);
+    if (hops < 0) {
+      printf("wrong source route to node %d\n", i);
+      fails++;
+      continue;
+    }
+    total_hops += hops;
+    if (hops > max_hops) {
+      max_hops = hops;
+    }
+  }
+  printf("source routes                %7d checked, depth %.1f average, %d max\n",
+         BENCH_NODES - 1, (double)total_hops / (BENCH_NODES - 1), max_hops);
+
+  t0 = now();
+  for (hops = 0; hops < BENCH_SRH_ROUNDS; hops++) {
+    for (i = 1; i < BENCH_NODES; i++) {
+      make_packet(i);
+      rpl_insert_header();
+    }
+  }
+  printf("path computation + SRH       %7.3f us per packet\n",
+         (now() - t0) * 1e6 / (BENCH_SRH_ROUNDS * (BENCH_NODES - 1.0)));
+
+  /* half of the nodes expire, their links must stay as long as a live
+   * node below needs them */
+  for (i = 1; i < BENCH_NODES; i += 2) {
+    node_addr(&child, i);
+    rpl_ns_get_node(&dag, &child)->lifetime = 1;
+  }
+  t0 = now();
+  rpl_ns_periodic();
+  rpl_ns_periodic();
+  printf("periodic aging               %7.1f us per pass, %d links left\n",
+         (now() - t0) * 1e6 / 2, rpl_ns_num_nodes());
+  for (i = 2; i < BENCH_NODES; i += 2) {
+    node_addr(&child, i);
+    if (!rpl_ns_is_node_reachable(&dag, &child)) {
+      printf("live node %d unreachable\n", i);
+      fails++;
+    }
+  }
+
+  for (i = 1; i < BENCH_NODES; i++) {
+    node_addr(&child, i);
+    node = rpl_ns_get_node(&dag, &child);
+    if (node != NULL) {
+      node->lifetime = 0;
+    }
+  }
+  rpl_ns_periodic();
+  if (rpl_ns_num_nodes() != 1) {
+    printf("%d links left after all nodes expired\n", rpl_ns_num_nodes());
+    fails++;
+  }
+
+  /* 2 -> 1 -> root, then 1 claims 2 as its parent */
+  rpl_ns_init();
+  node_addr(&child, 1);
+  node_addr(&parent, 0);
+  rpl_ns_update_node(&dag, &child, &parent, 10);
+  node_addr(&child, 2);
+  node_addr(&parent, 1);
+  rpl_ns_update_node(&dag, &child, &parent, 10);
+  node_addr(&child, 1);
+  node_addr(&parent, 2);
+  rpl_ns_update_node(&dag, &child, &parent, 10);
+  node_addr(&child, 2);
+  if (!rpl_ns_is_node_reachable(&dag, &child)) {
+    printf("loop not rejected\n");
+    fails++;
+  }
+
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+/*
+ * RFC 8138 6LoRH compression of the RPL headers
+ *
+ * Datagrams with the RPL option (storing mode) and with the RPL option
+ * and a source routing header (non-storing mode) go through sicslowpan,
+ * dllsec_null, dllc_802154 and mac_802154 down to a PHY recording the
+ * frames. The frames are passed up the stack of the receiver, which has
+ * to rebuild the original datagram.
+ *
+ * The source routing headers are already in the form sicslowpan sends,
+ * with the hops that are left and the CmprI and CmprE of the root, so
+ * the datagram the receiver rebuilds is the one that was sent.
+ *
+ * Also checked: the first hop of the SRH-6LoRH is compressed against the
+ * IPv6 source, the root, and not against the IPv6 destination.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "emb6.h"
+#include "evproc.h"
+#include "rt_tmr.h"
+#include "packetbuf.h"
+#include "queuebuf.h"
+#include "sicslowpan.h"
+#include "mac.h"
+#include "bsp.h"
+
+#define FRAMES_MAX          4
+#define RUN_MS              100
+#define PAYLOAD_LEN         20
+/* frame control, sequence number, PAN ID and two long addresses */
+#define MAC_HDR_LEN         21
+
+#define UIP_IP_BUF          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+extern const s_nsHeadComp_t hc_driver_sicslowpan;
+extern const s_nsFramer_t framer_802154;
+extern const s_nsdllsec_t dllsec_driver_null;
+extern const s_nsDLLC_t dllc_driver_802154;
+extern const s_nsMAC_t mac_driver_802154;
+
+/*
+ * Stubs of the parts of the stack and the board the test does not link
+ */
+uip_buf_t uip_aligned_buf;
+uint16_t uip_len;
+uint8_t uip_ext_len;
+uip_lladdr_t uip_lladdr;
+s_mac_phy_conf_t mac_phy_config;
+
+static uint8_t (*output)(const uip_lladdr_t *);
+static uint8_t rx_dgram[UIP_BUFSIZE];
+static int rx_len;
+
+void tcpip_set_outputfunc(uint8_t (*f)(const uip_lladdr_t *)) { output = f; }
+void tcpip_input(void)
+{
+  memcpy(rx_dgram, &uip_buf[UIP_LLH_LEN], uip_len);
+  rx_len = uip_len;
+}
+void uip_ds6_link_neighbor_callback(int status, int numtx) {}
+void uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
+{
+  memcpy(&ipaddr->u8[8], lladdr, UIP_LLADDR_LEN);
+  ipaddr->u8[8] ^= 0x02;
+}
+void bsp_wdt(en_bspWdtAction_t wdtAct) {}
+void bsp_enterCritical(void) {}
+void bsp_exitCritical(void) {}
+void bsp_delay_us(uint32_t us) {}
+uint32_t bsp_getrand(uint32_t max) { return max; }
+uint32_t bsp_get(en_bspParams_t param) { return 1000; }
+clock_time_t bsp_getTick(void) { return 0; }
+void link_stats_input_callback(const linkaddr_t *lladdr) {}
+
+/* PHY recording the frames, all transmissions succeed */
+static uint8_t frames[FRAMES_MAX][PACKETBUF_SIZE];
+static uint16_t frame_len[FRAMES_MAX];
+static int sent;
+
+static void phy_init(void *p_netstk, e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void phy_on(e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void phy_off(e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void phy_recv(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err) {}
+static void phy_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
+{
+  if (sent < FRAMES_MAX) {
+    memcpy(frames[sent], p_data, len);
+    frame_len[sent] = len;
+  }
+  *p_err = NETSTK_ERR_NONE;
+  sent++;
+}
+static void phy_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err)
+{
+  *p_err = NETSTK_ERR_NONE;
+  if (cmd == NETSTK_CMD_RF_RSSI_GET) {
+    *(int8_t *)p_val = -60;
+  }
+}
+static const s_nsPHY_t phy = { "PHY TEST", phy_init, phy_on, phy_off, phy_send, phy_recv, phy_ioctl };
+
+static s_ns_t ns;
+
+static const uip_lladdr_t addr_a = {{ 0x02, 0x12, 0x4b, 0, 0, 0, 0, 0x0a }};
+static const uip_lladdr_t addr_b = {{ 0x02, 0x12, 0x4b, 0, 0, 0, 0, 0x0b }};
+
+static void set_node(const uip_lladdr_t *addr)
+{
+  memcpy(&uip_lladdr, addr, sizeof(uip_lladdr));
+  linkaddr_set_node_addr((linkaddr_t *)addr);
+}
+
+/*
+ * UDP datagram from src to B in uip_buf, behind the extension headers
+ * ext of ext_len bytes whose first next header field is proto
+ */
+static int make_dgram(const uip_ipaddr_t *src, uint8_t proto,
+                      const uint8_t *ext, int ext_len)
+{
+  uint8_t *udp;
+  int len;
+  int i;
+
+  len = UIP_IPH_LEN + ext_len + 8 + PAYLOAD_LEN;
+  memset(uip_buf, 0, sizeof(uip_buf));
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = proto;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, src);
+  uip_ip6addr(&UIP_IP_BUF->destipaddr, 0xfd00, 0, 0, 0, 0x0012, 0x4b00, 0, 0x0b);
+  UIP_IP_BUF->len[0] = (len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (len - UIP_IPH_LEN) & 0xff;
+  memcpy(&uip_buf[UIP_LLIPH_LEN], ext, ext_len);
+  udp = &uip_buf[UIP_LLIPH_LEN + ext_len];
+  udp[1] = 0x33;
+  udp[3] = 0x33;
+  udp[5] = 8 + PAYLOAD_LEN;
+  udp[6] = 0x12;
+  udp[7] = 0x34;
+  for (i = 0; i < PAYLOAD_LEN; i++) {
+    udp[8 + i] = i;
+  }
+  uip_len = len;
+  return len;
+}
+
+/* sends the datagram in uip_buf to B and passes the frames up its stack */
+static int send_receive(void)
+{
+  e_nsErr_t err;
+  int i;
+
+  sent = 0;
+  if (output(&addr_b) != 1) {
+    return 0;
+  }
+  while (evproc_nextEvent() == E_SUCCESS);
+  for (i = 0; i < RUN_MS; i++) {
+    rt_tmr_update();
+    while (evproc_nextEvent() == E_SUCCESS);
+  }
+
+  set_node(&addr_b);
+  rx_len = -1;
+  for (i = 0; (i < sent) && (i < FRAMES_MAX); i++) {
+    mac_driver_802154.recv(frames[i], frame_len[i], &err);
+  }
+  set_node(&addr_a);
+  return sent;
+}
+
+static int check(const char *name, int ok)
+{
+  printf("%-52s %s\n", name, ok ? "ok" : "FAILED");
+  return !ok;
+}
+
+int main(void)
+{
+  /* RPL option, O flag, instance 30, rank 512 */
+  static const uint8_t rpi[] = {
+    UIP_PROTO_UDP, 0, UIP_EXT_HDR_OPT_RPL, 4, 0x80, 30, 0x02, 0x00,
+  };
+  /*
+   * RPL option, instance 0, rank 200, and a source route over the hops
+   * fd00::212:4b00:0:c, d and e, CmprI and CmprE 15, 5 octets padding
+   */
+  static const uint8_t rpi_srh[] = {
+    UIP_PROTO_ROUTING, 0, UIP_EXT_HDR_OPT_RPL, 4, 0x00, 0, 0x00, 200,
+    UIP_PROTO_UDP, 1, 3, 3, 0xff, 0x50, 0, 0,
+    0x0c, 0x0d, 0x0e, 0, 0, 0, 0, 0,
+  };
+  static uint8_t dgram[UIP_BUFSIZE];
+  uip_ipaddr_t node;
+  uip_ipaddr_t root;
+  uint8_t *lorh;
+  e_nsErr_t err;
+  int fails = 0;
+  int len;
+
+  rt_tmr_init();
+  queuebuf_init();
+  packetbuf_clear();
+  set_node(&addr_a);
+  mac_phy_config.pan_id = 0xabcd;
+
+  ns.frame = &framer_802154;
+  ns.hc = &hc_driver_sicslowpan;
+  ns.dllsec = &dllsec_driver_null;
+  ns.dllc = &dllc_driver_802154;
+  ns.mac = &mac_driver_802154;
+  ns.phy = &phy;
+  mac_driver_802154.init(&ns, &err);
+  dllc_driver_802154.init(&ns, &err);
+  dllsec_driver_null.init(&ns);
+  hc_driver_sicslowpan.init(&ns);
+
+  uip_ip6addr(&node, 0xfd00, 0, 0, 0, 0x0012, 0x4b00, 0, 0x0a);
+  uip_ip6addr(&root, 0xfd00, 0, 0, 0, 0, 0, 0, 0x01);
+
+  /* storing mode, the RPL option only */
+  len = make_dgram(&node, UIP_PROTO_HBHO, rpi, sizeof(rpi));
+  memcpy(dgram, &uip_buf[UIP_LLH_LEN], len);
+  fails += check("storing: sent in one frame", send_receive() == 1);
+  lorh = &frames[0][MAC_HDR_LEN];
+  fails += check("storing: RPI-6LoRH behind the page 1 dispatch",
+                 (lorh[0] == SICSLOWPAN_DISPATCH_PAGING_1) &&
+                 (lorh[2] == SICSLOWPAN_6LORH_TYPE_RPI));
+  fails += check("storing: datagram rebuilt by the receiver",
+                 (rx_len == len) && (memcmp(rx_dgram, dgram, len) == 0));
+
+  /* non-storing mode, the root sends along a source route */
+  len = make_dgram(&root, UIP_PROTO_HBHO, rpi_srh, sizeof(rpi_srh));
+  memcpy(dgram, &uip_buf[UIP_LLH_LEN], len);
+  fails += check("non-storing: sent in one frame", send_receive() == 1);
+  lorh = &frames[0][MAC_HDR_LEN];
+  /* fd00::1 and fd00::212:4b00:0:c differ in their last 8 octets */
+  fails += check("non-storing: SRH-6LoRH of 3 hops, 8 octets each",
+                 (lorh[0] == SICSLOWPAN_DISPATCH_PAGING_1) &&
+                 (lorh[1] == (SICSLOWPAN_6LORH_CRITICAL | 2)) &&
+                 (lorh[2] == 3));
+  fails += check("non-storing: first hop relative to the IPv6 source",
+                 (lorh[3] == 0x00) && (lorh[4] == 0x12) &&
+                 (lorh[5] == 0x4b) && (lorh[10] == 0x0c));
+  fails += check("non-storing: datagram rebuilt by the receiver",
+                 (rx_len == len) && (memcmp(rx_dgram, dgram, len) == 0));
+
+  return fails ? 1 : 0;
+}
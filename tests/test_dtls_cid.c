@@ -0,0 +1,188 @@
+/*
+ * DTLS Connection ID (RFC 9146)
+ *
+ * A client and a server, two peers of one DTLS context, run a PSK
+ * handshake over a loopback that hands every record to the context with
+ * the address of its sender. Once the CIDs are negotiated, application
+ * data has to travel as tls12_cid records, and the session has to follow
+ * the client to a new address and port.
+ *
+ * Also checked: an older record replayed from a third address and a
+ * forged record do not move the session.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dtls_config.h"
+#include "emb6_conf.h"
+#include "bsp.h"
+#include "evproc.h"
+#include "dtls.h"
+#include "debug.h"
+
+#define RECORDS_MAX         64
+
+/*
+ * Stubs of the parts of the stack and the board the test does not link
+ */
+uint16_t uip_htons(uint16_t val) { return val; }
+void uip_debug_ipaddr_print(const uip_ipaddr_t *addr) {}
+clock_time_t bsp_getTick(void) { return 0; }
+uint32_t bsp_get(en_bspParams_t param) { return 1000; }
+void etimer_set(struct etimer *et, clock_time_t interval, pfn_callback_t callback) {}
+void etimer_stop(struct etimer *et) {}
+int etimer_expired(struct etimer *et) { return 1; }
+clock_time_t etimer_expiration_time(struct etimer *et) { return 0; }
+
+/* loopback, the records wait here until run() delivers them */
+typedef struct {
+  session_t from;
+  uint8 buf[DTLS_MAX_BUF];
+  size_t len;
+} record_t;
+
+static record_t records[RECORDS_MAX];
+static int head, tail;
+
+static dtls_context_t *ctx;
+static session_t cli_addr;
+static session_t srv_addr;
+
+/* what the application got last, and from where */
+static char rx_data[16];
+static session_t rx_from;
+static int rx_num;
+
+static int cb_write(dtls_context_t *c, session_t *dst, uint8 *buf, size_t len)
+{
+  record_t *r = &records[tail++ % RECORDS_MAX];
+
+  r->from = (dst->port == srv_addr.port) ? cli_addr : srv_addr;
+  memcpy(r->buf, buf, len);
+  r->len = len;
+  return len;
+}
+
+static int cb_read(dtls_context_t *c, session_t *src, uint8 *buf, size_t len)
+{
+  memset(rx_data, 0, sizeof(rx_data));
+  memcpy(rx_data, buf, len < sizeof(rx_data) - 1 ? len : sizeof(rx_data) - 1);
+  rx_from = *src;
+  rx_num++;
+  return 0;
+}
+
+static int cb_psk(dtls_context_t *c, const session_t *session,
+                  dtls_credentials_type_t type,
+                  const unsigned char *id, size_t id_len,
+                  unsigned char *result, size_t result_len)
+{
+  if (type == DTLS_PSK_IDENTITY) {
+    memcpy(result, "id", 2);
+    return 2;
+  }
+  if (type == DTLS_PSK_KEY) {
+    memcpy(result, "secretsecret1234", 16);
+    return 16;
+  }
+  return 0;
+}
+
+static void run(void)
+{
+  record_t *r;
+
+  while (head != tail) {
+    r = &records[head++ % RECORDS_MAX];
+    dtls_handle_message(ctx, &r->from, r->buf, r->len);
+  }
+}
+
+static void set_addr(session_t *s, uint16_t port, uint8_t host)
+{
+  memset(s, 0, sizeof(*s));
+  s->size = sizeof(s->addr) + sizeof(s->port);
+  s->port = port;
+  s->addr.u8[15] = host;
+}
+
+static int check(const char *name, int ok)
+{
+  printf("%-52s %s\n", name, ok ? "ok" : "FAILED");
+  return !ok;
+}
+
+int main(void)
+{
+  dtls_handler_t cb;
+  dtls_peer_t *peer;
+  session_t old_addr;
+  record_t old;
+  int fails = 0;
+
+  memset(&cb, 0, sizeof(cb));
+  cb.write = cb_write;
+  cb.read = cb_read;
+  cb.get_psk_info = cb_psk;
+
+  dtls_init();
+  dtls_set_log_level(DTLS_LOG_CRIT);
+  set_addr(&cli_addr, 1000, 1);
+  set_addr(&srv_addr, 5684, 2);
+  ctx = dtls_new_context(NULL);
+  dtls_set_handler(ctx, &cb);
+
+  dtls_connect(ctx, &srv_addr);
+  run();
+  peer = dtls_get_peer(ctx, &cli_addr);
+  fails += check("handshake done",
+                 (peer != NULL) && (peer->state == DTLS_STATE_CONNECTED));
+  fails += check("CIDs negotiated",
+                 (peer != NULL) && peer->cid_negotiated &&
+                 (peer->peer_cid_length == DTLS_CID_LENGTH));
+
+  dtls_write(ctx, &srv_addr, (uint8 *)"hello", 5);
+  old = records[(tail - 1) % RECORDS_MAX];
+  fails += check("application data sent as tls12_cid record",
+                 old.buf[0] == DTLS_CT_TLS12_CID);
+  run();
+  fails += check("server reads the data",
+                 (rx_num == 1) && (strcmp(rx_data, "hello") == 0));
+
+  /* the client moves to another address and port */
+  old_addr = cli_addr;
+  set_addr(&cli_addr, 2000, 9);
+  dtls_write(ctx, &srv_addr, (uint8 *)"moved", 5);
+  run();
+  fails += check("server reads the data from the new address",
+                 (rx_num == 2) && (strcmp(rx_data, "moved") == 0) &&
+                 (rx_from.port == cli_addr.port));
+  fails += check("session follows the client",
+                 (dtls_get_peer(ctx, &cli_addr) != NULL) &&
+                 (dtls_get_peer(ctx, &old_addr) == NULL));
+  dtls_write(ctx, &cli_addr, (uint8 *)"reply", 5);
+  run();
+  fails += check("client reads the reply",
+                 (rx_num == 3) && (strcmp(rx_data, "reply") == 0));
+
+  /* the first record again, from a third address */
+  set_addr(&old.from, 3000, 7);
+  dtls_handle_message(ctx, &old.from, old.buf, old.len);
+  fails += check("replayed record does not move the session",
+                 (dtls_get_peer(ctx, &cli_addr) != NULL) &&
+                 (dtls_get_peer(ctx, &old.from) == NULL));
+  old.buf[old.len - 1] ^= 1;
+  dtls_handle_message(ctx, &old.from, old.buf, old.len);
+  fails += check("forged record does not move the session",
+                 (dtls_get_peer(ctx, &cli_addr) != NULL) &&
+                 (dtls_get_peer(ctx, &old.from) == NULL));
+
+  dtls_write(ctx, &srv_addr, (uint8 *)"again", 5);
+  run();
+  fails += check("session still works",
+                 (strcmp(rx_data, "again") == 0) &&
+                 (rx_from.port == cli_addr.port));
+
+  return fails ? 1 : 0;
+}
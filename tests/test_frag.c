@@ -0,0 +1,250 @@
+/*
+ * 6LoWPAN fragmentation over the asynchronous MAC queue
+ *
+ * A 1280 byte datagram goes through sicslowpan, dllsec_null, dllc_802154
+ * and mac_802154 down to a scripted PHY. CSMA-CA backs off on the rt_tmr,
+ * so all fragments are queued by the MAC before the first one is sent,
+ * and their results arrive from the event loop. The frames seen by the
+ * PHY are then passed up the stack of the receiver, which has to
+ * reassemble the datagram.
+ *
+ * Also checked:
+ *  - a datagram whose fragments do not fit into the MAC queue any more is
+ *    dropped as a whole
+ *  - the failure of the last frame of a datagram does not abort the next
+ *    datagram
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "emb6.h"
+#include "evproc.h"
+#include "rt_tmr.h"
+#include "packetbuf.h"
+#include "queuebuf.h"
+#include "sicslowpan.h"
+#include "mac.h"
+#include "rime.h"
+#include "bsp.h"
+
+#define DGRAM_LEN           1280
+#define FRAMES_MAX          64
+#define RUN_MS              2000
+
+#define UIP_IP_BUF          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+extern const s_nsHeadComp_t hc_driver_sicslowpan;
+extern const s_nsFramer_t framer_802154;
+extern const s_nsdllsec_t dllsec_driver_null;
+extern const s_nsDLLC_t dllc_driver_802154;
+extern const s_nsMAC_t mac_driver_802154;
+
+/*
+ * Stubs of the parts of the stack and the board the test does not link
+ */
+uip_buf_t uip_aligned_buf;
+uint16_t uip_len;
+uint8_t uip_ext_len;
+uip_lladdr_t uip_lladdr;
+s_mac_phy_conf_t mac_phy_config;
+
+static uint8_t (*output)(const uip_lladdr_t *);
+static uint8_t rx_dgram[UIP_BUFSIZE];
+static int rx_len;
+
+void tcpip_set_outputfunc(uint8_t (*f)(const uip_lladdr_t *)) { output = f; }
+void tcpip_input(void)
+{
+  memcpy(rx_dgram, &uip_buf[UIP_LLH_LEN], uip_len);
+  rx_len = uip_len;
+}
+void uip_ds6_link_neighbor_callback(int status, int numtx) {}
+void uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
+{
+  memcpy(&ipaddr->u8[8], lladdr, UIP_LLADDR_LEN);
+  ipaddr->u8[8] ^= 0x02;
+}
+void bsp_wdt(en_bspWdtAction_t wdtAct) {}
+void bsp_enterCritical(void) {}
+void bsp_exitCritical(void) {}
+void bsp_delay_us(uint32_t us) {}
+uint32_t bsp_getrand(uint32_t max) { return max; }
+uint32_t bsp_get(en_bspParams_t param) { return 1000; }
+clock_time_t bsp_getTick(void) { return 0; }
+void link_stats_input_callback(const linkaddr_t *lladdr) {}
+
+/*
+ * PHY recording the frames, transmissions from noack_at on are not
+ * acknowledged, all others succeed
+ */
+static uint8_t frames[FRAMES_MAX][PACKETBUF_SIZE];
+static uint16_t frame_len[FRAMES_MAX];
+static int sent;
+static int noack_at = -1;
+
+static void phy_init(void *p_netstk, e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void phy_on(e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void phy_off(e_nsErr_t *p_err) { *p_err = NETSTK_ERR_NONE; }
+static void phy_recv(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err) {}
+static void phy_send(uint8_t *p_data, uint16_t len, e_nsErr_t *p_err)
+{
+  if (sent < FRAMES_MAX) {
+    memcpy(frames[sent], p_data, len);
+    frame_len[sent] = len;
+  }
+  *p_err = ((noack_at >= 0) && (sent >= noack_at)) ? NETSTK_ERR_TX_NOACK : NETSTK_ERR_NONE;
+  sent++;
+}
+static void phy_ioctl(e_nsIocCmd_t cmd, void *p_val, e_nsErr_t *p_err)
+{
+  *p_err = NETSTK_ERR_NONE;
+  if (cmd == NETSTK_CMD_RF_RSSI_GET) {
+    *(int8_t *)p_val = -60;
+  }
+}
+static const s_nsPHY_t phy = { "PHY TEST", phy_init, phy_on, phy_off, phy_send, phy_recv, phy_ioctl };
+
+static s_ns_t ns;
+
+/* sicslowpan sees the results through the hook of its output callback */
+static int results[MAC_TX_QUEUED + 1];
+static void rx_frame(void) {}
+static void tx_result(int status) { results[status]++; }
+static struct rime_sniffer sniffer = { NULL, rx_frame, tx_result };
+
+static const uip_lladdr_t addr_a = {{ 0x02, 0x12, 0x4b, 0, 0, 0, 0, 0x0a }};
+static const uip_lladdr_t addr_b = {{ 0x02, 0x12, 0x4b, 0, 0, 0, 0, 0x0b }};
+
+static void set_node(const uip_lladdr_t *addr)
+{
+  memcpy(&uip_lladdr, addr, sizeof(uip_lladdr));
+  linkaddr_set_node_addr((linkaddr_t *)addr);
+}
+
+/* UDP datagram of len bytes from A to B in uip_buf */
+static void make_dgram(int len, uint8_t fill)
+{
+  int i;
+
+  memset(uip_buf, 0, sizeof(uip_buf));
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ip6addr(&UIP_IP_BUF->srcipaddr, 0xfe80, 0, 0, 0, 0x0012, 0x4b00, 0, 0x0a);
+  uip_ip6addr(&UIP_IP_BUF->destipaddr, 0xfe80, 0, 0, 0, 0x0012, 0x4b00, 0, 0x0b);
+  UIP_IP_BUF->len[0] = (len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (len - UIP_IPH_LEN) & 0xff;
+  uip_buf[UIP_LLIPH_LEN + 1] = 0x33;
+  uip_buf[UIP_LLIPH_LEN + 3] = 0x33;
+  uip_buf[UIP_LLIPH_LEN + 4] = (len - UIP_IPH_LEN) >> 8;
+  uip_buf[UIP_LLIPH_LEN + 5] = (len - UIP_IPH_LEN) & 0xff;
+  for (i = UIP_IPH_LEN + 8; i < len; i++) {
+    uip_buf[UIP_LLH_LEN + i] = fill + i;
+  }
+  uip_len = len;
+}
+
+/* drives the timers and the event loop for ms milliseconds */
+static void run(int ms)
+{
+  while (ms--) {
+    while (evproc_nextEvent() == E_SUCCESS);
+    rt_tmr_update();
+  }
+  while (evproc_nextEvent() == E_SUCCESS);
+}
+
+/* passes the frames first..last-1 up the stack of B */
+static void receive(int first, int last)
+{
+  e_nsErr_t err;
+  int i;
+
+  set_node(&addr_b);
+  rx_len = -1;
+  for (i = first; i < last; i++) {
+    mac_driver_802154.recv(frames[i], frame_len[i], &err);
+  }
+  set_node(&addr_a);
+}
+
+static int check(const char *name, int ok)
+{
+  printf("%-52s %s\n", name, ok ? "ok" : "FAILED");
+  return !ok;
+}
+
+int main(void)
+{
+  static uint8_t dgram[UIP_BUFSIZE];
+  e_nsErr_t err;
+  int fails = 0;
+  int first;
+
+  rt_tmr_init();
+  queuebuf_init();
+  packetbuf_clear();
+  set_node(&addr_a);
+  mac_phy_config.pan_id = 0xabcd;
+
+  ns.frame = &framer_802154;
+  ns.hc = &hc_driver_sicslowpan;
+  ns.dllsec = &dllsec_driver_null;
+  ns.dllc = &dllc_driver_802154;
+  ns.mac = &mac_driver_802154;
+  ns.phy = &phy;
+  mac_driver_802154.init(&ns, &err);
+  memcpy(&uip_lladdr, &addr_a, sizeof(uip_lladdr));
+  linkaddr_set_node_addr((linkaddr_t *)&addr_a);
+  dllc_driver_802154.init(&ns, &err);
+  dllsec_driver_null.init(&ns);
+  hc_driver_sicslowpan.init(&ns);
+  rime_sniffer_add(&sniffer);
+
+  /* all fragments are queued before the first one is sent */
+  make_dgram(DGRAM_LEN, 0);
+  memcpy(dgram, &uip_buf[UIP_LLH_LEN], DGRAM_LEN);
+  fails += check("1280 byte datagram accepted", output(&addr_b) == 1);
+  fails += check("nothing sent before the backoff", sent == 0);
+  run(RUN_MS);
+  printf("  %d fragments\n", sent);
+  fails += check("all fragments sent and acknowledged",
+                 (sent > 1) && (results[MAC_TX_OK] == sent));
+  receive(0, sent);
+  fails += check("datagram reassembled by the receiver",
+                 (rx_len == DGRAM_LEN) && (memcmp(rx_dgram, dgram, DGRAM_LEN) == 0));
+
+  /* a second datagram does not fit while the first one is queued */
+  memset(results, 0, sizeof(results));
+  sent = 0;
+  make_dgram(DGRAM_LEN, 1);
+  output(&addr_b);
+  make_dgram(DGRAM_LEN, 2);
+  fails += check("datagram dropped when the MAC queue is full", output(&addr_b) == 0);
+  run(RUN_MS);
+  first = sent;
+  fails += check("queued datagram still sent",
+                 (first > 1) && (results[MAC_TX_OK] == first));
+
+  /* the last fragment of a datagram fails, the next one is not aborted */
+  memset(results, 0, sizeof(results));
+  sent = 0;
+  noack_at = first - 1;
+  make_dgram(DGRAM_LEN, 3);
+  output(&addr_b);
+  run(RUN_MS);
+  fails += check("last fragment not acknowledged",
+                 (results[MAC_TX_NOACK] == 1) && (results[MAC_TX_OK] == noack_at));
+  first = sent;
+  noack_at = -1;
+  make_dgram(DGRAM_LEN, 4);
+  memcpy(dgram, &uip_buf[UIP_LLH_LEN], DGRAM_LEN);
+  fails += check("next datagram accepted", output(&addr_b) == 1);
+  run(RUN_MS);
+  receive(first, sent);
+  fails += check("next datagram reassembled by the receiver",
+                 (rx_len == DGRAM_LEN) && (memcmp(rx_dgram, dgram, DGRAM_LEN) == 0));
+
+  return fails ? 1 : 0;
+}
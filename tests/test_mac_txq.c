@@ -0,0 +1,146 @@
+/*
+ * MAC transmission queue: round-robin, bursts and sizes
+ *
+ * Frames are queued for a few receivers and taken off the queue the way
+ * the MACs do it (mac_txq_head, mac_txq_load, mac_txq_done). The order of
+ * the frames and their frame pending bits are compared against what is
+ * expected:
+ *  - a receiver keeps the channel while the frame pending bit is set
+ *  - a burst only goes on to a frame that requests an ACK
+ *  - a burst ends after NETSTK_CFG_MAC_TXQ_BURST_MAX frames or on a NOACK
+ *  - frames of a receiver leave the queue in the order they came in
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "emb6.h"
+#include "packetbuf.h"
+#include "mac_txq.h"
+
+#define FCF_FRAME_PENDING   0x10
+
+static char order[128];
+
+/* tags every frame with its receiver and number, in the payload */
+static void put(char nbr, int num, int ack)
+{
+  linkaddr_t addr;
+  uint8_t frame[4] = { 0x41, 0xcc, 0, 0 };
+  e_nsErr_t err;
+
+  frame[2] = nbr;
+  frame[3] = num;
+  if (ack) {
+    frame[0] |= 0x20;
+  }
+  packetbuf_copyfrom(frame, sizeof(frame));
+  memset(&addr, 0, sizeof(addr));
+  addr.u8[7] = nbr;
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &addr);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, ack);
+  if (mac_txq_put(NULL, NULL, &err) == NULL) {
+    printf("frame %c%d not queued\n", nbr, num);
+  }
+}
+
+/* sends all queued frames, the transmission of the frame named fail is not
+ * acknowledged */
+static void send_all(const char *fail)
+{
+  struct mac_txq_frame *p_frame;
+  uint8_t *p_hdr;
+  char name[8];
+
+  order[0] = '\0';
+  while ((p_frame = mac_txq_head()) != NULL) {
+    mac_txq_load(p_frame);
+    p_hdr = packetbuf_hdrptr();
+    sprintf(name, "%c%d%s", p_hdr[2], p_hdr[3],
+            (p_hdr[0] & FCF_FRAME_PENDING) ? "p" : "");
+    if (order[0] != '\0') {
+      strcat(order, " ");
+    }
+    strcat(order, name);
+    mac_txq_done(((fail != NULL) && (strcmp(name, fail) == 0)) ?
+                 NETSTK_ERR_TX_NOACK : NETSTK_ERR_NONE);
+  }
+}
+
+static int check(const char *name, int ok)
+{
+  printf("%-52s %s\n", name, ok ? "ok" : "FAILED");
+  return !ok;
+}
+
+static int check_order(const char *name, const char *exp)
+{
+  if (strcmp(order, exp) != 0) {
+    printf("  sent     %s\n  expected %s\n", order, exp);
+  }
+  return check(name, strcmp(order, exp) == 0);
+}
+
+int main(void)
+{
+  linkaddr_t addr;
+  int fails = 0;
+  int i;
+
+  mac_txq_init();
+
+  /* A keeps the channel for its acknowledged frames, then B, then A again */
+  put('A', 1, 1);
+  put('A', 2, 1);
+  put('B', 1, 1);
+  put('A', 3, 1);
+  send_all(NULL);
+  fails += check_order("burst while frames are pending", "A1p A2p A3 B1");
+
+  /* a frame without ACK request is not announced by the frame pending bit */
+  put('A', 1, 1);
+  put('A', 2, 0);
+  put('B', 1, 1);
+  put('A', 3, 1);
+  send_all(NULL);
+  fails += check_order("burst ends before a frame without ACK", "A1 B1 A2 A3");
+
+  /* a NOACK ends the burst and hands the channel over */
+  put('A', 1, 1);
+  put('A', 2, 1);
+  put('A', 3, 1);
+  put('B', 1, 1);
+  send_all("A2p");
+  fails += check_order("burst ends on NOACK", "A1p A2p B1 A3");
+
+  /* a burst is not longer than NETSTK_CFG_MAC_TXQ_BURST_MAX frames */
+  for (i = 0; i < NETSTK_CFG_MAC_TXQ_BURST_MAX + 1; i++) {
+    put('C', i, 1);
+  }
+  put('D', 0, 1);
+  send_all(NULL);
+  fails += check("burst limited to NETSTK_CFG_MAC_TXQ_BURST_MAX",
+                 (strstr(order, "D0") != NULL) &&
+                 (strstr(order, "D0") < strstr(order, "C8")) &&
+                 (strstr(order, "D0")[-2] != 'p'));
+  printf("  %s\n", order);
+
+  /* sizes */
+  memset(&addr, 0, sizeof(addr));
+  addr.u8[7] = 'E';
+  fails += check("free frames of an empty queue",
+                 mac_txq_free(&addr) == NETSTK_CFG_MAC_TXQ_DEPTH);
+  for (i = 0; i < NETSTK_CFG_MAC_TXQ_DEPTH; i++) {
+    put('E', i, 1);
+  }
+  fails += check("receiver queue full at NETSTK_CFG_MAC_TXQ_DEPTH",
+                 (mac_txq_free(&addr) == 0) && (mac_txq_len() == NETSTK_CFG_MAC_TXQ_DEPTH));
+  addr.u8[7] = 'F';
+  fails += check("other receivers use the rest of the pool",
+                 mac_txq_free(&addr) == NETSTK_CFG_MAC_TXQ_FRAME_NUM - NETSTK_CFG_MAC_TXQ_DEPTH);
+  send_all(NULL);
+  fails += check("all frames taken off the queue",
+                 (mac_txq_len() == 0) && (mac_txq_head() == NULL));
+
+  return fails ? 1 : 0;
+}
@@ -32,17 +32,35 @@
  */
 /**
  * \file
- *         A brief description the file
+ *         Random number generators
+ *
+ *         Two independent generators are provided:
+ *         - a fast non-cryptographic PRNG (xoshiro128**) for backoffs,
+ *           timer jitter, sequence numbers and the like. It is seeded from
+ *           the node MAC address and the platform entropy source, so that
+ *           nodes sharing the same firmware do not draw the same numbers.
+ *         - a CSPRNG (ChaCha20 with fast key erasure) for keys, nonces and
+ *           cookies. It is only as good as the entropy fed to it by
+ *           random_crypto_seed().
  */
 #ifndef RANDOM_H_
 #define RANDOM_H_
 
+#include <stdint.h>
+
 /*
  * Initialize the pseudo-random generator.
  *
+ * The seed is mixed into the current state rather than replacing it, so
+ * calling it again never makes two nodes draw the same numbers.
  */
 void random_init(unsigned short seed);
 
+/*
+ * Mix a byte string, e.g. the MAC address, into the pseudo-random generator.
+ */
+void random_seed(const uint8_t *p_seed, uint16_t len);
+
 /*
  * Calculate a pseudo random number between 0 and 65535.
  *
@@ -50,8 +68,25 @@ void random_init(unsigned short seed);
  */
 unsigned short random_rand(void);
 
+/*
+ * Calculate a 32-bit pseudo random number.
+ */
+uint32_t random_rand32(void);
+
 /* In gcc int rand() uses RAND_MAX and long random() uses RANDOM_MAX */
 /* Since random_rand casts to unsigned short, we'll use this maxmimum */
 #define RANDOM_RAND_MAX 65535U
 
+/*
+ * Mix entropy into the cryptographic generator.
+ */
+void random_crypto_seed(const uint8_t *p_seed, uint16_t len);
+
+/*
+ * Fill a buffer with cryptographically secure random bytes.
+ *
+ * \return 1 on success, 0 if the generator was never seeded.
+ */
+int random_crypto(uint8_t *p_buf, uint16_t len);
+
 #endif /* RANDOM_H_ */
@@ -32,27 +32,180 @@
  */
 /**
  * \file
- *         A brief description the file
+ *         Random number generators: xoshiro128** for the stack and
+ *         ChaCha20 with fast key erasure for cryptographic material
  */
 
 
 #include "random.h"
 
-#include <stdlib.h>
+#include <string.h>
 
+/*---------------------------------------------------------------------------*/
+/* Fast generator state. Never all zeros, so it is usable before seeding */
+static uint32_t state[4] = {
+  0x243F6A88UL, 0x85A308D3UL, 0x13198A2EUL, 0x03707344UL
+};
+
+/* ChaCha20 key of the cryptographic generator, replaced after every use */
+static uint32_t crypto_key[8];
+static uint32_t crypto_counter;
+static uint8_t crypto_seeded;
+
+#define ROTL32(x, n)  (((x) << (n)) | ((x) >> (32 - (n))))
+/*---------------------------------------------------------------------------*/
+static uint32_t
+xoshiro_next(void)
+{
+  uint32_t result;
+  uint32_t t;
+
+  result = ROTL32(state[1] * 5, 7) * 9;
+  t = state[1] << 9;
+  state[2] ^= state[0];
+  state[3] ^= state[1];
+  state[1] ^= state[2];
+  state[0] ^= state[3];
+  state[2] ^= t;
+  state[3] = ROTL32(state[3], 11);
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static void
+xoshiro_mix(uint32_t v)
+{
+  uint8_t i;
+  uint32_t z;
+
+  /* spread the word over the whole state with splitmix32 */
+  for(i = 0; i < 4; i++) {
+    v += 0x9E3779B9UL;
+    z = v;
+    z = (z ^ (z >> 16)) * 0x85EBCA6BUL;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35UL;
+    state[i] ^= z ^ (z >> 16);
+  }
+  if((state[0] | state[1] | state[2] | state[3]) == 0) {
+    state[0] = 1;
+  }
+  xoshiro_next();
+}
 /*---------------------------------------------------------------------------*/
 void
 random_init(unsigned short seed)
 {
-  srand(seed);
+  xoshiro_mix(seed);
+}
+/*---------------------------------------------------------------------------*/
+void
+random_seed(const uint8_t *p_seed, uint16_t len)
+{
+  uint32_t v;
+  uint16_t i;
+
+  v = len;
+  for(i = 0; i < len; i++) {
+    v = (v << 8) | p_seed[i];
+    if((i & 3) == 3 || i == len - 1) {
+      xoshiro_mix(v);
+      v = 0;
+    }
+  }
 }
 /*---------------------------------------------------------------------------*/
 unsigned short
 random_rand(void)
 {
-/* In gcc int rand() uses RAND_MAX and long random() uses RANDOM_MAX=0x7FFFFFFF */
-/* RAND_MAX varies depending on the architecture */
+  /* the upper bits are the best ones */
+  return (unsigned short)(xoshiro_next() >> 16);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+random_rand32(void)
+{
+  return xoshiro_next();
+}
+/*---------------------------------------------------------------------------*/
+#define QR(a, b, c, d) \
+  a += b; d ^= a; d = ROTL32(d, 16); \
+  c += d; b ^= c; b = ROTL32(b, 12); \
+  a += b; d ^= a; d = ROTL32(d, 8);  \
+  c += d; b ^= c; b = ROTL32(b, 7)
+
+/* ChaCha20 block (RFC 7539) with a zero nonce */
+static void
+chacha20_block(uint32_t out[16])
+{
+  uint32_t x[16];
+  uint8_t i;
+
+  x[0] = 0x61707865UL;
+  x[1] = 0x3320646EUL;
+  x[2] = 0x79622D32UL;
+  x[3] = 0x6B206574UL;
+  memcpy(&x[4], crypto_key, sizeof(crypto_key));
+  x[12] = crypto_counter++;
+  x[13] = 0;
+  x[14] = 0;
+  x[15] = 0;
+  memcpy(out, x, sizeof(x));
+
+  for(i = 0; i < 10; i++) {
+    QR(x[0], x[4], x[8], x[12]);
+    QR(x[1], x[5], x[9], x[13]);
+    QR(x[2], x[6], x[10], x[14]);
+    QR(x[3], x[7], x[11], x[15]);
+    QR(x[0], x[5], x[10], x[15]);
+    QR(x[1], x[6], x[11], x[12]);
+    QR(x[2], x[7], x[8], x[13]);
+    QR(x[3], x[4], x[9], x[14]);
+  }
+  for(i = 0; i < 16; i++) {
+    out[i] += x[i];
+  }
+  memset(x, 0, sizeof(x));
+}
+/*---------------------------------------------------------------------------*/
+void
+random_crypto_seed(const uint8_t *p_seed, uint16_t len)
+{
+  uint32_t block[16];
+  uint16_t len_total = len;
+  uint16_t i;
+
+  while(len > 0) {
+    /* absorb up to one key worth of seed, then ratchet the key */
+    for(i = 0; i < sizeof(crypto_key) && len > 0; i++, len--) {
+      ((uint8_t *)crypto_key)[i] ^= *p_seed++;
+    }
+    chacha20_block(block);
+    memcpy(crypto_key, block, sizeof(crypto_key));
+  }
+  memset(block, 0, sizeof(block));
+  crypto_seeded |= (len_total > 0);
+}
+/*---------------------------------------------------------------------------*/
+int
+random_crypto(uint8_t *p_buf, uint16_t len)
+{
+  uint32_t block[16];
+  uint16_t n;
+
+  if(!crypto_seeded) {
+    return 0;
+  }
 
-  return (unsigned short)rand();
+  while(len > 0) {
+    /* the first half of every block becomes the next key, so output that
+       was handed out cannot be recovered from the state */
+    chacha20_block(block);
+    memcpy(crypto_key, block, sizeof(crypto_key));
+    n = len < sizeof(block) - sizeof(crypto_key) ? len : sizeof(block) - sizeof(crypto_key);
+    memcpy(p_buf, (uint8_t *)block + sizeof(crypto_key), n);
+    p_buf += n;
+    len -= n;
+  }
+  memset(block, 0, sizeof(block));
+  return 1;
 }
 /*---------------------------------------------------------------------------*/